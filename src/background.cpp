@@ -31,90 +31,254 @@
 
 OP_NAMESPACE_BEGIN
 
-    class BackGroundThread: public Thread
+    class AsyncDeleteWorker: public Thread
     {
         private:
-	        typedef std::deque<KeyPrefix> KeyQueue;
-	        KeyQueue async_delete_keys;
-	        ThreadMutexLock async_delete_lock;
-	        bool running;
-	        void Run()
-	        {
-	        	Context dctx;
-	        	while(running)
-	        	{
-	        		KeyQueue delete_ks;
-	        		{
-		        		LockGuard<ThreadMutexLock> guard(async_delete_lock);
-		        		if(!async_delete_keys.empty())
-		        		{
-		        			delete_ks = async_delete_keys;
-		        			async_delete_keys.clear();
-		        		}
-	        		}
-	        		while(!delete_ks.empty())
-	        		{
-	        			KeyPrefix& k = delete_ks.front();
-	        			KeyObject dk(k.ns, KEY_META, k.key);
-	        			g_db->DelKey(dctx, dk);
-	        			g_db->UnlockKey(k);
-	        			if(!g_db->GetConf().master_host.empty())
-	        			{
-		        			std::string kstr;
-		        			k.key.ToString(kstr);
-	        				g_db->FeedReplicationDelOperation(dctx, k.ns, kstr);
-	        			}
-	        			delete_ks.pop_front();
-	        		}
-	        		LockGuard<ThreadMutexLock> guard(async_delete_lock);
-	        		async_delete_lock.Wait(500);
-	        	}
-	        }
+            BackGroundThread* m_pool;
+            void Run();
         public:
-	        BackGroundThread():running(true)
+            AsyncDeleteWorker(BackGroundThread* pool)
+                    : m_pool(pool)
             {
+            }
+    };
 
+    /*
+     * Reclaims the elements of deleted versioned collections recorded in the ttl db.
+     */
+    class StaleVersionSweeper: public Thread
+    {
+        private:
+            BackGroundThread* m_pool;
+            void Run();
+        public:
+            StaleVersionSweeper(BackGroundThread* pool)
+                    : m_pool(pool)
+            {
             }
-	        void Shutdown()
-	        {
-	        	running = false;
-	        	LockGuard<ThreadMutexLock> guard(async_delete_lock);
-	            async_delete_lock.Notify();
-	        }
-	        void AsyncDelete(const KeyPrefix& k)
-	        {
-	        	LockGuard<ThreadMutexLock> guard(async_delete_lock);
-	        	g_db->LockKey(k);
-	        	async_delete_keys.push_back(k);
-	        	async_delete_lock.Notify();
-	        }
+    };
 
-            virtual ~BackGroundThread()
+    /*
+     * A pool of async delete workers sharing one key queue. Every queued key is locked until a worker
+     * finished deleting it, so a key is queued at most once.
+     */
+    class BackGroundThread
+    {
+        private:
+            typedef std::deque<KeyPrefix> KeyQueue;
+            typedef std::vector<AsyncDeleteWorker*> WorkerArray;
+            KeyQueue async_delete_keys;
+            KeyPrefixSet pending_keys; /* queued & deleting keys */
+            ThreadMutexLock async_delete_lock;
+            WorkerArray workers;
+            StaleVersionSweeper* sweeper;
+            ThreadMutexLock sweep_lock;
+            bool sweep_pending;
+            volatile bool running;
+        public:
+            volatile uint64 deleting_keys;
+            volatile uint64 deleted_keys;
+            volatile uint64 deleted_elements;
+            volatile uint64 swept_versions;
+            BackGroundThread()
+                    : sweeper(NULL), sweep_pending(true), running(true), deleting_keys(0), deleted_keys(0), deleted_elements(
+                            0), swept_versions(0)
+            {
+            }
+            void Start(int64 threads)
+            {
+                for (int64 i = 0; i < threads; i++)
+                {
+                    AsyncDeleteWorker* worker = NULL;
+                    NEW(worker, AsyncDeleteWorker(this));
+                    worker->Start();
+                    workers.push_back(worker);
+                }
+                NEW(sweeper, StaleVersionSweeper(this));
+                sweeper->Start();
+            }
+            void Shutdown()
+            {
+                {
+                    LockGuard<ThreadMutexLock> guard(async_delete_lock);
+                    running = false;
+                    async_delete_lock.NotifyAll();
+                }
+                {
+                    LockGuard<ThreadMutexLock> guard(sweep_lock);
+                    sweep_lock.NotifyAll();
+                }
+                for (size_t i = 0; i < workers.size(); i++)
+                {
+                    workers[i]->Join();
+                    DELETE(workers[i]);
+                }
+                workers.clear();
+                if (NULL != sweeper)
+                {
+                    sweeper->Join();
+                    DELETE(sweeper);
+                }
+            }
+            /*
+             * stale versions are written by the deleting command's write batch, the sweeper scans the ttl db
+             * when notified & once per second, so a version is only swept after its batch is committed.
+             */
+            bool WaitSweep()
+            {
+                LockGuard<ThreadMutexLock> guard(sweep_lock);
+                if (running && !sweep_pending)
+                {
+                    sweep_lock.Wait(1000);
+                }
+                sweep_pending = false;
+                return running;
+            }
+            void NotifySweep()
+            {
+                LockGuard<ThreadMutexLock> guard(sweep_lock);
+                sweep_pending = true;
+                sweep_lock.Notify();
+            }
+            bool Take(KeyPrefix& k)
+            {
+                LockGuard<ThreadMutexLock> guard(async_delete_lock);
+                while (running && async_delete_keys.empty())
+                {
+                    async_delete_lock.Wait(500);
+                }
+                if (!running)
+                {
+                    return false;
+                }
+                k = async_delete_keys.front();
+                async_delete_keys.pop_front();
+                deleting_keys++;
+                return true;
+            }
+            void Done(const KeyPrefix& k)
+            {
+                {
+                    LockGuard<ThreadMutexLock> guard(async_delete_lock);
+                    pending_keys.erase(k);
+                    deleting_keys--;
+                    deleted_keys++;
+                }
+                g_db->UnlockKey(k);
+            }
+            void AsyncDelete(const KeyPrefix& k, bool locked)
+            {
+                if (!locked)
+                {
+                    {
+                        /*
+                         * the key is already locked by the pool and would be deleted
+                         */
+                        LockGuard<ThreadMutexLock> guard(async_delete_lock);
+                        if (pending_keys.count(k) > 0)
+                        {
+                            return;
+                        }
+                    }
+                    g_db->LockKey(k);
+                }
+                LockGuard<ThreadMutexLock> guard(async_delete_lock);
+                pending_keys.insert(k);
+                async_delete_keys.push_back(k);
+                async_delete_lock.Notify();
+            }
+            void Stats(std::string& info)
             {
+                size_t queued = 0;
+                {
+                    LockGuard<ThreadMutexLock> guard(async_delete_lock);
+                    queued = async_delete_keys.size();
+                }
+                info.append("async_delete_threads:").append(stringfromll(workers.size())).append("\r\n");
+                info.append("async_delete_queue_keys:").append(stringfromll(queued)).append("\r\n");
+                info.append("async_delete_deleting_keys:").append(stringfromll(deleting_keys)).append("\r\n");
+                info.append("async_deleted_keys:").append(stringfromll(deleted_keys)).append("\r\n");
+                info.append("async_deleted_elements:").append(stringfromll(deleted_elements)).append("\r\n");
+                info.append("stale_versions_swept:").append(stringfromll(swept_versions)).append("\r\n");
             }
     };
 
+    void AsyncDeleteWorker::Run()
+    {
+        Context dctx;
+        KeyPrefix k;
+        while (m_pool->Take(k))
+        {
+            KeyObject dk(k.ns, KEY_META, k.key);
+            dctx.ns = k.ns;
+            g_db->DelKeyInChunks(dctx, dk, g_db->GetConf().async_delete_batch_size, &m_pool->deleted_elements);
+            m_pool->Done(k);
+            if (!g_db->GetConf().master_host.empty())
+            {
+                std::string kstr;
+                k.key.ToString(kstr);
+                g_db->FeedReplicationDelOperation(dctx, k.ns, kstr);
+            }
+        }
+    }
+
+    void StaleVersionSweeper::Run()
+    {
+        Context sctx;
+        while (m_pool->WaitSweep())
+        {
+            int64 swept = g_db->SweepStaleVersions(sctx);
+            if (swept > 0)
+            {
+                atomic_add_uint64(&m_pool->swept_versions, swept);
+            }
+        }
+    }
+
     int Ardb::AsyncDeleteKey(Context& ctx, const Data& ns, const std::string& key)
     {
     	KeyPrefix k;
     	k.ns = ns;
     	k.key.SetString(key, false);
-    	g_background->AsyncDelete(k);
+    	g_background->AsyncDelete(k, false);
+    	return 0;
+    }
+
+    int Ardb::AsyncDeleteLockedKey(const KeyPrefix& k)
+    {
+    	g_background->AsyncDelete(k, true);
     	return 0;
     }
 
+    void Ardb::NotifyStaleVersionSweeper()
+    {
+        if (NULL != g_background)
+        {
+            g_background->NotifySweep();
+        }
+    }
+
+    void Ardb::GetAsyncDeleteStats(std::string& info)
+    {
+        if (NULL != g_background)
+        {
+            g_background->Stats(info);
+        }
+    }
+
     int Ardb::CreateBackGroundThread()
     {
     	NEW(g_background, BackGroundThread);
-    	g_background->Start();
+    	g_background->Start(GetConf().async_delete_threads);
+    	CreateKeyScanPool();
     	return 0;
     }
     int Ardb::StopBackGroundThread()
     {
+    	StopKeyScanPool();
     	if(NULL != g_background)
     	{
     		g_background->Shutdown();
-    		g_background->Join();
     		DELETE(g_background);
     	}
     	return 0;
@@ -236,10 +236,17 @@ namespace ardb
                 return 0;
             }
         }
+        ValueObject meta;
+        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_ZSET, meta))
+        {
+            return 0;
+        }
         KeyObjectArray members;
         KeyObject member1(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
+        member1.BindCollection(meta);
         member1.SetZSetMember(cmd.GetArguments()[1]);
         KeyObject member2(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
+        member2.BindCollection(meta);
         member2.SetZSetMember(cmd.GetArguments()[2]);
         members.push_back(member1);
         members.push_back(member2);
@@ -267,10 +274,16 @@ namespace ardb
     int Ardb::GeoHash(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
+        ValueObject meta;
+        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_ZSET, meta))
+        {
+            return 0;
+        }
         KeyObjectArray members;
         for (size_t i = 1; i < cmd.GetArguments().size(); i++)
         {
             KeyObject member(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
+            member.BindCollection(meta);
             member.SetZSetMember(cmd.GetArguments()[i]);
             members.push_back(member);
         }
@@ -328,10 +341,16 @@ namespace ardb
     int Ardb::GeoPos(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
+        ValueObject meta;
+        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_ZSET, meta))
+        {
+            return 0;
+        }
         KeyObjectArray members;
         for (size_t i = 1; i < cmd.GetArguments().size(); i++)
         {
             KeyObject member(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
+            member.BindCollection(meta);
             member.SetZSetMember(cmd.GetArguments()[i]);
             members.push_back(member);
         }
@@ -380,6 +399,232 @@ namespace ardb
         return v1.distance > v2.distance;
     }
 
+    typedef TreeMap<uint64, uint64>::Type HashRangeMap;
+
+    static void AddHashRange(HashRangeMap& ranges, const GeoHashBits& hash)
+    {
+        GeoHashBits next = hash;
+        next.bits++;
+        ranges[GeoHashHelper::AllignHashBits(GEO_STEP_MAX, hash)] = GeoHashHelper::AllignHashBits(GEO_STEP_MAX, next);
+    }
+
+    static void MergeHashRanges(HashRangeMap& tmp, std::vector<ZRangeSpec>& range_array)
+    {
+        HashRangeMap::iterator tit = tmp.begin();
+        HashRangeMap::iterator nit = tmp.begin();
+        nit++;
+        while (tit != tmp.end())
+        {
+            ZRangeSpec range;
+            range.contain_min = true;
+            range.contain_max = true;
+            range.min.SetInt64(tit->first);
+            range.max.SetInt64(tit->second);
+            while (nit != tmp.end() && (int64_t)nit->first == range.max.GetInt64())
+            {
+                range.max.SetInt64(nit->second);
+                nit++;
+                tit++;
+            }
+            range_array.push_back(range);
+            nit++;
+            tit++;
+        }
+    }
+
+    struct GeoBox
+    {
+            double min_x, max_x, min_y, max_y;
+            bool Contains(double px, double py) const
+            {
+                return px >= min_x && px <= max_x && py >= min_y && py <= max_y;
+            }
+            bool Contains(const GeoBox& other) const
+            {
+                return other.min_x >= min_x && other.max_x <= max_x && other.min_y >= min_y && other.max_y <= max_y;
+            }
+    };
+
+    /*
+     * Iterates the sorted set entries of a geo key over hash ranges and keeps the points within
+     * radius. With a non zero 'heap_limit', 'points' is a max heap by distance holding only the
+     * nearest 'heap_limit' points; points inside the 'skip' box are ignored.
+     */
+    struct GeoRangeScanner
+    {
+            Context& ctx;
+            Engine* engine;
+            KeyObject zmember;
+            double x, y, radius;
+            GeoPointArray& points;
+            size_t heap_limit;
+            const GeoBox* skip;
+            Iterator* iter;
+            uint64 scanned;
+            GeoRangeScanner(Context& c, Engine* e, const std::string& key, ValueObject& meta, double px, double py,
+                    double r, GeoPointArray& res)
+                    : ctx(c), engine(e), zmember(c.ns, KEY_ZSET_SORT, key), x(px), y(py), radius(r), points(res), heap_limit(
+                            0), skip(NULL), iter(NULL), scanned(0)
+            {
+                zmember.BindCollection(meta);
+            }
+            void Keep(GeoPoint& point)
+            {
+                if (0 == heap_limit)
+                {
+                    points.push_back(point);
+                }
+                else if (points.size() < heap_limit)
+                {
+                    points.push_back(point);
+                    std::push_heap(points.begin(), points.end(), less_by_distance);
+                }
+                else if (point.distance < points.front().distance)
+                {
+                    std::pop_heap(points.begin(), points.end(), less_by_distance);
+                    points.back() = point;
+                    std::push_heap(points.begin(), points.end(), less_by_distance);
+                }
+            }
+            void Scan(std::vector<ZRangeSpec>& range_array)
+            {
+                std::vector<ZRangeSpec>::iterator hit = range_array.begin();
+                while (hit != range_array.end())
+                {
+                    ZRangeSpec& range = *hit;
+                    zmember.SetZSetScore(range.min.GetFloat64());
+                    if (NULL == iter)
+                    {
+                        iter = engine->Find(ctx, zmember);
+                    }
+                    else
+                    {
+                        iter->Jump(zmember);
+                    }
+                    while (iter->Valid())
+                    {
+                        KeyObject& zkey = iter->Key(true);
+                        if (zkey.GetType() != KEY_ZSET_SORT || zkey.GetKey() != zmember.GetKey() || zkey.GetNameSpace() != ctx.ns
+                                || zkey.GetVersion() != zmember.GetVersion())
+                        {
+                            break;
+                        }
+                        int inrange = range.InRange(zkey.GetZSetScore());
+                        if (0 == inrange)
+                        {
+                            GeoPoint point;
+                            point.score = (int64_t) zkey.GetZSetScore();
+                            scanned++;
+                            if (GeoHashHelper::GetXYByHash(GEO_WGS84_TYPE, GEO_STEP_MAX, (uint64) point.score, point.x, point.y)
+                                    && (NULL == skip || !skip->Contains(point.x, point.y)))
+                            {
+                                point.distance = GeoHashHelper::GetWGS84Distance(x, y, point.x, point.y);
+                                if (point.distance < radius)
+                                {
+                                    point.value = zkey.GetZSetMember();
+                                    Keep(point);
+                                }
+                            }
+                        }
+                        else if (inrange > 0)
+                        {
+                            break;
+                        }
+                        iter->Next();
+                    }
+                    if (!iter->Valid())
+                    {
+                        break;
+                    }
+                    hit++;
+                }
+            }
+            ~GeoRangeScanner()
+            {
+                DELETE(iter);
+            }
+    };
+
+    static const int kGeoNearestRingsPerStep = 4;
+    static const int kGeoNearestMaxRings = 64;
+
+    /*
+     * k nearest search: scan rings of geohash cells around the query point, nearest ring first,
+     * keeping the best k candidates in a max heap. Stop once nothing outside of the scanned block
+     * could beat the current k-th distance or be within radius. If the heap is still short after
+     * a few rings the cells are too small, so continue one step coarser skipping the block scanned.
+     * Return false if the search gives up (too many rings, or the block reaches the 180th meridian);
+     * the caller falls back to scanning every area within radius then.
+     */
+    static bool GeoRadiusNearest(GeoRangeScanner& scanner, size_t k, uint8 min_step, uint8 step)
+    {
+        GeoHashRange lat_range, lon_range;
+        GeoHashHelper::GetCoordRange(GEO_WGS84_TYPE, lat_range, lon_range);
+        scanner.heap_limit = k;
+        scanner.skip = NULL;
+        GeoBox scanned_box;
+        int total_rings = 0;
+        while (true)
+        {
+            int64 cells = 1LL << step;
+            double cell_w = (lon_range.max - lon_range.min) / cells;
+            double cell_h = (lat_range.max - lat_range.min) / cells;
+            int64 ci = (int64) ((scanner.x - lon_range.min) / cell_w);
+            int64 cj = (int64) ((scanner.y - lat_range.min) / cell_h);
+            ci = ci >= cells ? cells - 1 : ci;
+            cj = cj >= cells ? cells - 1 : cj;
+            bool coarsen = false;
+            for (int64 r = 0; !coarsen; r++)
+            {
+                if (ci - r < 0 || ci + r >= cells || ++total_rings > kGeoNearestMaxRings)
+                {
+                    return false;
+                }
+                HashRangeMap ring;
+                for (int64 j = cj - r; j <= cj + r; j++)
+                {
+                    if (j < 0 || j >= cells)
+                    {
+                        continue;
+                    }
+                    int64 di = (j == cj - r || j == cj + r) ? 1 : 2 * r;
+                    for (int64 i = ci - r; i <= ci + r; i += di)
+                    {
+                        GeoHashBits hash;
+                        geohash_fast_encode(lat_range, lon_range, lat_range.min + (j + 0.5) * cell_h,
+                                lon_range.min + (i + 0.5) * cell_w, step, &hash);
+                        AddHashRange(ring, hash);
+                    }
+                }
+                std::vector<ZRangeSpec> range_array;
+                MergeHashRanges(ring, range_array);
+                scanner.Scan(range_array);
+
+                GeoBox box;
+                box.min_x = lon_range.min + (ci - r) * cell_w;
+                box.max_x = lon_range.min + (ci + r + 1) * cell_w;
+                box.min_y = cj - r <= 0 ? lat_range.min : lat_range.min + (cj - r) * cell_h;
+                box.max_y = cj + r + 1 >= cells ? lat_range.max : lat_range.min + (cj + r + 1) * cell_h;
+                double bound = GeoHashHelper::GetWGS84DistanceOutsideBox(scanner.x, scanner.y, box.min_x, box.max_x,
+                        box.min_y, box.max_y);
+                if (bound >= scanner.radius || (scanner.points.size() >= k && bound >= scanner.points.front().distance))
+                {
+                    std::sort_heap(scanner.points.begin(), scanner.points.end(), less_by_distance);
+                    return true;
+                }
+                if (scanner.points.size() < k && r + 1 >= kGeoNearestRingsPerStep && step > min_step
+                        && (NULL == scanner.skip || box.Contains(scanned_box)))
+                {
+                    scanned_box = box;
+                    scanner.skip = &scanned_box;
+                    step--;
+                    coarsen = true;
+                }
+            }
+        }
+        return false;
+    }
+
     /*
      *  GEORADIUS key x y              <GeoOptions>
      *  GEORADIUSBYMEMBER key member   <GeoOptions>
@@ -403,6 +648,8 @@ namespace ardb
         double x, y, radius;
 
         size_t radius_arg_pos = 3;
+        KeyObject geokey(ctx.ns, KEY_META, cmd.GetArguments()[0]);
+        ValueObject geometa;
         GeoHashRange lat_range, lon_range;
         GeoHashHelper::GetCoordRange(GEO_WGS84_TYPE, lat_range, lon_range);
         if (cmd.GetType() == REDIS_CMD_GEO_RADIUS)
@@ -422,7 +669,12 @@ namespace ardb
         }
         else
         {
+            if (!CheckMeta(ctx, geokey, KEY_ZSET, geometa))
+            {
+                return 0;
+            }
             KeyObject member(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
+            member.BindCollection(geometa);
             member.SetZSetMember(cmd.GetArguments()[1]);
             ValueObject score_val;
             int err = m_engine->Get(ctx, member, score_val);
@@ -466,112 +718,72 @@ namespace ardb
             return 0;
         }
 
-        KeyObject geokey(ctx.ns, KEY_META, cmd.GetArguments()[0]);
-        ValueObject geometa;
-        if (!CheckMeta(ctx, geokey, KEY_ZSET, geometa))
+        if (cmd.GetType() == REDIS_CMD_GEO_RADIUS && !CheckMeta(ctx, geokey, KEY_ZSET, geometa))
         {
             return 0;
         }
 
-        /*
-         * 1. Get all neighbors area by radius
-         */
-        GeoHashBitsSet ress;
-        GeoHashHelper::GetAreasByRadius(GEO_WGS84_TYPE, y, x, radius, ress);
-
-        /*
-         * 2. Merge neighbors areas if possible to avoid more tree search
-         */
-        std::vector<ZRangeSpec> range_array;
-        GeoHashBitsSet::iterator rit = ress.begin();
-        typedef TreeMap<uint64, uint64>::Type HashRangeMap;
-        HashRangeMap tmp;
-        while (rit != ress.end())
-        {
-            GeoHashBits& hash = *rit;
-            GeoHashBits next = hash;
-            next.bits++;
-            tmp[GeoHashHelper::AllignHashBits(GEO_STEP_MAX, hash)] = GeoHashHelper::AllignHashBits(GEO_STEP_MAX, next);
-            rit++;
-        }
-        HashRangeMap::iterator tit = tmp.begin();
-        HashRangeMap::iterator nit = tmp.begin();
-        nit++;
-        while (tit != tmp.end())
-        {
-            ZRangeSpec range;
-            range.contain_min = true;
-            range.contain_max = true;
-            range.min.SetInt64(tit->first);
-            range.max.SetInt64(tit->second);
-            while (nit != tmp.end() && (int64_t)nit->first == range.max.GetInt64())
-            {
-                range.max.SetInt64(nit->second);
-                nit++;
-                tit++;
-            }
-            range_array.push_back(range);
-            nit++;
-            tit++;
-        }
-
-        /*
-         * 3. Get all data by iterate areas
-         */
         GeoPointArray points;
-        std::vector<ZRangeSpec>::iterator hit = range_array.begin();
-        Iterator* iter = NULL;
-        //printf("###%d \n", range_array.size());
-        while (hit != range_array.end())
+        GeoRangeScanner scanner(ctx, m_engine, cmd.GetArguments()[0], geometa, x, y, radius, points);
+        bool nearest = false;
+        if (!options.nosort && options.asc && options.limit > 0)
         {
-            ZRangeSpec& range = *hit;
-            KeyObject zmember(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
-            zmember.SetZSetScore(range.min.GetFloat64());
-            if (NULL == iter)
-            {
-                iter = m_engine->Find(ctx, zmember);
-            }
-            else
+            /*
+             * 1. COUNT with ascending order only needs the nearest (offset + limit) points
+             */
+            size_t k = (size_t) options.offset + options.limit;
+            uint8 min_step = GeoHashHelper::EstimateStepsByRadius(GEO_WGS84_TYPE, radius, y);
+            uint8 start_step = min_step;
+            uint64 len = geometa.GetObjectLen();
+            while (len > k && start_step < GEO_STEP_MAX - 1)
             {
-                iter->Jump(zmember);
+                len /= 4;
+                start_step++;
             }
-            //printf("###%.2f\n", range.min.GetFloat64());
-            while (iter->Valid())
+            nearest = GeoRadiusNearest(scanner, k, min_step, start_step);
+            if (!nearest)
             {
-                KeyObject& zkey = iter->Key(true);
-                if (zkey.GetType() != KEY_ZSET_SORT || zkey.GetKey() != zmember.GetKey() || zkey.GetNameSpace() != ctx.ns)
-                {
-                    break;
-                }
-                int inrange = range.InRange(zkey.GetZSetScore());
-                if (0 == inrange)
-                {
-                    GeoPoint point;
-                    point.score = (int64_t) zkey.GetZSetScore();
-                    point.value = zkey.GetZSetMember();
-                    //printf("###Find %lld %s\n", point.score, point.value.AsString().c_str());
-                    if (GeoHashHelper::GetXYByHash(GEO_WGS84_TYPE, GEO_STEP_MAX, (uint64) point.score, point.x, point.y))
-                    {
-                        point.distance = GeoHashHelper::GetWGS84Distance(x, y, point.x, point.y);
-                        if (point.distance < radius)
-                        {
-                            points.push_back(point);
-                        }
-                    }
-                }
-                else if (inrange > 0)
-                {
-                    break;
-                }
-                iter->Next();
+                points.clear();
+                scanner.heap_limit = 0;
+                scanner.skip = NULL;
             }
-            if (!iter->Valid())
+        }
+        if (!nearest)
+        {
+            /*
+             * 1. Get all neighbors area by radius
+             */
+            GeoHashBitsSet ress;
+            GeoHashHelper::GetAreasByRadius(GEO_WGS84_TYPE, y, x, radius, ress);
+
+            /*
+             * 2. Merge neighbors areas if possible to avoid more tree search
+             */
+            HashRangeMap tmp;
+            GeoHashBitsSet::iterator rit = ress.begin();
+            while (rit != ress.end())
             {
-                break;
+                AddHashRange(tmp, *rit);
+                rit++;
             }
-            hit++;
+            std::vector<ZRangeSpec> range_array;
+            MergeHashRanges(tmp, range_array);
+
+            /*
+             * 3. Get all data by iterate areas
+             */
+            scanner.Scan(range_array);
+        }
+        DEBUG_LOG("GEORADIUS %s scanned %llu points, kept %llu%s", cmd.GetArguments()[0].c_str(),
+                (unsigned long long) scanner.scanned,
+                (unsigned long long) points.size(), nearest ? " by nearest search" : "");
+        atomic_add_uint64(&m_geo_radius_queries, 1);
+        if (nearest)
+        {
+            atomic_add_uint64(&m_geo_nearest_queries, 1);
         }
-        DELETE(iter);
+        atomic_add_uint64(&m_geo_points_scanned, scanner.scanned);
+        atomic_add_uint64(&m_geo_points_kept, points.size());
 
         /*
          * 4. sort & erase results
@@ -663,23 +875,33 @@ namespace ardb
                 ValueObject dstmeta;
                 dstmeta.SetType(KEY_ZSET);
                 dstmeta.SetObjectLen(points.size());
+                dstmeta.GetMetaObject().zset_rank_index = GetConf().zset_rank_index;
+                NewCollectionVersion(dstmeta);
+                RankIndexDeltaTable rank_deltas;
                 GeoPointArray::iterator pit = points.begin();
                 while (pit != points.end())
                 {
                     KeyObject zsort(ctx.ns, KEY_ZSET_SORT, options.storekey);
+                    zsort.BindCollection(dstmeta);
                     zsort.SetZSetMember(pit->value);
                     zsort.SetZSetScore(options.storedist ? pit->distance : pit->score);
                     ValueObject zsort_value;
                     zsort_value.SetType(KEY_ZSET_SORT);
                     KeyObject zscore(ctx.ns, KEY_ZSET_SCORE, options.storekey);
+                    zscore.BindCollection(dstmeta);
                     zscore.SetZSetMember(pit->value);
                     ValueObject zscore_value;
                     zscore_value.SetType(KEY_ZSET_SCORE);
                     zscore_value.SetZSetScore(options.storedist ? pit->distance : pit->score);
                     SetKeyValue(ctx, zsort, zsort_value);
                     SetKeyValue(ctx, zscore, zscore_value);
+                    if (dstmeta.GetMetaObject().zset_rank_index)
+                    {
+                        RankIndexUpdate(rank_deltas, zscore_value.GetZSetScore(), 1);
+                    }
                     pit++;
                 }
+                RankIndexCommit(ctx, KEY_ZSET_RANK, options.storekey, dstmeta, rank_deltas);
                 SetKeyValue(ctx, dstkey, dstmeta);
             }
             if (0 == ctx.transc_err)
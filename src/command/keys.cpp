@@ -28,8 +28,38 @@
  */
 #include "../repl/snapshot.hpp"
 #include "db/db.hpp"
+#include <deque>
+#include <algorithm>
 
 OP_NAMESPACE_BEGIN
+    /*
+     * element key types of a versioned collection
+     */
+    static size_t versioned_element_types(uint8 collection_type, const KeyType*& types)
+    {
+        static const KeyType zset_types[] = { KEY_ZSET_SORT, KEY_ZSET_SCORE, KEY_ZSET_RANK };
+        static const KeyType list_types[] = { KEY_LIST_ELEMENT, KEY_LIST_RANK };
+        static const KeyType bitmap_types[] = { KEY_BITMAP_SEGMENT };
+        switch (collection_type)
+        {
+            case KEY_ZSET:
+            {
+                types = zset_types;
+                return arraysize(zset_types);
+            }
+            case KEY_BITMAP:
+            {
+                types = bitmap_types;
+                return arraysize(bitmap_types);
+            }
+            default:
+            {
+                types = list_types;
+                return arraysize(list_types);
+            }
+        }
+    }
+
     int Ardb::ObjectLen(Context& ctx, KeyType type, const std::string& keystr)
     {
         RedisReply& reply = ctx.GetReply();
@@ -53,12 +83,13 @@ OP_NAMESPACE_BEGIN
             KeyType ele_type = element_type(type);
             int64_t len = 0;
             KeyObject key(ctx.ns, ele_type, keystr);
+            key.BindCollection(meta);
             Iterator* iter = m_engine->Find(ctx, key);
             while (NULL != iter && iter->Valid())
             {
                 KeyObject& field = iter->Key();
                 if (field.GetType() != ele_type || field.GetNameSpace() != key.GetNameSpace()
-                        || field.GetKey() != key.GetKey())
+                        || field.GetKey() != key.GetKey() || field.GetVersion() != key.GetVersion())
                 {
                     break;
                 }
@@ -84,6 +115,7 @@ OP_NAMESPACE_BEGIN
         }
         KeyType ele_type = element_type((KeyType) meta.GetType());
         KeyObject start_element(ctx.ns, ele_type, key.GetKey());
+        start_element.BindCollection(meta);
         start_element.SetMember(meta.GetMin(), 0);
         if (meta.GetMax().IsNil())
         {
@@ -101,8 +133,8 @@ OP_NAMESPACE_BEGIN
             return -1;
         }
         KeyObject& min_key = iter->Key(true);
-        if (min_key.GetKey() != key.GetKey() || min_key.GetType() != ele_type
-                || min_key.GetNameSpace() != key.GetNameSpace())
+        if (min_key.GetKey() != start_element.GetKey() || min_key.GetType() != ele_type
+                || min_key.GetNameSpace() != key.GetNameSpace() || min_key.GetVersion() != start_element.GetVersion())
         {
             WARN_LOG("Invalid start iterator to fetch max element");
             DELETE(iter);
@@ -124,8 +156,8 @@ OP_NAMESPACE_BEGIN
                 return -1;
             }
             KeyObject& iter_key = iter->Key(true);
-            if (iter_key.GetType() != ele_type || iter_key.GetKey() != key.GetKey()
-                    || iter_key.GetNameSpace() != key.GetNameSpace())
+            if (iter_key.GetType() != ele_type || iter_key.GetKey() != start_element.GetKey()
+                    || iter_key.GetNameSpace() != key.GetNameSpace() || iter_key.GetVersion() != start_element.GetVersion())
             {
                 DELETE(iter);
                 WARN_LOG("Invalid iterator key to fetch max element");
@@ -144,7 +176,7 @@ OP_NAMESPACE_BEGIN
     }
     int Ardb::GetMinMax(Context& ctx, const KeyObject& key, KeyType expected, ValueObject& meta, Iterator*& iter)
     {
-        m_engine->Get(ctx, key, meta);
+        GetMeta(ctx, key, meta);
         if (meta.GetType() > 0 && meta.GetType() != expected)
         {
             return -1;
@@ -152,6 +184,492 @@ OP_NAMESPACE_BEGIN
         return GetMinMax(ctx, key, meta, iter);
     }
 
+    /*
+     * One KEYS/KEYSCOUNT/SCAN MATCH/DBSIZE EXACT pass over the key partitions of a namespace. The caller and
+     * the key scan workers helping it claim partitions through 'next', every partition has its own result slot.
+     */
+    struct KeyScanJob
+    {
+            Context* caller;
+            std::string pattern; /* empty matches all keys */
+            std::string prefix; /* every key matching the pattern starts with it */
+            bool collect; /* keep the matched keys or only count them */
+            uint64 max_matches; /* abort all partitions once that many keys matched, 0 is unlimited */
+            int64 scan_limit; /* stop a partition after scanning that many keys, 0 is unlimited */
+            int64 match_limit; /* or after matching that many */
+            StringArray bounds;
+            std::vector<StringArray> matches;
+            std::vector<int64> counts;
+            StringArray last_keys; /* last key scanned by a partition stopped by a limit */
+            std::vector<uint8> stopped;
+            volatile uint32 next;
+            volatile uint64 matched;
+            volatile bool aborted;
+            uint32 helpers; /* workers running the job, guarded by the pool lock */
+            KeyScanJob()
+                    : caller(NULL), collect(true), max_matches(0), scan_limit(0), match_limit(0), next(0), matched(0), aborted(
+                            false), helpers(0)
+            {
+            }
+    };
+
+    class KeyScanPool;
+    class KeyScanWorker: public Thread
+    {
+        private:
+            KeyScanPool* m_pool;
+            void Run();
+        public:
+            KeyScanWorker(KeyScanPool* pool)
+                    : m_pool(pool)
+            {
+            }
+    };
+
+    /*
+     * Helper threads shared by all key scans. A job is queued once per worker it may use and a worker runs one
+     * job at a time, so scans never keep more cpus busy than the pool's threads plus their own callers.
+     */
+    class KeyScanPool
+    {
+        private:
+            typedef std::deque<KeyScanJob*> JobQueue;
+            typedef std::vector<KeyScanWorker*> WorkerArray;
+            JobQueue jobs;
+            WorkerArray workers;
+            ThreadMutexLock lock;
+            volatile bool running;
+        public:
+            KeyScanPool()
+                    : running(true)
+            {
+            }
+            size_t Size() const
+            {
+                return workers.size();
+            }
+            void Start(int64 threads)
+            {
+                for (int64 i = 0; i < threads; i++)
+                {
+                    KeyScanWorker* worker = NULL;
+                    NEW(worker, KeyScanWorker(this));
+                    worker->Start();
+                    workers.push_back(worker);
+                }
+            }
+            void Shutdown()
+            {
+                {
+                    LockGuard<ThreadMutexLock> guard(lock);
+                    running = false;
+                    lock.NotifyAll();
+                }
+                for (size_t i = 0; i < workers.size(); i++)
+                {
+                    workers[i]->Join();
+                    DELETE(workers[i]);
+                }
+                workers.clear();
+            }
+            void Submit(KeyScanJob* job, size_t helpers)
+            {
+                LockGuard<ThreadMutexLock> guard(lock);
+                for (size_t i = 0; i < helpers; i++)
+                {
+                    jobs.push_back(job);
+                }
+                lock.NotifyAll();
+            }
+            KeyScanJob* Take()
+            {
+                LockGuard<ThreadMutexLock> guard(lock);
+                while (running && jobs.empty())
+                {
+                    lock.Wait(500);
+                }
+                if (!running)
+                {
+                    return NULL;
+                }
+                KeyScanJob* job = jobs.front();
+                jobs.pop_front();
+                job->helpers++;
+                return job;
+            }
+            void Done(KeyScanJob* job)
+            {
+                LockGuard<ThreadMutexLock> guard(lock);
+                job->helpers--;
+                lock.NotifyAll();
+            }
+            /*
+             * drops the job's entries no worker took yet, then waits for the workers still running it
+             */
+            void Finish(KeyScanJob* job)
+            {
+                LockGuard<ThreadMutexLock> guard(lock);
+                JobQueue::iterator it = jobs.begin();
+                while (it != jobs.end())
+                {
+                    if (*it == job)
+                    {
+                        it = jobs.erase(it);
+                    }
+                    else
+                    {
+                        it++;
+                    }
+                }
+                while (job->helpers > 0)
+                {
+                    lock.Wait(1);
+                }
+            }
+    };
+    static KeyScanPool* g_key_scan_pool = NULL;
+
+    void KeyScanWorker::Run()
+    {
+        Context sctx;
+        KeyScanJob* job = NULL;
+        while (NULL != (job = m_pool->Take()))
+        {
+            sctx.ns = job->caller->ns;
+            sctx.engine_snapshot = job->caller->engine_snapshot;
+            uint32 idx = 0;
+            while ((idx = atomic_add_uint32(&job->next, 1) - 1) < job->bounds.size())
+            {
+                g_db->ScanKeyPartition(sctx, *job, idx);
+            }
+            sctx.engine_snapshot = NULL;
+            m_pool->Done(job);
+        }
+    }
+
+    int Ardb::CreateKeyScanPool()
+    {
+        if (GetConf().scan_parallel_threads > 0)
+        {
+            NEW(g_key_scan_pool, KeyScanPool);
+            g_key_scan_pool->Start(GetConf().scan_parallel_threads);
+        }
+        return 0;
+    }
+    int Ardb::StopKeyScanPool()
+    {
+        if (NULL != g_key_scan_pool)
+        {
+            g_key_scan_pool->Shutdown();
+            DELETE(g_key_scan_pool);
+        }
+        return 0;
+    }
+
+    /*
+     * Split points are cached per namespace for a while, they only balance the work: partitions cover the whole
+     * key space whatever the bounds are.
+     */
+    struct KeySplitsCache
+    {
+            StringArray splits;
+            uint64 ts;
+            KeySplitsCache()
+                    : ts(0)
+            {
+            }
+    };
+    typedef TreeMap<std::string, KeySplitsCache>::Type KeySplitsCacheTable;
+    static KeySplitsCacheTable g_key_splits;
+    static SpinMutexLock g_key_splits_lock;
+    static const size_t kMaxKeySplits = 256;
+    static const uint64 kKeySplitsTTLMicros = 10 * 1000 * 1000;
+    static const uint64 kKeysMaxMatches = 10000;
+
+    /*
+     * keeps 'max' evenly spaced elements of 'src'
+     */
+    static void pick_evenly(const StringArray& src, size_t max, StringArray& dst)
+    {
+        for (size_t i = 0; i < src.size(); i++)
+        {
+            if (src.size() <= max || (i * max) / src.size() != ((i + 1) * max) / src.size())
+            {
+                dst.push_back(src[i]);
+            }
+        }
+    }
+
+    /*
+     * literal head of a glob pattern, all keys it matches start with it
+     */
+    static void pattern_prefix(const std::string& pattern, std::string& prefix)
+    {
+        prefix.clear();
+        for (size_t i = 0; i < pattern.size(); i++)
+        {
+            if (pattern[i] == '*' || pattern[i] == '?' || pattern[i] == '[' || pattern[i] == '\\')
+            {
+                break;
+            }
+            prefix.append(1, pattern[i]);
+        }
+    }
+
+    /*
+     * a random key in [lo, hi), 'hi' NULL is unbounded
+     */
+    static std::string random_key_between(const std::string& lo, const std::string* hi)
+    {
+        size_t common = 0;
+        if (NULL != hi)
+        {
+            while (common < lo.size() && common < hi->size() && lo[common] == (*hi)[common])
+            {
+                common++;
+            }
+        }
+        int lo_c = common < lo.size() ? (uint8) lo[common] : 0;
+        int hi_c = NULL != hi ? (common < hi->size() ? (uint8) (*hi)[common] : 0) : 256;
+        if (hi_c <= lo_c)
+        {
+            return lo;
+        }
+        std::string key = lo.substr(0, common);
+        key.append(1, (char) (lo_c + random() % (hi_c - lo_c)));
+        for (int i = 0; i < 4; i++)
+        {
+            key.append(1, (char) (random() & 0xFF));
+        }
+        return key < lo ? lo : key;
+    }
+
+    void Ardb::SampleKeySplits(Context& ctx, size_t max, StringArray& splits)
+    {
+        splits.clear();
+        ctx.flags.iterate_multi_keys = 1;
+        ctx.flags.iterate_no_upperbound = 1;
+        ctx.flags.iterate_total_order = 1;
+        KeyObject startkey(ctx.ns, KEY_META, "");
+        Iterator* iter = m_engine->Find(ctx, startkey);
+        if (NULL == iter || !iter->Valid())
+        {
+            DELETE(iter);
+            return;
+        }
+        std::string first, last, key;
+        iter->Key().GetKey().ToString(first);
+        iter->JumpToLast();
+        if (!iter->Valid() || iter->Key().GetNameSpace() != ctx.ns)
+        {
+            DELETE(iter);
+            return;
+        }
+        iter->Key().GetKey().ToString(last);
+        /*
+         * all keys share the common prefix of the first & last ones, probing every value of the byte after it
+         * finds where the keys actually are
+         */
+        size_t common = 0;
+        while (common < first.size() && common < last.size() && first[common] == last[common])
+        {
+            common++;
+        }
+        std::string probe = first.substr(0, common);
+        probe.append(1, 0);
+        StringArray candidates;
+        for (int c = 0; c < 256; c++)
+        {
+            probe[common] = (char) c;
+            KeyObject next(ctx.ns, KEY_META, probe);
+            iter->Jump(next);
+            if (!iter->Valid() || iter->Key().GetNameSpace() != ctx.ns)
+            {
+                break;
+            }
+            iter->Key().GetKey().ToString(key);
+            if (key > first && (candidates.empty() || key > candidates.back()))
+            {
+                candidates.push_back(key);
+            }
+        }
+        DELETE(iter);
+        pick_evenly(candidates, max, splits);
+    }
+
+    void Ardb::GetKeyPartitions(Context& ctx, size_t max, StringArray& bounds)
+    {
+        bounds.assign(1, "");
+        if (max <= 1)
+        {
+            return;
+        }
+        std::string ns = ctx.ns.AsString();
+        uint64 now = get_current_epoch_micros();
+        StringArray splits;
+        bool cached = false;
+        {
+            LockGuard<SpinMutexLock> guard(g_key_splits_lock);
+            KeySplitsCacheTable::iterator found = g_key_splits.find(ns);
+            if (found != g_key_splits.end() && found->second.ts + kKeySplitsTTLMicros > now)
+            {
+                splits = found->second.splits;
+                cached = true;
+            }
+        }
+        if (!cached)
+        {
+            if (0 != m_engine->GetKeySplits(ctx, ctx.ns, kMaxKeySplits, splits) || splits.empty())
+            {
+                SampleKeySplits(ctx, kMaxKeySplits, splits);
+            }
+            LockGuard<SpinMutexLock> guard(g_key_splits_lock);
+            KeySplitsCache& cache = g_key_splits[ns];
+            cache.splits = splits;
+            cache.ts = now;
+        }
+        StringArray picked;
+        pick_evenly(splits, max - 1, picked);
+        for (size_t i = 0; i < picked.size(); i++)
+        {
+            if (!picked[i].empty())
+            {
+                bounds.push_back(picked[i]);
+            }
+        }
+    }
+
+    size_t Ardb::KeyScanPartitionsLimit(Context& ctx)
+    {
+        /*
+         * an EXEC batch is only visible to the thread owning it
+         */
+        if (NULL == g_key_scan_pool || NULL != ctx.transc_keys)
+        {
+            return 1;
+        }
+        int64 estimate = m_engine->EstimateKeysNum(ctx, ctx.ns); /* negative when the engine can not tell */
+        if (estimate >= 0 && estimate < GetConf().scan_parallel_min_keys)
+        {
+            return 1;
+        }
+        /*
+         * more partitions than threads, so a thread done with a small one takes another
+         */
+        return (g_key_scan_pool->Size() + 1) * 4;
+    }
+
+    void Ardb::ScanKeyPartition(Context& ctx, KeyScanJob& job, size_t idx)
+    {
+        const std::string* upper = idx + 1 < job.bounds.size() ? &job.bounds[idx + 1] : NULL;
+        const std::string& start = job.bounds[idx] < job.prefix ? job.prefix : job.bounds[idx];
+        if (NULL != upper && start >= *upper)
+        {
+            return;
+        }
+        ctx.flags.iterate_multi_keys = 1;
+        ctx.flags.iterate_no_upperbound = 1;
+        /*
+         * for rocksdb, this flag must be set for right behavior
+         */
+        ctx.flags.iterate_total_order = 1;
+        KeyObject startkey(ctx.ns, KEY_META, start);
+        Iterator* iter = m_engine->Find(ctx, startkey);
+        StringArray& matches = job.matches[idx];
+        int64 scanned = 0, matched = 0;
+        std::string keystr;
+        while (NULL != iter && iter->Valid() && !job.aborted)
+        {
+            KeyObject& k = iter->Key();
+            k.GetKey().ToString(keystr);
+            if ((NULL != upper && keystr >= *upper) || keystr.compare(0, job.prefix.size(), job.prefix) != 0)
+            {
+                break;
+            }
+            if (k.GetType() == KEY_META)
+            {
+                scanned++;
+                if (job.pattern.empty()
+                        || stringmatchlen(job.pattern.c_str(), job.pattern.size(), keystr.c_str(), keystr.size(), 0) == 1)
+                {
+                    matched++;
+                    if (job.collect)
+                    {
+                        matches.push_back(keystr);
+                    }
+                    if (job.max_matches > 0 && atomic_add_uint64(&job.matched, 1) >= job.max_matches)
+                    {
+                        job.aborted = true;
+                        break;
+                    }
+                }
+                if (job.scan_limit > 0 && (scanned >= job.scan_limit || matched >= job.match_limit))
+                {
+                    job.last_keys[idx] = keystr;
+                    job.stopped[idx] = 1;
+                    break;
+                }
+                if (iter->Value().GetType() == KEY_STRING)
+                {
+                    iter->Next();
+                    continue;
+                }
+            }
+            /*
+             * skip the elements of a collection
+             */
+            keystr.append(1, 0);
+            KeyObject next(ctx.ns, KEY_META, keystr);
+            iter->Jump(next);
+        }
+        job.counts[idx] = matched;
+        DELETE(iter);
+    }
+
+    void Ardb::RunKeyScanJob(Context& ctx, KeyScanJob& job)
+    {
+        size_t num = job.bounds.size();
+        job.caller = &ctx;
+        job.matches.resize(num);
+        job.counts.assign(num, 0);
+        job.last_keys.resize(num);
+        job.stopped.assign(num, 0);
+        size_t helpers = 0;
+        if (num > 1 && NULL != g_key_scan_pool)
+        {
+            helpers = std::min(num - 1, g_key_scan_pool->Size());
+            g_key_scan_pool->Submit(&job, helpers);
+        }
+        uint32 idx = 0;
+        while ((idx = atomic_add_uint32(&job.next, 1) - 1) < num)
+        {
+            ScanKeyPartition(ctx, job, idx);
+        }
+        if (helpers > 0)
+        {
+            g_key_scan_pool->Finish(&job);
+        }
+    }
+
+    int64 Ardb::CountKeys(Context& ctx, const std::string& pattern)
+    {
+        KeyScanJob job;
+        job.collect = false;
+        if (pattern != "*")
+        {
+            job.pattern = pattern;
+            pattern_prefix(pattern, job.prefix);
+        }
+        GetKeyPartitions(ctx, KeyScanPartitionsLimit(ctx), job.bounds);
+        RunKeyScanJob(ctx, job);
+        int64 count = 0;
+        for (size_t i = 0; i < job.counts.size(); i++)
+        {
+            count += job.counts[i];
+        }
+        return count;
+    }
+
     int Ardb::KeysCount(Context& ctx, RedisCommandFrame& cmd)
     {
         return Keys(ctx, cmd);
@@ -159,7 +677,14 @@ OP_NAMESPACE_BEGIN
     int Ardb::Randomkey(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
-        KeyObject startkey(ctx.ns, KEY_META, "");
+        /*
+         * a uniformly random partition, then a random key inside it
+         */
+        StringArray bounds;
+        GetKeyPartitions(ctx, 64, bounds);
+        size_t idx = random() % bounds.size();
+        std::string probe = random_key_between(bounds[idx], idx + 1 < bounds.size() ? &bounds[idx + 1] : NULL);
+        KeyObject startkey(ctx.ns, KEY_META, probe);
         ctx.flags.iterate_multi_keys = 1;
         ctx.flags.iterate_no_upperbound = 1;
         /*
@@ -167,15 +692,89 @@ OP_NAMESPACE_BEGIN
          */
         ctx.flags.iterate_total_order = 1;
         Iterator* iter = m_engine->Find(ctx, startkey);
-        if (iter->Valid())
+        for (int pass = 0; pass < 2 && NULL != iter; pass++)
         {
-            KeyObject& k = iter->Key();
-            reply.SetString(k.GetKey());
+            while (iter->Valid() && iter->Key().GetType() != KEY_META)
+            {
+                std::string keystr;
+                iter->Key().GetKey().ToString(keystr);
+                keystr.append(1, 0);
+                KeyObject next(ctx.ns, KEY_META, keystr);
+                iter->Jump(next);
+            }
+            if (iter->Valid())
+            {
+                reply.SetString(iter->Key().GetKey());
+                break;
+            }
+            /*
+             * probed after the last key, wrap around to the first one
+             */
+            KeyObject first(ctx.ns, KEY_META, "");
+            iter->Jump(first);
         }
         DELETE(iter);
         return 0;
     }
 
+    /*
+     * SCAN MATCH over consecutive partitions from the cursor. A partition's matches are only returned when all
+     * the partitions before it were scanned to their end, the cursor is the last key returned or scanned.
+     */
+    int Ardb::ScanKeysByPartition(Context& ctx, const std::string& cursor_element, const std::string& pattern, uint32 limit)
+    {
+        RedisReply& reply = ctx.GetReply();
+        KeyScanJob job;
+        job.pattern = pattern;
+        pattern_prefix(pattern, job.prefix);
+        job.scan_limit = (int64) limit * 10;
+        job.match_limit = limit;
+        std::string start = cursor_element;
+        if (!start.empty())
+        {
+            start.append(1, 0); /* resume after the cursor key */
+        }
+        StringArray bounds;
+        GetKeyPartitions(ctx, KeyScanPartitionsLimit(ctx), bounds);
+        job.bounds.push_back(start);
+        for (size_t i = 1; i < bounds.size() && job.bounds.size() <= g_key_scan_pool->Size(); i++)
+        {
+            if (bounds[i] > start)
+            {
+                job.bounds.push_back(bounds[i]);
+            }
+        }
+        RunKeyScanJob(ctx, job);
+        RedisReply& r1 = reply.AddMember();
+        RedisReply& r2 = reply.AddMember();
+        r2.ReserveMember(0);
+        std::string cursor;
+        bool more = false;
+        uint32 count = 0;
+        for (size_t i = 0; i < job.bounds.size() && !more; i++)
+        {
+            const StringArray& matches = job.matches[i];
+            for (size_t j = 0; j < matches.size(); j++)
+            {
+                if (count >= limit)
+                {
+                    more = true;
+                    break;
+                }
+                r2.AddMember().SetString(matches[j]);
+                cursor = matches[j];
+                count++;
+            }
+            if (!more && job.stopped[i])
+            {
+                cursor = job.last_keys[i];
+                more = true;
+            }
+        }
+        r1.SetString(more ? stringfromll(GetNewRedisCursor(cursor)) : "0");
+        return 0;
+    }
+
     int Ardb::Scan(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
@@ -230,6 +829,12 @@ OP_NAMESPACE_BEGIN
             FindElementByRedisCursor(cmd.GetArguments()[cursor_pos], cursor_element);
             startkey.SetType(KEY_ZSET_SORT);
             startkey.SetKey(cmd.GetArguments()[0]);
+            KeyObject meta_key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
+            ValueObject meta;
+            if (0 == GetMeta(ctx, meta_key, meta) && meta.GetType() == KEY_ZSET)
+            {
+                startkey.BindCollection(meta);
+            }
             startkey.SetZSetMember(cursor_element);
         }
         else
@@ -281,6 +886,10 @@ OP_NAMESPACE_BEGIN
                 }
             }
         }
+        if (cmd.GetType() == REDIS_CMD_SCAN && !pattern.empty() && limit > 0 && KeyScanPartitionsLimit(ctx) > 1)
+        {
+            return ScanKeysByPartition(ctx, cursor_element, pattern, limit);
+        }
         RedisReply& r1 = reply.AddMember();
         RedisReply& r2 = reply.AddMember();
         r2.ReserveMember(0);
@@ -310,7 +919,7 @@ OP_NAMESPACE_BEGIN
             else
             {
                 if (k.GetType() != startkey.GetType() || k.GetKey() != startkey.GetKey()
-                        || k.GetNameSpace() != startkey.GetNameSpace())
+                        || k.GetNameSpace() != startkey.GetNameSpace() || k.GetVersion() != startkey.GetVersion())
                 {
                     break;
                 }
@@ -397,82 +1006,56 @@ OP_NAMESPACE_BEGIN
     int Ardb::Keys(Context& ctx, RedisCommandFrame& cmd)
     {
         const std::string& pattern = cmd.GetArguments()[0];
-        std::string start;
-        for (size_t i = 0; i < pattern.size(); i++)
+        RedisReply& reply = ctx.GetReply();
+        bool keys = cmd.GetType() == REDIS_CMD_KEYS;
+        KeyScanJob job;
+        pattern_prefix(pattern, job.prefix);
+        if (job.prefix == pattern)
         {
-            if (pattern[i] != '*' && pattern[i] != '?' && pattern[i] != '[' && pattern[i] != '\\')
+            /*
+             * no wildcard, only the key itself could match
+             */
+            KeyObject key(ctx.ns, KEY_META, pattern);
+            ValueObject meta;
+            bool exist = m_engine->Exists(ctx, key, meta);
+            if (keys)
             {
-                start.append(pattern[i], 1);
+                reply.ReserveMember(0);
+                if (exist)
+                {
+                    reply.AddMember().SetString(pattern);
+                }
             }
             else
             {
-                break;
+                reply.SetInteger(exist ? 1 : 0);
             }
+            return 0;
         }
-        RedisReply& reply = ctx.GetReply();
-        if (cmd.GetType() == REDIS_CMD_KEYS)
-        {
-            reply.ReserveMember(0);
-        }
-        else
+        if (!keys)
         {
-            reply.SetInteger(0);
+            reply.SetInteger(CountKeys(ctx, pattern));
+            return 0;
         }
-
-        bool noregex = start == pattern;
-        int64_t match_count = 0;
-        KeyObject startkey(ctx.ns, KEY_META, start);
-        ctx.flags.iterate_multi_keys = 1;
-        ctx.flags.iterate_no_upperbound = 1;
+        job.pattern = pattern;
         /*
-         * for rocksdb, this flag must be set for right behavior
+         * limit keys output
          */
-        ctx.flags.iterate_total_order = 1;
-        Iterator* iter = m_engine->Find(ctx, startkey);
-        while (iter->Valid())
+        job.max_matches = kKeysMaxMatches;
+        GetKeyPartitions(ctx, KeyScanPartitionsLimit(ctx), job.bounds);
+        RunKeyScanJob(ctx, job);
+        if (job.aborted)
         {
-            KeyObject& k = iter->Key();
-            if (k.GetType() == KEY_META)
-            {
-                std::string keystr;
-                k.GetKey().ToString(keystr);
-                if (stringmatchlen(pattern.c_str(), pattern.size(), keystr.c_str(), keystr.size(), 0) == 1)
-                {
-                    match_count++;
-                    if (cmd.GetType() == REDIS_CMD_KEYS)
-                    {
-                        RedisReply& r = reply.AddMember();
-                        r.SetString(keystr);
-                    }
-                    /*
-                     * limit keys output
-                     */
-                    if (match_count >= 10000 && cmd.GetType() == REDIS_CMD_KEYS)
-                    {
-                        reply.SetErrorReason("Too many keys for keys command, use 'scan' instead.");
-                        break;
-                    }
-                    if (noregex)
-                    {
-                        break;
-                    }
-                }
-            }
-            if (iter->Value().GetType() != KEY_STRING)
-            {
-                std::string keystr;
-                k.GetKey().ToString(keystr);
-                keystr.append(1, 0);
-                KeyObject next(ctx.ns, KEY_META, keystr);
-                iter->Jump(next);
-                continue;
-            }
-            iter->Next();
+            reply.SetErrorReason("Too many keys for keys command, use 'scan' instead.");
+            return 0;
         }
-        DELETE(iter);
-        if (cmd.GetType() == REDIS_CMD_KEYSCOUNT)
+        reply.ReserveMember(0);
+        for (size_t i = 0; i < job.matches.size(); i++)
         {
-            reply.SetInteger(match_count);
+            for (size_t j = 0; j < job.matches[i].size(); j++)
+            {
+                reply.AddMember().SetString(job.matches[i][j]);
+            }
         }
         return 0;
     }
@@ -510,14 +1093,72 @@ OP_NAMESPACE_BEGIN
             DelKey(ctx, dst);
         }
         int64_t moved = 0;
-        Iterator* iter = m_engine->Find(ctx, src);
-        while (iter->Valid())
+        ValueObject src_meta;
+        bool versioned = 0 == m_engine->Get(ctx, src, src_meta) && src_meta.GetMetaObject().version > 0;
+        if (versioned)
+        {
+            MetaObject& m = src_meta.GetMetaObject();
+            if (srcdb == dstdb)
+            {
+                /*
+                 * the elements of a versioned collection stay where they are, the renamed meta points to them
+                 */
+                if (m.data_key.empty())
+                {
+                    m.data_key = srckey;
+                }
+                if (m.data_key == dstkey)
+                {
+                    m.data_key.clear();
+                }
+            }
+            else
+            {
+                const KeyType* types = NULL;
+                size_t types_num = versioned_element_types(src_meta.GetType(), types);
+                for (size_t i = 0; i < types_num; i++)
+                {
+                    KeyObject start(srcdb, types[i], srckey);
+                    start.BindCollection(src_meta);
+                    Iterator* iter = m_engine->Find(ctx, start);
+                    while (iter->Valid())
+                    {
+                        KeyObject& k = iter->Key();
+                        if (k.GetType() != types[i] || k.GetVersion() != start.GetVersion()
+                                || k.GetKey() != start.GetKey() || k.GetNameSpace() != srcdb)
+                        {
+                            break;
+                        }
+                        k.SetNameSpace(dstdb);
+                        k.SetKey(dstkey);
+                        SetKeyValue(ctx, k, iter->Value());
+                        iter->Del();
+                        iter->Next();
+                    }
+                    DELETE(iter);
+                }
+                m.data_key.clear();
+            }
+            {
+                WriteBatchGuard batch(ctx, m_engine);
+                SetKeyValue(ctx, dst, src_meta);
+                RemoveKey(ctx, src);
+            }
+            moved = 1;
+        }
+        Iterator* iter = versioned ? NULL : m_engine->Find(ctx, src);
+        while (NULL != iter && iter->Valid())
         {
             KeyObject& k = iter->Key();
             if (k.GetKey() != src.GetKey() || k.GetNameSpace() != src.GetNameSpace())
             {
                 break;
             }
+            if (k.GetVersion() > 0)
+            {
+                iter->Next();
+                continue;
+            }
             k.SetNameSpace(dstdb);
             k.SetKey(dstkey);
             SetKeyValue(ctx, k, iter->Value());
@@ -526,6 +1167,7 @@ OP_NAMESPACE_BEGIN
             moved++;
         }
         DELETE(iter);
+        InvalidateMeta(src);
         if (cmd.GetType() == REDIS_CMD_RENAME)
         {
             reply.SetStatusCode(STATUS_OK);
@@ -590,6 +1232,7 @@ OP_NAMESPACE_BEGIN
                 break;
             }
             case KEY_STRING:
+            case KEY_BITMAP:
             {
                 reply.SetStatusString("string");
                 break;
@@ -836,20 +1479,56 @@ OP_NAMESPACE_BEGIN
     int Ardb::Exists(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
-        const std::string& keystr = cmd.GetArguments()[0];
-        KeyObject key(ctx.ns, KEY_META, keystr);
-        ValueObject val;
-        bool existed = m_engine->Exists(ctx, key,val);
-        if(existed)
+        if (cmd.GetArguments().size() == 1)
+        {
+            const std::string& keystr = cmd.GetArguments()[0];
+            KeyObject key(ctx.ns, KEY_META, keystr);
+            ValueObject val;
+            bool existed = m_engine->Exists(ctx, key,val);
+            if(existed)
+            {
+                bool expired;
+                CheckMeta(ctx, key, KEY_UNKNOWN, val, false, &expired);
+                if(expired)
+                {
+                    existed = false;
+                }
+            }
+            reply.SetInteger(existed ? 1 : 0);
+            return 0;
+        }
+        /*
+         * multiple keys are looked up with one batched engine read, the same key given twice is counted twice
+         */
+        KeyObjectArray ks;
+        for (size_t i = 0; i < cmd.GetArguments().size(); i++)
         {
-        	bool expired;
-        	CheckMeta(ctx, key, KEY_UNKNOWN, val, false, &expired);
-        	if(expired)
-        	{
-        		existed = false;
-        	}
+            KeyObject k(ctx.ns, KEY_META, cmd.GetArguments()[i]);
+            ks.push_back(k);
+        }
+        ValueObjectArray vs;
+        ErrCodeArray errs;
+        int err = m_engine->MultiGet(ctx, ks, vs, errs);
+        if (0 != err && ERR_ENTRY_NOT_EXIST != err)
+        {
+            reply.SetErrCode(err);
+            return 0;
+        }
+        int64 count = 0;
+        for (size_t i = 0; i < ks.size() && i < vs.size() && i < errs.size(); i++)
+        {
+            if (0 != errs[i] || vs[i].GetType() == 0)
+            {
+                continue;
+            }
+            bool expired = false;
+            CheckMeta(ctx, ks[i], KEY_UNKNOWN, vs[i], false, &expired);
+            if (!expired)
+            {
+                count++;
+            }
         }
-        reply.SetInteger(existed ? 1 : 0);
+        reply.SetInteger(count);
         return 0;
     }
 
@@ -893,6 +1572,14 @@ OP_NAMESPACE_BEGIN
                 int err = RemoveKey(ctx, meta_key);
                 return err == 0 ? 1 : 0;
             }
+            if (meta_obj.GetMetaObject().version > 0)
+            {
+                StaleCollection(ctx, meta_key, meta_obj);
+                InvalidateMeta(meta_key);
+                TouchWatchKey(ctx, meta_key);
+                ctx.dirty++;
+                return 1;
+            }
         }
         else
         {
@@ -902,8 +1589,7 @@ OP_NAMESPACE_BEGIN
         if (m_engine->GetFeatureSet().support_delete_range
                 && (meta_obj.GetObjectLen() < 0 || meta_obj.GetObjectLen() >= GetConf().range_delete_min_size))
         {
-            KeyObject end(ctx.ns, KEY_END, meta_key.GetKey());
-            m_engine->DelRange(ctx, meta_key, end);
+            DelUnversionedRange(ctx, meta_key);
             removed = 1;
         }
         else
@@ -926,6 +1612,14 @@ OP_NAMESPACE_BEGIN
                 {
                     break;
                 }
+                if (k.GetVersion() > 0)
+                {
+                    /*
+                     * elements of a versioned collection renamed from this key
+                     */
+                    iter->Next();
+                    continue;
+                }
                 removed = 1;
                 iter->Del();
                 //RemoveKey(ctx, k);
@@ -936,6 +1630,96 @@ OP_NAMESPACE_BEGIN
         {
             StreamDel(ctx, meta_key);
         }
+        InvalidateMeta(meta_key);
+        if (removed > 0)
+        {
+            TouchWatchKey(ctx, meta_key);
+            ctx.dirty++;
+        }
+        return removed;
+    }
+
+    int Ardb::DelKeyInChunks(Context& ctx, const KeyObject& meta_key, int64 chunk_size, volatile uint64* progress)
+    {
+        ValueObject meta_obj;
+        if (0 != m_engine->Get(ctx, meta_key, meta_obj))
+        {
+            return 0;
+        }
+        int64 len = meta_obj.GetObjectLen();
+        bool range_delete = m_engine->GetFeatureSet().support_delete_range
+                && (len < 0 || len >= GetConf().range_delete_min_size);
+        if (meta_obj.GetType() == KEY_STRING || meta_obj.GetMetaObject().version > 0 || range_delete || chunk_size <= 0
+                || (len >= 0 && len <= chunk_size))
+        {
+            /*
+             * range deletion & versioned collections cost the same for any size, and small collections fit
+             * into one write batch
+             */
+            int removed = 0;
+            {
+                WriteBatchGuard batch(ctx, m_engine);
+                removed = DelKey(ctx, meta_key);
+            }
+            if (NULL != progress)
+            {
+                atomic_add_uint64(progress, len > 0 ? len : 1);
+            }
+            return removed;
+        }
+        Iterator* iter = m_engine->Find(ctx, meta_key);
+        bool first_chunk = true;
+        int removed = 0;
+        while (NULL != iter && iter->Valid())
+        {
+            int64 count = 0;
+            WriteBatchGuard batch(ctx, m_engine);
+            if (first_chunk && m_engine->GetFeatureSet().support_compactfilter && meta_obj.GetTTL() > 0)
+            {
+                Data tll_ns(TTL_DB_NSMAESPACE, false);
+                KeyObject ttl_key(tll_ns, KEY_TTL_SORT, "");
+                ttl_key.SetTTL(meta_obj.GetTTL());
+                ttl_key.SetTTLKeyNamespace(meta_key.GetNameSpace());
+                ttl_key.SetTTLKey(meta_key.GetKey().AsString());
+                m_engine->Del(ctx, ttl_key);
+            }
+            first_chunk = false;
+            /*
+             * the meta is the first record of the key, so the key is gone with the first chunk,
+             * the caller must keep the key locked until the last chunk is committed.
+             */
+            while (count < chunk_size && iter->Valid())
+            {
+                KeyObject& k = iter->Key();
+                const Data& kdata = k.GetKey();
+                if (k.GetNameSpace().Compare(meta_key.GetNameSpace()) != 0
+                        || kdata.StringLength() != meta_key.GetKey().StringLength()
+                        || strncmp(meta_key.GetKey().CStr(), kdata.CStr(), kdata.StringLength()) != 0)
+                {
+                    DELETE(iter);
+                    break;
+                }
+                if (k.GetVersion() > 0)
+                {
+                    iter->Next();
+                    continue;
+                }
+                removed = 1;
+                iter->Del();
+                iter->Next();
+                count++;
+            }
+            if (NULL != progress)
+            {
+                atomic_add_uint64(progress, count);
+            }
+            InvalidateMeta(meta_key);
+        }
+        DELETE(iter);
+        if (meta_obj.GetType() == KEY_STREAM)
+        {
+            StreamDel(ctx, meta_key);
+        }
         if (removed > 0)
         {
             TouchWatchKey(ctx, meta_key);
@@ -944,6 +1728,142 @@ OP_NAMESPACE_BEGIN
         return removed;
     }
 
+    /*
+     * Range deletes the records of an unversioned key. Element records of versioned collections stored
+     * under the same key name belong to collections renamed from it and are kept.
+     */
+    void Ardb::DelUnversionedRange(Context& ctx, const KeyObject& meta_key)
+    {
+        static const KeyType versioned_types[] = { KEY_LIST_ELEMENT, KEY_ZSET_SORT, KEY_ZSET_SCORE, KEY_ZSET_RANK,
+                KEY_LIST_RANK, KEY_BITMAP_SEGMENT };
+        KeyObject start = meta_key;
+        for (size_t i = 0; i < arraysize(versioned_types); i++)
+        {
+            KeyObject end(meta_key.GetNameSpace(), versioned_types[i], meta_key.GetKey());
+            end.SetVersion(1);
+            m_engine->DelRange(ctx, start, end);
+            start = KeyObject(meta_key.GetNameSpace(), versioned_types[i] + 1, meta_key.GetKey());
+        }
+        KeyObject end(meta_key.GetNameSpace(), KEY_END, meta_key.GetKey());
+        m_engine->DelRange(ctx, start, end);
+    }
+
+    /*
+     * Deletes a versioned collection in O(1): the meta is removed and the collection version is recorded
+     * in the ttl db, the sweeper reclaims the elements of recorded versions in the background. Callers
+     * replacing the collection with a new version in the same batch keep the meta with 'remove_meta' false.
+     */
+    int Ardb::StaleCollection(Context& ctx, const KeyObject& meta_key, ValueObject& meta, bool remove_meta)
+    {
+        MetaObject& m = meta.GetMetaObject();
+        Data data_key = meta_key.GetKey();
+        if (!m.data_key.empty())
+        {
+            data_key.SetString(m.data_key, false);
+        }
+        Data tll_ns(TTL_DB_NSMAESPACE, false);
+        KeyObject stale_key(tll_ns, KEY_STALE_VERSION, "");
+        stale_key.SetStaleVersion(meta_key.GetNameSpace(), data_key, m.version);
+        ValueObject stale;
+        stale.SetType(KEY_STALE_VERSION);
+        stale.SetStaleCollectionType(meta.GetType());
+        {
+            WriteBatchGuard batch(ctx, m_engine);
+            unsigned create_if_notexist = ctx.flags.create_if_notexist;
+            ctx.flags.create_if_notexist = 1;
+            m_engine->Put(ctx, stale_key, stale);
+            ctx.flags.create_if_notexist = create_if_notexist;
+            if (remove_meta)
+            {
+                RemoveKey(ctx, meta_key);
+            }
+        }
+        NotifyStaleVersionSweeper();
+        return 0;
+    }
+
+    int Ardb::SweepStaleVersion(Context& ctx, const KeyObject& stale_key, uint8 collection_type)
+    {
+        const KeyType* types = NULL;
+        size_t types_num = versioned_element_types(collection_type, types);
+        const Data& ns = stale_key.GetStaleNameSpace();
+        const Data& data_key = stale_key.GetStaleDataKey();
+        uint64 version = stale_key.GetStaleVersion();
+        ctx.ns = ns;
+        for (size_t i = 0; i < types_num; i++)
+        {
+            KeyObject start(ns, types[i], data_key);
+            start.SetVersion(version);
+            if (m_engine->GetFeatureSet().support_delete_range)
+            {
+                KeyObject end(ns, types[i], data_key);
+                end.SetVersion(version + 1);
+                m_engine->DelRange(ctx, start, end);
+                continue;
+            }
+            Iterator* iter = m_engine->Find(ctx, start);
+            while (NULL != iter && iter->Valid())
+            {
+                int64 count = 0;
+                WriteBatchGuard batch(ctx, m_engine);
+                while (count < GetConf().async_delete_batch_size && iter->Valid())
+                {
+                    KeyObject& k = iter->Key();
+                    if (k.GetType() != types[i] || k.GetVersion() != version || k.GetNameSpace() != ns
+                            || k.GetKey() != data_key)
+                    {
+                        DELETE(iter);
+                        break;
+                    }
+                    iter->Del();
+                    iter->Next();
+                    count++;
+                }
+            }
+            DELETE(iter);
+        }
+        m_engine->Del(ctx, stale_key);
+        return 0;
+    }
+
+    int64 Ardb::SweepStaleVersions(Context& ctx)
+    {
+        Data tll_ns(TTL_DB_NSMAESPACE, false);
+        int64 swept = 0;
+        while (true)
+        {
+            /*
+             * collect a batch of stale versions first, some engines do not allow writing while iterating
+             */
+            KeyObjectArray stale_keys;
+            std::vector<uint8> collection_types;
+            KeyObject start(tll_ns, KEY_STALE_VERSION, "");
+            Iterator* iter = m_engine->Find(ctx, start);
+            while (NULL != iter && iter->Valid() && stale_keys.size() < 1000)
+            {
+                KeyObject& k = iter->Key(true);
+                if (k.GetType() != KEY_STALE_VERSION)
+                {
+                    break;
+                }
+                stale_keys.push_back(k);
+                collection_types.push_back(iter->Value().GetStaleCollectionType());
+                iter->Next();
+            }
+            DELETE(iter);
+            if (stale_keys.empty())
+            {
+                break;
+            }
+            for (size_t i = 0; i < stale_keys.size(); i++)
+            {
+                SweepStaleVersion(ctx, stale_keys[i], collection_types[i]);
+            }
+            swept += stale_keys.size();
+        }
+        return swept;
+    }
+
     int Ardb::Unlink(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
@@ -964,11 +1884,20 @@ OP_NAMESPACE_BEGIN
         Iterator* iter = NULL;
         int removed = 0;
         ctx.flags.iterate_no_upperbound = cmd.GetArguments().size() > 1 ? 1 : 0;
+        KeyObjectArray metas;
         for (size_t i = 0; i < cmd.GetArguments().size(); i++)
         {
-            KeyObject meta(ctx.ns, KEY_META, cmd.GetArguments()[i]);
-            KeyLockGuard guard(ctx, meta);
-            removed += DelKey(ctx, meta, iter);
+            metas.push_back(KeyObject(ctx.ns, KEY_META, cmd.GetArguments()[i]));
+        }
+        {
+            /*
+             * one guard for all keys, see ReplicationBacklog::ReserveSequence
+             */
+            KeysLockGuard guard(ctx, metas);
+            for (size_t i = 0; i < metas.size(); i++)
+            {
+                removed += DelKey(ctx, metas[i], iter);
+            }
         }
         DELETE(iter);
 
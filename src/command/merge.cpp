@@ -136,6 +136,10 @@ namespace ardb
                 op = REDIS_CMD_PEXPIREAT;
                return true;
             }
+            case REDIS_CMD_XADD:
+            {
+                return true;
+            }
             default:
             {
                 ERROR_LOG("Not supported merge operation:%u", op);
@@ -244,6 +248,10 @@ namespace ardb
             {
                 return MergeExpire(merge_ctx, key, val, args[0].GetInt64());
             }
+            case REDIS_CMD_XADD:
+            {
+                return MergeStreamAppend(merge_ctx, key, val, args);
+            }
             default:
             {
                 ERROR_LOG("Not supported merge operation:%u", op);
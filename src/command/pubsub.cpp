@@ -31,6 +31,183 @@
 
 namespace ardb
 {
+    /*
+     * A published message encoded once as a RESP frame and shared by all its receivers.
+     */
+    struct PubSubFrame
+    {
+            Buffer content;
+            volatile uint32_t ref;
+            PubSubFrame()
+                    : ref(1)
+            {
+            }
+    };
+
+    static PubSubFrame* new_pubsub_frame(const char* kind, const std::string* pattern, const std::string& channel,
+            const std::string& message)
+    {
+        PubSubFrame* frame = NULL;
+        NEW(frame, PubSubFrame);
+        Buffer& buf = frame->content;
+        buf.EnsureWritableBytes(64 + channel.size() + message.size() + (NULL != pattern ? pattern->size() : 0));
+        buf.Printf("*%d\r\n$%d\r\n%s\r\n", NULL != pattern ? 4 : 3, (int) strlen(kind), kind);
+        if (NULL != pattern)
+        {
+            buf.Printf("$%d\r\n", (int) pattern->size());
+            buf.Write(pattern->data(), pattern->size());
+            buf.Write("\r\n", 2);
+        }
+        buf.Printf("$%d\r\n", (int) channel.size());
+        buf.Write(channel.data(), channel.size());
+        buf.Write("\r\n", 2);
+        buf.Printf("$%d\r\n", (int) message.size());
+        buf.Write(message.data(), message.size());
+        buf.Write("\r\n", 2);
+        return frame;
+    }
+
+    static void release_pubsub_frame(PubSubFrame* frame)
+    {
+        if (0 == atomic_sub_uint32(&frame->ref, 1))
+        {
+            DELETE(frame);
+        }
+    }
+
+    /*
+     * All the frames of one published message to be written by the same io thread, the io thread is
+     * woken up once for them instead of once per receiver.
+     */
+    struct PubSubDelivery
+    {
+            ChannelService* serv;
+            std::vector<std::pair<PubSubFrame*, uint32> > targets;
+            PubSubDelivery()
+                    : serv(NULL)
+            {
+            }
+    };
+    typedef TreeMap<ChannelService*, PubSubDelivery*>::Type PubSubDeliveryTable;
+
+    static void deliver_pubsub_frames(Channel* unused, void* data)
+    {
+        PubSubDelivery* delivery = (PubSubDelivery*) data;
+        int64 limit = g_db->GetConf().pubsub_client_output_buffer_limit;
+        for (size_t i = 0; i < delivery->targets.size(); i++)
+        {
+            PubSubFrame* frame = delivery->targets[i].first;
+            Channel* ch = delivery->serv->GetChannel(delivery->targets[i].second);
+            if (NULL != ch)
+            {
+                Buffer& out = ch->GetOutputBuffer();
+                if (limit > 0 && (int64) (out.ReadableBytes() + frame->content.ReadableBytes()) > limit)
+                {
+                    WARN_LOG("Close pubsub client:%u since output buffer exceed limit:%lld", ch->GetID(), limit);
+                    ch->Close();
+                }
+                else
+                {
+                    /*
+                     * an idle subscriber is written straight from the shared frame, only what its socket does
+                     * not take, or the whole frame behind pending output, is copied into its output buffer
+                     */
+                    struct iovec iov;
+                    iov.iov_base = (void*) frame->content.GetRawReadBuffer();
+                    iov.iov_len = frame->content.ReadableBytes();
+                    ch->WriteNowV(&iov, 1);
+                }
+            }
+            release_pubsub_frame(frame);
+        }
+        DELETE(delivery);
+    }
+
+    static void add_pubsub_target(PubSubDeliveryTable& deliveries, Context* cc, PubSubFrame* frame)
+    {
+        Channel* ch = cc->client->client;
+        ChannelService* serv = &(ch->GetService());
+        PubSubDelivery*& delivery = deliveries[serv];
+        if (NULL == delivery)
+        {
+            NEW(delivery, PubSubDelivery);
+            delivery->serv = serv;
+        }
+        atomic_add_uint32(&frame->ref, 1);
+        delivery->targets.push_back(std::make_pair(frame, ch->GetID()));
+    }
+
+    /*
+     * The literal prefix of a glob pattern, every channel matching the pattern starts with it.
+     */
+    static void pattern_literal_prefix(const std::string& pattern, std::string& prefix)
+    {
+        size_t len = pattern.find_first_of("*?[\\");
+        prefix.assign(pattern, 0, len == std::string::npos ? pattern.size() : len);
+    }
+
+    void PubSubPatternIndex::Add(const std::string& pattern)
+    {
+        std::string prefix;
+        pattern_literal_prefix(pattern, prefix);
+        StringTreeSet& patterns = m_prefixes[prefix];
+        if (patterns.empty())
+        {
+            m_prefix_lens[prefix.size()]++;
+        }
+        patterns.insert(pattern);
+    }
+
+    void PubSubPatternIndex::Remove(const std::string& pattern)
+    {
+        std::string prefix;
+        pattern_literal_prefix(pattern, prefix);
+        PrefixTable::iterator found = m_prefixes.find(prefix);
+        if (found == m_prefixes.end())
+        {
+            return;
+        }
+        found->second.erase(pattern);
+        if (found->second.empty())
+        {
+            m_prefixes.erase(found);
+            PrefixLengthTable::iterator lit = m_prefix_lens.find(prefix.size());
+            if (lit != m_prefix_lens.end() && 0 == --(lit->second))
+            {
+                m_prefix_lens.erase(lit);
+            }
+        }
+    }
+
+    /*
+     * Only the patterns whose literal prefix is a prefix of the channel need to be matched, look them up
+     * by every distinct prefix length instead of matching all the subscribed patterns.
+     */
+    void PubSubPatternIndex::Match(const std::string& channel, StringArray& patterns)
+    {
+        std::string prefix;
+        PrefixLengthTable::iterator lit = m_prefix_lens.begin();
+        while (lit != m_prefix_lens.end() && lit->first <= channel.size())
+        {
+            prefix.assign(channel, 0, lit->first);
+            PrefixTable::iterator found = m_prefixes.find(prefix);
+            if (found != m_prefixes.end())
+            {
+                StringTreeSet::iterator pit = found->second.begin();
+                while (pit != found->second.end())
+                {
+                    const std::string& pattern = *pit;
+                    if (stringmatchlen(pattern.c_str(), pattern.size(), channel.c_str(), channel.size(), 0))
+                    {
+                        patterns.push_back(pattern);
+                    }
+                    pit++;
+                }
+            }
+            lit++;
+        }
+    }
+
     int Ardb::SubscribeChannel(Context& ctx, const std::string& channel, bool is_pattern)
     {
         if (is_pattern)
@@ -45,7 +222,12 @@ namespace ardb
             WriteLockGuard<SpinRWLock> guard(m_pubsub_lock);
             if (is_pattern)
             {
-                m_pubsub_patterns[channel].insert(&ctx);
+                ContextSet& subscribers = m_pubsub_patterns[channel];
+                if (subscribers.empty())
+                {
+                    m_pubsub_pattern_index.Add(channel);
+                }
+                subscribers.insert(&ctx);
             }
             else
             {
@@ -89,6 +271,10 @@ namespace ardb
             it->second.erase(&ctx);
             if (it->second.empty())
             {
+                if (is_pattern)
+                {
+                    m_pubsub_pattern_index.Remove(channel);
+                }
                 tables->erase(it);
             }
             ret = 1;
@@ -212,61 +398,64 @@ namespace ardb
 
     int Ardb::PublishMessage(Context& ctx, const std::string& channel, const std::string& message)
     {
-        ReadLockGuard<SpinRWLock> guard(m_pubsub_lock);
-        PubSubChannelTable::iterator fit = m_pubsub_channels.find(channel);
-
+        PubSubDeliveryTable deliveries;
         int receiver = 0;
-        if (fit != m_pubsub_channels.end())
         {
-            ContextSet::iterator cit = fit->second.begin();
-            while (cit != fit->second.end())
+            ReadLockGuard<SpinRWLock> guard(m_pubsub_lock);
+            PubSubChannelTable::iterator fit = m_pubsub_channels.find(channel);
+            if (fit != m_pubsub_channels.end())
             {
-                Context* cc = *cit;
-                if (NULL != cc && cc->client != NULL)
+                PubSubFrame* frame = new_pubsub_frame("message", NULL, channel, message);
+                ContextSet::iterator cit = fit->second.begin();
+                while (cit != fit->second.end())
                 {
-                    RedisReply* r = NULL;
-                    NEW(r, RedisReply);
-                    RedisReply& r1 = r->AddMember();
-                    RedisReply& r2 = r->AddMember();
-                    RedisReply& r3 = r->AddMember();
-                    r1.SetString("message");
-                    r2.SetString(channel);
-                    r3.SetString(message);
-                    WriteReply(*cc, r, true);
-                    receiver++;
+                    Context* cc = *cit;
+                    if (NULL != cc && cc->client != NULL && cc->client->client != NULL)
+                    {
+                        add_pubsub_target(deliveries, cc, frame);
+                        receiver++;
+                    }
+                    cit++;
                 }
-                cit++;
+                release_pubsub_frame(frame);
             }
-        }
-        PubSubChannelTable::iterator pit = m_pubsub_patterns.begin();
-        while (pit != m_pubsub_patterns.end())
-        {
-            const std::string& pattern = pit->first;
-            if (stringmatchlen(pattern.c_str(), pattern.size(), channel.c_str(), channel.size(), 0))
+            StringArray patterns;
+            m_pubsub_pattern_index.Match(channel, patterns);
+            for (size_t i = 0; i < patterns.size(); i++)
             {
+                PubSubChannelTable::iterator pit = m_pubsub_patterns.find(patterns[i]);
+                if (pit == m_pubsub_patterns.end())
+                {
+                    continue;
+                }
+                PubSubFrame* frame = new_pubsub_frame("pmessage", &patterns[i], channel, message);
                 ContextSet::iterator cit = pit->second.begin();
                 while (cit != pit->second.end())
                 {
                     Context* cc = *cit;
-                    if (NULL != cc && cc->client != NULL)
+                    if (NULL != cc && cc->client != NULL && cc->client->client != NULL)
                     {
-                        RedisReply* r = NULL;
-                        NEW(r, RedisReply);
-                        RedisReply& r1 = r->AddMember();
-                        RedisReply& r2 = r->AddMember();
-                        RedisReply& r3 = r->AddMember();
-                        RedisReply& r4 = r->AddMember();
-                        r1.SetString("pmessage");
-                        r2.SetString(pattern);
-                        r3.SetString(channel);
-                        r4.SetString(message);
-                        WriteReply(*cc, r, true);
+                        add_pubsub_target(deliveries, cc, frame);
                         receiver++;
                     }
                     cit++;
                 }
+                release_pubsub_frame(frame);
+            }
+        }
+        PubSubDeliveryTable::iterator dit = deliveries.begin();
+        while (dit != deliveries.end())
+        {
+            PubSubDelivery* delivery = dit->second;
+            if (delivery->serv->IsInLoopThread())
+            {
+                deliver_pubsub_frames(NULL, delivery);
+            }
+            else
+            {
+                delivery->serv->AsyncIO(0, deliver_pubsub_frames, delivery);
             }
-            pit++;
+            dit++;
         }
         return receiver;
     }
@@ -0,0 +1,261 @@
+/*
+ *Copyright (c) 2013-2014, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "db/db.hpp"
+#include <float.h>
+#include <cmath>
+
+/*
+ * Order statistic index shared by sorted sets(KEY_ZSET_RANK) and non sequential lists(KEY_LIST_RANK).
+ * Element positions(zset score or list index) are mapped to an order preserving 64bit integer, and
+ * every 8bit prefix of that integer is a node which counts the elements falling into the prefix range.
+ * Rank lookups sum at most 256 sibling nodes per level, then scan the elements inside the last 56bit bucket.
+ */
+#define RANK_INDEX_LEVELS 7
+#define RANK_INDEX_FANOUT_BITS 8
+#define RANK_INDEX_FANOUT (1 << RANK_INDEX_FANOUT_BITS)
+
+OP_NAMESPACE_BEGIN
+
+    static uint64_t rank_index_position_bits(double pos)
+    {
+        if (pos == 0)
+        {
+            pos = 0; /* -0.0 and 0.0 are equal positions */
+        }
+        uint64_t bits;
+        memcpy(&bits, &pos, sizeof(bits));
+        if (bits & (1ULL << 63))
+        {
+            bits = ~bits;
+        }
+        else
+        {
+            bits |= (1ULL << 63);
+        }
+        return bits;
+    }
+
+    static int64_t rank_index_prefix(uint64_t bits, int level)
+    {
+        return (int64_t) (bits >> (64 - level * RANK_INDEX_FANOUT_BITS));
+    }
+
+    /*
+     * The min position of the leaf bucket, used as the start of the element scan.
+     */
+    static double rank_index_bucket_start(int64_t leaf_prefix)
+    {
+        uint64_t bits = ((uint64_t) leaf_prefix) << RANK_INDEX_FANOUT_BITS;
+        if (bits & (1ULL << 63))
+        {
+            bits &= ~(1ULL << 63);
+        }
+        else
+        {
+            bits = ~bits;
+        }
+        double pos;
+        memcpy(&pos, &bits, sizeof(pos));
+        if (std::isnan(pos))
+        {
+            pos = -INFINITY;
+        }
+        return pos;
+    }
+
+    static void rank_index_element_key(KeyObject& ele, KeyType node_type, double pos)
+    {
+        if (node_type == KEY_ZSET_RANK)
+        {
+            ele.SetType(KEY_ZSET_SORT);
+            ele.SetZSetScore(pos);
+        }
+        else
+        {
+            ele.SetType(KEY_LIST_ELEMENT);
+            ele.SetListIndex(pos);
+        }
+    }
+
+    void Ardb::RankIndexUpdate(RankIndexDeltaTable& deltas, double pos, int64_t delta)
+    {
+        uint64_t bits = rank_index_position_bits(pos);
+        for (int level = 1; level <= RANK_INDEX_LEVELS; level++)
+        {
+            deltas[RankIndexNode(level, rank_index_prefix(bits, level))] += delta;
+        }
+    }
+
+    int Ardb::RankIndexCommit(Context& ctx, KeyType node_type, const std::string& key, ValueObject& meta,
+            const RankIndexDeltaTable& deltas)
+    {
+        if (deltas.empty())
+        {
+            return 0;
+        }
+        KeyObjectArray keys;
+        ValueObjectArray vs;
+        ErrCodeArray errs;
+        std::vector<int64_t> changes;
+        RankIndexDeltaTable::const_iterator it = deltas.begin();
+        while (it != deltas.end())
+        {
+            if (it->second != 0)
+            {
+                KeyObject node(ctx.ns, node_type, key);
+                node.BindCollection(meta);
+                node.SetRankIndexNode(it->first.first, it->first.second);
+                keys.push_back(node);
+                changes.push_back(it->second);
+            }
+            it++;
+        }
+        if (keys.empty())
+        {
+            return 0;
+        }
+        m_engine->MultiGet(ctx, keys, vs, errs);
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            int64_t count = changes[i];
+            if (vs[i].GetType() == node_type)
+            {
+                count += vs[i].GetRankIndexCount();
+            }
+            if (count <= 0)
+            {
+                RemoveKey(ctx, keys[i]);
+            }
+            else
+            {
+                ValueObject v;
+                v.SetType(node_type);
+                v.SetRankIndexCount(count);
+                SetKeyValue(ctx, keys[i], v);
+            }
+        }
+        return 0;
+    }
+
+    Iterator* Ardb::RankIndexCountBefore(Context& ctx, KeyType node_type, const std::string& key, ValueObject& meta,
+            double pos, int64_t& count)
+    {
+        count = 0;
+        uint64_t bits = rank_index_position_bits(pos);
+        KeyObject node(ctx.ns, node_type, key);
+        node.BindCollection(meta);
+        node.SetRankIndexNode(1, 0);
+        Iterator* iter = m_engine->Find(ctx, node);
+        for (int level = 1; level <= RANK_INDEX_LEVELS; level++)
+        {
+            int64_t prefix = rank_index_prefix(bits, level);
+            int64_t first = level == 1 ? 0 : (rank_index_prefix(bits, level - 1) << RANK_INDEX_FANOUT_BITS);
+            if (prefix == first)
+            {
+                continue;
+            }
+            node.SetRankIndexNode(level, first);
+            iter->Jump(node);
+            while (iter->Valid())
+            {
+                KeyObject& field = iter->Key();
+                if (field.GetType() != node_type || field.GetNameSpace() != node.GetNameSpace()
+                        || field.GetKey() != node.GetKey() || field.GetVersion() != node.GetVersion()
+                        || field.GetRankIndexLevel() != level || field.GetRankIndexPrefix() >= prefix)
+                {
+                    break;
+                }
+                count += iter->Value().GetRankIndexCount();
+                iter->Next();
+            }
+        }
+        KeyObject ele(ctx.ns, KEY_META, key);
+        ele.BindCollection(meta);
+        rank_index_element_key(ele, node_type, rank_index_bucket_start(rank_index_prefix(bits, RANK_INDEX_LEVELS)));
+        iter->Jump(ele);
+        return iter;
+    }
+
+    Iterator* Ardb::RankIndexSeek(Context& ctx, KeyType node_type, const std::string& key, ValueObject& meta,
+            int64_t rank)
+    {
+        KeyObject node(ctx.ns, node_type, key);
+        node.BindCollection(meta);
+        node.SetRankIndexNode(1, 0);
+        Iterator* iter = m_engine->Find(ctx, node);
+        int64_t parent = 0;
+        for (int level = 1; level <= RANK_INDEX_LEVELS; level++)
+        {
+            int64_t first = parent << RANK_INDEX_FANOUT_BITS;
+            bool found = false;
+            node.SetRankIndexNode(level, first);
+            iter->Jump(node);
+            while (iter->Valid())
+            {
+                KeyObject& field = iter->Key();
+                if (field.GetType() != node_type || field.GetNameSpace() != node.GetNameSpace()
+                        || field.GetKey() != node.GetKey() || field.GetVersion() != node.GetVersion()
+                        || field.GetRankIndexLevel() != level || field.GetRankIndexPrefix() >= first + RANK_INDEX_FANOUT)
+                {
+                    break;
+                }
+                int64_t count = iter->Value().GetRankIndexCount();
+                if (rank < count)
+                {
+                    parent = field.GetRankIndexPrefix();
+                    found = true;
+                    break;
+                }
+                rank -= count;
+                iter->Next();
+            }
+            if (!found)
+            {
+                DELETE(iter);
+                return NULL;
+            }
+        }
+        KeyObject ele(ctx.ns, KEY_META, key);
+        ele.BindCollection(meta);
+        rank_index_element_key(ele, node_type, rank_index_bucket_start(parent));
+        iter->Jump(ele);
+        while (rank > 0 && iter->Valid())
+        {
+            iter->Next();
+            rank--;
+        }
+        if (!iter->Valid() || iter->Key().GetType() != ele.GetType() || iter->Key().GetVersion() != ele.GetVersion())
+        {
+            DELETE(iter);
+            return NULL;
+        }
+        return iter;
+    }
+
+OP_NAMESPACE_END
@@ -32,6 +32,7 @@
 #include "util/socket_address.hpp"
 #include "util/lru.hpp"
 #include "util/system_helper.hpp"
+#include "util/bit_helper.hpp"
 #include "statistics.hpp"
 #include <sstream>
 #include <sys/utsname.h>
@@ -189,6 +190,7 @@ namespace ardb
             info.append("ardb_version:").append(ARDB_VERSION).append("\r\n");
             info.append("redis_version:").append(GetConf().redis_compatible_version).append("\r\n");
             info.append("engine:").append(g_engine_name).append("\r\n");
+            info.append("key_format:").append(key_format_name(g_key_format)).append("\r\n");
             info.append("ardb_home:").append(GetConf().home).append("\r\n");
             info.append("os:").append(name.sysname).append(" ").append(name.release).append(" ").append(name.machine).append("\r\n");
             char tmp[256];
@@ -200,6 +202,7 @@ namespace ardb
 #endif
                     );
             info.append("gcc_version:").append(tmp).append("\r\n");
+            info.append("bitops_kernel:").append(bits_kernel_name(bits_kernel())).append("\r\n");
             info.append("process_id:").append(stringfromll(getpid())).append("\r\n");
 
             if (!g_repl->GetReplLog().GetReplKey().empty())
@@ -388,6 +391,39 @@ namespace ardb
                 LockGuard<SpinMutexLock> guard(m_expires_lock);
                 info.append("expire_scan_keys:").append(stringfromll(m_expires.size())).append("\r\n");
             }
+            info.append("expired_keys:").append(stringfromll(m_expired_keys)).append("\r\n");
+            info.append("expired_keys_per_sec:").append(stringfromll(m_expired_keys_per_sec)).append("\r\n");
+            info.append("expire_backlog_keys:").append(stringfromll(m_expire_backlog_keys)).append("\r\n");
+            info.append("expire_cycle_time_limit:").append(stringfromll(m_expire_cycle_time_limit)).append("\r\n");
+            GetAsyncDeleteStats(info);
+            {
+                uint64 hits, misses, keys;
+                GetMetaCacheStats(hits, misses, keys);
+                info.append("meta_cache_keys:").append(stringfromll(keys)).append("\r\n");
+                info.append("meta_cache_hits:").append(stringfromll(hits)).append("\r\n");
+                info.append("meta_cache_misses:").append(stringfromll(misses)).append("\r\n");
+                info.append("meta_cache_hit_rate:").append(
+                        stringfromll(hits + misses > 0 ? hits * 100 / (hits + misses) : 0)).append("%\r\n");
+            }
+            info.append("geo_radius_queries:").append(stringfromll(m_geo_radius_queries)).append("\r\n");
+            info.append("geo_nearest_queries:").append(stringfromll(m_geo_nearest_queries)).append("\r\n");
+            info.append("geo_points_scanned:").append(stringfromll(m_geo_points_scanned)).append("\r\n");
+            info.append("geo_points_kept:").append(stringfromll(m_geo_points_kept)).append("\r\n");
+            if (NULL != g_group_committer)
+            {
+                uint64 groups, batches;
+                g_group_committer->Stats(groups, batches);
+                info.append("group_commit_groups:").append(stringfromll(groups)).append("\r\n");
+                info.append("group_commit_batches:").append(stringfromll(batches)).append("\r\n");
+            }
+            {
+                uint64 acquired, contended, waits;
+                GetKeyLockStats(acquired, contended, waits);
+                info.append("keylock_stripes:").append(stringfromll(m_lock_stripes_num)).append("\r\n");
+                info.append("keylock_acquired:").append(stringfromll(acquired)).append("\r\n");
+                info.append("keylock_contended:").append(stringfromll(contended)).append("\r\n");
+                info.append("keylock_waits:").append(stringfromll(waits)).append("\r\n");
+            }
             info.append("\r\n");
         }
 
@@ -414,18 +450,19 @@ namespace ardb
         if (!strcasecmp(section.c_str(), all) || !strcasecmp(section.c_str(), "commandstats"))
         {
             info.append("# Commandstats\r\n");
-            RedisCommandHandlerSettingTable::iterator cit = m_settings.begin();
-            while (cit != m_settings.end())
+            uint64 counts[LATENCY_HISTOGRAM_BUCKETS];
+            for (size_t i = 0; i < m_settings.size(); i++)
             {
-                RedisCommandHandlerSetting& setting = cit->second;
+                RedisCommandHandlerSetting& setting = m_settings[i];
                 if (setting.calls > 0)
                 {
+                    uint64 total = setting.latency->Merge(counts);
                     info.append("cmdstat_").append(setting.name).append(":").append("calls=").append(stringfromll(setting.calls)).append(",usec=").append(
                             stringfromll(setting.microseconds)).append(",usecpercall=").append(stringfromll(setting.microseconds / setting.calls)).append(
-                            "\r\n");
+                            ",p50=").append(stringfromll(CommandLatencyHistogram::Percentile(counts, total, 0.5))).append(",p99=").append(
+                            stringfromll(CommandLatencyHistogram::Percentile(counts, total, 0.99))).append(",p999=").append(
+                            stringfromll(CommandLatencyHistogram::Percentile(counts, total, 0.999))).append("\r\n");
                 }
-
-                cit++;
             }
             info.append("\r\n");
         }
@@ -456,7 +493,20 @@ namespace ardb
     int Ardb::DBSize(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
-        reply.SetInteger(m_engine->EstimateKeysNum(ctx, ctx.ns));
+        if (cmd.GetArguments().empty())
+        {
+            reply.SetInteger(m_engine->EstimateKeysNum(ctx, ctx.ns));
+            return 0;
+        }
+        if (strcasecmp(cmd.GetArguments()[0].c_str(), "exact"))
+        {
+            reply.SetErrCode(ERR_INVALID_SYNTAX);
+            return 0;
+        }
+        /*
+         * count every key over the key partitions instead of the engine's estimation
+         */
+        reply.SetInteger(CountKeys(ctx, "*"));
         return 0;
     }
 
@@ -739,15 +789,13 @@ namespace ardb
                 info.append("wbuf_cap=").append(stringfromll(conn->GetOutputBuffer().Capacity())).append(" ");
                 conn->GetOutputBuffer().Compact(8192);
                 std::string cmd;
-                RedisCommandHandlerSettingTable::iterator cit = m_settings.begin();
-                while (cit != m_settings.end())
+                for (size_t i = 0; i < m_settings.size(); i++)
                 {
-                    if (cit->second.type == client_ctx->last_cmdtype)
+                    if (m_settings[i].type == client_ctx->last_cmdtype)
                     {
-                        cmd = cit->first;
+                        cmd = m_settings_names[i];
                         break;
                     }
-                    cit++;
                 }
                 info.append("cmd=").append(cmd).append(" ");
                 info.append("\n");
@@ -779,6 +827,12 @@ namespace ardb
                 return 0;
             }
             Statistics::GetSingleton().Clear();
+            for (size_t i = 0; i < m_settings.size(); i++)
+            {
+                m_settings[i].calls = 0;
+                m_settings[i].microseconds = 0;
+                m_settings[i].latency->Clear();
+            }
             reply.SetStatusCode(STATUS_OK);
         }
         else if (arg0 == "get")
@@ -1151,7 +1205,11 @@ namespace ardb
     {
         RedisReply& reply = ctx.GetReply();
         reply.SetStatusCode(STATUS_OK);
-        if (!strcasecmp(cmd.GetArguments()[0].c_str(), "iterator"))
+        if (cmd.GetArguments().size() < 2 && (!strcasecmp(cmd.GetArguments()[0].c_str(), "iterator") || !strcasecmp(cmd.GetArguments()[0].c_str(), "replay")))
+        {
+            reply.SetErrCode(ERR_INVALID_SYNTAX);
+        }
+        else if (!strcasecmp(cmd.GetArguments()[0].c_str(), "iterator"))
         {
             KeyObject empty;
             empty.SetNameSpace(ctx.ns);
@@ -1213,6 +1271,14 @@ namespace ardb
              */
             g_repl->GetReplLog().DebugDumpCache(g_db->GetConf().home + "/dwc.txt");
         }
+        else if (!strcasecmp(cmd.GetArguments()[0].c_str(), "sweep"))
+        {
+            /*
+             * reclaim the elements of deleted versioned collections now instead of waiting for the sweeper
+             */
+            Context sweep_ctx;
+            reply.SetInteger(SweepStaleVersions(sweep_ctx));
+        }
         return 0;
     }
 
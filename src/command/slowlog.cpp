@@ -129,5 +129,67 @@ namespace ardb
         }
         return 0;
     }
+
+    /*
+     * LATENCY HISTOGRAM [command ...], cumulative counts per non empty bucket like redis 7, the bucket
+     * bound is its largest latency in microseconds.
+     */
+    int Ardb::Latency(Context& ctx, RedisCommandFrame& cmd)
+    {
+        std::string subcmd = string_tolower(cmd.GetArguments()[0]);
+        RedisReply& reply = ctx.GetReply();
+        if (subcmd != "histogram")
+        {
+            reply.SetErrorReason("LATENCY subcommand must be HISTOGRAM");
+            return 0;
+        }
+        reply.ReserveMember(0);
+        uint64 counts[LATENCY_HISTOGRAM_BUCKETS];
+        for (size_t i = 0; i < m_settings.size(); i++)
+        {
+            const std::string& name = m_settings_names[i];
+            if (name.empty())
+            {
+                continue;
+            }
+            if (cmd.GetArguments().size() > 1)
+            {
+                bool wanted = false;
+                for (size_t j = 1; j < cmd.GetArguments().size() && !wanted; j++)
+                {
+                    wanted = !strcasecmp(cmd.GetArguments()[j].c_str(), name.c_str());
+                }
+                if (!wanted)
+                {
+                    continue;
+                }
+            }
+            uint64 total = m_settings[i].latency->Merge(counts);
+            if (0 == total)
+            {
+                continue;
+            }
+            reply.AddMember().SetString(name);
+            RedisReply& stat = reply.AddMember();
+            stat.ReserveMember(0);
+            stat.AddMember().SetString("calls");
+            stat.AddMember().SetInteger(total);
+            stat.AddMember().SetString("histogram_usec");
+            RedisReply& hist = stat.AddMember();
+            hist.ReserveMember(0);
+            uint64 sum = 0;
+            for (size_t j = 0; j < LATENCY_HISTOGRAM_BUCKETS; j++)
+            {
+                if (0 == counts[j])
+                {
+                    continue;
+                }
+                sum += counts[j];
+                hist.AddMember().SetInteger(CommandLatencyHistogram::BucketUpperBound(j));
+                hist.AddMember().SetInteger(sum);
+            }
+        }
+        return 0;
+    }
 }
 
@@ -223,11 +223,13 @@ namespace ardb
                 return 0;
             }
             KeyObject startkey(ctx.ns, (KeyType) element_type((KeyType) meta.GetType()), key.GetKey());
+            startkey.BindCollection(meta);
             Iterator* iter = m_engine->Find(ctx, startkey);
             while (iter->Valid())
             {
                 KeyObject& k = iter->Key(true);
-                if (k.GetType() != startkey.GetType() || k.GetNameSpace() != startkey.GetNameSpace() || k.GetKey() != startkey.GetKey())
+                if (k.GetType() != startkey.GetType() || k.GetNameSpace() != startkey.GetNameSpace() || k.GetKey() != startkey.GetKey()
+                        || k.GetVersion() != startkey.GetVersion())
                 {
                     break;
                 }
@@ -338,11 +340,13 @@ namespace ardb
             store_meta.SetObjectLen(value_list.size());
             store_meta.GetMetaObject().list_sequential = true;
             store_meta.SetListMinIdx(0);
+            NewCollectionVersion(store_meta);
             DataArray::iterator it = value_list.begin();
             int64_t idx = 0;
             while (it != value_list.end())
             {
                 KeyObject ele_key(ctx.ns, KEY_LIST_ELEMENT, options.store_dst);
+                ele_key.BindCollection(store_meta);
                 ele_key.SetListIndex(idx);
                 ValueObject ele_value;
                 ele_value.SetType(KEY_LIST_ELEMENT);
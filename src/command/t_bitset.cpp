@@ -28,183 +28,206 @@
  */
 
 #include "db/db.hpp"
+#include "util/bit_helper.hpp"
 
 OP_NAMESPACE_BEGIN
-    static const unsigned long BITOP_AND = 0;
-    static const unsigned long BITOP_OR = 1;
-    static const unsigned long BITOP_XOR = 2;
-    static const unsigned long BITOP_NOT = 3;
-
-    //copy from redis
-    static long popcount(const void *s, long count)
+    static bool get_bit_offset(const std::string& str, int64& offset)
     {
-        long bits = 0;
-        unsigned char *p;
-        const uint32_t* p4 = (const uint32_t*) s;
-        static const unsigned char bitsinbyte[256] =
-        { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3,
-                3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3,
-                3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3,
-                3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 2, 3,
-                3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 4, 5,
-                5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8 };
-
-        /* Count bits 16 bytes at a time */
-        while (count >= 16)
-        {
-            uint32_t aux1, aux2, aux3, aux4;
-
-            aux1 = *p4++;
-            aux2 = *p4++;
-            aux3 = *p4++;
-            aux4 = *p4++;
-            count -= 16;
-
-            aux1 = aux1 - ((aux1 >> 1) & 0x55555555);
-            aux1 = (aux1 & 0x33333333) + ((aux1 >> 2) & 0x33333333);
-            aux2 = aux2 - ((aux2 >> 1) & 0x55555555);
-            aux2 = (aux2 & 0x33333333) + ((aux2 >> 2) & 0x33333333);
-            aux3 = aux3 - ((aux3 >> 1) & 0x55555555);
-            aux3 = (aux3 & 0x33333333) + ((aux3 >> 2) & 0x33333333);
-            aux4 = aux4 - ((aux4 >> 1) & 0x55555555);
-            aux4 = (aux4 & 0x33333333) + ((aux4 >> 2) & 0x33333333);
-            bits += ((((aux1 + (aux1 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24) + ((((aux2 + (aux2 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24)
-                    + ((((aux3 + (aux3 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24) + ((((aux4 + (aux4 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
-        }
-        /* Count the remaining bytes */
-        p = (unsigned char*) p4;
-        while (count--)
-            bits += bitsinbyte[*p++];
-        return bits;
+        if (!string_toint64(str, offset) || offset < 0 || ((unsigned long long) offset >> 3) >= (512 * 1024 * 1024))
+        {
+            return false;
+        }
+        return true;
     }
 
-//    static long popcount_bitval(const std::string& val, int32 offset, int32 limit)
-//    {
-//        if (limit < 0)
-//        {
-//            limit = val.size() - 1;
-//        }
-//        if (val.size() > (size_t)limit)
-//        {
-//            std::string tmp = val.substr(offset, limit - offset + 1);
-//            return popcount(tmp.data(), tmp.size());
-//        }
-//        else if (val.size() <= (size_t)limit && val.size() <= (size_t)offset)
-//        {
-//            return 0;
-//        }
-//        else if (val.size() > (size_t)offset)
-//        {
-//            std::string tmp = val.substr(offset);
-//            return popcount(tmp.data(), tmp.size());
-//        }
-//        return 0;
-//    }
-
-    static bool get_bit_offset(const std::string& str, int64& offset)
+    /*
+     * Bit commands work on strings and chunked bitmaps.
+     */
+    static bool check_bitmap_type(Context& ctx, ValueObject& v)
     {
-        if (!string_toint64(str, offset) || offset < 0 || ((unsigned long long) offset >> 3) >= (512 * 1024 * 1024))
+        if (v.GetType() != 0 && v.GetType() != KEY_STRING && v.GetType() != KEY_BITMAP)
         {
+            ctx.GetReply().SetErrCode(ERR_WRONG_TYPE);
             return false;
         }
         return true;
     }
 
-    /* Return the position of the first bit set to one (if 'bit' is 1) or
-     * zero (if 'bit' is 0) in the bitmap starting at 's' and long 'count' bytes.
-     *
-     * The function is guaranteed to return a value >= 0 if 'bit' is 0 since if
-     * no zero bit is found, it returns count*8 assuming the string is zero
-     * padded on the right. However if 'bit' is 1 it is possible that there is
-     * not a single set bit in the bitmap. In this special case -1 is returned. */
-    static long bitpos(void *s, unsigned long count, int bit)
+    /*
+     * Reads a chunked bitmap segment by segment in ascending order with one iterator. Segments never
+     * written, or cleared to all zero, are absent and read as zero bytes.
+     */
+    class BitmapReader
+    {
+        private:
+            Context& m_ctx;
+            Engine* m_engine;
+            KeyObject m_start;
+            int64 m_segment;
+            Iterator* m_iter;
+        public:
+            BitmapReader(Context& ctx, Engine* engine, const KeyObject& key, ValueObject& meta)
+                    : m_ctx(ctx), m_engine(engine), m_start(key.GetNameSpace(), KEY_BITMAP_SEGMENT, key.GetKey()), m_segment(
+                            meta.GetMetaObject().bitmap_segment), m_iter(NULL)
+            {
+                m_start.BindCollection(meta);
+            }
+            /*
+             * Positions at the first segment whose index >= 'first', return false if there is none.
+             */
+            bool Seek(int64 first, int64& idx, Data*& bytes, int64& count)
+            {
+                if (NULL == m_iter)
+                {
+                    m_start.SetBitmapSegment(first);
+                    m_iter = m_engine->Find(m_ctx, m_start);
+                }
+                while (m_iter->Valid())
+                {
+                    KeyObject& k = m_iter->Key();
+                    if (k.GetType() != KEY_BITMAP_SEGMENT || k.GetKey() != m_start.GetKey()
+                            || k.GetNameSpace() != m_start.GetNameSpace() || k.GetVersion() != m_start.GetVersion())
+                    {
+                        return false;
+                    }
+                    idx = k.GetBitmapSegment();
+                    if (idx >= first)
+                    {
+                        ValueObject& v = m_iter->Value();
+                        bytes = &v.GetBitmapSegmentBytes();
+                        count = v.GetBitmapSegmentCount();
+                        return true;
+                    }
+                    m_iter->Next();
+                }
+                return false;
+            }
+            void Next()
+            {
+                m_iter->Next();
+            }
+            /*
+             * Copies bytes [begin, end] into 'out', successive ranges must not go backwards.
+             */
+            void Read(int64 begin, int64 end, std::string& out)
+            {
+                out.assign(end - begin + 1, 0);
+                int64 idx, count;
+                Data* bytes = NULL;
+                while (Seek(begin / m_segment, idx, bytes, count) && idx * m_segment <= end)
+                {
+                    int64 seg_begin = idx * m_segment;
+                    int64 from = std::max(begin, seg_begin);
+                    int64 to = std::min(end + 1, seg_begin + (int64) bytes->StringLength());
+                    if (to > from)
+                    {
+                        memcpy(&out[from - begin], bytes->CStr() + (from - seg_begin), to - from);
+                    }
+                    if (seg_begin + m_segment - 1 > end)
+                    {
+                        /* the rest of the segment belongs to the next range */
+                        break;
+                    }
+                    Next();
+                }
+            }
+            ~BitmapReader()
+            {
+                DELETE(m_iter);
+            }
+    };
+
+    int Ardb::GetBitmapRange(Context& ctx, const KeyObject& key, ValueObject& meta, int64 start, int64 end, std::string& bytes)
     {
-        unsigned long *l;
-        unsigned char *c;
-        unsigned long skipval, word = 0, one;
-        long pos = 0; /* Position of bit, to return to the caller. */
-        unsigned long j;
-
-        /* Process whole words first, seeking for first word that is not
-         * all ones or all zeros respectively if we are lookig for zeros
-         * or ones. This is much faster with large strings having contiguous
-         * blocks of 1 or 0 bits compared to the vanilla bit per bit processing.
-         *
-         * Note that if we start from an address that is not aligned
-         * to sizeof(unsigned long) we consume it byte by byte until it is
-         * aligned. */
-
-        /* Skip initial bits not aligned to sizeof(unsigned long) byte by byte. */
-        skipval = bit ? 0 : UCHAR_MAX;
-        c = (unsigned char*) s;
-        while ((unsigned long) c & (sizeof(*l) - 1) && count)
-        {
-            if (*c != skipval)
-                break;
-            c++;
-            count--;
-            pos += 8;
-        }
-
-        /* Skip bits with full word step. */
-        skipval = bit ? 0 : ULONG_MAX;
-        l = (unsigned long*) c;
-        while (count >= sizeof(*l))
-        {
-            if (*l != skipval)
-                break;
-            l++;
-            count -= sizeof(*l);
-            pos += sizeof(*l) * 8;
-        }
-
-        /* Load bytes into "word" considering the first byte as the most significant
-         * (we basically consider it as written in big endian, since we consider the
-         * string as a set of bits from left to right, with the first bit at position
-         * zero.
-         *
-         * Note that the loading is designed to work even when the bytes left
-         * (count) are less than a full word. We pad it with zero on the right. */
-        c = (unsigned char*) l;
-        for (j = 0; j < sizeof(*l); j++)
-        {
-            word <<= 8;
-            if (count)
-            {
-                word |= *c;
-                c++;
-                count--;
-            }
-        }
-
-        /* Special case:
-         * If bits in the string are all zero and we are looking for one,
-         * return -1 to signal that there is not a single "1" in the whole
-         * string. This can't happen when we are looking for "0" as we assume
-         * that the right of the string is zero padded. */
-        if (bit == 1 && word == 0)
-            return -1;
-
-        /* Last word left, scan bit by bit. The first thing we need is to
-         * have a single "1" set in the most significant position in an
-         * unsigned long. We don't know the size of the long so we use a
-         * simple trick. */
-        one = ULONG_MAX; /* All bits set to 1.*/
-        one >>= 1; /* All bits set to 1 but the MSB. */
-        one = ~one; /* All bits set to 0 but the MSB. */
-
-        while (one)
-        {
-            if (((one & word) != 0) == bit)
-                return pos;
-            pos++;
-            one >>= 1;
-        }
-
-        /* If we reached this point, there is a bug in the algorithm, since
-         * the case of no match is handled as a special case before. */
-        abort();
-        return 0; /* Just to avoid warnings. */
+        bytes.clear();
+        if (start > end)
+        {
+            return 0;
+        }
+        BitmapReader reader(ctx, m_engine, key, meta);
+        reader.Read(start, end, bytes);
+        return 0;
+    }
+
+    /*
+     * SETBIT on a chunked bitmap rewrites the one segment holding the bit and the small meta,
+     * a segment cleared to all zero is removed.
+     */
+    int Ardb::BitmapSetBit(Context& ctx, const KeyObject& key, ValueObject& meta, int64 offset, uint8 on, uint8& oldbit)
+    {
+        MetaObject& m = meta.GetMetaObject();
+        if (meta.GetType() == 0)
+        {
+            meta.SetType(KEY_BITMAP);
+            meta.SetObjectLen(0);
+            m.bitmap_segment = GetConf().bitmap_segment_size;
+            NewCollectionVersion(meta);
+        }
+        int64 byte = offset >> 3;
+        KeyObject segkey(ctx.ns, KEY_BITMAP_SEGMENT, key.GetKey());
+        segkey.BindCollection(meta);
+        segkey.SetBitmapSegment(byte / m.bitmap_segment);
+        ValueObject seg;
+        int err = m_engine->Get(ctx, segkey, seg);
+        if (0 != err && ERR_ENTRY_NOT_EXIST != err)
+        {
+            return err;
+        }
+        bool exists = 0 == err;
+        std::string bytes;
+        int64 count = 0;
+        if (exists)
+        {
+            seg.GetBitmapSegmentBytes().ToString(bytes);
+            count = seg.GetBitmapSegmentCount();
+        }
+        size_t pos = byte % m.bitmap_segment;
+        int bit = 7 - (offset & 0x7);
+        oldbit = (pos < bytes.size() && (bytes[pos] & (1 << bit))) ? 1 : 0;
+        bool meta_changed = false;
+        if (byte >= m.bitmap_len)
+        {
+            m.bitmap_len = byte + 1;
+            meta_changed = true;
+        }
+        WriteBatchGuard batch(ctx, m_engine);
+        err = 0;
+        if (oldbit != on)
+        {
+            if (pos >= bytes.size())
+            {
+                bytes.resize(pos + 1, 0);
+            }
+            bytes[pos] ^= (1 << bit);
+            count += on ? 1 : -1;
+            m.bitmap_count += on ? 1 : -1;
+            if (count > 0)
+            {
+                seg.SetType(KEY_BITMAP_SEGMENT);
+                seg.GetBitmapSegmentBytes().SetString(bytes, false);
+                seg.SetBitmapSegmentCount(count);
+                err = SetKeyValue(ctx, segkey, seg);
+                if (!exists)
+                {
+                    meta.SetObjectLen(meta.GetObjectLen() + 1);
+                }
+            }
+            else
+            {
+                err = RemoveKey(ctx, segkey);
+                meta.SetObjectLen(meta.GetObjectLen() - 1);
+            }
+            meta_changed = true;
+        }
+        if (0 == err && meta_changed)
+        {
+            err = SetKeyValue(ctx, key, meta);
+        }
+        if (0 != err)
+        {
+            batch.MarkFailed(err);
+        }
+        return err;
     }
 
     int Ardb::MergeSetBit(Context& ctx, const KeyObject& key, ValueObject& meta, int64 offset, uint8 on, uint8* oldbit)
@@ -253,9 +276,9 @@ OP_NAMESPACE_BEGIN
         uint8 bit = cmd.GetArguments()[2] != "0" ? 1 : 0;
         int err = 0;
         /*
-         * merge setbit
+         * merge setbit, chunked bitmaps need the meta to locate the segment
          */
-        if (!ctx.flags.redis_compatible && m_engine->GetFeatureSet().support_merge)
+        if (!ctx.flags.redis_compatible && m_engine->GetFeatureSet().support_merge && GetConf().bitmap_segment_size <= 0)
         {
             DataArray args(2);
             args[0].SetInt64(offset);
@@ -271,12 +294,33 @@ OP_NAMESPACE_BEGIN
             }
             return 0;
         }
+        /*
+         * the counters & version of a chunked bitmap are updated from the meta read here
+         */
+        KeyLockGuard guard(ctx, key);
         ValueObject v;
-        if (!CheckMeta(ctx, key, KEY_STRING, v))
+        if (!CheckMeta(ctx, key, (KeyType) 0, v) || !check_bitmap_type(ctx, v))
         {
             return 0;
         }
         uint8 oldbit = 0;
+        if (v.GetType() == KEY_BITMAP || (v.GetType() == 0 && GetConf().bitmap_segment_size > 0))
+        {
+            err = BitmapSetBit(ctx, key, v, offset, bit, oldbit);
+            if (0 == err)
+            {
+                err = ctx.transc_err;
+            }
+            if (err < 0)
+            {
+                reply.SetErrCode(err);
+            }
+            else
+            {
+                reply.SetInteger(oldbit);
+            }
+            return 0;
+        }
         err = MergeSetBit(ctx, key, v, offset, bit, &oldbit);
         if (0 == err)
         {
@@ -307,7 +351,7 @@ OP_NAMESPACE_BEGIN
         size_t bit = 7 - (bitoffset & 0x7);
         reply.SetInteger(0); //default response
         ValueObject v;
-        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_STRING, v))
+        if (!CheckMeta(ctx, cmd.GetArguments()[0], (KeyType) 0, v) || !check_bitmap_type(ctx, v))
         {
             return 0;
         }
@@ -315,6 +359,24 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
+        if (v.GetType() == KEY_BITMAP)
+        {
+            int64 segment = v.GetMetaObject().bitmap_segment;
+            KeyObject segkey(ctx.ns, KEY_BITMAP_SEGMENT, cmd.GetArguments()[0]);
+            segkey.BindCollection(v);
+            segkey.SetBitmapSegment(byte / segment);
+            ValueObject seg;
+            if (0 == m_engine->Get(ctx, segkey, seg))
+            {
+                Data& bytes = seg.GetBitmapSegmentBytes();
+                size_t pos = byte % segment;
+                if (pos < bytes.StringLength() && (bytes.CStr()[pos] & (1 << bit)))
+                {
+                    reply.SetInteger(1);
+                }
+            }
+            return 0;
+        }
         Data& str = v.GetStringValue();
         if (str.IsString())
         {
@@ -347,25 +409,31 @@ OP_NAMESPACE_BEGIN
         RedisReply& reply = ctx.GetReply();
         reply.SetInteger(0); //default response
         ValueObject v;
-        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_STRING, v) || v.GetType() == 0)
+        if (!CheckMeta(ctx, cmd.GetArguments()[0], (KeyType) 0, v) || !check_bitmap_type(ctx, v) || v.GetType() == 0)
         {
             return 0;
         }
 
-        Data& str = v.GetStringValue();
-
-        /* Set the 'p' pointer to the string, that can be just a stack allocated
-         * array if our string was integer encoded. */
-        if (!str.IsString())
+        if (v.GetType() == KEY_BITMAP)
         {
-            str.ToString(strbuf);
-            p = (const unsigned char*) (&strbuf[0]);
-            strlen = strbuf.size();
+            strlen = v.GetMetaObject().bitmap_len;
         }
         else
         {
-            p = (const unsigned char*) str.CStr();
-            strlen = str.StringLength();
+            Data& str = v.GetStringValue();
+            /* Set the 'p' pointer to the string, that can be just a stack allocated
+             * array if our string was integer encoded. */
+            if (!str.IsString())
+            {
+                str.ToString(strbuf);
+                p = (const unsigned char*) (&strbuf[0]);
+                strlen = strbuf.size();
+            }
+            else
+            {
+                p = (const unsigned char*) str.CStr();
+                strlen = str.StringLength();
+            }
         }
         /* Parse start/end range if any. */
         if (cmd.GetArguments().size() == 3)
@@ -400,10 +468,45 @@ OP_NAMESPACE_BEGIN
         }
         /* Precondition: end >= 0 && end < strlen, so the only condition where
          * zero can be returned is: start > end. */
-        if (start <= end)
+        if (start <= end && v.GetType() == KEY_BITMAP)
+        {
+            MetaObject& m = v.GetMetaObject();
+            if (0 == start && end == strlen - 1)
+            {
+                reply.SetInteger(m.bitmap_count);
+                return 0;
+            }
+            /*
+             * only the segments in range are read, the ones fully inside count by their recorded bits
+             */
+            KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
+            BitmapReader reader(ctx, m_engine, key, v);
+            int64 idx, count, bits = 0;
+            Data* bytes = NULL;
+            while (reader.Seek(start / m.bitmap_segment, idx, bytes, count) && idx * m.bitmap_segment <= end)
+            {
+                int64 seg_begin = idx * m.bitmap_segment;
+                if (seg_begin >= start && seg_begin + m.bitmap_segment - 1 <= end)
+                {
+                    bits += count;
+                }
+                else
+                {
+                    int64 from = std::max(start, seg_begin);
+                    int64 to = std::min(end + 1, seg_begin + (int64) bytes->StringLength());
+                    if (to > from)
+                    {
+                        bits += bits_popcount(bytes->CStr() + (from - seg_begin), to - from);
+                    }
+                }
+                reader.Next();
+            }
+            reply.SetInteger(bits);
+        }
+        else if (start <= end)
         {
             long bytes = end - start + 1;
-            reply.SetInteger(popcount(p + start, bytes));
+            reply.SetInteger(bits_popcount(p + start, bytes));
         }
         return 0;
     }
@@ -426,7 +529,7 @@ OP_NAMESPACE_BEGIN
         }
 
         ValueObject v;
-        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_STRING, v) || v.GetType() == 0)
+        if (!CheckMeta(ctx, cmd.GetArguments()[0], (KeyType) 0, v) || !check_bitmap_type(ctx, v))
         {
             return 0;
         }
@@ -436,19 +539,26 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         std::string strbuf;
-        Data& str = v.GetStringValue();
-        /* Set the 'p' pointer to the string, that can be just a stack allocated
-         * array if our string was integer encoded. */
-        if (!str.IsString())
+        if (v.GetType() == KEY_BITMAP)
         {
-            str.ToString(strbuf);
-            p = (const unsigned char *) &strbuf[0];
-            strlen = strbuf.size();
+            strlen = v.GetMetaObject().bitmap_len;
         }
         else
         {
-            p = (const unsigned char *) str.CStr();
-            strlen = str.StringLength();
+            Data& str = v.GetStringValue();
+            /* Set the 'p' pointer to the string, that can be just a stack allocated
+             * array if our string was integer encoded. */
+            if (!str.IsString())
+            {
+                str.ToString(strbuf);
+                p = (const unsigned char *) &strbuf[0];
+                strlen = strbuf.size();
+            }
+            else
+            {
+                p = (const unsigned char *) str.CStr();
+                strlen = str.StringLength();
+            }
         }
 
         /* Parse start/end range if any. */
@@ -497,10 +607,60 @@ OP_NAMESPACE_BEGIN
         {
             reply.SetInteger(-1);
         }
+        else if (v.GetType() == KEY_BITMAP)
+        {
+            /*
+             * walk the segments from start, an absent segment or the missing tail of a segment is all zero
+             */
+            KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
+            BitmapReader reader(ctx, m_engine, key, v);
+            int64 segment = v.GetMetaObject().bitmap_segment;
+            int64 idx, count, cursor = start, pos = -1;
+            Data* bytes = NULL;
+            while (cursor <= end && reader.Seek(cursor / segment, idx, bytes, count))
+            {
+                int64 seg_begin = idx * segment;
+                if (seg_begin > end || (bit == 0 && seg_begin > cursor))
+                {
+                    break;
+                }
+                int64 from = std::max(cursor, seg_begin);
+                int64 seg_end = std::min(end, seg_begin + segment - 1);
+                int64 to = std::min(seg_end + 1, seg_begin + (int64) bytes->StringLength());
+                if (to > from && (bit == 0 || count > 0))
+                {
+                    int64 found = bits_pos(bytes->CStr() + (from - seg_begin), to - from, bit);
+                    if (found >= 0 && found < (to - from) * 8)
+                    {
+                        pos = from * 8 + found;
+                        break;
+                    }
+                }
+                if (bit == 0 && to <= seg_end)
+                {
+                    pos = std::max(to, from) * 8;
+                    break;
+                }
+                cursor = seg_end + 1;
+                reader.Next();
+            }
+            if (pos < 0 && bit == 0)
+            {
+                if (cursor <= end)
+                {
+                    pos = cursor * 8;
+                }
+                else if (!end_given)
+                {
+                    pos = (end + 1) * 8;
+                }
+            }
+            reply.SetInteger(pos);
+        }
         else
         {
             long bytes = end - start + 1;
-            long pos = bitpos((void*) (p + start), bytes, bit);
+            long pos = bits_pos(p + start, bytes, bit);
 
             /* If we are looking for clear bits, and the user specified an exact
              * range with start-end, we can't consider the right of the range as
@@ -541,7 +701,6 @@ OP_NAMESPACE_BEGIN
         unsigned long op;
         unsigned long maxlen = 0; /* Array of length of src strings,
          and max len. */
-        unsigned long minlen = 0; /* Min len among the input keys. */
         std::string res; /* Resulting string. */
 
         /* Parse the operation name. */
@@ -576,159 +735,80 @@ OP_NAMESPACE_BEGIN
             KeyObject k(ctx.ns, KEY_META, cmd.GetArguments()[i]);
             keys.push_back(k);
         }
+        /*
+         * BITOP locks the destination & the sources, a chunked source is read segment by segment
+         */
+        KeyObjectArray lock_keys;
+        if (cmd.GetType() == REDIS_CMD_BITOP)
+        {
+            lock_keys = keys;
+        }
+        KeysLockGuard guard(ctx, lock_keys);
         m_engine->MultiGet(ctx, keys, vals, errs);
         if (cmd.GetType() == REDIS_CMD_BITOP)
         {
-            if (vals[0].GetType() != 0 && vals[0].GetType() != KEY_STRING)
+            if (!check_bitmap_type(ctx, vals[0]))
             {
-                reply.SetErrCode(ERR_WRONG_TYPE);
                 return 0;
             }
         }
         //printf("####%s %s\n", vals[0].GetStringValue().AsString().c_str(),vals[1].GetStringValue().AsString().c_str());
 
         size_t numkeys = keys.size() - destkey_count;
+        bool chunked = cmd.GetType() == REDIS_CMD_BITOP && GetConf().bitmap_segment_size > 0;
         for (size_t j = destkey_count; j < keys.size(); j++)
         {
+            /* Return an error if one of the keys is not a string. */
+            if (!check_bitmap_type(ctx, vals[j]))
+            {
+                return 0;
+            }
             /* Handle non-existing keys as empty strings. */
             if (vals[j].GetType() == 0)
             {
-                minlen = 0;
                 continue;
             }
-            /* Return an error if one of the keys is not a string. */
-            if (vals[j].GetType() != KEY_STRING)
+            if (vals[j].GetType() == KEY_BITMAP)
             {
-                reply.SetErrCode(ERR_WRONG_TYPE);
-                return 0;
+                chunked = true;
+                continue;
             }
             vals[j].GetStringValue().ToMutableStr();
             size_t slen = vals[j].GetStringValue().StringLength();
             if (slen > maxlen)
                 maxlen = slen;
-            if (j == 0 || slen < minlen)
-                minlen = slen;
+        }
+
+        if (chunked)
+        {
+            return BitopChunked(ctx, cmd, op, keys, vals, destkey_count);
         }
 
         /* Compute the bit operation, if at least one string is not empty. */
         if (maxlen)
         {
             res.resize(maxlen);
-            unsigned char output, byte;
-            unsigned long i;
-
-            /* Fast path: as far as we have data for all the input bitmaps we
-             * can take a fast path that performs much better than the
-             * vanilla algorithm. */
-            size_t j = 0;
-            if (minlen >= sizeof(unsigned long) * 4 && numkeys <= 16)
-            {
-                unsigned long *lp[16];
-                unsigned long *lres = (unsigned long*) (&res[0]);
-
-                /* Note: sds pointer is always aligned to 8 byte boundary. */
-                for (size_t k = 0; k < numkeys; k++)
-                {
-                    lp[k] = (unsigned long*) (vals[k + destkey_count].GetStringValue().CStr());
-                }
-                memcpy(&res[0], vals[destkey_count].GetStringValue().CStr(), minlen);
-
-                /* Different branches per different operations for speed (sorry). */
-                if (op == BITOP_AND)
-                {
-                    while (minlen >= sizeof(unsigned long) * 4)
-                    {
-                        for (i = 1; i < numkeys; i++)
-                        {
-                            lres[0] &= lp[i][0];
-                            lres[1] &= lp[i][1];
-                            lres[2] &= lp[i][2];
-                            lres[3] &= lp[i][3];
-                            lp[i] += 4;
-                        }
-                        lres += 4;
-                        j += sizeof(unsigned long) * 4;
-                        minlen -= sizeof(unsigned long) * 4;
-                    }
-                }
-                else if (op == BITOP_OR)
-                {
-                    while (minlen >= sizeof(unsigned long) * 4)
-                    {
-                        for (i = 1; i < numkeys; i++)
-                        {
-                            lres[0] |= lp[i][0];
-                            lres[1] |= lp[i][1];
-                            lres[2] |= lp[i][2];
-                            lres[3] |= lp[i][3];
-                            lp[i] += 4;
-                        }
-                        lres += 4;
-                        j += sizeof(unsigned long) * 4;
-                        minlen -= sizeof(unsigned long) * 4;
-                    }
-                }
-                else if (op == BITOP_XOR)
-                {
-                    while (minlen >= sizeof(unsigned long) * 4)
-                    {
-                        for (i = 1; i < numkeys; i++)
-                        {
-                            lres[0] ^= lp[i][0];
-                            lres[1] ^= lp[i][1];
-                            lres[2] ^= lp[i][2];
-                            lres[3] ^= lp[i][3];
-                            lp[i] += 4;
-                        }
-                        lres += 4;
-                        j += sizeof(unsigned long) * 4;
-                        minlen -= sizeof(unsigned long) * 4;
-                    }
-                }
-                else if (op == BITOP_NOT)
-                {
-                    while (minlen >= sizeof(unsigned long) * 4)
-                    {
-                        lres[0] = ~lres[0];
-                        lres[1] = ~lres[1];
-                        lres[2] = ~lres[2];
-                        lres[3] = ~lres[3];
-                        lres += 4;
-                        j += sizeof(unsigned long) * 4;
-                        minlen -= sizeof(unsigned long) * 4;
-                    }
-                }
-            }
-
-            /* j is set to the next byte to process by the previous loop. */
-            for (; j < maxlen; j++)
+            std::vector<const unsigned char*> srcs(numkeys, (const unsigned char*) NULL);
+            std::vector<size_t> lens(numkeys, 0);
+            for (size_t j = 0; j < numkeys; j++)
             {
-                Data& first = vals[destkey_count].GetStringValue();
-                output = (first.StringLength() <= j) ? 0 : first.CStr()[j];
-                if (op == BITOP_NOT)
-                    output = ~output;
-                for (i = 1; i < numkeys; i++)
+                if (vals[j + destkey_count].GetType() == KEY_STRING)
                 {
-                    byte = (vals[i + destkey_count].GetStringValue().StringLength() <= j) ? 0 : vals[destkey_count + 1].GetStringValue().CStr()[j];
-                    switch (op)
-                    {
-                        case BITOP_AND:
-                            output &= byte;
-                            break;
-                        case BITOP_OR:
-                            output |= byte;
-                            break;
-                        case BITOP_XOR:
-                            output ^= byte;
-                            break;
-                    }
+                    Data& str = vals[j + destkey_count].GetStringValue();
+                    srcs[j] = (const unsigned char*) str.CStr();
+                    lens[j] = str.StringLength();
                 }
-                res[j] = output;
             }
+            bits_op(op, (unsigned char*) &res[0], maxlen, &srcs[0], &lens[0], numkeys);
         }
 
         /* Store the computed value into the target key */
         int err = 0;
+        if (cmd.GetType() == REDIS_CMD_BITOP && vals[0].GetType() == KEY_BITMAP)
+        {
+            DelKey(ctx, keys[0]);
+            vals[0].Clear();
+        }
         if (maxlen)
         {
             if (cmd.GetType() == REDIS_CMD_BITOP)
@@ -739,7 +819,7 @@ OP_NAMESPACE_BEGIN
             }
             else
             {
-                maxlen = popcount(res.c_str(), res.size());
+                maxlen = bits_popcount(res.data(), res.size());
             }
         }
         else
@@ -760,5 +840,135 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
+    /*
+     * BITOP/BITOPCOUNT involving chunked bitmaps, computed one segment size window at a time so
+     * neither the operands nor the result are ever held in full. BITOP stores a chunked bitmap.
+     */
+    int Ardb::BitopChunked(Context& ctx, RedisCommandFrame& cmd, uint32 op, KeyObjectArray& keys, ValueObjectArray& vals,
+            size_t destkey_count)
+    {
+        RedisReply& reply = ctx.GetReply();
+        bool store = cmd.GetType() == REDIS_CMD_BITOP;
+        int64 segment = GetConf().bitmap_segment_size;
+        int64 maxlen = 0;
+        std::vector<BitmapReader*> readers(keys.size(), (BitmapReader*) NULL);
+        for (size_t j = destkey_count; j < keys.size(); j++)
+        {
+            int64 len = 0;
+            if (vals[j].GetType() == KEY_BITMAP)
+            {
+                MetaObject& m = vals[j].GetMetaObject();
+                len = m.bitmap_len;
+                if (segment <= 0)
+                {
+                    segment = m.bitmap_segment;
+                }
+                readers[j] = new BitmapReader(ctx, m_engine, keys[j], vals[j]);
+            }
+            else if (vals[j].GetType() == KEY_STRING)
+            {
+                vals[j].GetStringValue().ToMutableStr();
+                len = vals[j].GetStringValue().StringLength();
+            }
+            maxlen = std::max(maxlen, len);
+        }
+
+        ValueObject dest_meta;
+        if (store)
+        {
+            dest_meta.SetType(KEY_BITMAP);
+            dest_meta.SetObjectLen(0);
+            dest_meta.GetMetaObject().bitmap_segment = segment;
+            dest_meta.GetMetaObject().bitmap_len = maxlen;
+            NewCollectionVersion(dest_meta);
+        }
+        int64 total = 0;
+        {
+            WriteBatchGuard batch(ctx, m_engine);
+            if (maxlen > 0)
+            {
+                size_t numkeys = keys.size() - destkey_count;
+                std::string res;
+                std::vector<std::string> windows(numkeys);
+                std::vector<const unsigned char*> srcs(numkeys, (const unsigned char*) NULL);
+                std::vector<size_t> lens(numkeys, 0);
+                for (int64 begin = 0; begin < maxlen; begin += segment)
+                {
+                    int64 end = std::min(begin + segment, maxlen) - 1;
+                    for (size_t j = destkey_count; j < keys.size(); j++)
+                    {
+                        size_t k = j - destkey_count;
+                        lens[k] = 0;
+                        if (NULL != readers[j])
+                        {
+                            readers[j]->Read(begin, end, windows[k]);
+                            srcs[k] = (const unsigned char*) windows[k].data();
+                            lens[k] = windows[k].size();
+                        }
+                        else if (vals[j].GetType() == KEY_STRING)
+                        {
+                            /* plain strings are used in place, bits_op zero pads past their end */
+                            Data& str = vals[j].GetStringValue();
+                            if ((int64) str.StringLength() > begin)
+                            {
+                                srcs[k] = (const unsigned char*) str.CStr() + begin;
+                                lens[k] = std::min(end + 1, (int64) str.StringLength()) - begin;
+                            }
+                        }
+                    }
+                    res.resize(end - begin + 1);
+                    bits_op(op, (unsigned char*) &res[0], res.size(), &srcs[0], &lens[0], numkeys);
+                    int64 count = bits_popcount(res.data(), res.size());
+                    total += count;
+                    if (store && count > 0)
+                    {
+                        KeyObject segkey(ctx.ns, KEY_BITMAP_SEGMENT, keys[0].GetKey());
+                        segkey.BindCollection(dest_meta);
+                        segkey.SetBitmapSegment(begin / segment);
+                        ValueObject seg;
+                        seg.SetType(KEY_BITMAP_SEGMENT);
+                        seg.GetBitmapSegmentBytes().SetString(res, false);
+                        seg.SetBitmapSegmentCount(count);
+                        SetKeyValue(ctx, segkey, seg);
+                        dest_meta.SetObjectLen(dest_meta.GetObjectLen() + 1);
+                    }
+                }
+            }
+            if (store)
+            {
+                /*
+                 * the destination may be one of the sources, its old version is staled only after every window
+                 * was read and the new meta is in the batch, so the sweeper never reclaims segments still read
+                 */
+                if (maxlen > 0)
+                {
+                    dest_meta.GetMetaObject().bitmap_count = total;
+                    SetKeyValue(ctx, keys[0], dest_meta);
+                    if (vals[0].GetType() == KEY_BITMAP)
+                    {
+                        StaleCollection(ctx, keys[0], vals[0], false);
+                    }
+                }
+                else if (vals[0].GetType() > 0)
+                {
+                    DelKey(ctx, keys[0]);
+                }
+            }
+        }
+        for (size_t j = 0; j < readers.size(); j++)
+        {
+            DELETE(readers[j]);
+        }
+        if (0 != ctx.transc_err)
+        {
+            reply.SetErrCode(ctx.transc_err);
+        }
+        else
+        {
+            reply.SetInteger(store ? maxlen : total);
+        }
+        return 0;
+    }
+
 OP_NAMESPACE_END
 
@@ -163,6 +163,7 @@ OP_NAMESPACE_BEGIN
                         Data meta_size;
                         meta_size.SetInt64(1);
                         m_engine->Merge(ctx, key, REDIS_CMD_HSETNX, meta_size);
+                        InvalidateMeta(key);
                         m_engine->Merge(ctx, field, REDIS_CMD_HSETNX, field_value.GetHashValue());
                     }
                     else
@@ -33,6 +33,36 @@
 
 OP_NAMESPACE_BEGIN
 
+    /*
+     * Collect the positional index counts of all existing elements, invoked when a list is about to
+     * become non sequential(LINSERT/LREM), which already costs a full scan of the list.
+     */
+    void Ardb::ListRankIndexBuild(Context& ctx, const std::string& key, ValueObject& meta,
+            RankIndexDeltaTable& deltas)
+    {
+        if (!GetConf().list_rank_index || meta.GetMetaObject().list_rank_index)
+        {
+            return;
+        }
+        KeyObject ele_key(ctx.ns, KEY_LIST_ELEMENT, key);
+        ele_key.BindCollection(meta);
+        ele_key.SetListIndex(meta.GetMin());
+        Iterator* iter = m_engine->Find(ctx, ele_key);
+        while (iter->Valid())
+        {
+            KeyObject& field = iter->Key();
+            if (field.GetType() != KEY_LIST_ELEMENT || field.GetNameSpace() != ele_key.GetNameSpace()
+                    || field.GetKey() != ele_key.GetKey() || field.GetVersion() != ele_key.GetVersion())
+            {
+                break;
+            }
+            RankIndexUpdate(deltas, field.GetListIndex(), 1);
+            iter->Next();
+        }
+        DELETE(iter);
+        meta.GetMetaObject().list_rank_index = true;
+    }
+
     int Ardb::LIndex(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
@@ -67,6 +97,7 @@ OP_NAMESPACE_BEGIN
         if (v.GetMetaObject().list_sequential)
         {
             KeyObject ele(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+            ele.BindCollection(v);
             ele.SetListIndex(v.GetListMinIdx() + index);
             ValueObject ele_value;
             err = m_engine->Get(ctx, ele, ele_value);
@@ -82,14 +113,27 @@ OP_NAMESPACE_BEGIN
         else
         {
             KeyObject key(ctx.ns, KEY_LIST_ELEMENT, k.GetKey());
+            key.BindCollection(v);
             key.SetListIndex(v.GetMin());
-            Iterator* iter = m_engine->Find(ctx, key);
+            Iterator* iter = NULL;
             int64 cursor = 0;
+            if (v.GetMetaObject().list_rank_index)
+            {
+                iter = RankIndexSeek(ctx, KEY_LIST_RANK, cmd.GetArguments()[0], v, index);
+                if (NULL != iter)
+                {
+                    cursor = index;
+                }
+            }
+            if (NULL == iter)
+            {
+                iter = m_engine->Find(ctx, key);
+            }
             while (NULL != iter && iter->Valid())
             {
                 KeyObject& field = iter->Key();
                 if (field.GetType() != KEY_LIST_ELEMENT || field.GetNameSpace() != key.GetNameSpace()
-                        || field.GetKey() != key.GetKey())
+                        || field.GetKey() != key.GetKey() || field.GetVersion() != key.GetVersion())
                 {
                     break;
                 }
@@ -139,6 +183,7 @@ OP_NAMESPACE_BEGIN
             if (meta.GetMetaObject().list_sequential)
             {
                 KeyObject ele_key(ctx.ns, KEY_LIST_ELEMENT, keystr);
+                ele_key.BindCollection(meta);
                 ValueObject ele_value;
                 ele_key.SetListIndex(is_lpop ? meta.GetListMinIdx() : meta.GetListMaxIdx());
                 err = m_engine->Get(ctx, ele_key, ele_value);
@@ -161,6 +206,7 @@ OP_NAMESPACE_BEGIN
             else
             {
                 KeyObject ele_key(ctx.ns, KEY_LIST_ELEMENT, keystr);
+                ele_key.BindCollection(meta);
                 if (!is_lpop)
                 {
                     ctx.flags.iterate_total_order = 1;
@@ -178,9 +224,15 @@ OP_NAMESPACE_BEGIN
                 {
                     KeyObject& field = iter->Key();
                     if (field.GetType() == KEY_LIST_ELEMENT && field.GetNameSpace() == ele_key.GetNameSpace()
-                            && field.GetKey() == ele_key.GetKey())
+                            && field.GetKey() == ele_key.GetKey() && field.GetVersion() == ele_key.GetVersion())
                     {
                         reply.SetString(iter->Value().GetListElement());
+                        if (meta.GetMetaObject().list_rank_index)
+                        {
+                            RankIndexDeltaTable rank_deltas;
+                            RankIndexUpdate(rank_deltas, field.GetListIndex(), -1);
+                            RankIndexCommit(ctx, KEY_LIST_RANK, keystr, meta, rank_deltas);
+                        }
                         //RemoveKey(ctx, field);
                         IteratorDel(ctx, key, iter);
                         if (meta.GetObjectLen() > 1)
@@ -198,7 +250,8 @@ OP_NAMESPACE_BEGIN
                                 KeyObject& minmax = iter->Key();
                                 if (minmax.GetType() == KEY_LIST_ELEMENT
                                         && minmax.GetNameSpace() == ele_key.GetNameSpace()
-                                        && minmax.GetKey() == ele_key.GetKey())
+                                        && minmax.GetKey() == ele_key.GetKey()
+                                        && minmax.GetVersion() == ele_key.GetVersion())
                                 {
                                     if (is_lpop)
                                     {
@@ -273,17 +326,19 @@ OP_NAMESPACE_BEGIN
         Data match;
         match.SetString(cmd.GetArguments()[2], true);
         KeyObject elekey(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+        elekey.BindCollection(meta);
         elekey.SetListIndex(meta.GetMin());
         Iterator* iter = m_engine->Find(ctx, elekey);
         bool found_match = false;
         bool insert_ele_idx_computed = false;
         double insert_ele_idx = 0;
         KeyObject insert(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+        insert.BindCollection(meta);
         while (NULL != iter && iter->Valid())
         {
             KeyObject& field = iter->Key();
-            if (field.GetType() != KEY_LIST_ELEMENT || field.GetNameSpace() != key.GetNameSpace()
-                    || field.GetKey() != key.GetKey())
+            if (field.GetType() != KEY_LIST_ELEMENT || field.GetNameSpace() != elekey.GetNameSpace()
+                    || field.GetKey() != elekey.GetKey() || field.GetVersion() != elekey.GetVersion())
             {
                 break;
             }
@@ -326,6 +381,12 @@ OP_NAMESPACE_BEGIN
                     insert_ele_idx += 1;
                 }
             }
+            RankIndexDeltaTable rank_deltas;
+            ListRankIndexBuild(ctx, keystr, meta, rank_deltas);
+            if (meta.GetMetaObject().list_rank_index)
+            {
+                RankIndexUpdate(rank_deltas, insert_ele_idx, 1);
+            }
             WriteBatchGuard batch(ctx, m_engine);
             ValueObject insert_val;
             insert_val.SetType(KEY_LIST_ELEMENT);
@@ -334,6 +395,7 @@ OP_NAMESPACE_BEGIN
             {
                 WriteBatchGuard batch(ctx, m_engine);
                 SetKeyValue(ctx, insert, insert_val);
+                RankIndexCommit(ctx, KEY_LIST_RANK, keystr, meta, rank_deltas);
                 meta.SetObjectLen(meta.GetObjectLen() + 1);
                 meta.GetMetaObject().list_sequential = false;
                 meta.SetMinMaxData(insert_ele_idx);
@@ -379,12 +441,16 @@ OP_NAMESPACE_BEGIN
                 meta.SetListMaxIdx(0);
                 meta.SetListMinIdx(0);
                 meta.GetMetaObject().list_sequential = true;
+                meta.GetMetaObject().list_rank_index = false;
+                NewCollectionVersion(meta);
             }
             {
                 WriteBatchGuard batch(ctx, m_engine);
+                RankIndexDeltaTable rank_deltas;
                 for (size_t i = 1; i < cmd.GetArguments().size(); i++)
                 {
                     KeyObject ele(ctx.ns, KEY_LIST_ELEMENT, keystr);
+                    ele.BindCollection(meta);
                     ValueObject ele_value;
                     ele_value.SetType(KEY_LIST_ELEMENT);
                     ele_value.SetListElement(cmd.GetArguments()[i]);
@@ -418,8 +484,13 @@ OP_NAMESPACE_BEGIN
                     }
                     ele.SetListIndex(idx);
                     SetKeyValue(ctx, ele, ele_value);
+                    if (meta.GetMetaObject().list_rank_index)
+                    {
+                        RankIndexUpdate(rank_deltas, (double) idx, 1);
+                    }
                     meta.SetObjectLen(meta.GetObjectLen() + 1);
                 }
+                RankIndexCommit(ctx, KEY_LIST_RANK, keystr, meta, rank_deltas);
                 //meta.SetTTL(0); //clear ttl setting
                 SetKeyValue(ctx, key, meta);
             }
@@ -478,7 +549,9 @@ OP_NAMESPACE_BEGIN
         reply.ReserveMember(0);
 
         KeyObject ele_key(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+        ele_key.BindCollection(meta);
         int64 cursor = 0;
+        Iterator* iter = NULL;
         if (meta.GetMetaObject().list_sequential)
         {
             ele_key.SetListIndex(meta.GetListMinIdx() + start);
@@ -488,14 +561,25 @@ OP_NAMESPACE_BEGIN
         {
             ele_key.SetListIndex(meta.GetMin());
             cursor = 0;
+            if (meta.GetMetaObject().list_rank_index && start > 0)
+            {
+                iter = RankIndexSeek(ctx, KEY_LIST_RANK, cmd.GetArguments()[0], meta, start);
+                if (NULL != iter)
+                {
+                    cursor = start;
+                }
+            }
         }
         ctx.flags.iterate_no_upperbound = 1;
-        Iterator* iter = m_engine->Find(ctx, ele_key);
+        if (NULL == iter)
+        {
+            iter = m_engine->Find(ctx, ele_key);
+        }
         while (NULL != iter && iter->Valid())
         {
             KeyObject& field = iter->Key();
-            if (field.GetType() != KEY_LIST_ELEMENT || field.GetNameSpace() != key.GetNameSpace()
-                    || field.GetKey() != key.GetKey())
+            if (field.GetType() != KEY_LIST_ELEMENT || field.GetNameSpace() != ele_key.GetNameSpace()
+                    || field.GetKey() != ele_key.GetKey() || field.GetVersion() != ele_key.GetVersion())
             {
                 break;
             }
@@ -539,10 +623,13 @@ OP_NAMESPACE_BEGIN
         Iterator* iter = NULL;
         // bookkeeping element key min/max index
         KeyObject min_key(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+        min_key.BindCollection(meta);
         min_key.SetListIndex(meta.GetMin());
         KeyObject max_key(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+        max_key.BindCollection(meta);
         max_key.SetListIndex(meta.GetMax());
         KeyObject ele_key(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+        ele_key.BindCollection(meta);
         if (count < 0)
         {
             ele_key.SetListIndex(meta.GetMax());
@@ -571,17 +658,24 @@ OP_NAMESPACE_BEGIN
         int64 removed = 0;
         Data rem_data;
         rem_data.SetString(cmd.GetArguments()[2], true);
+        RankIndexDeltaTable rank_deltas;
+        ListRankIndexBuild(ctx, cmd.GetArguments()[0], meta, rank_deltas);
         {
             WriteBatchGuard batch(ctx, m_engine);
             while (iter != NULL && iter->Valid())
             {
                 KeyObject& field = iter->Key();
-                if (field.GetType() != KEY_LIST_ELEMENT || ele_key.ComparePrefix(field) != 0)
+                if (field.GetType() != KEY_LIST_ELEMENT || ele_key.ComparePrefix(field) != 0
+                        || field.GetVersion() != ele_key.GetVersion())
                 {
                     break;
                 }
                 if (iter->Value().GetListElement() == rem_data)
                 {
+                    if (meta.GetMetaObject().list_rank_index)
+                    {
+                        RankIndexUpdate(rank_deltas, field.GetListIndex(), -1);
+                    }
                     //RemoveKey(ctx, field);
                     IteratorDel(ctx, key, iter);
                     removed++;
@@ -605,7 +699,8 @@ OP_NAMESPACE_BEGIN
                 // re-collect minmax
                 Iterator* min_iter = m_engine->Find(ctx, min_key);
                 if (min_iter->Valid() && min_iter->Key().GetType() == KEY_LIST_ELEMENT
-                        && min_key.ComparePrefix(min_iter->Key()) == 0)
+                        && min_key.ComparePrefix(min_iter->Key()) == 0
+                        && min_key.GetVersion() == min_iter->Key().GetVersion())
                 {
                     Data min_data = min_iter->Key().GetElement(0);
                     meta.SetMinData(min_data);
@@ -615,13 +710,15 @@ OP_NAMESPACE_BEGIN
                 Iterator* max_iter = m_engine->Find(ctx, max_key);
                 if (!max_iter->Valid()) max_iter->JumpToLast();
                 if (max_iter->Valid() && max_iter->Key().GetType() == KEY_LIST_ELEMENT
-                        && max_key.ComparePrefix(max_iter->Key()) == 0)
+                        && max_key.ComparePrefix(max_iter->Key()) == 0
+                        && max_key.GetVersion() == max_iter->Key().GetVersion())
                 {
                     Data max_data = max_iter->Key().GetElement(0);
                     meta.SetMaxData(max_data);
                 }
                 DELETE(max_iter);
             }
+            RankIndexCommit(ctx, KEY_LIST_RANK, cmd.GetArguments()[0], meta, rank_deltas);
             meta.GetMetaObject().list_sequential = false;
             meta.SetObjectLen(meta.GetObjectLen() - removed);
             if (meta.GetObjectLen() == 0)
@@ -677,6 +774,7 @@ OP_NAMESPACE_BEGIN
         if (v.GetMetaObject().list_sequential)
         {
             KeyObject ele(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+            ele.BindCollection(v);
             ele.SetListIndex((int64_t) (v.GetListMinIdx() + index));
             ValueObject ele_value;
             ele_value.SetType(KEY_LIST_ELEMENT);
@@ -694,14 +792,27 @@ OP_NAMESPACE_BEGIN
         else
         {
             KeyObject key(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+            key.BindCollection(v);
             key.SetListIndex(v.GetMin());
-            Iterator* iter = m_engine->Find(ctx, key);
+            Iterator* iter = NULL;
             int64 cursor = 0;
+            if (v.GetMetaObject().list_rank_index)
+            {
+                iter = RankIndexSeek(ctx, KEY_LIST_RANK, cmd.GetArguments()[0], v, index);
+                if (NULL != iter)
+                {
+                    cursor = index;
+                }
+            }
+            if (NULL == iter)
+            {
+                iter = m_engine->Find(ctx, key);
+            }
             while (NULL != iter && iter->Valid())
             {
                 KeyObject& field = iter->Key();
                 if (field.GetType() != KEY_LIST_ELEMENT || field.GetNameSpace() != key.GetNameSpace()
-                        || field.GetKey() != key.GetKey())
+                        || field.GetKey() != key.GetKey() || field.GetVersion() != key.GetVersion())
                 {
                     break;
                 }
@@ -780,6 +891,7 @@ OP_NAMESPACE_BEGIN
             for (int64_t i = 0; i < ltrim; i++)
             {
                 KeyObject elekey(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+                elekey.BindCollection(meta);
                 elekey.SetListIndex(i + meta.GetListMinIdx());
                 RemoveKey(ctx, elekey);
                 trimed_count++;
@@ -787,6 +899,7 @@ OP_NAMESPACE_BEGIN
             for (int64_t i = rtrim + 1; rtrim > 0 && i < llen; i++)
             {
                 KeyObject elekey(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+                elekey.BindCollection(meta);
                 elekey.SetListIndex(i + meta.GetListMinIdx());
                 RemoveKey(ctx, elekey);
                 trimed_count++;
@@ -805,17 +918,19 @@ OP_NAMESPACE_BEGIN
         {
             Iterator* iter = NULL;
             bool trim_stop = false;
+            RankIndexDeltaTable rank_deltas;
             if (ltrim > 0)
             {
                 KeyObject elekey(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+                elekey.BindCollection(meta);
                 elekey.SetListIndex(meta.GetMin());
                 ctx.flags.iterate_total_order = 1;
                 iter = m_engine->Find(ctx, elekey);
                 while (NULL != iter && iter->Valid())
                 {
                     KeyObject& field = iter->Key();
-                    if (field.GetType() != KEY_LIST_ELEMENT || field.GetNameSpace() != key.GetNameSpace()
-                            || field.GetKey() != elekey.GetKey())
+                    if (field.GetType() != KEY_LIST_ELEMENT || field.GetNameSpace() != elekey.GetNameSpace()
+                            || field.GetKey() != elekey.GetKey() || field.GetVersion() != elekey.GetVersion())
                     {
                         trim_stop = true;
                         break;
@@ -826,6 +941,10 @@ OP_NAMESPACE_BEGIN
                         break;
                     }
 
+                    if (meta.GetMetaObject().list_rank_index)
+                    {
+                        RankIndexUpdate(rank_deltas, field.GetListIndex(), -1);
+                    }
                     //RemoveKey(ctx, field);
                     IteratorDel(ctx, key, iter);
                     trimed_count++;
@@ -836,6 +955,7 @@ OP_NAMESPACE_BEGIN
             if (rtrim > 0 && !trim_stop)
             {
                 KeyObject tail(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
+                tail.BindCollection(meta);
                 tail.SetListIndex(meta.GetMax());
                 if (NULL != iter)
                 {
@@ -853,8 +973,8 @@ OP_NAMESPACE_BEGIN
                 while (iter->Valid())
                 {
                     KeyObject& field = iter->Key();
-                    if (field.GetType() != KEY_LIST_ELEMENT || field.GetNameSpace() != key.GetNameSpace()
-                            || field.GetKey() != key.GetKey())
+                    if (field.GetType() != KEY_LIST_ELEMENT || field.GetNameSpace() != tail.GetNameSpace()
+                            || field.GetKey() != tail.GetKey() || field.GetVersion() != tail.GetVersion())
                     {
                         break;
                     }
@@ -863,6 +983,10 @@ OP_NAMESPACE_BEGIN
                         meta.SetMaxData(field.GetElement(0), true);
                         break;
                     }
+                    if (meta.GetMetaObject().list_rank_index)
+                    {
+                        RankIndexUpdate(rank_deltas, field.GetListIndex(), -1);
+                    }
                     RemoveKey(ctx, field);
                     tail_trim_count--;
                     trimed_count++;
@@ -870,6 +994,7 @@ OP_NAMESPACE_BEGIN
                 }
             }
             DELETE(iter);
+            RankIndexCommit(ctx, KEY_LIST_RANK, cmd.GetArguments()[0], meta, rank_deltas);
         }
         meta.SetObjectLen(meta.GetObjectLen() - trimed_count);
         if (0 == meta.GetObjectLen())
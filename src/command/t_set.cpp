@@ -514,420 +514,432 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
-    int Ardb::SDiff(Context& ctx, RedisCommandFrame& cmd)
+    /*
+     * Sorted cursor over the members of one set, the current member is only valid until the cursor moves.
+     */
+    struct SetMemberCursor
     {
-        RedisReply& reply = ctx.GetReply();
-        PointerArray<Iterator*> iters;
-        ValueObjectArray metas;
-        size_t diff_key_cursor = 0;
-        KeyObjectArray keys;
-        for (size_t i = 0; i < cmd.GetArguments().size(); i++)
-        {
-            KeyObject set_key(ctx.ns, KEY_META, cmd.GetArguments()[i]);
-            keys.push_back(set_key);
-        }
-        metas.resize(keys.size());
-        iters.resize(keys.size());
-        KeysLockGuard guard(ctx, keys);
-        if (cmd.GetType() == REDIS_CMD_SDIFFSTORE)
-        {
-            diff_key_cursor = 1;
-            if (!CheckMeta(ctx, keys[0], KEY_SET, metas[0]))
+            Iterator* iter;
+            KeyObject key;
+            KeyObject seek_key;
+            ValueObject meta;
+            const Data* member;
+            SetMemberCursor()
+                    : iter(NULL), member(NULL)
             {
-                return 0;
             }
-        }
-        for (size_t i = diff_key_cursor; i < keys.size(); i++)
-        {
-            if (0 != GetMinMax(ctx, keys[i], KEY_SET, metas[i], iters[i]))
+            bool Valid() const
             {
-                reply.SetErrCode(ERR_WRONG_TYPE);
-                return 0;
+                return NULL != member;
             }
-        }
-        if (metas[diff_key_cursor].GetType() == 0)
-        {
-            if (cmd.GetType() == REDIS_CMD_SDIFF)
+            const Data& Member() const
             {
-                reply.ReserveMember(0);
+                return *member;
             }
-            else
+            void Check()
             {
-                if (cmd.GetType() == REDIS_CMD_SDIFFSTORE)
+                member = NULL;
+                if (NULL != iter && iter->Valid())
                 {
-                    if (metas[0].GetType() > 0)
+                    KeyObject& k = iter->Key(false);
+                    if (k.GetType() == KEY_SET_MEMBER && k.GetKey() == key.GetKey()
+                            && k.GetNameSpace() == key.GetNameSpace())
                     {
-                        DelKey(ctx, keys[0]);
+                        member = &(k.GetSetMember());
                     }
                 }
-                reply.SetInteger(0); //REDIS_CMD_SDIFFCOUNT & REDIS_CMD_SDIFFSTORE
             }
-            return 0;
-        }
-        DataSet diff_result;
-        while (iters[diff_key_cursor]->Valid())
-        {
-            KeyObject& k = iters[diff_key_cursor]->Key(true);
-            if (k.GetType() != KEY_SET_MEMBER || k.GetKey() != keys[diff_key_cursor].GetKey() || k.GetNameSpace() != keys[diff_key_cursor].GetNameSpace())
+            void Next()
             {
-                break;
+                iter->Next();
+                Check();
             }
-            diff_result.insert(k.GetSetMember());
-            iters[diff_key_cursor]->Next();
-        }
-
-        for (size_t i = diff_key_cursor + 1; i < metas.size(); i++)
-        {
-
-            if (metas[i].GetType() == 0)
+            /*
+             * move to the first member >= 'target', a couple of Next() are cheaper than a Jump() on dense sets.
+             */
+            void Seek(const Data& target)
             {
-                continue;
+                for (int i = 0; i < 2 && Valid() && Member() < target; i++)
+                {
+                    Next();
+                }
+                if (Valid() && Member() < target)
+                {
+                    seek_key.SetSetMember(target);
+                    iter->Jump(seek_key);
+                    Check();
+                }
             }
-            if (metas[i].GetMin() > metas[diff_key_cursor].GetMax() || metas[i].GetMax() < metas[diff_key_cursor].GetMin())
+    };
+    typedef std::vector<SetMemberCursor> SetMemberCursorArray;
+
+    struct SetMergeSink
+    {
+            virtual void Add(const Data& member) = 0;
+            virtual ~SetMergeSink()
             {
-                continue;
             }
-            Data min = metas[diff_key_cursor].GetMin() > metas[i].GetMin() ? metas[diff_key_cursor].GetMin() : metas[i].GetMin();
-            Data max = metas[diff_key_cursor].GetMax() < metas[i].GetMax() ? metas[diff_key_cursor].GetMax() : metas[i].GetMax();
-            KeyObject start(ctx.ns, KEY_SET_MEMBER, keys[i].GetKey());
-            start.SetSetMember(min);
-            iters[i]->Jump(start);
+    };
 
-            while (iters[i]->Valid())
+    /*
+     * Leapfrog intersection: every cursor behind the current largest member seeks to it,
+     * a member is emitted once all cursors agree on it.
+     */
+    static void set_inter_merge(SetMemberCursorArray& cursors, SetMergeSink& sink)
+    {
+        size_t max_idx = 0;
+        for (size_t i = 0; i < cursors.size(); i++)
+        {
+            if (!cursors[i].Valid())
             {
-                KeyObject& k = iters[i]->Key(false);
-                if (k.GetType() != KEY_SET_MEMBER || k.GetKey() != keys[i].GetKey() || k.GetNameSpace() != keys[i].GetNameSpace() || k.GetSetMember() > max)
-                {
-                    break;
-                }
-                diff_result.erase(k.GetSetMember());
-                iters[i]->Next();
+                return;
             }
-        }
-        if (cmd.GetType() == REDIS_CMD_SDIFFSTORE)
-        {
-            if (metas[0].GetType() > 0)
+            if (cursors[i].Member() > cursors[max_idx].Member())
             {
-                Iterator* iter = NULL;
-                DelKey(ctx, keys[0], iter);
-                DELETE(iter);
+                max_idx = i;
             }
-            if (!diff_result.empty())
+        }
+        while (true)
+        {
+            bool matched = true;
+            for (size_t i = 0; i < cursors.size(); i++)
             {
-                DataSet::iterator it = diff_result.begin();
-                ValueObject dest_meta;
-                dest_meta.SetType(KEY_SET);
-                dest_meta.SetObjectLen(diff_result.size());
-                while (it != diff_result.end())
+                if (i == max_idx)
                 {
-                    KeyObject element(ctx.ns, KEY_SET_MEMBER, cmd.GetArguments()[0]);
-                    element.SetSetMember(*it);
-                    ValueObject empty;
-                    empty.SetType(KEY_SET_MEMBER);
-                    SetKeyValue(ctx, element, empty);
-                    it++;
+                    continue;
+                }
+                int cmp = cursors[i].Member().Compare(cursors[max_idx].Member());
+                if (cmp < 0)
+                {
+                    cursors[i].Seek(cursors[max_idx].Member());
+                    if (!cursors[i].Valid())
+                    {
+                        return;
+                    }
+                    cmp = cursors[i].Member().Compare(cursors[max_idx].Member());
+                }
+                if (cmp > 0)
+                {
+                    max_idx = i;
+                    matched = false;
+                    break;
                 }
-                dest_meta.SetMinData(*(diff_result.begin()));
-                dest_meta.SetMaxData(*(diff_result.rbegin()));
-                SetKeyValue(ctx, keys[0], dest_meta);
             }
-            reply.SetInteger(diff_result.size());
-        }
-        else if (cmd.GetType() == REDIS_CMD_SDIFF)
-        {
-            DataSet::iterator it = diff_result.begin();
-            while (it != diff_result.end())
+            if (matched)
             {
-                RedisReply& r = reply.AddMember();
-                r.SetString(*it);
-                it++;
+                sink.Add(cursors[max_idx].Member());
+                cursors[max_idx].Next();
+                if (!cursors[max_idx].Valid())
+                {
+                    return;
+                }
             }
         }
-        else
-        {
-            reply.SetInteger(diff_result.size()); //REDIS_CMD_SDIFFCOUNT
-        }
-        return 0;
-    }
-
-    int Ardb::SDiffStore(Context& ctx, RedisCommandFrame& cmd)
-    {
-        return SDiff(ctx, cmd);
-    }
-    int Ardb::SDiffCount(Context& ctx, RedisCommandFrame& cmd)
-    {
-        return SDiff(ctx, cmd);
     }
 
-    int Ardb::SInter(Context& ctx, RedisCommandFrame& cmd)
+    /*
+     * Streams the first cursor, other cursors seek to each of its members.
+     */
+    static void set_diff_merge(SetMemberCursorArray& cursors, SetMergeSink& sink)
     {
-        RedisReply& reply = ctx.GetReply();
-        PointerArray<Iterator*> iters;
-        ValueObjectArray metas;
-        size_t inter_key_cursor = 0;
-        KeyObjectArray keys;
-        for (size_t i = 0; i < cmd.GetArguments().size(); i++)
+        if (cursors.empty())
         {
-            KeyObject set_key(ctx.ns, KEY_META, cmd.GetArguments()[i]);
-            keys.push_back(set_key);
+            return;
         }
-        metas.resize(keys.size());
-        iters.resize(keys.size());
-        KeysLockGuard guard(ctx, keys);
-        if (cmd.GetType() == REDIS_CMD_SINTERSTORE)
+        SetMemberCursor& base = cursors[0];
+        while (base.Valid())
         {
-            inter_key_cursor = 1;
-            if (!CheckMeta(ctx, keys[0], KEY_SET, metas[0]))
+            bool excluded = false;
+            for (size_t i = 1; i < cursors.size() && !excluded; i++)
             {
-                return 0;
+                if (!cursors[i].Valid())
+                {
+                    continue;
+                }
+                cursors[i].Seek(base.Member());
+                excluded = cursors[i].Valid() && cursors[i].Member() == base.Member();
             }
-        }
-        bool empty_result = false;
-        Data min, max;
-        for (size_t i = inter_key_cursor; i < keys.size(); i++)
-        {
-            if (0 != GetMinMax(ctx, keys[i], KEY_SET, metas[i], iters[i]))
+            if (!excluded)
             {
-                reply.SetErrCode(ERR_WRONG_TYPE);
-                return 0;
+                sink.Add(base.Member());
             }
-            if (metas[i].GetType() == 0)
+            base.Next();
+        }
+    }
+
+    /*
+     * K-way merge, cursors positioned at the smallest member emit it once and move on together.
+     */
+    static void set_union_merge(SetMemberCursorArray& cursors, SetMergeSink& sink)
+    {
+        while (true)
+        {
+            int min_idx = -1;
+            for (size_t i = 0; i < cursors.size(); i++)
             {
-                empty_result = true;
-                break;
+                if (cursors[i].Valid() && (min_idx < 0 || cursors[i].Member() < cursors[min_idx].Member()))
+                {
+                    min_idx = i;
+                }
             }
-            if (min.IsNil() || metas[i].GetMin() > min)
+            if (min_idx < 0)
             {
-                min = metas[i].GetMin();
+                return;
             }
-            if (max.IsNil() || metas[i].GetMax() < max)
+            sink.Add(cursors[min_idx].Member());
+            for (size_t i = 0; i < cursors.size(); i++)
             {
-                max = metas[i].GetMax();
+                if ((int) i != min_idx && cursors[i].Valid() && cursors[i].Member() == cursors[min_idx].Member())
+                {
+                    cursors[i].Next();
+                }
             }
+            cursors[min_idx].Next();
         }
-        if (min > max)
-        {
-            empty_result = true;
-        }
+    }
 
-        if (empty_result)
-        {
-            if (cmd.GetType() == REDIS_CMD_SINTER)
-            {
-                reply.ReserveMember(0);
+    /*
+     * Consumes the sorted merge result according to the command, the destination of the *STORE commands
+     * is written while merging unless it is one of the source sets.
+     */
+    struct Ardb::SetMergeOutput: public SetMergeSink
+    {
+            Ardb* db;
+            Context& ctx;
+            RedisReply& reply;
+            bool store;
+            bool count_only;
+            bool buffered;
+            int64 count;
+            const KeyObject& dest_key;
+            KeyObject element;
+            ValueObject dest_meta;
+            ValueObject empty;
+            DataArray buffer;
+            std::string max_str;
+            Data max;
+            SetMergeOutput(Ardb* a, Context& c, bool is_store, bool is_count, const KeyObject& dest)
+                    : db(a), ctx(c), reply(c.GetReply()), store(is_store), count_only(is_count), buffered(false), count(
+                            0), dest_key(dest), element(c.ns, KEY_SET_MEMBER, dest.GetKey())
+            {
+                empty.SetType(KEY_SET_MEMBER);
+                dest_meta.SetType(KEY_SET);
             }
-            else // REDIS_CMD_SINTERSTORE | REDIS_CMD_SINTERCOUNT
+            void DelDest(const ValueObject& old_meta)
             {
-                if (cmd.GetType() == REDIS_CMD_SINTERSTORE)
+                if (old_meta.GetType() > 0)
                 {
-                    if (metas[0].GetType() > 0)
-                    {
-                        Iterator* iter = NULL;
-                        DelKey(ctx, keys[0], iter);
-                        DELETE(iter);
-                    }
+                    Iterator* iter = NULL;
+                    db->DelKey(ctx, dest_key, iter);
+                    DELETE(iter);
                 }
-                reply.SetInteger(0);
             }
-            return 0;
-        }
-        DataSet inter_result[2];
-        size_t inter_result_cursor = 1;
-        for (size_t i = inter_key_cursor; i < metas.size(); i++)
-        {
-            KeyObject start(ctx.ns, KEY_SET_MEMBER, keys[i].GetKey());
-            start.SetSetMember(min);
-            iters[i]->Jump(start);
-            inter_result_cursor = 1 - inter_result_cursor;
-            inter_result[inter_result_cursor].clear();
-            while (iters[i]->Valid())
+            void Write(const Data& member)
             {
-                KeyObject& k = iters[i]->Key(true);
-                if (k.GetType() != KEY_SET_MEMBER || k.GetKey() != keys[i].GetKey() || k.GetNameSpace() != keys[i].GetNameSpace() || k.GetSetMember() > max)
+                element.SetSetMember(member);
+                db->SetKeyValue(ctx, element, empty);
+                if (0 == count)
                 {
-                    break;
+                    dest_meta.SetMinData(member.IsCStr() ? Data(member.AsString(), false) : member);
+                }
+                if (member.IsString())
+                {
+                    max_str.assign(member.CStr(), member.StringLength());
+                    max.Clear();
                 }
-                if (i == inter_key_cursor || inter_result[1 - inter_result_cursor].erase(k.GetSetMember()) > 0)
+                else
                 {
-                    inter_result[inter_result_cursor].insert(k.GetSetMember());
+                    max = member;
                 }
-                iters[i]->Next();
             }
-        }
-        if (cmd.GetType() == REDIS_CMD_SINTERSTORE)
-        {
-            if (!inter_result[inter_result_cursor].empty())
+            void Add(const Data& member)
             {
-                if (metas[0].GetType() > 0)
+                if (store)
                 {
-                    Iterator* iter = NULL;
-                    DelKey(ctx, keys[0], iter);
-                    DELETE(iter);
+                    if (buffered)
+                    {
+                        buffer.resize(buffer.size() + 1);
+                        if (member.IsCStr())
+                        {
+                            buffer.back().SetString(member.CStr(), member.StringLength(), true);
+                        }
+                        else
+                        {
+                            buffer.back() = member;
+                        }
+                    }
+                    else
+                    {
+                        Write(member);
+                    }
                 }
-                DataSet::iterator it = inter_result[inter_result_cursor].begin();
-                ValueObject dest_meta;
-                dest_meta.SetType(KEY_SET);
-                dest_meta.SetObjectLen(inter_result[inter_result_cursor].size());
-                while (it != inter_result[inter_result_cursor].end())
+                else if (!count_only)
                 {
-                    KeyObject element(ctx.ns, KEY_SET_MEMBER, cmd.GetArguments()[0]);
-                    element.SetSetMember(*it);
-                    ValueObject empty;
-                    empty.SetType(KEY_SET_MEMBER);
-                    SetKeyValue(ctx, element, empty);
-                    it++;
+                    reply.AddMember().SetString(member);
                 }
-                dest_meta.SetMinData(*(inter_result[inter_result_cursor].begin()));
-                dest_meta.SetMaxData(*(inter_result[inter_result_cursor].rbegin()));
-                SetKeyValue(ctx, keys[0], dest_meta);
+                count++;
             }
-            reply.SetInteger(inter_result[inter_result_cursor].size());
-        }
-        else if (cmd.GetType() == REDIS_CMD_SINTER)
-        {
-            DataSet::iterator it = inter_result[inter_result_cursor].begin();
-            while (it != inter_result[inter_result_cursor].end())
+            void End()
             {
-                RedisReply& r = reply.AddMember();
-                r.SetString(*it);
-                it++;
+                if (store)
+                {
+                    if (buffered)
+                    {
+                        count = 0;
+                        for (size_t i = 0; i < buffer.size(); i++)
+                        {
+                            Write(buffer[i]);
+                            count++;
+                        }
+                    }
+                    if (count > 0)
+                    {
+                        if (max.IsNil())
+                        {
+                            max.SetString(max_str, false);
+                        }
+                        dest_meta.SetMaxData(max);
+                        dest_meta.SetObjectLen(count);
+                        db->SetKeyValue(ctx, dest_key, dest_meta);
+                    }
+                    reply.SetInteger(count);
+                }
+                else if (count_only)
+                {
+                    reply.SetInteger(count);
+                }
+                else if (0 == count)
+                {
+                    reply.ReserveMember(0);
+                }
             }
-        }
-        else
-        {
-            reply.SetInteger(inter_result[inter_result_cursor].size()); //REDIS_CMD_SINTERCOUNT
-        }
-        return 0;
-    }
+    };
 
-    int Ardb::SInterStore(Context& ctx, RedisCommandFrame& cmd)
-    {
-        return SInter(ctx, cmd);
-    }
-
-    int Ardb::SInterCount(Context& ctx, RedisCommandFrame& cmd)
-    {
-        return SInter(ctx, cmd);
-    }
-
-    int Ardb::SUnion(Context& ctx, RedisCommandFrame& cmd)
+    int Ardb::SetMerge(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
-        ValueObjectArray metas;
-        size_t union_key_cursor = 0;
+        RedisCommandType type = cmd.GetType();
+        bool store = type == REDIS_CMD_SDIFFSTORE || type == REDIS_CMD_SINTERSTORE || type == REDIS_CMD_SUNIONSTORE;
+        bool count_only = type == REDIS_CMD_SDIFFCOUNT || type == REDIS_CMD_SINTERCOUNT
+                || type == REDIS_CMD_SUNIONCOUNT;
         KeyObjectArray keys;
         for (size_t i = 0; i < cmd.GetArguments().size(); i++)
         {
             KeyObject set_key(ctx.ns, KEY_META, cmd.GetArguments()[i]);
             keys.push_back(set_key);
         }
-        metas.resize(keys.size());
-        KeysLockGuard guard(ctx,keys);
-        ErrCodeArray errs;
-        m_engine->MultiGet(ctx, keys, metas, errs);
-        for (size_t i = 0; i < metas.size(); i++)
+        KeysLockGuard guard(ctx, keys);
+        size_t src_cursor = store ? 1 : 0;
+        ValueObject dest_meta;
+        if (store && !CheckMeta(ctx, keys[0], KEY_SET, dest_meta))
+        {
+            return 0;
+        }
+        PointerArray<Iterator*> iters;
+        iters.resize(keys.size());
+        SetMemberCursorArray cursors(keys.size() - src_cursor);
+        bool dest_is_source = false;
+        for (size_t i = src_cursor; i < keys.size(); i++)
         {
-            if (!CheckMeta(ctx, keys[i], KEY_SET, metas[i], false))
+            SetMemberCursor& cursor = cursors[i - src_cursor];
+            if (0 != GetMinMax(ctx, keys[i], KEY_SET, cursor.meta, iters[i]))
             {
+                reply.SetErrCode(ERR_WRONG_TYPE);
                 return 0;
             }
-            if (errs[i] != 0 && errs[i] != ERR_ENTRY_NOT_EXIST)
+            cursor.iter = iters[i];
+            cursor.key = keys[i];
+            cursor.seek_key = KeyObject(ctx.ns, KEY_SET_MEMBER, keys[i].GetKey());
+            cursor.Check();
+            if (store && keys[i].GetKey() == keys[0].GetKey())
             {
-                reply.SetErrCode(errs[i]);
-                return 0;
+                dest_is_source = true;
             }
         }
-        if (cmd.GetType() == REDIS_CMD_SUNIONSTORE)
-        {
-            union_key_cursor = 1;
-        }
-        DataSet union_result;
-        Iterator* iter = NULL;
-        ctx.flags.iterate_no_upperbound = 1;
-        for (size_t i = union_key_cursor; i < keys.size(); i++)
+        SetMergeOutput output(this, ctx, store, count_only, keys[0]);
+        if (store)
         {
-            if (metas[i].GetType() == 0)
-            {
-                continue;
-            }
-            KeyObject ele(ctx.ns, KEY_SET_MEMBER, keys[i].GetKey());
-            ele.SetSetMember(metas[i].GetMin());
-            if (NULL != iter)
-            {
-                iter->Jump(ele);
-            }
-            else
+            /*
+             * a source set can not be overwritten while it is merged, the result is buffered then
+             */
+            output.buffered = dest_is_source;
+            if (!dest_is_source)
             {
-                iter = m_engine->Find(ctx, ele);
-            }
-            while (NULL != iter && iter->Valid())
-            {
-                KeyObject& k = iter->Key(true);
-                if (k.GetType() != KEY_SET_MEMBER || k.GetKey() != keys[i].GetKey() || k.GetNameSpace() != keys[i].GetNameSpace())
-                {
-                    break;
-                }
-                union_result.insert(k.GetSetMember());
-                iter->Next();
+                output.DelDest(dest_meta);
             }
         }
-        DELETE(iter);
-        if (cmd.GetType() == REDIS_CMD_SUNIONSTORE)
+        switch (type)
         {
-            if (metas[0].GetType() > 0)
+            case REDIS_CMD_SINTER:
+            case REDIS_CMD_SINTERSTORE:
+            case REDIS_CMD_SINTERCOUNT:
             {
-                Iterator* iter = NULL;
-                DelKey(ctx, keys[0], iter);
-                DELETE(iter);
+                set_inter_merge(cursors, output);
+                break;
             }
-
-            if (!union_result.empty())
+            case REDIS_CMD_SDIFF:
+            case REDIS_CMD_SDIFFSTORE:
+            case REDIS_CMD_SDIFFCOUNT:
             {
-                DataSet::iterator it = union_result.begin();
-                ValueObject dest_meta;
-                dest_meta.SetType(KEY_SET);
-                dest_meta.SetObjectLen(union_result.size());
-                while (it != union_result.end())
-                {
-                    KeyObject element(ctx.ns, KEY_SET_MEMBER, cmd.GetArguments()[0]);
-                    element.SetSetMember(*it);
-                    ValueObject empty;
-                    empty.SetType(KEY_SET_MEMBER);
-                    SetKeyValue(ctx, element, empty);
-                    it++;
-                }
-                dest_meta.SetMinData(*(union_result.begin()));
-                dest_meta.SetMaxData(*(union_result.rbegin()));
-                SetKeyValue(ctx, keys[0], dest_meta);
-                reply.SetInteger(union_result.size());
+                set_diff_merge(cursors, output);
+                break;
             }
-
-        }
-        else if (cmd.GetType() == REDIS_CMD_SUNION)
-        {
-            DataSet::iterator it = union_result.begin();
-            while (it != union_result.end())
+            default:
             {
-                RedisReply& r = reply.AddMember();
-                r.SetString(*it);
-                it++;
+                set_union_merge(cursors, output);
+                break;
             }
         }
-        else
+        if (output.buffered)
         {
-            reply.SetInteger(union_result.size()); //REDIS_CMD_SUNIONCOUNT
+            output.DelDest(dest_meta);
         }
+        output.End();
         return 0;
     }
 
+    int Ardb::SDiff(Context& ctx, RedisCommandFrame& cmd)
+    {
+        return SetMerge(ctx, cmd);
+    }
+
+    int Ardb::SDiffStore(Context& ctx, RedisCommandFrame& cmd)
+    {
+        return SetMerge(ctx, cmd);
+    }
+    int Ardb::SDiffCount(Context& ctx, RedisCommandFrame& cmd)
+    {
+        return SetMerge(ctx, cmd);
+    }
+
+    int Ardb::SInter(Context& ctx, RedisCommandFrame& cmd)
+    {
+        return SetMerge(ctx, cmd);
+    }
+
+    int Ardb::SInterStore(Context& ctx, RedisCommandFrame& cmd)
+    {
+        return SetMerge(ctx, cmd);
+    }
+
+    int Ardb::SInterCount(Context& ctx, RedisCommandFrame& cmd)
+    {
+        return SetMerge(ctx, cmd);
+    }
+
+    int Ardb::SUnion(Context& ctx, RedisCommandFrame& cmd)
+    {
+        return SetMerge(ctx, cmd);
+    }
+
     int Ardb::SUnionStore(Context& ctx, RedisCommandFrame& cmd)
     {
-        return SUnion(ctx, cmd);
+        return SetMerge(ctx, cmd);
     }
 
     int Ardb::SUnionCount(Context& ctx, RedisCommandFrame& cmd)
     {
-        return SUnion(ctx, cmd);
+        return SetMerge(ctx, cmd);
     }
 
     int Ardb::SScan(Context& ctx, RedisCommandFrame& cmd)
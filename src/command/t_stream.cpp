@@ -29,6 +29,7 @@
 #include "db/db.hpp"
 #include "util/string_helper.hpp"
 #include "util/lru.hpp"
+#include <algorithm>
 
 #define GTABLE_IDLE   0
 #define GTABLE_INUSE  1
@@ -115,6 +116,242 @@ OP_NAMESPACE_BEGIN
             fvs.AddMember().SetString(ele.GetStreamFieldValue(i));
         }
     }
+
+    /*
+     * Walks the entries of a stream in id order, whether the stream stores one KEY_STREAM_ELEMENT record
+     * per entry or packs them in KEY_STREAM_BLOCK records, a block is decoded once when the walk enters it.
+     */
+    class StreamIterator
+    {
+        private:
+            Context& m_ctx;
+            Engine* m_engine;
+            KeyObject m_start;
+            bool m_block;
+            Iterator* m_iter;
+            StreamIDArray m_ids;
+            ValueObjectArray m_eles;
+            int64 m_pos;
+            bool matchRecord()
+            {
+                if (!m_iter->Valid())
+                {
+                    return false;
+                }
+                KeyObject& k = m_iter->Key(false);
+                return k.GetType() == m_start.GetType() && k.GetNameSpace() == m_start.GetNameSpace()
+                        && k.GetKey() == m_start.GetKey();
+            }
+            /*
+             * Decodes the block under the engine iterator, return false if the iterator left the stream.
+             */
+            bool loadBlock()
+            {
+                m_ids.clear();
+                m_eles.clear();
+                if (!matchRecord())
+                {
+                    return false;
+                }
+                KeyObject& k = m_iter->Key(false);
+                if (!stream_block_decode(m_iter->Value(false), k.GetStreamBlockID(), m_ids, m_eles))
+                {
+                    std::string keystr;
+                    WARN_LOG("Invalid stream block in key:%s", k.GetKey().ToString(keystr).c_str());
+                    m_ids.clear();
+                    m_eles.clear();
+                }
+                return true;
+            }
+            void forwardBlock()
+            {
+                while (loadBlock() && m_ids.empty())
+                {
+                    m_iter->Next();
+                }
+                m_pos = 0;
+            }
+            void backwardBlock()
+            {
+                while (loadBlock() && m_ids.empty())
+                {
+                    m_iter->Prev();
+                }
+                m_pos = (int64) m_ids.size() - 1;
+            }
+            StreamID recordID()
+            {
+                return m_iter->Key(false).GetStreamID();
+            }
+            void jump(const StreamID& id)
+            {
+                m_start.SetStreamID(id);
+                if (NULL == m_iter)
+                {
+                    m_iter = m_engine->Find(m_ctx, m_start);
+                }
+                else
+                {
+                    m_iter->Jump(m_start);
+                }
+            }
+        public:
+            StreamIterator(Context& ctx, Engine* engine, const Data& ns, const Data& key, ValueObject& meta)
+                    : m_ctx(ctx), m_engine(engine), m_start(ns, KEY_STREAM_ELEMENT, key), m_block(
+                            meta.GetMetaObject().stream_block > 0), m_iter(NULL), m_pos(0)
+            {
+                if (m_block)
+                {
+                    m_start.SetType(KEY_STREAM_BLOCK);
+                    m_ctx.flags.iterate_total_order = 1;
+                }
+            }
+            /*
+             * Positions at the first entry whose id >= 'id'.
+             */
+            void Seek(const StreamID& id)
+            {
+                jump(id);
+                if (!m_block)
+                {
+                    return;
+                }
+                /* the entry may sit in the block before the first block created at or after 'id' */
+                if (!m_iter->Valid())
+                {
+                    m_iter->JumpToLast();
+                }
+                else if (!matchRecord() || recordID().Compare(id) > 0)
+                {
+                    m_iter->Prev();
+                }
+                if (!matchRecord())
+                {
+                    m_iter->Jump(m_start);
+                }
+                forwardBlock();
+                while (Valid() && m_ids[m_pos].Compare(id) < 0)
+                {
+                    Next();
+                }
+            }
+            /*
+             * Positions at the last entry whose id <= 'id'.
+             */
+            void SeekLast(const StreamID& id)
+            {
+                m_ctx.flags.iterate_total_order = 1;
+                jump(id);
+                if (!m_iter->Valid())
+                {
+                    m_iter->JumpToLast();
+                }
+                else if (!matchRecord() || recordID().Compare(id) > 0)
+                {
+                    m_iter->Prev();
+                }
+                if (!m_block)
+                {
+                    return;
+                }
+                backwardBlock();
+                while (Valid() && m_ids[m_pos].Compare(id) > 0)
+                {
+                    Prev();
+                }
+            }
+            bool Valid()
+            {
+                if (m_block)
+                {
+                    return m_pos >= 0 && m_pos < (int64) m_ids.size();
+                }
+                return matchRecord();
+            }
+            void Next()
+            {
+                if (!m_block)
+                {
+                    m_iter->Next();
+                    return;
+                }
+                if (++m_pos >= (int64) m_ids.size())
+                {
+                    m_iter->Next();
+                    forwardBlock();
+                }
+            }
+            void Prev()
+            {
+                if (!m_block)
+                {
+                    m_iter->Prev();
+                    return;
+                }
+                if (--m_pos < 0)
+                {
+                    m_iter->Prev();
+                    backwardBlock();
+                }
+            }
+            StreamID ID()
+            {
+                return m_block ? m_ids[m_pos] : recordID();
+            }
+            ValueObject& Value()
+            {
+                return m_block ? m_eles[m_pos] : m_iter->Value(false);
+            }
+            /*
+             * Removes the entries of the current block listed in the sorted 'ids' from 'idx' on, the block is
+             * rewritten once or deleted if it gets empty. 'idx' moves past the ids not above the block's last
+             * entry, and the iterator must be positioned again afterwards.
+             */
+            int64 RemoveFromBlock(const StreamIDArray& ids, size_t& idx)
+            {
+                const StreamID& last = m_ids.back();
+                StreamID block_id = m_iter->Key(false).GetStreamBlockID();
+                ValueObject block;
+                int64 removed = 0;
+                for (size_t i = 0; i < m_ids.size(); i++)
+                {
+                    while (idx < ids.size() && ids[idx].Compare(m_ids[i]) < 0)
+                    {
+                        idx++;
+                    }
+                    if (idx < ids.size() && ids[idx].Compare(m_ids[i]) == 0)
+                    {
+                        removed++;
+                        continue;
+                    }
+                    stream_block_append(block, block_id, m_ids[i], m_eles[i]);
+                }
+                while (idx < ids.size() && ids[idx].Compare(last) <= 0)
+                {
+                    idx++;
+                }
+                if (removed == 0)
+                {
+                    return 0;
+                }
+                if (block.GetType() == 0)
+                {
+                    m_iter->Del();
+                }
+                else
+                {
+                    KeyObject bk(m_start.GetNameSpace(), KEY_STREAM_BLOCK, m_start.GetKey());
+                    bk.SetStreamBlockID(block_id);
+                    m_engine->Put(m_ctx, bk, block);
+                }
+                return removed;
+            }
+            ~StreamIterator()
+            {
+                DELETE(m_iter);
+            }
+    };
+
     static void replyHelp(RedisReply& reply, const std::string& cmd, const char** help)
     {
         std::string ncmd = string_toupper(cmd);
@@ -459,17 +696,147 @@ OP_NAMESPACE_BEGIN
         nack->delivery_time = (int64_t) (get_current_epoch_millis());
         return StreamUpdateNACK(ctx, key, group, consumer, id, group_meta, nack);
     }
-    int Ardb::StreamDelItem(Context& ctx, const std::string& key, const StreamID& id)
+    /*
+     * Appends an entry after the stream's last one, a block stream adds it to the tail block until the block
+     * is full and then starts a new block keyed by the entry id. The meta counts the tail block's entries, so
+     * engines supporting merge append without reading the block; the others read and rewrite it.
+     */
+    int Ardb::StreamAppend(Context& ctx, const std::string& key, ValueObject& meta, const StreamID& id, ValueObject& ele)
     {
-        KeyObject k(ctx.ns, KEY_STREAM_ELEMENT, key);
-        k.SetStreamID(id);
-        ValueObject tmp;
-        if (!m_engine->Exists(ctx, k, tmp))
+        MetaObject& m = meta.GetMetaObject();
+        if (m.stream_block <= 0)
         {
-            return 0;
+            KeyObject ek(ctx.ns, KEY_STREAM_ELEMENT, key);
+            ek.SetStreamID(id);
+            return SetKeyValue(ctx, ek, ele);
+        }
+        if (m.stream_tail.Empty() || m.stream_tail_count >= m.stream_block)
+        {
+            m.stream_tail = id;
+            m.stream_tail_count = 0;
+        }
+        KeyObject bk(ctx.ns, KEY_STREAM_BLOCK, key);
+        bk.SetStreamBlockID(m.stream_tail);
+        m.stream_tail_count++;
+        if (m_engine->GetFeatureSet().support_merge)
+        {
+            int64_t fieldlen = ele.GetStreamFieldLength();
+            bool with_names = ele.ElementSize() != (size_t) fieldlen + 1;
+            DataArray args(with_names ? 2 + 2 * fieldlen : 2 + fieldlen);
+            id.Encode(args[0]);
+            args[1].SetInt64(fieldlen);
+            for (int64_t i = 0; i < fieldlen; i++)
+            {
+                args[2 + i] = ele.GetStreamFieldValue(i);
+                if (with_names)
+                {
+                    args[2 + fieldlen + i] = ele.GetStreamFieldName(i);
+                }
+            }
+            return MergeKeyValue(ctx, bk, REDIS_CMD_XADD, args);
+        }
+        ValueObject block;
+        if (m.stream_tail_count > 1 && 0 != m_engine->Get(ctx, bk, block))
+        {
+            block.Clear();
+        }
+        stream_block_append(block, m.stream_tail, id, ele);
+        return SetKeyValue(ctx, bk, block);
+    }
+
+    /*
+     * Merge side of StreamAppend, 'args' holds the entry id, the field count, the values and the names if any.
+     */
+    int Ardb::MergeStreamAppend(Context& ctx, const KeyObject& key, ValueObject& block, const DataArray& args)
+    {
+        if (args.size() < 2)
+        {
+            return -1;
+        }
+        StreamID id;
+        id.Decode(args[0]);
+        int64_t fieldlen = args[1].GetInt64();
+        bool with_names = args.size() == (size_t) (2 + 2 * fieldlen);
+        ValueObject ele;
+        ele.SetType(KEY_STREAM_ELEMENT);
+        ele.SetStreamFieldLength(fieldlen);
+        for (int64_t i = 0; i < fieldlen; i++)
+        {
+            ele.GetStreamFieldValue(i) = args[2 + i];
+            if (with_names)
+            {
+                ele.GetStreamFieldName(i) = args[2 + fieldlen + i];
+            }
+        }
+        stream_block_append(block, key.GetStreamBlockID(), id, ele);
+        return 0;
+    }
+
+    int Ardb::StreamGetItem(Context& ctx, const std::string& key, ValueObject& meta, const StreamID& id, ValueObject& ele)
+    {
+        if (meta.GetMetaObject().stream_block <= 0)
+        {
+            KeyObject ek(ctx.ns, KEY_STREAM_ELEMENT, key);
+            ek.SetStreamID(id);
+            return m_engine->Get(ctx, ek, ele);
         }
-        m_engine->Del(ctx, k);
-        return 1;
+        Data keydata;
+        keydata.SetString(key, false);
+        StreamIterator iter(ctx, m_engine, ctx.ns, keydata, meta);
+        iter.Seek(id);
+        if (!iter.Valid() || iter.ID().Compare(id) != 0)
+        {
+            return ERR_ENTRY_NOT_EXIST;
+        }
+        ele = iter.Value();
+        return 0;
+    }
+
+    /*
+     * Deletes the listed entries and returns how many existed, 'ids' gets sorted. Each block holding some of
+     * them is rewritten once.
+     */
+    int64_t Ardb::StreamDelItems(Context& ctx, const std::string& key, ValueObject& meta, StreamIDArray& ids)
+    {
+        int64_t deleted = 0;
+        std::sort(ids.begin(), ids.end());
+        if (meta.GetMetaObject().stream_block <= 0)
+        {
+            for (size_t i = 0; i < ids.size(); i++)
+            {
+                if (i > 0 && ids[i].Compare(ids[i - 1]) == 0)
+                {
+                    continue;
+                }
+                KeyObject k(ctx.ns, KEY_STREAM_ELEMENT, key);
+                k.SetStreamID(ids[i]);
+                ValueObject tmp;
+                if (!m_engine->Exists(ctx, k, tmp))
+                {
+                    continue;
+                }
+                m_engine->Del(ctx, k);
+                deleted++;
+            }
+        }
+        else
+        {
+            Data keydata;
+            keydata.SetString(key, false);
+            StreamIterator iter(ctx, m_engine, ctx.ns, keydata, meta);
+            size_t idx = 0;
+            while (idx < ids.size())
+            {
+                iter.Seek(ids[idx]);
+                if (!iter.Valid())
+                {
+                    break;
+                }
+                deleted += iter.RemoveFromBlock(ids, idx);
+            }
+        }
+        meta.SetObjectLen(meta.GetObjectLen() - deleted);
+        return deleted;
     }
 
     int Ardb::StreamCreateCG(Context& ctx, const std::string& key, const std::string& group, const StreamID& id,
@@ -498,42 +865,32 @@ OP_NAMESPACE_BEGIN
         }
         return 0;
     }
-    int Ardb::StreamMinMaxID(Context& ctx, const std::string& key, StreamID& min, StreamID& max, ValueObject& minv,
-            ValueObject& maxv)
+    int Ardb::StreamMinMaxID(Context& ctx, const std::string& key, ValueObject& meta, StreamID& min, StreamID& max,
+            ValueObject& minv, ValueObject& maxv)
     {
-        KeyObject ck(ctx.ns, KEY_STREAM_ELEMENT, key);
-        Iterator* citer = m_engine->Find(ctx, ck);
-        if (!citer->Valid())
-        {
-            DELETE(citer);
-            return -1;
-        }
-        KeyObject& ik = citer->Key(false);
-        if (ik.GetType() != KEY_STREAM_ELEMENT || ik.GetKey() != ck.GetKey())
+        Data keydata;
+        keydata.SetString(key, false);
+        StreamIterator iter(ctx, m_engine, ctx.ns, keydata, meta);
+        iter.Seek(StreamID());
+        if (!iter.Valid())
         {
-            DELETE(citer);
             return -1;
         }
-        min = ik.GetStreamID();
+        min = iter.ID();
         max = min;
-        minv = citer->Value(true);
-        if (maxv.GetType() == 0)
-        {
-            maxv = minv;
+        minv = iter.Value();
+        minv.CloneStringPart();
+        maxv = minv;
+        StreamID last;
+        last.ms = UINT64_MAX;
+        last.seq = UINT64_MAX;
+        iter.SeekLast(last);
+        if (iter.Valid())
+        {
+            max = iter.ID();
+            maxv = iter.Value();
+            maxv.CloneStringPart();
         }
-        KeyObject next(ctx.ns, KEY_STREAM_ELEMENT + 1, key);
-        citer->Jump(next);
-        citer->Prev();
-        if (citer->Valid())
-        {
-            KeyObject& nk = citer->Key(false);
-            if (nk.GetType() == KEY_STREAM_ELEMENT && nk.GetKey() == ck.GetKey())
-            {
-                max = nk.GetStreamID();
-                maxv = citer->Value(true);
-            }
-        }
-        DELETE(citer);
         return 0;
     }
     int Ardb::StreamAddConsumer(Context& ctx, const std::string& consumer, StreamGroupMeta* group_meta)
@@ -621,29 +978,135 @@ OP_NAMESPACE_BEGIN
     }
 
     int64_t Ardb::StreamTrimByLength(Context& ctx, const std::string& key, ValueObject& meta, size_t maxlen, int approx)
+    {
+        return StreamTrim(ctx, key, meta, (int64_t) maxlen, NULL, approx);
+    }
+
+    int64_t Ardb::StreamTrimByMinID(Context& ctx, const std::string& key, ValueObject& meta, const StreamID& minid,
+            int approx)
+    {
+        return StreamTrim(ctx, key, meta, 0, &minid, approx);
+    }
+
+    /*
+     * Removes the oldest entries until 'maxlen' are left, or the ones below 'minid' when it is given. Blocks
+     * whose entries all go are dropped whole, a run of them with one range delete when the engine supports
+     * it. With 'approx' a block keeping some entries is left as it is, else it is rewritten without the
+     * removed ones.
+     */
+    int64_t Ardb::StreamTrim(Context& ctx, const std::string& key, ValueObject& meta, int64_t maxlen,
+            const StreamID* minid, int approx)
     {
         int64_t trimed = 0;
-        KeyObject start(ctx.ns, KEY_STREAM_ELEMENT, key);
+        if (meta.GetMetaObject().stream_block <= 0)
+        {
+            KeyObject start(ctx.ns, KEY_STREAM_ELEMENT, key);
+            Iterator* iter = m_engine->Find(ctx, start);
+            WriteBatchGuard batch(ctx, m_engine);
+            while (iter->Valid() && meta.GetObjectLen() > 0)
+            {
+                KeyObject& ik = iter->Key(false);
+                if (ik.GetType() != KEY_STREAM_ELEMENT || ik.GetNameSpace() != start.GetNameSpace()
+                        || ik.GetKey() != start.GetKey())
+                {
+                    break;
+                }
+                if (NULL == minid ? meta.GetObjectLen() <= maxlen : ik.GetStreamID().Compare(*minid) >= 0)
+                {
+                    break;
+                }
+                trimed++;
+                meta.SetObjectLen(meta.GetObjectLen() - 1);
+                iter->Del();
+                iter->Next();
+            }
+            DELETE(iter);
+            return trimed;
+        }
+        KeyObject start(ctx.ns, KEY_STREAM_BLOCK, key);
         Iterator* iter = m_engine->Find(ctx, start);
         WriteBatchGuard batch(ctx, m_engine);
-        while (iter->Valid() && meta.GetObjectLen() > (int64_t)maxlen)
+        bool range_delete = m_engine->GetFeatureSet().support_delete_range;
+        KeyObject range_start(ctx.ns, KEY_STREAM_BLOCK, key);
+        bool dropping = false;
+        while (iter->Valid() && meta.GetObjectLen() > 0)
         {
             KeyObject& ik = iter->Key(false);
-            if (ik.GetType() != KEY_STREAM_ELEMENT || ik.GetNameSpace() != start.GetNameSpace()
+            if (ik.GetType() != KEY_STREAM_BLOCK || ik.GetNameSpace() != start.GetNameSpace()
                     || ik.GetKey() != start.GetKey())
             {
                 break;
             }
-            trimed++;
-            meta.SetObjectLen(meta.GetObjectLen() - 1);
-            iter->Del();
-            iter->Next();
+            ValueObject& block = iter->Value(false);
+            int64_t count = block.GetStreamBlockCount();
+            StreamID last;
+            last.Decode(block.GetStreamBlockLastId());
+            if (NULL == minid ? meta.GetObjectLen() - count >= maxlen : last.Compare(*minid) < 0)
+            {
+                if (!range_delete)
+                {
+                    iter->Del();
+                }
+                else if (!dropping)
+                {
+                    range_start.SetStreamBlockID(ik.GetStreamBlockID());
+                    dropping = true;
+                }
+                trimed += count;
+                meta.SetObjectLen(meta.GetObjectLen() - count);
+                iter->Next();
+                continue;
+            }
+            if (!approx && (NULL != minid || meta.GetObjectLen() > maxlen))
+            {
+                StreamID block_id = ik.GetStreamBlockID();
+                StreamIDArray ids;
+                ValueObjectArray eles;
+                if (stream_block_decode(block, block_id, ids, eles))
+                {
+                    size_t drop = 0;
+                    while (drop < ids.size()
+                            && (NULL == minid ? meta.GetObjectLen() - (int64_t) drop > maxlen : ids[drop].Compare(*minid) < 0))
+                    {
+                        drop++;
+                    }
+                    if (drop > 0)
+                    {
+                        ValueObject rest;
+                        for (size_t i = drop; i < ids.size(); i++)
+                        {
+                            stream_block_append(rest, block_id, ids[i], eles[i]);
+                        }
+                        KeyObject bk(ctx.ns, KEY_STREAM_BLOCK, key);
+                        bk.SetStreamBlockID(block_id);
+                        m_engine->Put(ctx, bk, rest);
+                        trimed += drop;
+                        meta.SetObjectLen(meta.GetObjectLen() - drop);
+                    }
+                }
+            }
+            break;
+        }
+        if (dropping)
+        {
+            KeyObject range_end(ctx.ns, KEY_STREAM_BLOCK + 1, key);
+            if (iter->Valid() && iter->Key(false).GetType() == KEY_STREAM_BLOCK
+                    && iter->Key(false).GetNameSpace() == start.GetNameSpace() && iter->Key(false).GetKey() == start.GetKey())
+            {
+                range_end.SetType(KEY_STREAM_BLOCK);
+                range_end.SetStreamBlockID(iter->Key(false).GetStreamBlockID());
+            }
+            m_engine->DelRange(ctx, range_start, range_end);
         }
         DELETE(iter);
         return trimed;
     }
 
-    /* XADD key [MAXLEN <count>] <ID or *> [field value] [field value] ... */
+#define TRIM_STRATEGY_NONE 0
+#define TRIM_STRATEGY_MAXLEN 1
+#define TRIM_STRATEGY_MINID 2
+
+    /* XADD key [MAXLEN|MINID [~] <threshold>] <ID or *> [field value] [field value] ... */
     int Ardb::XAdd(Context& ctx, RedisCommandFrame& cmd)
     {
         ctx.flags.create_if_notexist = 1;
@@ -658,9 +1121,11 @@ OP_NAMESPACE_BEGIN
                 return 0;
             }
             StreamID id;
-            int64_t maxlen = 0; /* 0 means no maximum length. */
-            int approx_maxlen = 0; /* If 1 only delete whole radix tree nodes, so
-             the maxium length is not applied verbatim. */
+            int trim_strategy = TRIM_STRATEGY_NONE;
+            int64_t maxlen = 0;
+            StreamID minid;
+            int approx_maxlen = 0; /* If 1 only delete whole stream blocks, so
+             the threshold is not applied verbatim. */
             //int maxlen_arg_idx = 0; /* Index of the count in MAXLEN, for rewriting. */
             bool id_given = false;
             size_t i = 1;
@@ -674,16 +1139,21 @@ OP_NAMESPACE_BEGIN
                      * creation. */
                     break;
                 }
-                else if (!strcasecmp(opt, "maxlen") && moreargs)
+                else if ((!strcasecmp(opt, "maxlen") || !strcasecmp(opt, "minid")) && moreargs >= 2)
                 {
+                    trim_strategy = !strcasecmp(opt, "maxlen") ? TRIM_STRATEGY_MAXLEN : TRIM_STRATEGY_MINID;
                     const char *next = cmd.GetArguments()[i + 1].c_str();
                     /* Check for the form MAXLEN ~ <count>. */
-                    if (moreargs >= 2 && next[0] == '~' && next[1] == '\0')
+                    if (moreargs >= 3 && next[0] == '~' && next[1] == '\0')
                     {
                         approx_maxlen = 1;
                         i++;
                     }
-                    if (!string_toint64(cmd.GetArguments()[i + 1], maxlen))
+                    if (trim_strategy == TRIM_STRATEGY_MINID)
+                    {
+                        if (streamParseIDOrReply(ctx, cmd.GetArguments()[i + 1], minid, 0) != 0) return 0;
+                    }
+                    else if (!string_toint64(cmd.GetArguments()[i + 1], maxlen) || maxlen < 0)
                     {
                         reply.SetErrCode(ERR_INVALID_INTEGER_ARGS);
                         return 0;
@@ -713,6 +1183,7 @@ OP_NAMESPACE_BEGIN
             {
                 meta.SetType(KEY_STREAM);
                 meta.SetObjectLen(1);
+                meta.GetMetaObject().stream_block = GetConf().stream_block_entries;
                 create_stream = true;
             }
             else
@@ -730,8 +1201,6 @@ OP_NAMESPACE_BEGIN
                 streamNextID(meta.GetMetaObject().stream_last_id, id);
             }
             meta.GetMetaObject().stream_last_id = id;
-            KeyObject stream_ele(ctx.ns, KEY_STREAM_ELEMENT, keystr);
-            stream_ele.SetStreamID(id);
             ValueObject stream_ele_val;
             stream_ele_val.SetType(KEY_STREAM_ELEMENT);
             int stream_meta_fields_equal = -1; // -1: not compared 0: not equal  1:  equal
@@ -782,15 +1251,19 @@ OP_NAMESPACE_BEGIN
                     stream_ele_val.GetStreamFieldName(field_idx).SetString(cmd.GetArguments()[i], false, false);
                 }
             }
-            SetKeyValue(ctx, stream_ele, stream_ele_val);
-            SetKeyValue(ctx, key, meta);
-            replyStreamID(reply, id);
+            StreamAppend(ctx, keystr, meta, id, stream_ele_val);
 
             //trim stream
-            if (approx_maxlen && meta.GetObjectLen() > maxlen)
+            if (trim_strategy == TRIM_STRATEGY_MAXLEN && meta.GetObjectLen() > maxlen)
             {
                 StreamTrimByLength(ctx, keystr, meta, maxlen, approx_maxlen);
             }
+            else if (trim_strategy == TRIM_STRATEGY_MINID)
+            {
+                StreamTrimByMinID(ctx, keystr, meta, minid, approx_maxlen);
+            }
+            SetKeyValue(ctx, key, meta);
+            replyStreamID(reply, id);
             cmd.ClearRawProtocolData();
             std::string idstr;
             id.ToString(idstr);
@@ -869,11 +1342,13 @@ OP_NAMESPACE_BEGIN
         //const char* grpname = NULL;
         const char *opt = cmd.GetArguments()[0].c_str(); /* Subcommand name. */
         ValueObject meta;
-        /* Lookup the key now, this is common for all the subcommands but HELP. */
-        if (cmd.GetArguments().size() >= 3)
+        /* Lookup the key now, this is common for all the subcommands but HELP.
+         * The key stays locked until the subcommand is done. */
+        bool with_key = cmd.GetArguments().size() >= 3;
+        KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[with_key ? 1 : 0]);
+        KeyLockGuard guard(ctx, key, with_key);
+        if (with_key)
         {
-            KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[1]);
-            KeyLockGuard guard(ctx, key);
             if (!CheckMeta(ctx, cmd.GetArguments()[1], KEY_STREAM, meta))
             {
                 return 0;
@@ -924,8 +1399,6 @@ OP_NAMESPACE_BEGIN
         }
         else if (!strcasecmp(opt, "DELGROUP") && cmd.GetArguments().size() == 3)
         {
-            KeyObject k(ctx.ns, KEY_META, cmd.GetArguments()[1]);
-            KeyLockGuard guard(ctx, k);
             int64_t pending = StreamDelGroup(ctx, cmd.GetArguments()[1], cmd.GetArguments()[2]);
             ctx.GetReply().SetInteger(pending);
         }
@@ -933,8 +1406,6 @@ OP_NAMESPACE_BEGIN
         {
             /* Delete the consumer and returns the number of pending messages
              * that were yet associated with such a consumer. */
-            KeyObject k(ctx.ns, KEY_META, cmd.GetArguments()[1]);
-            KeyLockGuard guard(ctx, k);
             int64_t pending = StreamDelConsumer(ctx, cmd.GetArguments()[1], cmd.GetArguments()[2],
                     cmd.GetArguments()[3]);
             ctx.GetReply().SetInteger(pending);
@@ -972,19 +1443,20 @@ OP_NAMESPACE_BEGIN
         /* We need to sanity check the IDs passed to start. Even if not
          * a big issue, it is not great that the command is only partially
          * executed becuase at some point an invalid ID is parsed. */
-        StreamID id;
+        StreamIDArray ids;
         for (size_t j = 1; j < cmd.GetArguments().size(); j++)
         {
+            StreamID id;
             if (streamParseIDOrReply(ctx, cmd.GetArguments()[j], id, 0) != 0) return 0;
+            ids.push_back(id);
         }
 
         /* Actaully apply the command. */
-        int deleted = 0;
         WriteBatchGuard batch(ctx, m_engine);
-        for (size_t j = 1; j < cmd.GetArguments().size(); j++)
+        int64_t deleted = StreamDelItems(ctx, cmd.GetArguments()[0], meta, ids);
+        if (deleted > 0)
         {
-            streamParseIDOrReply(ctx, cmd.GetArguments()[j], id, 0); /* Retval already checked. */
-            deleted += StreamDelItem(ctx, cmd.GetArguments()[0], id);
+            SetKeyValue(ctx, key, meta);
         }
         ctx.GetReply().SetInteger(deleted);
         return 0;
@@ -997,10 +1469,10 @@ OP_NAMESPACE_BEGIN
      *                             the specified length. Use ~ before the
      *                             count in order to demand approximated trimming
      *                             (like XADD MAXLEN option).
+     * MINID [~] <id>           -- Trim so that the stream will not contain
+     *                             entries with IDs lower than the specified one.
      */
 
-#define TRIM_STRATEGY_NONE 0
-#define TRIM_STRATEGY_MAXLEN 1
     int Ardb::XTrim(Context& ctx, RedisCommandFrame& cmd)
     {
         KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
@@ -1018,9 +1490,10 @@ OP_NAMESPACE_BEGIN
 
         /* Argument parsing. */
         int trim_strategy = TRIM_STRATEGY_NONE;
-        int64_t maxlen = 0; /* 0 means no maximum length. */
-        int approx_maxlen = 0; /* If 1 only delete whole radix tree nodes, so
-         the maxium length is not applied verbatim. */
+        int64_t maxlen = 0;
+        StreamID minid;
+        int approx_maxlen = 0; /* If 1 only delete whole stream blocks, so
+         the threshold is not applied verbatim. */
 
         /* Parse options. */
         size_t i = 1; /* Start of options. */
@@ -1029,17 +1502,21 @@ OP_NAMESPACE_BEGIN
             int moreargs = (cmd.GetArguments().size() - i);
             /* Number of additional arguments. */
             const char *opt = cmd.GetArguments()[i].c_str();
-            if (!strcasecmp(opt, "maxlen") && moreargs)
+            if ((!strcasecmp(opt, "maxlen") || !strcasecmp(opt, "minid")) && moreargs >= 2)
             {
-                trim_strategy = TRIM_STRATEGY_MAXLEN;
+                trim_strategy = !strcasecmp(opt, "maxlen") ? TRIM_STRATEGY_MAXLEN : TRIM_STRATEGY_MINID;
                 const char *next = cmd.GetArguments()[i + 1].c_str();
                 /* Check for the form MAXLEN ~ <count>. */
-                if (moreargs >= 2 && next[0] == '~' && next[1] == '\0')
+                if (moreargs >= 3 && next[0] == '~' && next[1] == '\0')
                 {
                     approx_maxlen = 1;
                     i++;
                 }
-                if (!string_toint64(cmd.GetArguments()[i + 1], maxlen))
+                if (trim_strategy == TRIM_STRATEGY_MINID)
+                {
+                    if (streamParseIDOrReply(ctx, cmd.GetArguments()[i + 1], minid, 0) != 0) return 0;
+                }
+                else if (!string_toint64(cmd.GetArguments()[i + 1], maxlen) || maxlen < 0)
                 {
                     ctx.GetReply().SetErrCode(ERR_INVALID_INTEGER_ARGS);
                     return 0;
@@ -1055,17 +1532,25 @@ OP_NAMESPACE_BEGIN
 
         /* Perform the trimming. */
         int64_t deleted = 0;
+        if (trim_strategy == TRIM_STRATEGY_NONE)
+        {
+            ctx.GetReply().SetErrorReason("XTRIM called without an option to trim the stream");
+            return 0;
+        }
         if (trim_strategy == TRIM_STRATEGY_MAXLEN)
         {
             deleted = StreamTrimByLength(ctx, cmd.GetArguments()[0], meta, maxlen, approx_maxlen);
-            ctx.GetReply().SetInteger(deleted);
-            return 0;
         }
         else
         {
-            ctx.GetReply().SetErrorReason("XTRIM called without an option to trim the stream");
-            return 0;
+            deleted = StreamTrimByMinID(ctx, cmd.GetArguments()[0], meta, minid, approx_maxlen);
         }
+        if (deleted > 0)
+        {
+            SetKeyValue(ctx, key, meta);
+        }
+        ctx.GetReply().SetInteger(deleted);
+        return 0;
     }
 
     int Ardb::XLen(Context& ctx, RedisCommandFrame& cmd)
@@ -1130,27 +1615,18 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
-        KeyObject key(ctx.ns, KEY_STREAM_ELEMENT, cmd.GetArguments()[0]);
+        KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
+        StreamIterator iter(ctx, m_engine, ctx.ns, key.GetKey(), meta);
         if (rev)
         {
-            key.SetStreamID(endid);
+            iter.SeekLast(endid);
         }
         else
         {
-            key.SetStreamID(startid);
-        }
-        ctx.flags.iterate_total_order = 1;
-        Iterator* iter = m_engine->Find(ctx, key);
-        if (rev)
-        {
-            if (!iter->Valid() || iter->Key(false).GetType() != KEY_STREAM_ELEMENT)
-            {
-                iter->JumpToLast();
-            }
+            iter.Seek(startid);
         }
-        bool first_iter = true;
         RedisReply& reply = ctx.GetReply();
-        while (iter->Valid())
+        while (iter.Valid())
         {
             if (count > 0)
             {
@@ -1159,57 +1635,25 @@ OP_NAMESPACE_BEGIN
                     break;
                 }
             }
-            KeyObject& ik = iter->Key(false);
-            if (ik.GetType() != KEY_STREAM_ELEMENT)
-            {
-                break;
-            }
-            StreamID iid = ik.GetStreamID();
-            if (rev && first_iter) //first for rev
-            {
-                first_iter = false;
-                if (iid.Compare(endid) > 0)
-                {
-                    iter->Prev();
-                    continue;
-                }
-            }
-
+            StreamID iid = iter.ID();
             if (rev && iid.Compare(startid) < 0)
             {
                 break;
             }
-            if (iid.Compare(endid) > 0)
+            if (!rev && iid.Compare(endid) > 0)
             {
                 break;
             }
-            ValueObject& iv = iter->Value(false);
-            RedisReply& rr = reply.AddMember();
-            replyStreamID(rr.AddMember(), iid);
-            RedisReply& fvs = rr.AddMember();
-            fvs.ReserveMember(0);
-            for (int64_t i = 0; i < iv.GetStreamFieldLength(); i++)
-            {
-                if (iv.ElementSize() == (size_t)iv.GetStreamFieldLength() + 1)
-                {
-                    fvs.AddMember().SetString(meta.GetStreamMetaFieldNames()[i]);
-                }
-                else
-                {
-                    fvs.AddMember().SetString(iv.GetStreamFieldName(i));
-                }
-                fvs.AddMember().SetString(iv.GetStreamFieldValue(i));
-            }
+            replyStreamElement(reply.AddMember(), iid, meta, iter.Value());
             if (rev)
             {
-                iter->Prev();
+                iter.Prev();
             }
             else
             {
-                iter->Next();
+                iter.Next();
             }
         }
-        DELETE(iter);
         return 0;
     }
     int Ardb::XRevRange(Context& ctx, RedisCommandFrame& cmd)
@@ -1399,10 +1843,8 @@ OP_NAMESPACE_BEGIN
             bool exist = found != group_meta->consumer_pels.end();
             if (!exist && force)
             {
-                KeyObject selement(ctx.ns, KEY_STREAM_ELEMENT, cmd.GetArguments()[0]);
-                selement.SetStreamID(ids[i]);
                 ValueObject tmp;
-                if (!m_engine->Exists(ctx, selement, tmp))
+                if (0 != StreamGetItem(ctx, keystr, meta, ids[i], tmp))
                 {
                     continue;
                 }
@@ -1442,15 +1884,12 @@ OP_NAMESPACE_BEGIN
                 }
                 else
                 {
-                    RedisReply& r = ctx.GetReply().AddMember();
-                    KeyObject selement(ctx.ns, KEY_STREAM_ELEMENT, cmd.GetArguments()[0]);
-                    selement.SetStreamID(ids[i]);
                     ValueObject ele;
-                    if (0 != m_engine->Get(ctx, selement, ele))
+                    if (0 != StreamGetItem(ctx, keystr, meta, ids[i], ele))
                     {
                         continue;
                     }
-                    replyStreamElement(r, ids[i], meta, ele);
+                    replyStreamElement(ctx.GetReply().AddMember(), ids[i], meta, ele);
                 }
             }
         }
@@ -1680,7 +2119,7 @@ OP_NAMESPACE_BEGIN
             ctx.GetReply().AddMember().SetInteger(NULL == gs ? 0 : gs->size());
             StreamID min, max;
             ValueObject minv, maxv;
-            StreamMinMaxID(ctx, keystr, min, max, minv, maxv);
+            StreamMinMaxID(ctx, keystr, meta, min, max, minv, maxv);
             if (min.Empty())
             {
                 ctx.GetReply().AddMember().Clear();
@@ -1905,9 +2344,8 @@ OP_NAMESPACE_BEGIN
                         while (pit != c->pels.end())
                         {
                             StreamID sid = pit->first;
-                            KeyObject sk(ctx.ns, KEY_STREAM_ELEMENT, stream_key_str);
                             ValueObject sv;
-                            if (0 == m_engine->Get(ctx, sk, sv))
+                            if (0 == StreamGetItem(ctx, stream_key_str, streams[i], sid, sv))
                             {
                                 replyStreamElement(r2.AddMember(), sid, streams[i], sv);
                                 StreamNACK* nack = pit->second;
@@ -1929,23 +2367,15 @@ OP_NAMESPACE_BEGIN
                     }
                 }
                 StreamGroupMeta* group_meta = groups[i];
-                KeyObject sk(ctx.ns, KEY_STREAM_ELEMENT, stream_key_str);
-                sk.SetStreamID(start);
-                Iterator* iter = m_engine->Find(ctx, sk);
+                StreamIterator iter(ctx, m_engine, ctx.ns, stream_key.GetKey(), streams[i]);
+                iter.Seek(start);
                 WriteBatchGuard batch(ctx, m_engine);
                 int64_t ele_count = 0;
                 bool group_meta_updated = false;
-                while (iter->Valid())
+                while (iter.Valid())
                 {
-                    KeyObject& ik = iter->Key(false);
-                    if (ik.GetType() != KEY_STREAM_ELEMENT || ik.GetNameSpace() != sk.GetNameSpace()
-                            || ik.GetKey() != sk.GetKey())
-                    {
-                        break;
-                    }
-                    StreamID id = ik.GetStreamID();
-                    ValueObject& iv = iter->Value(false);
-                    replyStreamElement(r2.AddMember(), id, streams[i], iv);
+                    StreamID id = iter.ID();
+                    replyStreamElement(r2.AddMember(), id, streams[i], iter.Value());
                     ele_count++;
                     reply_count++;
                     if (NULL != group_meta && id.Compare(group_meta->lastid) > 0)
@@ -1961,9 +2391,8 @@ OP_NAMESPACE_BEGIN
                     {
                         break;
                     }
-                    iter->Next();
+                    iter.Next();
                 }
-                DELETE(iter);
                 if (group_meta_updated)
                 {
                     KeyObject gk(ctx.ns, KEY_STREAM_PEL, stream_key_str);
@@ -2029,31 +2458,24 @@ OP_NAMESPACE_BEGIN
         std::string stream_key;
         ready_key.key.ToString(stream_key);
 
-        KeyObject sk(ready_key.ns, KEY_STREAM_ELEMENT, ready_key.key);
+        StreamID sid;
         BlockingState::BlockKeyTable::iterator found = unblock_client.GetBPop().keys.find(ready_key);
         if (found != unblock_client.GetBPop().keys.end())
         {
-            StreamID sid = *(const StreamID*) found->second;
+            sid = *(const StreamID*) found->second;
             sid.seq++;
-            sk.SetStreamID(sid);
         }
         ctx.flags.iterate_total_order = 1;
-        Iterator* iter = m_engine->Find(ctx, sk);
+        StreamIterator iter(ctx, m_engine, ready_key.ns, ready_key.key, meta);
+        iter.Seek(sid);
         WriteBatchGuard batch(ctx, m_engine);
         int64_t ele_count = 0;
         bool group_meta_updated = false;
-        while (iter->Valid())
+        while (iter.Valid())
         {
-            KeyObject& ik = iter->Key(false);
-            if (ik.GetType() != KEY_STREAM_ELEMENT || ik.GetNameSpace() != sk.GetNameSpace()
-                    || ik.GetKey() != sk.GetKey())
-            {
-                break;
-            }
-            StreamID id = ik.GetStreamID();
-            ValueObject& iv = iter->Value(false);
+            StreamID id = iter.ID();
             RedisReply& ele_reply = r2.AddMember();
-            replyStreamElement(ele_reply, id, meta, iv);
+            replyStreamElement(ele_reply, id, meta, iter.Value());
             ele_count++;
             if (NULL != group_meta && id.Compare(group_meta->lastid) > 0)
             {
@@ -2069,9 +2491,8 @@ OP_NAMESPACE_BEGIN
             {
                 break;
             }
-            iter->Next();
+            iter.Next();
         }
-        DELETE(iter);
         if (group_meta_updated)
         {
             KeyObject gk(ready_key.ns, KEY_STREAM_PEL, ready_key.key);
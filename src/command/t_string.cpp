@@ -35,7 +35,7 @@ OP_NAMESPACE_BEGIN
         RedisReply& reply = ctx.GetReply();
         KeyObject keyobj(ctx.ns, KEY_META, Data::WrapCStr(cmd.GetArguments()[0]));
         ValueObject v;
-        if (!CheckMeta(ctx, keyobj, KEY_STRING, v))
+        if (!CheckMeta(ctx, keyobj, (KeyType) 0, v))
         {
             return 0;
         }
@@ -44,6 +44,16 @@ OP_NAMESPACE_BEGIN
             //return nil if not exist
             reply.Clear();
         }
+        else if (v.GetType() == KEY_BITMAP)
+        {
+            std::string str;
+            GetBitmapRange(ctx, keyobj, v, 0, v.GetMetaObject().bitmap_len - 1, str);
+            reply.SetString(str);
+        }
+        else if (v.GetType() != KEY_STRING)
+        {
+            reply.SetErrCode(ERR_WRONG_TYPE);
+        }
         else
         {
             reply.SetString(v.GetStringValue());
@@ -71,7 +81,13 @@ OP_NAMESPACE_BEGIN
         for (size_t i = 0; i < ks.size(); i++)
         {
             RedisReply& r = reply.AddMember();
-            if (errs[i] != 0 || vs[i].GetType() != KEY_STRING)
+            if (0 == errs[i] && vs[i].GetType() == KEY_BITMAP)
+            {
+                std::string str;
+                GetBitmapRange(ctx, ks[i], vs[i], 0, vs[i].GetMetaObject().bitmap_len - 1, str);
+                r.SetString(str);
+            }
+            else if (errs[i] != 0 || vs[i].GetType() != KEY_STRING)
             {
                 r.Clear();
             }
@@ -465,14 +481,22 @@ OP_NAMESPACE_BEGIN
         }
         else
         {
-            if (value.GetType() != KEY_STRING)
+            if (value.GetType() != KEY_STRING && value.GetType() != KEY_BITMAP)
             {
                 reply.SetErrCode(ERR_WRONG_TYPE);
                 return 0;
             }
             std::string str;
-            value.GetStringValue().ToString(str);
-            size_t strlen = str.size();
+            size_t strlen = 0;
+            if (value.GetType() == KEY_BITMAP)
+            {
+                strlen = value.GetMetaObject().bitmap_len;
+            }
+            else
+            {
+                value.GetStringValue().ToString(str);
+                strlen = str.size();
+            }
             /* Convert negative indexes */
             if (start < 0)
                 start = strlen + start;
@@ -491,6 +515,10 @@ OP_NAMESPACE_BEGIN
             {
                 str.clear();
             }
+            else if (value.GetType() == KEY_BITMAP)
+            {
+                GetBitmapRange(ctx, keyobj, value, start, end, str);
+            }
             else
             {
                 str = str.substr(start, end - start + 1);
@@ -557,10 +585,28 @@ OP_NAMESPACE_BEGIN
         }
         if (redis_compatible)
         {
-            if (!CheckMeta(ctx, key, KEY_STRING, valueobj))
+            if (!CheckMeta(ctx, key, (KeyType) 0, valueobj))
             {
                 return ctx.GetReply().ErrCode();
             }
+            if (valueobj.GetType() == KEY_BITMAP)
+            {
+                /*
+                 * a chunked bitmap is a string to clients, overwrite it
+                 */
+                if (nx_xx == 0)
+                {
+                    return ERR_NOTPERFORMED;
+                }
+                DelKey(ctx, keyobj);
+                valueobj.Clear();
+                valueobj.SetType(KEY_STRING);
+            }
+            else if (valueobj.GetType() != 0 && valueobj.GetType() != KEY_STRING)
+            {
+                ctx.GetReply().SetErrCode(ERR_WRONG_TYPE);
+                return ERR_WRONG_TYPE;
+            }
             Data merge;
             merge.SetString(value, true);
             int64 oldttl = valueobj.GetTTL();
@@ -805,11 +851,22 @@ OP_NAMESPACE_BEGIN
         RedisReply& reply = ctx.GetReply();
         KeyObject keyobj(ctx.ns, KEY_META, cmd.GetArguments()[0]);
         ValueObject value;
-        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_STRING, value))
+        if (!CheckMeta(ctx, cmd.GetArguments()[0], (KeyType) 0, value))
         {
             return 0;
         }
-        reply.SetInteger(value.GetStringValue().StringLength());
+        if (value.GetType() == KEY_BITMAP)
+        {
+            reply.SetInteger(value.GetMetaObject().bitmap_len);
+        }
+        else if (value.GetType() != 0 && value.GetType() != KEY_STRING)
+        {
+            reply.SetErrCode(ERR_WRONG_TYPE);
+        }
+        else
+        {
+            reply.SetInteger(value.GetStringValue().StringLength());
+        }
         return 0;
     }
 
@@ -118,14 +118,19 @@ OP_NAMESPACE_BEGIN
                 {
                     meta.SetType(KEY_ZSET);
                     meta.SetObjectLen(0);
+                    meta.GetMetaObject().zset_rank_index = GetConf().zset_rank_index;
+                    NewCollectionVersion(meta);
                 }
             }
+            bool rank_indexed = meta.GetMetaObject().zset_rank_index;
+            RankIndexDeltaTable rank_deltas;
             double score = 0;
             {
                 WriteBatchGuard batch(ctx, m_engine);
                 for (size_t i = 0; i < elements; i++)
                 {
                     KeyObject ele(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
+                    ele.BindCollection(meta);
                     ele.SetZSetMember(cmd.GetArguments()[scoreidx + i * 2 + 1]);
                     score = scores[i];
                     double current_score = 0;
@@ -150,9 +155,14 @@ OP_NAMESPACE_BEGIN
                         if (score != current_score)
                         {
                             KeyObject old_sort_key(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
+                            old_sort_key.BindCollection(meta);
                             old_sort_key.SetZSetMember(cmd.GetArguments()[scoreidx + i * 2 + 1]);
                             old_sort_key.SetZSetScore(current_score);
                             RemoveKey(ctx, old_sort_key);
+                            if (rank_indexed)
+                            {
+                                RankIndexUpdate(rank_deltas, current_score, -1);
+                            }
                             updated++;
                         }
                         else
@@ -170,16 +180,22 @@ OP_NAMESPACE_BEGIN
                         processed++;
                     }
                     KeyObject new_sort_key(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
+                    new_sort_key.BindCollection(meta);
                     new_sort_key.SetZSetMember(cmd.GetArguments()[scoreidx + i * 2 + 1]);
                     new_sort_key.SetZSetScore(score);
                     ValueObject empty;
                     empty.SetType(KEY_ZSET_SORT);
                     SetKeyValue(ctx, new_sort_key, empty);
+                    if (rank_indexed)
+                    {
+                        RankIndexUpdate(rank_deltas, score, 1);
+                    }
                     ele_value.SetType(KEY_ZSET_SCORE);
                     ele_value.SetZSetScore(score);
                     SetKeyValue(ctx, ele, ele_value);
                     meta.SetMinMaxData(new_sort_key.GetZSetMember());
                 }
+                RankIndexCommit(ctx, KEY_ZSET_RANK, keystr, meta, rank_deltas);
                 meta.SetObjectLen(meta.GetObjectLen() + added);
                 SetKeyValue(ctx, key, meta);
             }
@@ -279,21 +295,36 @@ OP_NAMESPACE_BEGIN
         }
         if (end >= meta.GetObjectLen()) end = meta.GetObjectLen() - 1;
         KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, key.GetKey());
+        sort_key.BindCollection(meta);
         if (reverse)
         {
             ctx.flags.iterate_total_order = 1;
         }
-        Iterator* iter = m_engine->Find(ctx, sort_key);
-        if (reverse)
+        bool rank_indexed = meta.GetMetaObject().zset_rank_index;
+        RankIndexDeltaTable rank_deltas;
+        Iterator* iter = NULL;
+        int64_t rank = 0;
+        if (rank_indexed && start > 0)
         {
-            iter->JumpToLast();
+            iter = RankIndexSeek(ctx, KEY_ZSET_RANK, cmd.GetArguments()[0], meta, reverse ? meta.GetObjectLen() - 1 - start : start);
+            if (NULL != iter)
+            {
+                rank = start;
+            }
+        }
+        if (NULL == iter)
+        {
+            iter = m_engine->Find(ctx, sort_key);
+            if (reverse)
+            {
+                iter->JumpToLast();
+            }
         }
-        int64_t rank = 0;
         while (iter->Valid())
         {
             KeyObject& field = iter->Key();
-            if (field.GetType() != KEY_ZSET_SORT || field.GetNameSpace() != key.GetNameSpace()
-                    || field.GetKey() != key.GetKey())
+            if (field.GetType() != KEY_ZSET_SORT || field.GetNameSpace() != sort_key.GetNameSpace()
+                    || field.GetKey() != sort_key.GetKey() || field.GetVersion() != sort_key.GetVersion())
             {
                 break;
             }
@@ -306,9 +337,14 @@ OP_NAMESPACE_BEGIN
                 if (toremove)
                 {
                     KeyObject score_key(ctx.ns, KEY_ZSET_SCORE, key.GetKey());
+                    score_key.BindCollection(meta);
                     score_key.SetZSetMember(field.GetZSetMember());
                     //RemoveKey(ctx, field);
                     RemoveKey(ctx, score_key);
+                    if (rank_indexed)
+                    {
+                        RankIndexUpdate(rank_deltas, field.GetZSetScore(), -1);
+                    }
                     iter->Del();
                     removed++;
                 }
@@ -340,6 +376,7 @@ OP_NAMESPACE_BEGIN
         {
             if (removed > 0)
             {
+                RankIndexCommit(ctx, KEY_ZSET_RANK, cmd.GetArguments()[0], meta, rank_deltas);
                 meta.SetObjectLen(meta.GetObjectLen() - removed);
                 if (meta.GetObjectLen() == 0)
                 {
@@ -434,7 +471,10 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
+        bool rank_indexed = meta.GetMetaObject().zset_rank_index;
+        RankIndexDeltaTable rank_deltas;
         KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, key.GetKey());
+        sort_key.BindCollection(meta);
         sort_key.SetZSetScore(reverse ? range.max.GetFloat64() : range.min.GetFloat64());
         if (reverse)
         {
@@ -451,8 +491,8 @@ OP_NAMESPACE_BEGIN
         while (iter->Valid())
         {
             KeyObject& field = iter->Key();
-            if (field.GetType() != KEY_ZSET_SORT || field.GetNameSpace() != key.GetNameSpace()
-                    || field.GetKey() != key.GetKey())
+            if (field.GetType() != KEY_ZSET_SORT || field.GetNameSpace() != sort_key.GetNameSpace()
+                    || field.GetKey() != sort_key.GetKey() || field.GetVersion() != sort_key.GetVersion())
             {
                 if (first_iter && reverse)
                 {
@@ -485,9 +525,14 @@ OP_NAMESPACE_BEGIN
                     if (toremove)
                     {
                         KeyObject score_key(ctx.ns, KEY_ZSET_SCORE, key.GetKey());
+                        score_key.BindCollection(meta);
                         score_key.SetZSetMember(field.GetZSetMember());
                         //RemoveKey(ctx, field);
                         RemoveKey(ctx, score_key);
+                        if (rank_indexed)
+                        {
+                            RankIndexUpdate(rank_deltas, field.GetZSetScore(), -1);
+                        }
                         iter->Del();
                         removed++;
                     }
@@ -523,6 +568,7 @@ OP_NAMESPACE_BEGIN
         {
             if (removed > 0)
             {
+                RankIndexCommit(ctx, KEY_ZSET_RANK, cmd.GetArguments()[0], meta, rank_deltas);
                 meta.SetObjectLen(meta.GetObjectLen() - removed);
                 if (meta.GetObjectLen() == 0)
                 {
@@ -565,6 +611,64 @@ OP_NAMESPACE_BEGIN
     int Ardb::ZRank(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
+        ValueObject meta;
+        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_ZSET, meta))
+        {
+            return 0;
+        }
+        if (meta.GetMetaObject().zset_rank_index)
+        {
+            KeyObject score_key(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
+            score_key.BindCollection(meta);
+            score_key.SetZSetMember(cmd.GetArguments()[1]);
+            ValueObject score;
+            int err = m_engine->Get(ctx, score_key, score);
+            if (0 != err)
+            {
+                if (err != ERR_ENTRY_NOT_EXIST)
+                {
+                    reply.SetErrCode(err);
+                }
+                else
+                {
+                    reply.Clear();
+                }
+                return 0;
+            }
+            Data member;
+            member.SetString(cmd.GetArguments()[1], false);
+            int64_t rank = 0;
+            bool found = false;
+            Iterator* iter = RankIndexCountBefore(ctx, KEY_ZSET_RANK, cmd.GetArguments()[0], meta,
+                    score.GetZSetScore(), rank);
+            while (iter->Valid())
+            {
+                KeyObject& field = iter->Key();
+                if (field.GetType() != KEY_ZSET_SORT || field.GetNameSpace() != score_key.GetNameSpace()
+                        || field.GetKey() != score_key.GetKey() || field.GetVersion() != score_key.GetVersion()
+                        || field.GetZSetScore() > score.GetZSetScore())
+                {
+                    break;
+                }
+                if (field.GetZSetScore() == score.GetZSetScore() && field.GetZSetMember() == member)
+                {
+                    found = true;
+                    break;
+                }
+                rank++;
+                iter->Next();
+            }
+            DELETE(iter);
+            if (!found)
+            {
+                reply.Clear();
+            }
+            else
+            {
+                reply.SetInteger(cmd.GetType() == REDIS_CMD_ZREVRANK ? meta.GetObjectLen() - 1 - rank : rank);
+            }
+            return 0;
+        }
         ZScore(ctx, cmd);
         if (reply.type == REDIS_REPLY_DOUBLE)
         {
@@ -572,6 +676,7 @@ OP_NAMESPACE_BEGIN
             Data member;
             member.SetString(cmd.GetArguments()[1], false);
             KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
+            sort_key.BindCollection(meta);
             if (cmd.GetType() == REDIS_CMD_ZREVRANK)
             {
                 ctx.flags.iterate_total_order = 1;
@@ -587,7 +692,7 @@ OP_NAMESPACE_BEGIN
             {
                 KeyObject& field = iter->Key();
                 if (field.GetType() != KEY_ZSET_SORT || field.GetNameSpace() != sort_key.GetNameSpace()
-                        || field.GetKey() != sort_key.GetKey())
+                        || field.GetKey() != sort_key.GetKey() || field.GetVersion() != sort_key.GetVersion())
                 {
                     break;
                 }
@@ -634,21 +739,33 @@ OP_NAMESPACE_BEGIN
         KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
         KeyLockGuard guard(ctx, key);
         keys.push_back(key);
+        vs.resize(1);
+        if (!CheckMeta(ctx, keys[0], KEY_ZSET, vs[0]))
+        {
+            return 0;
+        }
+        if (vs[0].GetType() == 0)
+        {
+            return 0;
+        }
         for (size_t i = 1; i < cmd.GetArguments().size(); i++)
         {
             KeyObject score_key(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
+            score_key.BindCollection(vs[0]);
             score_key.SetZSetMember(cmd.GetArguments()[i]);
             keys.push_back(score_key);
         }
-        m_engine->MultiGet(ctx, keys, vs, errs);
-        if (!CheckMeta(ctx, keys[0], KEY_ZSET, vs[0], false))
-        {
-            return 0;
-        }
-        if (vs[0].GetType() == 0)
         {
-            return 0;
+            /*
+             * the score keys can only be built once the meta tells which version they belong to
+             */
+            KeyObjectArray score_keys(keys.begin() + 1, keys.end());
+            ValueObjectArray scores;
+            m_engine->MultiGet(ctx, score_keys, scores, errs);
+            vs.insert(vs.end(), scores.begin(), scores.end());
         }
+        bool rank_indexed = vs[0].GetMetaObject().zset_rank_index;
+        RankIndexDeltaTable rank_deltas;
         int64_t removed = 0;
         {
             WriteBatchGuard batch(ctx, m_engine);
@@ -657,15 +774,21 @@ OP_NAMESPACE_BEGIN
                 if (vs[i].GetType() == KEY_ZSET_SCORE)
                 {
                     KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
+                    sort_key.BindCollection(vs[0]);
                     sort_key.SetZSetMember(keys[i].GetZSetMember());
                     sort_key.SetZSetScore(vs[i].GetZSetScore());
                     RemoveKey(ctx, sort_key);
                     RemoveKey(ctx, keys[i]);
+                    if (rank_indexed)
+                    {
+                        RankIndexUpdate(rank_deltas, vs[i].GetZSetScore(), -1);
+                    }
                     removed++;
                 }
             }
             if (removed > 0)
             {
+                RankIndexCommit(ctx, KEY_ZSET_RANK, cmd.GetArguments()[0], vs[0], rank_deltas);
                 vs[0].SetObjectLen(vs[0].GetObjectLen() - removed);
                 SetKeyValue(ctx, keys[0], vs[0]);
             }
@@ -683,10 +806,21 @@ OP_NAMESPACE_BEGIN
 
     int Ardb::ZScore(Context& ctx, RedisCommandFrame& cmd)
     {
+        RedisReply& reply = ctx.GetReply();
+        ValueObject meta;
+        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_ZSET, meta))
+        {
+            return 0;
+        }
+        if (meta.GetType() == 0)
+        {
+            reply.Clear();
+            return 0;
+        }
         KeyObject score_key(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
+        score_key.BindCollection(meta);
         score_key.SetZSetMember(cmd.GetArguments()[1]);
         ValueObject score;
-        RedisReply& reply = ctx.GetReply();
         int err = m_engine->Get(ctx, score_key, score);
         if (0 != err)
         {
@@ -767,7 +901,10 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
+        bool rank_indexed = meta.GetMetaObject().zset_rank_index;
+        RankIndexDeltaTable rank_deltas;
         KeyObject sort_key(ctx.ns, KEY_ZSET_SCORE, key.GetKey());
+        sort_key.BindCollection(meta);
         sort_key.SetZSetMember(reverse ? range.max : range.min);
         if (reverse)
         {
@@ -783,8 +920,8 @@ OP_NAMESPACE_BEGIN
         while (iter->Valid())
         {
             KeyObject& field = iter->Key();
-            if (field.GetType() != KEY_ZSET_SCORE || field.GetNameSpace() != key.GetNameSpace()
-                    || field.GetKey() != key.GetKey())
+            if (field.GetType() != KEY_ZSET_SCORE || field.GetNameSpace() != sort_key.GetNameSpace()
+                    || field.GetKey() != sort_key.GetKey() || field.GetVersion() != sort_key.GetVersion())
             {
                 break;
             }
@@ -812,10 +949,15 @@ OP_NAMESPACE_BEGIN
                     if (toremove)
                     {
                         KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, key.GetKey());
+                        sort_key.BindCollection(meta);
                         sort_key.SetZSetMember(field.GetZSetMember());
                         sort_key.SetZSetScore(iter->Value().GetZSetScore());
                         RemoveKey(ctx, sort_key);
                         iter->Del();
+                        if (rank_indexed)
+                        {
+                            RankIndexUpdate(rank_deltas, sort_key.GetZSetScore(), -1);
+                        }
                         removed++;
                     }
                     else if (!countrange)
@@ -845,6 +987,7 @@ OP_NAMESPACE_BEGIN
         {
             if (removed > 0)
             {
+                RankIndexCommit(ctx, KEY_ZSET_RANK, cmd.GetArguments()[0], meta, rank_deltas);
                 meta.SetObjectLen(meta.GetObjectLen() - removed);
                 if (meta.GetObjectLen() == 0)
                 {
@@ -1034,6 +1177,7 @@ OP_NAMESPACE_BEGIN
             for (size_t i = 0; !empty_inter_result && i < setnum; i++)
             {
                 KeyObject start(ctx.ns, (KeyType) element_type((KeyType) vs[i].GetType()), keys[i].GetKey());
+                start.BindCollection(vs[i]);
                 if (use_minmax)
                 {
                     start.SetSetMember(min);
@@ -1045,8 +1189,8 @@ OP_NAMESPACE_BEGIN
                 while (iters[i]->Valid())
                 {
                     KeyObject& k = iters[i]->Key(true);
-                    if (k.GetType() != start.GetType() || k.GetKey() != keys[i].GetKey()
-                            || k.GetNameSpace() != keys[i].GetNameSpace())
+                    if (k.GetType() != start.GetType() || k.GetKey() != start.GetKey()
+                            || k.GetNameSpace() != start.GetNameSpace() || k.GetVersion() != start.GetVersion())
                     {
                         break;
                     }
@@ -1099,6 +1243,7 @@ OP_NAMESPACE_BEGIN
                     continue;
                 }
                 KeyObject ele(ctx.ns, (KeyType) element_type((KeyType) vs[i].GetType()), keys[i].GetKey());
+                ele.BindCollection(vs[i]);
                 if (NULL != iter)
                 {
                     iter->Jump(ele);
@@ -1110,8 +1255,8 @@ OP_NAMESPACE_BEGIN
                 while (NULL != iter && iter->Valid())
                 {
                     KeyObject& k = iter->Key(true);
-                    if (k.GetType() != ele.GetType() || k.GetKey() != keys[i].GetKey()
-                            || k.GetNameSpace() != keys[i].GetNameSpace())
+                    if (k.GetType() != ele.GetType() || k.GetKey() != ele.GetKey()
+                            || k.GetNameSpace() != ele.GetNameSpace() || k.GetVersion() != ele.GetVersion())
                     {
                         break;
                     }
@@ -1145,22 +1290,32 @@ OP_NAMESPACE_BEGIN
             ValueObject dest_meta;
             dest_meta.SetType(KEY_ZSET);
             dest_meta.SetObjectLen(inter_union_result[result_cursor].size());
+            dest_meta.GetMetaObject().zset_rank_index = GetConf().zset_rank_index;
+            NewCollectionVersion(dest_meta);
+            RankIndexDeltaTable rank_deltas;
             while (it != inter_union_result[result_cursor].end())
             {
                 KeyObject element(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
+                element.BindCollection(dest_meta);
                 element.SetSetMember(it->first);
                 ValueObject score;
                 score.SetType(KEY_ZSET_SCORE);
                 score.SetZSetScore(it->second);
                 SetKeyValue(ctx, element, score);
                 KeyObject sort(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
+                sort.BindCollection(dest_meta);
                 sort.SetZSetMember(it->first);
                 sort.SetZSetScore(it->second);
                 ValueObject sort_value;
                 sort_value.SetType(KEY_ZSET_SORT);
                 SetKeyValue(ctx, sort, sort_value);
+                if (dest_meta.GetMetaObject().zset_rank_index)
+                {
+                    RankIndexUpdate(rank_deltas, it->second, 1);
+                }
                 it++;
             }
+            RankIndexCommit(ctx, KEY_ZSET_RANK, cmd.GetArguments()[0], dest_meta, rank_deltas);
             dest_meta.SetMinData(inter_union_result[result_cursor].begin()->first);
             dest_meta.SetMaxData(inter_union_result[result_cursor].rbegin()->first);
             SetKeyValue(ctx, destkey, dest_meta);
@@ -1205,6 +1360,7 @@ OP_NAMESPACE_BEGIN
         }
         ctx.flags.iterate_total_order = 1;
         KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, keystr);
+        sort_key.BindCollection(*meta);
         sort_key.SetZSetScore(reverse ? DBL_MAX : -DBL_MAX);
         Iterator* iter = m_engine->Find(ctx, sort_key);
         if (reverse && !iter->Valid())
@@ -1212,12 +1368,13 @@ OP_NAMESPACE_BEGIN
             iter->JumpToLast();
         }
         bool first_iter = true;
+        RankIndexDeltaTable rank_deltas;
         WriteBatchGuard batch(ctx, m_engine);
         while (iter->Valid() && count > 0)
         {
             KeyObject& field = iter->Key();
             if (field.GetType() != KEY_ZSET_SORT || field.GetNameSpace() != sort_key.GetNameSpace()
-                    || field.GetKey() != sort_key.GetKey())
+                    || field.GetKey() != sort_key.GetKey() || field.GetVersion() != sort_key.GetVersion())
             {
                 if (first_iter && reverse)
                 {
@@ -1235,8 +1392,13 @@ OP_NAMESPACE_BEGIN
             r2.SetString(field.GetZSetMember());
 
             KeyObject sk(ctx.ns, KEY_ZSET_SCORE, keystr);
+            sk.BindCollection(*meta);
             sk.SetZSetMember(field.GetZSetMember());
             m_engine->Del(ctx, sk);
+            if (meta->GetMetaObject().zset_rank_index)
+            {
+                RankIndexUpdate(rank_deltas, field.GetZSetScore(), -1);
+            }
             iter->Del();
             meta->SetObjectLen(meta->GetObjectLen() - 1);
             if (reverse)
@@ -1249,6 +1411,7 @@ OP_NAMESPACE_BEGIN
             }
         }
         DELETE(iter);
+        RankIndexCommit(ctx, KEY_ZSET_RANK, keystr, *meta, rank_deltas);
         KeyObject mk(ctx.ns, KEY_META, keystr);
         if (0 == meta->GetObjectLen())
         {
@@ -1258,6 +1421,7 @@ OP_NAMESPACE_BEGIN
         {
             m_engine->Put(ctx, mk, *meta);
         }
+        InvalidateMeta(mk);
         return 0;
     }
 
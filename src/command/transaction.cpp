@@ -83,6 +83,26 @@ namespace ardb
             RedisCommandFrameArray::iterator it = ctx.GetTransaction().cached_cmds.begin();
             Context transc_ctx;
             transc_ctx.ns = ctx.ns;
+            /*
+             * The keys of all queued commands are locked up front and the commands run in one engine write batch
+             * whose writes are visible to the later commands only, so other clients see the whole transaction or
+             * nothing of it. Transactions the keys can not be told for run command by command as before.
+             * Their replication commands are held back and logged as MULTI/EXEC once the batch is committed.
+             */
+            KeyPrefixSet transc_keys;
+            StagedReplication staged;
+            bool batched = false;
+            if (GetTransactionKeys(ctx, transc_keys))
+            {
+                LockKeys(transc_keys);
+                transc_ctx.transc_keys = &transc_keys;
+                if (0 == m_engine->BeginIndexedWriteBatch(transc_ctx))
+                {
+                    batched = true;
+                    transc_ctx.engine_snapshot = m_engine->CreateSnapshot();
+                    transc_ctx.repl_staged = &staged;
+                }
+            }
             while (it != ctx.GetTransaction().cached_cmds.end())
             {
                 RedisReply& r = reply.AddMember();
@@ -99,6 +119,29 @@ namespace ardb
                 }
                 it++;
             }
+            if (batched)
+            {
+                int err = m_engine->CommitWriteBatch(transc_ctx);
+                m_engine->ReleaseSnapshot(transc_ctx.engine_snapshot);
+                transc_ctx.engine_snapshot = NULL;
+                transc_ctx.repl_staged = NULL;
+                if (0 != err)
+                {
+                    ERROR_LOG("Failed to commit transaction batch with err:%d", err);
+                    reply.Clear();
+                    reply.SetErrCode(err);
+                    staged.Clear();
+                }
+                else
+                {
+                    FeedStagedReplication(staged, true);
+                }
+            }
+            if (NULL != transc_ctx.transc_keys)
+            {
+                transc_ctx.transc_keys = NULL;
+                UnlockKeys(transc_keys);
+            }
             ctx.ns = transc_ctx.ns;
             DiscardTransaction(ctx);
         }
@@ -114,6 +157,53 @@ namespace ardb
         return 0;
     }
 
+    /*
+     * Collects the keys of the queued commands with the namespaces they are selected in. Returns false if a
+     * command may touch keys not told by its arguments (scripts, SORT, MIGRATE...) or writes without keys.
+     */
+    bool Ardb::GetTransactionKeys(Context& ctx, KeyPrefixSet& ks)
+    {
+        Data ns = ctx.ns;
+        std::vector<const std::string*> keys;
+        RedisCommandFrameArray& cmds = ctx.GetTransaction().cached_cmds;
+        for (size_t i = 0; i < cmds.size(); i++)
+        {
+            bool write = false;
+            if (!GetCommandKeys(cmds[i], keys, write))
+            {
+                return false;
+            }
+            const ArgumentArray& args = cmds[i].GetArguments();
+            if (cmds[i].GetType() == REDIS_CMD_SELECT)
+            {
+                if (!args.empty())
+                {
+                    ns.SetString(args[0], false);
+                }
+                continue;
+            }
+            if (keys.empty() && write)
+            {
+                return false;
+            }
+            for (size_t j = 0; j < keys.size(); j++)
+            {
+                KeyPrefix lk;
+                lk.ns = ns;
+                lk.key.SetString(*keys[j], false);
+                ks.insert(lk);
+            }
+            if (cmds[i].GetType() == REDIS_CMD_MOVE && args.size() > 1)
+            {
+                KeyPrefix lk;
+                lk.ns.SetString(args[1], false);
+                lk.key.SetString(args[0], false);
+                ks.insert(lk);
+            }
+        }
+        return true;
+    }
+
     int Ardb::DiscardTransaction(Context& ctx)
     {
         UnwatchKeys(ctx);
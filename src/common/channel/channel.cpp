@@ -426,6 +426,69 @@ int32 Channel::WriteNow(Buffer* buffer)
     }
 }
 
+int32 Channel::WriteNowV(const struct iovec* iov, int iovcnt)
+{
+    static const int kMaxWriteIOV = 256;
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        total += iov[i].iov_len;
+    }
+    int idx = 0;
+    size_t skip = 0; //bytes of iov[idx] already written
+    int fd = GetWriteFD();
+    if (NULL == m_file_sending && !m_outputBuffer.Readable() && fd > 0)
+    {
+        struct iovec batch[kMaxWriteIOV];
+        while (idx < iovcnt)
+        {
+            int cnt = 0;
+            size_t batch_len = 0;
+            for (int i = idx; i < iovcnt && cnt < kMaxWriteIOV; i++, cnt++)
+            {
+                batch[cnt] = iov[i];
+                batch_len += iov[i].iov_len;
+            }
+            batch[0].iov_base = (char*) batch[0].iov_base + skip;
+            batch[0].iov_len -= skip;
+            batch_len -= skip;
+            ssize_t ret = ::writev(fd, batch, cnt);
+            if (ret < 0)
+            {
+                int err = errno;
+                if (IO_ERR_RW_RETRIABLE(err))
+                {
+                    break;
+                }
+                return HandleIOError(err);
+            }
+            size_t written = ret;
+            while (idx < iovcnt && written >= iov[idx].iov_len - skip)
+            {
+                written -= iov[idx].iov_len - skip;
+                skip = 0;
+                idx++;
+            }
+            skip += written;
+            if ((size_t) ret < batch_len)
+            {
+                //socket send buffer is full
+                break;
+            }
+        }
+    }
+    for (; idx < iovcnt; idx++)
+    {
+        m_outputBuffer.Write((const char*) iov[idx].iov_base + skip, iov[idx].iov_len - skip);
+        skip = 0;
+    }
+    if (m_outputBuffer.Readable())
+    {
+        EnableWriting();
+    }
+    return total;
+}
+
 bool Channel::DoConfigure(const ChannelOptions& options)
 {
     if (options.user_write_buffer_water_mark > 0)
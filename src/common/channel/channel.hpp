@@ -35,6 +35,7 @@
 #include "channel/channel_pipeline.hpp"
 #include "util/helpers.hpp"
 #include <map>
+#include <sys/uio.h>
 
 /* delayed ack (quick_ack) */
 #ifndef HAVE_TCP_QUICKACK
@@ -307,6 +308,13 @@ namespace ardb
             void EnableWriting();
             void DisableWriting();
 
+            /*
+             * Writes the pieces with writev when nothing is queued before them, whatever the
+             * socket does not take is copied into the output buffer, so the pieces only need
+             * to live until this returns.
+             */
+            int32 WriteNowV(const struct iovec* iov, int iovcnt);
+
             bool BlockRead();
             bool UnblockRead();
             bool IsReadBlocked()
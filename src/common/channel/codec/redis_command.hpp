@@ -85,6 +85,7 @@ namespace ardb
             REDIS_CMD_DEBUG = 41,
             REDIS_CMD_BACKUP = 42,
 			REDIS_CMD_COMMAND = 43,
+            REDIS_CMD_LATENCY = 44,
 
             //'keys' commands
             REDIS_CMD_DEL = 50,
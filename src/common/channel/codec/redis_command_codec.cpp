@@ -438,6 +438,79 @@ bool RedisCommandDecoder::Decode(ChannelHandlerContext& ctx, Channel* channel, B
     return Decode(channel, buffer, msg);
 }
 
+void RedisCommandBatchDecoder::DecodeBatches(ChannelHandlerContext& ctx, Buffer& buffer)
+{
+    Channel* ch = ctx.GetChannel();
+    while (!ch->IsReadBlocked() && buffer.Readable())
+    {
+        size_t start = buffer.GetReadIndex();
+        size_t count = 0;
+        m_frame_ends.clear();
+        while (count < m_max_batch && buffer.Readable())
+        {
+            if (m_batch.frames.size() <= count)
+            {
+                m_batch.frames.resize(count + 1);
+            }
+            RedisCommandFrame& frame = m_batch.frames[count];
+            frame.Clear();
+            if (!RedisCommandDecoder::Decode(ch, buffer, frame))
+            {
+                break;
+            }
+            count++;
+            m_frame_ends.push_back(buffer.GetReadIndex());
+        }
+        if (0 == count)
+        {
+            if (buffer.GetReadIndex() != start)
+            {
+                // Previous data has been discarded.
+                continue;
+            }
+            // Seems like more data is required.
+            break;
+        }
+        m_batch.count = count;
+        m_batch.processed = count;
+        m_dispatching = true;
+        fire_message_received<RedisCommandBatch>(ctx, &m_batch, NULL);
+        m_dispatching = false;
+        if (m_batch.processed < count)
+        {
+            buffer.SetReadIndex(m_batch.processed > 0 ? m_frame_ends[m_batch.processed - 1] : start);
+            break;
+        }
+    }
+}
+
+void RedisCommandBatchDecoder::MessageReceived(ChannelHandlerContext& ctx, MessageEvent<Buffer>& e)
+{
+    if (m_dispatching)
+    {
+        /*
+         * UnblockRead called by a command of the batch in processing, the outer loop decodes the
+         * rest of the buffer once the batch returns.
+         */
+        return;
+    }
+    Buffer* input = e.GetMessage();
+    if (m_cumulation.Readable())
+    {
+        m_cumulation.DiscardReadedBytes();
+        m_cumulation.Write(input, input->ReadableBytes());
+        DecodeBatches(ctx, m_cumulation);
+    }
+    else
+    {
+        DecodeBatches(ctx, *input);
+        if (input->Readable())
+        {
+            m_cumulation.Write(input, input->ReadableBytes());
+        }
+    }
+}
+
 //===================================encoder==============================
 bool RedisCommandEncoder::Encode(Buffer& buf, const RedisCommandFrame& cmd)
 {
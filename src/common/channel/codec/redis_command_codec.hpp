@@ -55,6 +55,47 @@ namespace ardb
                 static bool Decode(Channel* ch, Buffer& buffer, RedisCommandFrame& msg);
         };
 
+        /*
+         * Complete frames decoded from one read, the handler sets 'processed' when it has to stop
+         * before the last one(client blocked or closed).
+         */
+        struct RedisCommandBatch
+        {
+                RedisCommandFrameArray frames;
+                size_t count;
+                size_t processed;
+                RedisCommandBatch() :
+                        count(0), processed(0)
+                {
+                }
+        };
+
+        /*
+         * Fires every complete frame of a read upstream as one RedisCommandBatch instead of one by one,
+         * frames not processed by the handler are left in the buffer and decoded again later.
+         */
+        class RedisCommandBatchDecoder: public ChannelUpstreamHandler<Buffer>
+        {
+            protected:
+                Buffer m_cumulation;
+                RedisCommandBatch m_batch;
+                std::vector<size_t> m_frame_ends;
+                uint32 m_max_batch;
+                bool m_dispatching;
+                void DecodeBatches(ChannelHandlerContext& ctx, Buffer& buffer);
+                void MessageReceived(ChannelHandlerContext& ctx, MessageEvent<Buffer>& e);
+                void ChannelClosed(ChannelHandlerContext& ctx, ChannelStateEvent& e)
+                {
+                    m_cumulation.Clear();
+                    ctx.SendUpstream(e);
+                }
+            public:
+                RedisCommandBatchDecoder(uint32 max_batch = 128) :
+                        m_max_batch(max_batch), m_dispatching(false)
+                {
+                }
+        };
+
         class FastRedisCommandDecoder: public ChannelUpstreamHandler<Buffer>
         {
             protected:
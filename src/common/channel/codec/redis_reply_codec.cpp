@@ -38,28 +38,124 @@ using ardb::BufferHelper;
 using namespace ardb::codec;
 using namespace ardb;
 
+/*
+ * Bulk strings at least this long are handed to writev from the reply instead of being copied
+ * into the output buffer, provided nothing is queued on the channel already.
+ */
+static const size_t kZeroCopyBulkSize = 4096;
+static const size_t kMaxStagingCapacity = 64 * 1024;
+
+/*
+ * "$<n>\r\n" and "*<n>\r\n" for every n below kPrecomputedHeaders, built once at startup.
+ */
+static const int64 kPrecomputedHeaders = 1024;
+static inline size_t format_integer_line(char* dst, char prefix, int64 v)
+{
+    char digits[24];
+    char* p = digits + sizeof(digits);
+    uint64 uv = v < 0 ? (uint64) 0 - (uint64) v : (uint64) v;
+    do
+    {
+        *--p = '0' + (uv % 10);
+        uv /= 10;
+    } while (uv);
+    if (v < 0)
+    {
+        *--p = '-';
+    }
+    size_t len = digits + sizeof(digits) - p;
+    dst[0] = prefix;
+    memcpy(dst + 1, p, len);
+    dst[len + 1] = '\r';
+    dst[len + 2] = '\n';
+    return len + 3;
+}
+struct RedisHeaderTable
+{
+        char bulk[kPrecomputedHeaders][8];
+        char multi[kPrecomputedHeaders][8];
+        uint8 len[kPrecomputedHeaders];
+        RedisHeaderTable()
+        {
+            for (int64 i = 0; i < kPrecomputedHeaders; i++)
+            {
+                len[i] = format_integer_line(bulk[i], '$', i);
+                format_integer_line(multi[i], '*', i);
+            }
+        }
+};
+static RedisHeaderTable g_header_table;
+
+static inline void write_integer_line(Buffer& buf, char prefix, int64 v)
+{
+    if (v >= 0 && v < kPrecomputedHeaders && (prefix == '$' || prefix == '*'))
+    {
+        buf.Write(prefix == '$' ? g_header_table.bulk[v] : g_header_table.multi[v], g_header_table.len[v]);
+        return;
+    }
+    buf.EnsureWritableBytes(32);
+    size_t len = format_integer_line(const_cast<char*>(buf.GetRawWriteBuffer()), prefix, v);
+    buf.AdvanceWriteIndex(len);
+}
+
+static inline void write_line(Buffer& buf, char prefix, const std::string& s)
+{
+    buf.EnsureWritableBytes(s.size() + 3);
+    buf.Write(&prefix, 1);
+    buf.Write(s.data(), s.size());
+    buf.Write("\r\n", 2);
+}
+
+static bool has_zero_copy_bulk(const RedisReply& reply)
+{
+    if (reply.type == REDIS_REPLY_STRING)
+    {
+        return reply.str.size() >= kZeroCopyBulkSize;
+    }
+    if (reply.type == REDIS_REPLY_ARRAY && NULL != reply.elements)
+    {
+        std::deque<RedisReply*>::const_iterator it = reply.elements->begin();
+        while (it != reply.elements->end())
+        {
+            if (has_zero_copy_bulk(*(*it)))
+            {
+                return true;
+            }
+            it++;
+        }
+    }
+    return false;
+}
+
 bool RedisReplyEncoder::Encode(Buffer& buf, RedisReply& reply)
+{
+    return Encode(buf, reply, NULL);
+}
+
+bool RedisReplyEncoder::Encode(Buffer& buf, RedisReply& reply, RedisBulkSegmentArray* segments)
 {
     switch (reply.type)
     {
         case REDIS_REPLY_NIL:
         {
-            buf.Printf("$-1\r\n");
+            buf.Write("$-1\r\n", 5);
             break;
         }
         case REDIS_REPLY_STRING:
         {
-            buf.Printf("$%d\r\n", reply.str.size());
-            if (reply.str.size() > 0)
+            write_integer_line(buf, '$', reply.str.size());
+            if (NULL != segments && reply.str.size() >= kZeroCopyBulkSize)
             {
-                //buf.Printf("%s\r\n", reply.str.c_str());
-                buf.Write(reply.str.data(), reply.str.size());
-                buf.Printf("\r\n");
+                RedisBulkSegment segment;
+                segment.offset = buf.GetWriteIndex();
+                segment.str = &reply.str;
+                segments->push_back(segment);
             }
             else
             {
-                buf.Printf("\r\n");
+                buf.Write(reply.str.data(), reply.str.size());
             }
+            buf.Write("\r\n", 2);
             break;
         }
         case REDIS_REPLY_ERROR:
@@ -67,23 +163,26 @@ bool RedisReplyEncoder::Encode(Buffer& buf, RedisReply& reply)
             const std::string& err = reply.Error();
             if (!err.empty() && err[0] == '-')
             {
-                buf.Printf("%s\r\n", err.c_str());
+                buf.Write(err.data(), err.size());
+                buf.Write("\r\n", 2);
             }
             else
             {
-                buf.Printf("-ERR %s\r\n", err.c_str());
+                buf.Write("-ERR ", 5);
+                buf.Write(err.data(), err.size());
+                buf.Write("\r\n", 2);
             }
             break;
         }
         case REDIS_REPLY_INTEGER:
         {
-            buf.Printf(":%lld\r\n", reply.integer);
+            write_integer_line(buf, ':', reply.integer);
             break;
         }
         case REDIS_REPLY_DOUBLE:
         {
-            char dbuf[128], sbuf[128];
-            int dlen, slen;
+            char dbuf[128];
+            int dlen;
             double d = reply.GetDouble();
             if (std::isinf (d))
             {
@@ -94,8 +193,9 @@ bool RedisReplyEncoder::Encode(Buffer& buf, RedisReply& reply)
             else
             {
                 dlen = snprintf(dbuf, sizeof(dbuf), "%.17g", d);
-                slen = snprintf(sbuf, sizeof(sbuf), "$%d\r\n%s\r\n", dlen, dbuf);
-                buf.Write(sbuf, slen);
+                write_integer_line(buf, '$', dlen);
+                buf.Write(dbuf, dlen);
+                buf.Write("\r\n", 2);
             }
             break;
         }
@@ -103,19 +203,19 @@ bool RedisReplyEncoder::Encode(Buffer& buf, RedisReply& reply)
         {
             if (reply.integer < 0 && NULL == reply.elements)
             {
-                buf.Printf("*-1\r\n");
+                buf.Write("*-1\r\n", 5);
                 break;
             }
             if (NULL == reply.elements)
             {
-                buf.Printf("*0\r\n");
+                buf.Write("*0\r\n", 4);
                 break;
             }
-            buf.Printf("*%d\r\n", reply.elements->size());
+            write_integer_line(buf, '*', reply.elements->size());
             std::deque<RedisReply*>::iterator it = reply.elements->begin();
             while (it != reply.elements->end())
             {
-                if (!RedisReplyEncoder::Encode(buf, *(*it)))
+                if (!RedisReplyEncoder::Encode(buf, *(*it), segments))
                 {
                     return false;
                 }
@@ -125,7 +225,7 @@ bool RedisReplyEncoder::Encode(Buffer& buf, RedisReply& reply)
         }
         case REDIS_REPLY_STATUS:
         {
-            buf.Printf("+%s\r\n", reply.Status().c_str());
+            write_line(buf, '+', reply.Status());
             break;
         }
         default:
@@ -137,12 +237,61 @@ bool RedisReplyEncoder::Encode(Buffer& buf, RedisReply& reply)
     return true;
 }
 
+/*
+ * Stages headers and short strings in m_staging and submits them together with the large bulk
+ * strings of the reply in one writev.
+ */
+bool RedisReplyEncoder::WriteScattered(Channel* ch, RedisReply& reply)
+{
+    m_staging.Clear();
+    m_segments.clear();
+    m_iov.clear();
+    if (!Encode(m_staging, reply, &m_segments))
+    {
+        return false;
+    }
+    struct iovec piece;
+    size_t staged = 0;
+    for (size_t i = 0; i < m_segments.size(); i++)
+    {
+        const RedisBulkSegment& segment = m_segments[i];
+        if (segment.offset > staged)
+        {
+            piece.iov_base = (void*) (m_staging.GetRawBuffer() + staged);
+            piece.iov_len = segment.offset - staged;
+            m_iov.push_back(piece);
+        }
+        piece.iov_base = (void*) segment.str->data();
+        piece.iov_len = segment.str->size();
+        m_iov.push_back(piece);
+        staged = segment.offset;
+    }
+    if (m_staging.GetWriteIndex() > staged)
+    {
+        piece.iov_base = (void*) (m_staging.GetRawBuffer() + staged);
+        piece.iov_len = m_staging.GetWriteIndex() - staged;
+        m_iov.push_back(piece);
+    }
+    ch->WriteNowV(&m_iov[0], m_iov.size());
+    m_staging.Clear();
+    if (m_staging.Capacity() > kMaxStagingCapacity)
+    {
+        m_staging.Compact(kMaxStagingCapacity / 16);
+    }
+    return true;
+}
+
 bool RedisReplyEncoder::WriteRequested(ChannelHandlerContext& ctx, MessageEvent<RedisReply>& e)
 {
     RedisReply* msg = e.GetMessage();
-    if (Encode(ctx.GetChannel()->GetOutputBuffer(), *msg))
+    Channel* ch = ctx.GetChannel();
+    if (!ch->GetOutputBuffer().Readable() && ch->IsWriteReady() && has_zero_copy_bulk(*msg))
+    {
+        return WriteScattered(ch, *msg);
+    }
+    if (Encode(ch->GetOutputBuffer(), *msg))
     {
-        ctx.GetChannel()->EnableWriting();
+        ch->EnableWriting();
         return true;
     }
     return false;
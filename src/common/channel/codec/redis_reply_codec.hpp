@@ -32,6 +32,8 @@
 #include "channel/codec/stack_frame_decoder.hpp"
 #include <deque>
 #include <string>
+#include <vector>
+#include <sys/uio.h>
 #include "redis_reply.hpp"
 
 namespace ardb
@@ -60,13 +62,28 @@ namespace ardb
 				}
 		};
 
+		/*
+		 * Bulk string found while staging a reply, it is written from the reply itself
+		 * right after the first 'offset' staged bytes.
+		 */
+		struct RedisBulkSegment
+		{
+				size_t offset;
+				const std::string* str;
+		};
+		typedef std::vector<RedisBulkSegment> RedisBulkSegmentArray;
+
 		class RedisReplyEncoder: public ChannelDownstreamHandler<RedisReply>
 		{
 			private:
-		        //Buffer m_buffer;
+				Buffer m_staging;
+				RedisBulkSegmentArray m_segments;
+				std::vector<struct iovec> m_iov;
+				bool WriteScattered(Channel* ch, RedisReply& reply);
 				bool WriteRequested(ChannelHandlerContext& ctx, MessageEvent<RedisReply>& e);
 			public:
 				static bool Encode(Buffer& buf, RedisReply& reply);
+				static bool Encode(Buffer& buf, RedisReply& reply, RedisBulkSegmentArray* segments);
 		};
 
 		class NullRedisReplyEncoder: public ChannelDownstreamHandler<RedisReply>
@@ -28,6 +28,7 @@
  */
 #include "geohash_helper.hpp"
 #include <math.h>
+#include <algorithm>
 #include <assert.h>
 #include <set>
 #include <complex>
@@ -485,6 +486,48 @@ namespace ardb
         return 2.0 * EARTH_RADIUS_IN_METERS * asin(sqrt(u * u + cos(lat1r) * cos(lat2r) * v * v));
     }
 
+    uint8 GeoHashHelper::EstimateStepsByRadius(uint8 coord_type, double radius_meters, double latitude)
+    {
+        if (coord_type == GEO_WGS84_TYPE)
+        {
+            return estimate_geohash_steps_by_radius_lat(radius_meters, latitude);
+        }
+        return estimate_geohash_steps_by_radius(radius_meters);
+    }
+
+    /*
+     * Lower bound of the distance from (lon, lat) inside the box to any point outside of it.
+     * Latitude edges lying on the coordinate range limits are closed since nothing is beyond them,
+     * longitude edges always are open as longitudes wrap around.
+     */
+    double GeoHashHelper::GetWGS84DistanceOutsideBox(double lon, double lat, double min_lon, double max_lon, double min_lat,
+            double max_lat)
+    {
+        GeoHashRange lat_range, lon_range;
+        GetCoordRange(GEO_WGS84_TYPE, lat_range, lon_range);
+        double distance = HUGE_VAL;
+        if (max_lat < lat_range.max)
+        {
+            distance = std::min(distance, EARTH_RADIUS_IN_METERS * deg_rad(max_lat - lat));
+        }
+        if (min_lat > lat_range.min)
+        {
+            distance = std::min(distance, EARTH_RADIUS_IN_METERS * deg_rad(lat - min_lat));
+        }
+        if (min_lon > lon_range.min || max_lon < lon_range.max)
+        {
+            /* closest point of a meridian 'dlon' away is at asin(cos(lat) * sin(dlon)) */
+            double dlon = std::min(max_lon - lon, lon - min_lon);
+            if (dlon > 90)
+            {
+                dlon = 90;
+            }
+            double v = cos(deg_rad(lat)) * sin(deg_rad(dlon));
+            distance = std::min(distance, EARTH_RADIUS_IN_METERS * asin(v > 1 ? 1 : v));
+        }
+        return distance;
+    }
+
     bool GeoHashHelper::GetDistanceSquareIfInRadius(uint8 coord_type, double x1, double y1, double x2, double y2, double radius, double& distance,
             double accurace)
     {
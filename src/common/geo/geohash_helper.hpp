@@ -78,6 +78,9 @@ namespace ardb
             static bool GetMercatorXYByHash(GeoHashFix60Bits hash, double& x, double& y);
             static bool GetXYByHash(uint8 coord_type, uint8 step, uint64_t hash, double& x, double& y);
             static double GetWGS84Distance(double lon1d, double lat1d, double lon2d, double lat2d);
+            static uint8 EstimateStepsByRadius(uint8 coord_type, double radius_meters, double latitude);
+            static double GetWGS84DistanceOutsideBox(double lon, double lat, double min_lon, double max_lon, double min_lat,
+                    double max_lat);
     };
 }
 
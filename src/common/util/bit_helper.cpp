@@ -0,0 +1,499 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/bit_helper.hpp"
+#include <string.h>
+
+/*
+ * The simd kernels are compiled with per function target attributes and only called after the cpu has been
+ * checked, so the rest of the server keeps building for the baseline instruction set.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC__ >= 6)
+#define BIT_HELPER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace ardb
+{
+    struct BitKernelFuncs
+    {
+            int64 (*popcount)(const unsigned char* p, size_t count);
+            /* index of the first byte != skip, or count */
+            size_t (*skip)(const unsigned char* p, size_t count, unsigned char skip);
+            /* dst = dst op src, or dst = ~src for BITOP_NOT */
+            void (*combine)(int op, unsigned char* dst, const unsigned char* src, size_t count);
+    };
+
+    static const unsigned char kBitsInByte[256] =
+    { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3,
+            4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3,
+            4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3,
+            4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 2, 3, 3,
+            4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 4, 5, 5,
+            6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8 };
+
+    static inline uint64 load_word(const unsigned char* p)
+    {
+        uint64 w;
+        memcpy(&w, p, sizeof(w));
+        return w;
+    }
+
+    static inline void store_word(unsigned char* p, uint64 w)
+    {
+        memcpy(p, &w, sizeof(w));
+    }
+
+    static inline uint64 swar_popcount(uint64 x)
+    {
+        x = x - ((x >> 1) & 0x5555555555555555ULL);
+        x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+        x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        return (x * 0x0101010101010101ULL) >> 56;
+    }
+
+    static int64 popcount_portable(const unsigned char* p, size_t count)
+    {
+        int64 bits = 0;
+        while (count >= 32)
+        {
+            bits += swar_popcount(load_word(p)) + swar_popcount(load_word(p + 8)) + swar_popcount(load_word(p + 16))
+                    + swar_popcount(load_word(p + 24));
+            p += 32;
+            count -= 32;
+        }
+        while (count >= 8)
+        {
+            bits += swar_popcount(load_word(p));
+            p += 8;
+            count -= 8;
+        }
+        while (count--)
+        {
+            bits += kBitsInByte[*p++];
+        }
+        return bits;
+    }
+
+    static size_t skip_portable(const unsigned char* p, size_t count, unsigned char skip)
+    {
+        uint64 skipword = skip ? ~0ULL : 0;
+        size_t i = 0;
+        while (i + 8 <= count && load_word(p + i) == skipword)
+        {
+            i += 8;
+        }
+        while (i < count && p[i] == skip)
+        {
+            i++;
+        }
+        return i;
+    }
+
+    static void combine_portable(int op, unsigned char* dst, const unsigned char* src, size_t count)
+    {
+        size_t i = 0;
+        switch (op)
+        {
+            case BITOP_AND:
+                for (; i + 8 <= count; i += 8)
+                    store_word(dst + i, load_word(dst + i) & load_word(src + i));
+                for (; i < count; i++)
+                    dst[i] &= src[i];
+                break;
+            case BITOP_OR:
+                for (; i + 8 <= count; i += 8)
+                    store_word(dst + i, load_word(dst + i) | load_word(src + i));
+                for (; i < count; i++)
+                    dst[i] |= src[i];
+                break;
+            case BITOP_XOR:
+                for (; i + 8 <= count; i += 8)
+                    store_word(dst + i, load_word(dst + i) ^ load_word(src + i));
+                for (; i < count; i++)
+                    dst[i] ^= src[i];
+                break;
+            case BITOP_NOT:
+                for (; i + 8 <= count; i += 8)
+                    store_word(dst + i, ~load_word(src + i));
+                for (; i < count; i++)
+                    dst[i] = ~src[i];
+                break;
+        }
+    }
+
+#ifdef BIT_HELPER_X86
+    __attribute__((target("popcnt")))
+    static int64 popcount_popcnt(const unsigned char* p, size_t count)
+    {
+        uint64 c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+        while (count >= 32)
+        {
+            c0 += __builtin_popcountll(load_word(p));
+            c1 += __builtin_popcountll(load_word(p + 8));
+            c2 += __builtin_popcountll(load_word(p + 16));
+            c3 += __builtin_popcountll(load_word(p + 24));
+            p += 32;
+            count -= 32;
+        }
+        while (count >= 8)
+        {
+            c0 += __builtin_popcountll(load_word(p));
+            p += 8;
+            count -= 8;
+        }
+        while (count--)
+        {
+            c1 += kBitsInByte[*p++];
+        }
+        return c0 + c1 + c2 + c3;
+    }
+
+    /*
+     * Nibble lookup with pshufb, byte counts are summed into 64 bit lanes with psadbw every 8 vectors before
+     * they can overflow.
+     */
+    __attribute__((target("avx2,popcnt")))
+    static int64 popcount_avx2(const unsigned char* p, size_t count)
+    {
+        const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3,
+                3, 4);
+        const __m256i low = _mm256_set1_epi8(0x0f);
+        __m256i acc = _mm256_setzero_si256();
+        while (count >= 256)
+        {
+            __m256i local = _mm256_setzero_si256();
+            for (int i = 0; i < 8; i++)
+            {
+                __m256i v = _mm256_loadu_si256((const __m256i*) (p + i * 32));
+                __m256i lo = _mm256_and_si256(v, low);
+                __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+                local = _mm256_add_epi8(local, _mm256_shuffle_epi8(lookup, lo));
+                local = _mm256_add_epi8(local, _mm256_shuffle_epi8(lookup, hi));
+            }
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(local, _mm256_setzero_si256()));
+            p += 256;
+            count -= 256;
+        }
+        uint64 lanes[4];
+        _mm256_storeu_si256((__m256i*) lanes, acc);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + popcount_popcnt(p, count);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t skip_avx2(const unsigned char* p, size_t count, unsigned char skip)
+    {
+        const __m256i sv = _mm256_set1_epi8((char) skip);
+        size_t i = 0;
+        while (i + 32 <= count)
+        {
+            unsigned int eq = (unsigned int) _mm256_movemask_epi8(
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (p + i)), sv));
+            if (eq != 0xFFFFFFFFU)
+            {
+                return i + __builtin_ctz(~eq);
+            }
+            i += 32;
+        }
+        return i + skip_portable(p + i, count - i, skip);
+    }
+
+    __attribute__((target("avx2")))
+    static void combine_avx2(int op, unsigned char* dst, const unsigned char* src, size_t count)
+    {
+        size_t i = 0;
+        switch (op)
+        {
+            case BITOP_AND:
+                for (; i + 32 <= count; i += 32)
+                    _mm256_storeu_si256((__m256i*) (dst + i),
+                            _mm256_and_si256(_mm256_loadu_si256((const __m256i*) (dst + i)), _mm256_loadu_si256((const __m256i*) (src + i))));
+                break;
+            case BITOP_OR:
+                for (; i + 32 <= count; i += 32)
+                    _mm256_storeu_si256((__m256i*) (dst + i),
+                            _mm256_or_si256(_mm256_loadu_si256((const __m256i*) (dst + i)), _mm256_loadu_si256((const __m256i*) (src + i))));
+                break;
+            case BITOP_XOR:
+                for (; i + 32 <= count; i += 32)
+                    _mm256_storeu_si256((__m256i*) (dst + i),
+                            _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (dst + i)), _mm256_loadu_si256((const __m256i*) (src + i))));
+                break;
+            case BITOP_NOT:
+            {
+                const __m256i ones = _mm256_set1_epi8(-1);
+                for (; i + 32 <= count; i += 32)
+                    _mm256_storeu_si256((__m256i*) (dst + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (src + i)), ones));
+                break;
+            }
+        }
+        combine_portable(op, dst + i, src + i, count - i);
+    }
+
+    __attribute__((target("avx512f,avx512bw,avx2,popcnt")))
+    static int64 popcount_avx512(const unsigned char* p, size_t count)
+    {
+        /* nibble popcounts 0..15 as little endian dwords, repeated in every 128 bit lane */
+        const __m512i lookup = _mm512_set4_epi32(0x04030302, 0x03020201, 0x03020201, 0x02010100);
+        const __m512i low = _mm512_set1_epi8(0x0f);
+        __m512i acc = _mm512_setzero_si512();
+        while (count >= 512)
+        {
+            __m512i local = _mm512_setzero_si512();
+            for (int i = 0; i < 8; i++)
+            {
+                __m512i v = _mm512_loadu_si512((const void*) (p + i * 64));
+                __m512i lo = _mm512_and_si512(v, low);
+                __m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), low);
+                local = _mm512_add_epi8(local, _mm512_shuffle_epi8(lookup, lo));
+                local = _mm512_add_epi8(local, _mm512_shuffle_epi8(lookup, hi));
+            }
+            acc = _mm512_add_epi64(acc, _mm512_sad_epu8(local, _mm512_setzero_si512()));
+            p += 512;
+            count -= 512;
+        }
+        uint64 lanes[8];
+        _mm512_storeu_si512((void*) lanes, acc);
+        int64 bits = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            bits += lanes[i];
+        }
+        return bits + popcount_avx2(p, count);
+    }
+
+    __attribute__((target("avx512f,avx512bw,avx2")))
+    static size_t skip_avx512(const unsigned char* p, size_t count, unsigned char skip)
+    {
+        const __m512i sv = _mm512_set1_epi8((char) skip);
+        size_t i = 0;
+        while (i + 64 <= count)
+        {
+            __mmask64 ne = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512((const void*) (p + i)), sv);
+            if (ne != 0)
+            {
+                return i + __builtin_ctzll(ne);
+            }
+            i += 64;
+        }
+        return i + skip_avx2(p + i, count - i, skip);
+    }
+
+    __attribute__((target("avx512f,avx512bw,avx2")))
+    static void combine_avx512(int op, unsigned char* dst, const unsigned char* src, size_t count)
+    {
+        size_t i = 0;
+        switch (op)
+        {
+            case BITOP_AND:
+                for (; i + 64 <= count; i += 64)
+                    _mm512_storeu_si512((void*) (dst + i),
+                            _mm512_and_si512(_mm512_loadu_si512((const void*) (dst + i)), _mm512_loadu_si512((const void*) (src + i))));
+                break;
+            case BITOP_OR:
+                for (; i + 64 <= count; i += 64)
+                    _mm512_storeu_si512((void*) (dst + i),
+                            _mm512_or_si512(_mm512_loadu_si512((const void*) (dst + i)), _mm512_loadu_si512((const void*) (src + i))));
+                break;
+            case BITOP_XOR:
+                for (; i + 64 <= count; i += 64)
+                    _mm512_storeu_si512((void*) (dst + i),
+                            _mm512_xor_si512(_mm512_loadu_si512((const void*) (dst + i)), _mm512_loadu_si512((const void*) (src + i))));
+                break;
+            case BITOP_NOT:
+            {
+                const __m512i ones = _mm512_set1_epi8(-1);
+                for (; i + 64 <= count; i += 64)
+                    _mm512_storeu_si512((void*) (dst + i), _mm512_xor_si512(_mm512_loadu_si512((const void*) (src + i)), ones));
+                break;
+            }
+        }
+        combine_avx2(op, dst + i, src + i, count - i);
+    }
+#endif
+
+    static const BitKernelFuncs kBitKernels[BIT_KERNEL_MAX] =
+    {
+    { popcount_portable, skip_portable, combine_portable },
+#ifdef BIT_HELPER_X86
+            { popcount_popcnt, skip_portable, combine_portable },
+            { popcount_avx2, skip_avx2, combine_avx2 },
+            { popcount_avx512, skip_avx512, combine_avx512 },
+#else
+            { popcount_portable, skip_portable, combine_portable },
+            { popcount_portable, skip_portable, combine_portable },
+            { popcount_portable, skip_portable, combine_portable },
+#endif
+            };
+
+    static BitKernel detect_bit_kernel()
+    {
+        BitKernel best = BIT_KERNEL_PORTABLE;
+        for (int k = BIT_KERNEL_POPCNT; k < BIT_KERNEL_MAX; k++)
+        {
+            if (bits_kernel_supported((BitKernel) k))
+            {
+                best = (BitKernel) k;
+            }
+        }
+        return best;
+    }
+
+    static BitKernel g_bit_kernel = detect_bit_kernel();
+    static const BitKernelFuncs* g_bit_funcs = &kBitKernels[g_bit_kernel];
+
+    int64 bits_popcount(const void* s, size_t count)
+    {
+        return g_bit_funcs->popcount((const unsigned char*) s, count);
+    }
+
+    int64 bits_pos(const void* s, size_t count, int bit)
+    {
+        const unsigned char* p = (const unsigned char*) s;
+        size_t idx = g_bit_funcs->skip(p, count, bit ? 0 : 0xFF);
+        if (idx == count)
+        {
+            return bit ? -1 : (int64) count * 8;
+        }
+        unsigned char c = bit ? p[idx] : ~p[idx];
+        int64 pos = (int64) idx * 8;
+        while (!(c & 0x80))
+        {
+            c <<= 1;
+            pos++;
+        }
+        return pos;
+    }
+
+    /*
+     * The result is built block by block so it stays in cache while every source is folded into it.
+     */
+    void bits_op(int op, unsigned char* dst, size_t len, const unsigned char* const * srcs, const size_t* lens, size_t numsrc)
+    {
+        static const size_t kBlockSize = 16 * 1024;
+        const BitKernelFuncs* funcs = g_bit_funcs;
+        if (0 == numsrc)
+        {
+            memset(dst, 0, len);
+            return;
+        }
+        for (size_t off = 0; off < len; off += kBlockSize)
+        {
+            size_t n = len - off < kBlockSize ? len - off : kBlockSize;
+            unsigned char* out = dst + off;
+            for (size_t i = 0; i < numsrc; i++)
+            {
+                size_t avail = lens[i] > off ? lens[i] - off : 0;
+                if (avail > n)
+                {
+                    avail = n;
+                }
+                if (0 == i)
+                {
+                    if (op == BITOP_NOT)
+                    {
+                        if (avail > 0)
+                        {
+                            funcs->combine(BITOP_NOT, out, srcs[i] + off, avail);
+                        }
+                        memset(out + avail, 0xFF, n - avail);
+                        break;
+                    }
+                    if (avail > 0)
+                    {
+                        memcpy(out, srcs[i] + off, avail);
+                    }
+                    memset(out + avail, 0, n - avail);
+                    continue;
+                }
+                if (avail > 0)
+                {
+                    funcs->combine(op, out, srcs[i] + off, avail);
+                }
+                if (op == BITOP_AND && avail < n)
+                {
+                    memset(out + avail, 0, n - avail);
+                }
+            }
+        }
+    }
+
+    BitKernel bits_kernel()
+    {
+        return g_bit_kernel;
+    }
+
+    const char* bits_kernel_name(BitKernel kernel)
+    {
+        switch (kernel)
+        {
+            case BIT_KERNEL_PORTABLE:
+                return "portable";
+            case BIT_KERNEL_POPCNT:
+                return "popcnt";
+            case BIT_KERNEL_AVX2:
+                return "avx2";
+            case BIT_KERNEL_AVX512:
+                return "avx512";
+            default:
+                return "unknown";
+        }
+    }
+
+    bool bits_kernel_supported(BitKernel kernel)
+    {
+        switch (kernel)
+        {
+            case BIT_KERNEL_PORTABLE:
+                return true;
+#ifdef BIT_HELPER_X86
+            case BIT_KERNEL_POPCNT:
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("popcnt");
+            case BIT_KERNEL_AVX2:
+                return bits_kernel_supported(BIT_KERNEL_POPCNT) && __builtin_cpu_supports("avx2");
+            case BIT_KERNEL_AVX512:
+                return bits_kernel_supported(BIT_KERNEL_AVX2) && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+            default:
+                return false;
+        }
+    }
+
+    bool bits_select_kernel(BitKernel kernel)
+    {
+        if (kernel < BIT_KERNEL_PORTABLE || kernel >= BIT_KERNEL_MAX || !bits_kernel_supported(kernel))
+        {
+            return false;
+        }
+        g_bit_kernel = kernel;
+        g_bit_funcs = &kBitKernels[kernel];
+        return true;
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BIT_HELPER_HPP_
+#define BIT_HELPER_HPP_
+#include "common.hpp"
+#include <stddef.h>
+
+namespace ardb
+{
+    enum BitOperation
+    {
+        BITOP_AND = 0, BITOP_OR = 1, BITOP_XOR = 2, BITOP_NOT = 3
+    };
+
+    /*
+     * Bitmap kernels, from the slowest to the fastest. The best one the cpu supports is picked at startup.
+     */
+    enum BitKernel
+    {
+        BIT_KERNEL_PORTABLE = 0, BIT_KERNEL_POPCNT = 1, BIT_KERNEL_AVX2 = 2, BIT_KERNEL_AVX512 = 3, BIT_KERNEL_MAX = 4
+    };
+
+    /*
+     * Number of bits set in 'count' bytes at 's'.
+     */
+    int64 bits_popcount(const void* s, size_t count);
+
+    /*
+     * Position of the first bit set to 'bit' in 'count' bytes at 's', counting from the most significant bit of
+     * the first byte. If there is none, -1 is returned when looking for 1 and count * 8 when looking for 0, as
+     * the bitmap is considered zero padded on the right.
+     */
+    int64 bits_pos(const void* s, size_t count, int bit);
+
+    /*
+     * Writes 'len' bytes of 'srcs[0] op srcs[1] op ...' to 'dst', a source shorter than 'len' reads as zero
+     * padded. BITOP_NOT only uses srcs[0]. 'dst' may not overlap any source.
+     */
+    void bits_op(int op, unsigned char* dst, size_t len, const unsigned char* const * srcs, const size_t* lens, size_t numsrc);
+
+    /*
+     * Kernel in use, and a way to force another one for benchmarks. Selecting a kernel the cpu does not
+     * support returns false and keeps the current one.
+     */
+    BitKernel bits_kernel();
+    const char* bits_kernel_name(BitKernel kernel);
+    bool bits_kernel_supported(BitKernel kernel);
+    bool bits_select_kernel(BitKernel kernel);
+}
+#endif /* BIT_HELPER_HPP_ */
@@ -31,6 +31,7 @@
 #include "util/file_helper.hpp"
 #include "util/string_helper.hpp"
 #include "util/system_helper.hpp"
+#include "db/codec.hpp"
 #include <errno.h>
 
 #define ARDB_AUTHPASS_MAX_LEN 512
@@ -174,6 +175,14 @@ OP_NAMESPACE_BEGIN
             backup_redis_format = true;
         }
 
+        conf_get_string(props, "key-encoding", key_encoding);
+        uint8 key_format;
+        if (!parse_key_format(key_encoding, key_format))
+        {
+            ERROR_LOG("Invalid 'key-encoding' config:%s", key_encoding.c_str());
+            return false;
+        }
+
         conf_get_string(props, "zookeeper-servers", zookeeper_servers);
         conf_get_string(props, "zk-clientid-file", zk_clientid_file);
 
@@ -291,11 +300,87 @@ OP_NAMESPACE_BEGIN
 
         conf_get_bool(props, "redis-compatible-mode", redis_compatible);
         conf_get_bool(props, "compact-after-snapshot-load", compact_after_snapshot_load);
+        conf_get_int64(props, "snapshot-threads", snapshot_threads);
+        if (snapshot_threads <= 0)
+        {
+            snapshot_threads = 1;
+        }
 
         conf_get_int64(props, "qps-limit-per-host", qps_limit_per_host);
         conf_get_int64(props, "qps-limit-per-connection", qps_limit_per_connection);
         conf_get_int64(props, "range-delete-min-size", range_delete_min_size);
         conf_get_int64(props, "stream-lru-cache-size", stream_lru_cache_size);
+        conf_get_int64(props, "stream-block-entries", stream_block_entries);
+        if (stream_block_entries < 0)
+        {
+            stream_block_entries = 0;
+        }
+        conf_get_bool(props, "zset-rank-index", zset_rank_index);
+        conf_get_bool(props, "list-rank-index", list_rank_index);
+        conf_get_int64(props, "bitmap-segment-size", bitmap_segment_size);
+        if (bitmap_segment_size < 0)
+        {
+            bitmap_segment_size = 0;
+        }
+        conf_get_int64(props, "key-lock-stripes", key_lock_stripes);
+        if (key_lock_stripes <= 0)
+        {
+            key_lock_stripes = 1024;
+        }
+        conf_get_int64(props, "expire-cycle-time-limit", expire_cycle_time_limit);
+        conf_get_int64(props, "expire-cycle-max-time-limit", expire_cycle_max_time_limit);
+        conf_get_int64(props, "expire-batch-size", expire_batch_size);
+        conf_get_int64(props, "expire-async-delete-min-size", expire_async_delete_min_size);
+        if (expire_cycle_time_limit <= 0)
+        {
+            expire_cycle_time_limit = 25;
+        }
+        if (expire_cycle_max_time_limit < expire_cycle_time_limit)
+        {
+            expire_cycle_max_time_limit = expire_cycle_time_limit;
+        }
+        if (expire_batch_size <= 0)
+        {
+            expire_batch_size = 256;
+        }
+        conf_get_int64(props, "async-delete-threads", async_delete_threads);
+        conf_get_int64(props, "async-delete-batch-size", async_delete_batch_size);
+        if (async_delete_threads <= 0)
+        {
+            async_delete_threads = 1;
+        }
+        if (async_delete_batch_size <= 0)
+        {
+            async_delete_batch_size = 1000;
+        }
+        conf_get_int64(props, "scan-parallel-threads", scan_parallel_threads);
+        conf_get_int64(props, "scan-parallel-min-keys", scan_parallel_min_keys);
+        if (scan_parallel_threads < 0)
+        {
+            scan_parallel_threads = 0;
+        }
+        conf_get_int64(props, "meta-cache-size", meta_cache_size);
+        conf_get_int64(props, "meta-cache-shards", meta_cache_shards);
+        if (meta_cache_size < 0)
+        {
+            meta_cache_size = 0;
+        }
+        if (meta_cache_shards <= 0)
+        {
+            meta_cache_shards = 16;
+        }
+        conf_get_bool(props, "write-group-commit", write_group_commit);
+        conf_get_int64(props, "write-group-commit-max-delay", write_group_commit_max_delay);
+        conf_get_int64(props, "write-group-commit-max-batch", write_group_commit_max_batch);
+        conf_get_bool(props, "write-group-commit-sync", write_group_commit_sync);
+        if (write_group_commit_max_delay < 0)
+        {
+            write_group_commit_max_delay = 0;
+        }
+        if (write_group_commit_max_batch <= 0)
+        {
+            write_group_commit_max_batch = 64;
+        }
 
         conf_get_bool(props, "rocksdb.read_fill_cache", rocksdb_read_fill_cache);
         conf_get_bool(props, "rocksdb.iter_fill_cache", rocksdb_iter_fill_cache);
@@ -141,6 +141,7 @@ OP_NAMESPACE_BEGIN
 
             bool redis_compatible;
             bool compact_after_snapshot_load;
+            int64_t snapshot_threads;
 
             std::string masterauth;
 
@@ -154,6 +155,34 @@ OP_NAMESPACE_BEGIN
             int64_t range_delete_min_size;
 
             int64_t stream_lru_cache_size;
+            int64_t stream_block_entries;
+
+            bool zset_rank_index;
+            bool list_rank_index;
+            int64_t bitmap_segment_size;
+
+            int64_t key_lock_stripes;
+
+            int64_t expire_cycle_time_limit;
+            int64_t expire_cycle_max_time_limit;
+            int64_t expire_batch_size;
+            int64_t expire_async_delete_min_size;
+
+            int64_t async_delete_threads;
+            int64_t async_delete_batch_size;
+
+            int64_t scan_parallel_threads;
+            int64_t scan_parallel_min_keys;
+
+            int64_t meta_cache_size;
+            int64_t meta_cache_shards;
+
+            bool write_group_commit;
+            int64_t write_group_commit_max_delay;
+            int64_t write_group_commit_max_batch;
+            bool write_group_commit_sync;
+
+            std::string key_encoding;
 
             std::string _conf_file;
             std::string _executable;
@@ -175,9 +204,9 @@ OP_NAMESPACE_BEGIN
                             256 * 1024 * 1024), pubsub_client_output_buffer_limit(32 * 1024 * 1024), slave_ignore_expire(
                             false), slave_ignore_del(false), repl_disable_tcp_nodelay(true), scan_redis_compatible(
                             true), scan_cursor_expire_after(60), snapshot_max_lag_offset(500 * 1024 * 1024), maxsnapshots(
-                            10), redis_compatible(false), compact_after_snapshot_load(false), redis_compatible_version(
+                            10), redis_compatible(false), compact_after_snapshot_load(false), snapshot_threads(4), redis_compatible_version(
                             "2.8.0"), statistics_log_period(300), qps_limit_per_host(0), qps_limit_per_connection(0), range_delete_min_size(
-                            100), stream_lru_cache_size(1024),rocksdb_read_fill_cache(true),rocksdb_iter_fill_cache(true)
+                            100), stream_lru_cache_size(1024),stream_block_entries(0),zset_rank_index(false),list_rank_index(false),bitmap_segment_size(0),key_lock_stripes(1024),expire_cycle_time_limit(25),expire_cycle_max_time_limit(250),expire_batch_size(256),expire_async_delete_min_size(10000),async_delete_threads(2),async_delete_batch_size(1000),scan_parallel_threads(4),scan_parallel_min_keys(100000),meta_cache_size(100000),meta_cache_shards(16),write_group_commit(false),write_group_commit_max_delay(100),write_group_commit_max_batch(64),write_group_commit_sync(false),key_encoding("legacy"),rocksdb_read_fill_cache(true),rocksdb_iter_fill_cache(true)
             {
             }
             bool Parse(const Properties& props);
@@ -84,6 +84,15 @@ OP_NAMESPACE_BEGIN
                 }
                 return key < other.key;
             }
+            bool operator==(const KeyPrefix& other) const
+            {
+                return ns.Compare(other.ns) == 0 && key.Compare(other.key) == 0;
+            }
+            size_t Hash() const
+            {
+                DataHash hash;
+                return hash(ns) * 31 + hash(key);
+            }
             void Clear()
             {
                 ns.Clear();
@@ -148,6 +157,19 @@ OP_NAMESPACE_BEGIN
             {
             }
     };
+    /*
+     * Replication commands of a write batch held back until the batch is committed.
+     */
+    struct StagedReplication
+    {
+            DataArray ns;
+            RedisCommandFrameArray cmds;
+            void Clear()
+            {
+                ns.clear();
+                cmds.clear();
+            }
+    };
     struct PubSubContext
     {
             StringTreeSet pubsub_channels;
@@ -235,14 +257,18 @@ OP_NAMESPACE_BEGIN
             CallFlags flags;
             bool authenticated;
             bool keyslocked;
+            bool repl_ordered; //reserve replication sequence when key locks released
+            KeyPrefixSet* transc_keys; //keys locked by EXEC for the whole transaction, key lock guards skip them
+            StagedReplication* repl_staged; //replication commands held back until the write batch is committed
 
             const void* engine_snapshot;
             void* cmd_proxy;
+            void* prefetched_metas; //filled by Ardb::PrefetchMetas for a run of pipelined reads
             ContextFunctorArray post_cmd_func;
             Context()
                     : reply(NULL), client(NULL), transc(NULL), pubsub(
                     NULL), bpop(NULL), current_cmd(NULL), dirty(0), last_cmdtype(REDIS_CMD_INVALID), transc_err(0), authenticated(
-                            true), keyslocked(false), engine_snapshot(NULL), cmd_proxy(NULL)
+                            true), keyslocked(false), repl_ordered(false), transc_keys(NULL), repl_staged(NULL), engine_snapshot(NULL), cmd_proxy(NULL), prefetched_metas(NULL)
             {
                 ns.SetString("0", false);
             }
@@ -35,9 +35,315 @@
 #include <float.h>
 
 static const uint8 kCurrentMetaFormat = 0;
+/*
+ * zset/list meta with this format or later carries an extra rank index flag byte
+ */
+static const uint8 kRankIndexMetaFormat = 1;
+/*
+ * zset/list meta with this format or later carries the collection version & data key after the rank index flag
+ */
+static const uint8 kVersionMetaFormat = 2;
+/*
+ * stream meta with this format or later carries the block size & tail block id after the last id
+ */
+static const uint8 kStreamBlockMetaFormat = 3;
+/*
+ * element keys of a versioned collection start with this byte instead of the element count,
+ * followed by the 8 bytes big endian version and then the element count.
+ */
+static const uint8 kKeyVersionMarker = 0x80;
 
 OP_NAMESPACE_BEGIN
 
+    uint8 g_key_format = KEY_FORMAT_LEGACY;
+
+    bool parse_key_format(const std::string& name, uint8& format)
+    {
+        if (!strcasecmp(name.c_str(), "legacy"))
+        {
+            format = KEY_FORMAT_LEGACY;
+            return true;
+        }
+        if (!strcasecmp(name.c_str(), "memcomparable"))
+        {
+            format = KEY_FORMAT_MEMCOMPARABLE;
+            return true;
+        }
+        return false;
+    }
+
+    const char* key_format_name(uint8 format)
+    {
+        return KEY_FORMAT_MEMCOMPARABLE == format ? "memcomparable" : "legacy";
+    }
+
+    /*
+     * Memcomparable key layout:
+     *   [namespace element] key-string type(1byte) element-count(1byte) [element]...
+     * A string is written with 0x00 escaped as 0x00 0xFF and terminated by 0x00 0x01, so a string
+     * orders before every longer string it prefixes.
+     * An element starts with a tag ordering nil < number < string like Data::Compare in non alpha mode.
+     * Numbers are written as an order preserving big endian double plus a subtype byte, integers append
+     * their order preserving int64, so integers above 2^53 keep their exact order.
+     */
+    static const uint8 kMCTagNil = 0x01;
+    static const uint8 kMCTagNumber = 0x02;
+    static const uint8 kMCTagString = 0x03;
+    static const uint8 kMCFloat = 0x00;
+    static const uint8 kMCInt = 0x01;
+    static const uint64 kMCSignBit = 0x8000000000000000ULL;
+
+    static void mc_encode_string(Buffer& buffer, const char* str, size_t len)
+    {
+        const char* end = str + len;
+        while (str < end)
+        {
+            const char* zero = (const char*) memchr(str, 0, end - str);
+            if (NULL == zero)
+            {
+                buffer.Write(str, end - str);
+                break;
+            }
+            buffer.Write(str, zero - str);
+            buffer.WriteByte((char) 0x00);
+            buffer.WriteByte((char) 0xFF);
+            str = zero + 1;
+        }
+        buffer.WriteByte((char) 0x00);
+        buffer.WriteByte((char) 0x01);
+    }
+
+    static bool mc_decode_string(Buffer& buffer, Data& data, bool clone_str)
+    {
+        const char* start = buffer.GetRawReadBuffer();
+        const char* end = start + buffer.ReadableBytes();
+        const char* p = start;
+        bool escaped = false;
+        while (true)
+        {
+            const char* zero = (const char*) memchr(p, 0, end - p);
+            if (NULL == zero || zero + 1 >= end)
+            {
+                return false;
+            }
+            if ((uint8) zero[1] == 0x01)
+            {
+                p = zero;
+                break;
+            }
+            if ((uint8) zero[1] != 0xFF)
+            {
+                return false;
+            }
+            escaped = true;
+            p = zero + 2;
+        }
+        size_t raw_len = p - start;
+        if (!escaped)
+        {
+            data.SetString(start, raw_len, clone_str);
+        }
+        else
+        {
+            /*
+             * escaped strings could not be referenced in place
+             */
+            std::string str;
+            str.reserve(raw_len);
+            for (const char* c = start; c < p; c++)
+            {
+                str.push_back(*c);
+                if (0 == *c)
+                {
+                    c++;
+                }
+            }
+            data.SetString(str.data(), str.size(), true);
+        }
+        buffer.AdvanceReadIndex(raw_len + 2);
+        return true;
+    }
+
+    static void mc_write_uint64(Buffer& buffer, uint64 v)
+    {
+        char bytes[8];
+        for (int i = 0; i < 8; i++)
+        {
+            bytes[i] = (char) (v >> (56 - 8 * i));
+        }
+        buffer.Write(bytes, 8);
+    }
+
+    static bool mc_read_uint64(Buffer& buffer, uint64& v)
+    {
+        if (buffer.ReadableBytes() < 8)
+        {
+            return false;
+        }
+        const unsigned char* bytes = (const unsigned char*) buffer.GetRawReadBuffer();
+        v = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            v = (v << 8) | bytes[i];
+        }
+        buffer.AdvanceReadIndex(8);
+        return true;
+    }
+
+    static void mc_encode_element(Buffer& buffer, const Data& data)
+    {
+        if (data.IsNil())
+        {
+            buffer.WriteByte((char) kMCTagNil);
+            return;
+        }
+        if (data.IsNumber())
+        {
+            double d = data.GetFloat64();
+            if (d == 0)
+            {
+                d = 0; /* -0.0 equals 0.0 */
+            }
+            uint64 bits;
+            memcpy(&bits, &d, sizeof(bits));
+            bits = (bits & kMCSignBit) ? ~bits : (bits | kMCSignBit);
+            buffer.WriteByte((char) kMCTagNumber);
+            mc_write_uint64(buffer, bits);
+            if (data.IsInteger())
+            {
+                buffer.WriteByte((char) kMCInt);
+                mc_write_uint64(buffer, ((uint64) data.GetInt64()) ^ kMCSignBit);
+            }
+            else
+            {
+                buffer.WriteByte((char) kMCFloat);
+            }
+            return;
+        }
+        buffer.WriteByte((char) kMCTagString);
+        mc_encode_string(buffer, data.CStr(), data.StringLength());
+    }
+
+    static bool mc_decode_element(Buffer& buffer, Data& data, bool clone_str)
+    {
+        char tag;
+        if (!buffer.ReadByte(tag))
+        {
+            return false;
+        }
+        data.Clear();
+        switch ((uint8) tag)
+        {
+            case kMCTagNil:
+            {
+                return true;
+            }
+            case kMCTagNumber:
+            {
+                uint64 bits;
+                char subtype;
+                if (!mc_read_uint64(buffer, bits) || !buffer.ReadByte(subtype))
+                {
+                    return false;
+                }
+                if ((uint8) subtype == kMCInt)
+                {
+                    uint64 v;
+                    if (!mc_read_uint64(buffer, v))
+                    {
+                        return false;
+                    }
+                    data.SetInt64((int64) (v ^ kMCSignBit));
+                    return true;
+                }
+                bits = (bits & kMCSignBit) ? (bits & ~kMCSignBit) : ~bits;
+                double d;
+                memcpy(&d, &bits, sizeof(d));
+                data.SetFloat64(d);
+                return true;
+            }
+            case kMCTagString:
+            {
+                return mc_decode_string(buffer, data, clone_str);
+            }
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
+    static void encode_key_element(Buffer& buffer, const Data& data, uint8 format)
+    {
+        if (KEY_FORMAT_MEMCOMPARABLE == format)
+        {
+            mc_encode_element(buffer, data);
+        }
+        else
+        {
+            data.Encode(buffer);
+        }
+    }
+
+    static bool decode_key_element(Buffer& buffer, Data& data, bool clone_str, uint8 format)
+    {
+        if (KEY_FORMAT_MEMCOMPARABLE == format)
+        {
+            return mc_decode_element(buffer, data, clone_str);
+        }
+        return data.Decode(buffer, clone_str);
+    }
+
+    static void encode_key_string(Buffer& buffer, const Data& key, uint8 format)
+    {
+        if (KEY_FORMAT_MEMCOMPARABLE == format)
+        {
+            mc_encode_string(buffer, key.CStr(), key.StringLength());
+        }
+        else
+        {
+            BufferHelper::WriteVarUInt32(buffer, key.StringLength());
+            buffer.Write(key.CStr(), key.StringLength());
+        }
+    }
+
+    static bool decode_key_string(Buffer& buffer, Data& key, bool clone_str, uint8 format)
+    {
+        if (KEY_FORMAT_MEMCOMPARABLE == format)
+        {
+            if (!mc_decode_string(buffer, key, clone_str))
+            {
+                ERROR_LOG("Invalid memcomparable key content.");
+                return false;
+            }
+            return true;
+        }
+        uint32 keylen;
+        if (!BufferHelper::ReadVarUInt32(buffer, keylen))
+        {
+            ERROR_LOG("Read length header failed.");
+            return false;
+        }
+        if (buffer.ReadableBytes() < (keylen))
+        {
+            ERROR_LOG("No space for key content with size:%u", keylen);
+            return false;
+        }
+        key.SetString(buffer.GetRawReadBuffer(), keylen, clone_str);
+        buffer.AdvanceReadIndex(keylen);
+        return true;
+    }
+
+    void encode_key_namespace(Buffer& buffer, const Data& ns)
+    {
+        encode_key_element(buffer, ns, g_key_format);
+    }
+
+    bool decode_key_namespace(Buffer& buffer, Data& ns, bool clone_str)
+    {
+        return decode_key_element(buffer, ns, clone_str, g_key_format);
+    }
+
     void KeyObject::SetType(uint8 t)
     {
         type = t;
@@ -48,12 +354,16 @@ OP_NAMESPACE_BEGIN
             case KEY_ZSET_SCORE:
             case KEY_HASH_FIELD:
             case KEY_STREAM_ELEMENT:
+            case KEY_STREAM_BLOCK:
+            case KEY_BITMAP_SEGMENT:
             {
                 elements.resize(1);
                 break;
             }
             case KEY_STREAM_PEL:
             case KEY_ZSET_SORT:
+            case KEY_ZSET_RANK:
+            case KEY_LIST_RANK:
             {
                 elements.resize(2);
                 break;
@@ -66,6 +376,14 @@ OP_NAMESPACE_BEGIN
                 elements.resize(3);
                 break;
             }
+            case KEY_STALE_VERSION:
+            {
+                /*
+                 * 0:namespace 1:data key 2:version
+                 */
+                elements.resize(3);
+                break;
+            }
 
             default:
             {
@@ -76,7 +394,7 @@ OP_NAMESPACE_BEGIN
 
     bool KeyObject::DecodeNS(Buffer& buffer, bool clone_str)
     {
-        return ns.Decode(buffer, clone_str);
+        return decode_key_element(buffer, ns, clone_str, g_key_format);
     }
 
     int KeyObject::ComparePrefix(const KeyObject& other) const
@@ -106,6 +424,10 @@ OP_NAMESPACE_BEGIN
         {
             return ret;
         }
+        if (version != other.version)
+        {
+            return version < other.version ? -1 : 1;
+        }
         ret = elements.size() - other.elements.size();
         if (ret != 0)
         {
@@ -124,20 +446,7 @@ OP_NAMESPACE_BEGIN
 
     bool KeyObject::DecodeKey(Buffer& buffer, bool clone_str)
     {
-        uint32 keylen;
-        if (!BufferHelper::ReadVarUInt32(buffer, keylen))
-        {
-            ERROR_LOG("Read length header failed.");
-            return false;
-        }
-        if (buffer.ReadableBytes() < (keylen))
-        {
-            ERROR_LOG("No space for key content with size:%u", keylen);
-            return false;
-        }
-        key.SetString(buffer.GetRawReadBuffer(), keylen, clone_str);
-        buffer.AdvanceReadIndex(keylen);
-        return true;
+        return decode_key_string(buffer, key, clone_str, g_key_format);
     }
 
     bool KeyObject::DecodeType(Buffer& buffer)
@@ -167,6 +476,13 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
+        if ((uint8) len == kKeyVersionMarker)
+        {
+            if (!BufferHelper::ReadFixUInt64(buffer, version) || !buffer.ReadByte(len))
+            {
+                return -1;
+            }
+        }
         if (len < 0 || len > 127)
         {
             return -1;
@@ -183,32 +499,36 @@ OP_NAMESPACE_BEGIN
         {
             elements.resize(idx + 1);
         }
-        return elements[idx].Decode(buffer, clone_str);
+        return decode_key_element(buffer, elements[idx], clone_str, g_key_format);
     }
     bool KeyObject::Decode(Buffer& buffer, bool clone_str, bool with_ns)
+    {
+        return Decode(buffer, clone_str, with_ns, g_key_format);
+    }
+    bool KeyObject::Decode(Buffer& buffer, bool clone_str, bool with_ns, uint8 format)
     {
         Clear();
         if (with_ns)
         {
-            if (!ns.Decode(buffer, clone_str))
+            if (!decode_key_element(buffer, ns, clone_str, format))
             {
                 return false;
             }
         }
-        if (!DecodePrefix(buffer, clone_str))
+        if (!decode_key_string(buffer, key, clone_str, format))
+        {
+            return false;
+        }
+        if (!DecodeType(buffer))
         {
             return false;
         }
-//        if (!DecodeKey(buffer, clone_str))
-//        {
-//            return false;
-//        }
         int elen1 = DecodeElementLength(buffer);
         if (elen1 > 0)
         {
             for (int i = 0; i < elen1; i++)
             {
-                if (!DecodeElement(buffer, clone_str, i))
+                if (!decode_key_element(buffer, elements[i], clone_str, format))
                 {
                     return false;
                 }
@@ -219,11 +539,14 @@ OP_NAMESPACE_BEGIN
 
     void KeyObject::EncodePrefix(Buffer& buffer) const
     {
-        BufferHelper::WriteVarUInt32(buffer, key.StringLength());
-        buffer.Write(key.CStr(), key.StringLength());
+        encode_key_string(buffer, key, g_key_format);
         buffer.WriteByte((char) type);
     }
     Slice KeyObject::Encode(Buffer& buffer, bool verify, bool with_ns) const
+    {
+        return Encode(buffer, verify, with_ns, g_key_format);
+    }
+    Slice KeyObject::Encode(Buffer& buffer, bool verify, bool with_ns, uint8 format) const
     {
         if (verify && !IsValid())
         {
@@ -233,13 +556,19 @@ OP_NAMESPACE_BEGIN
         size_t mark = buffer.GetWriteIndex();
         if (with_ns)
         {
-            ns.Encode(buffer);
+            encode_key_element(buffer, ns, format);
+        }
+        encode_key_string(buffer, key, format);
+        buffer.WriteByte((char) type);
+        if (version > 0 && type != KEY_META)
+        {
+            buffer.WriteByte((char) kKeyVersionMarker);
+            BufferHelper::WriteFixUInt64(buffer, version);
         }
-        EncodePrefix(buffer);
         buffer.WriteByte((char) elements.size());
         for (size_t i = 0; i < elements.size(); i++)
         {
-            elements[i].Encode(buffer);
+            encode_key_element(buffer, elements[i], format);
         }
         return Slice(buffer.GetRawBuffer() + mark, buffer.GetWriteIndex() - mark);
     }
@@ -280,6 +609,12 @@ OP_NAMESPACE_BEGIN
             case KEY_STREAM:
             case KEY_STREAM_ELEMENT:
             case KEY_STREAM_PEL:
+            case KEY_ZSET_RANK:
+            case KEY_LIST_RANK:
+            case KEY_BITMAP:
+            case KEY_BITMAP_SEGMENT:
+            case KEY_STREAM_BLOCK:
+            case KEY_STALE_VERSION:
             {
                 return true;
             }
@@ -309,9 +644,19 @@ OP_NAMESPACE_BEGIN
         id.Decode(GetElement(1));
         return id;
     }
+    void KeyObject::BindCollection(ValueObject& meta)
+    {
+        MetaObject& m = meta.GetMetaObject();
+        if (!m.data_key.empty())
+        {
+            key.SetString(m.data_key, true);
+        }
+        version = m.version;
+    }
 
     MetaObject::MetaObject()
-            : format(kCurrentMetaFormat), ttl(0), size(-1), list_sequential(true)
+            : format(kCurrentMetaFormat), ttl(0), size(-1), list_sequential(true), zset_rank_index(false), list_rank_index(
+                    false), version(0), bitmap_len(0), bitmap_count(0), bitmap_segment(0), stream_block(0), stream_tail_count(0)
     {
 
     }
@@ -321,10 +666,35 @@ OP_NAMESPACE_BEGIN
         ttl = 0;
         size = -1;
         list_sequential = true;
+        zset_rank_index = false;
+        list_rank_index = false;
+        version = 0;
+        data_key.clear();
+        bitmap_len = 0;
+        bitmap_count = 0;
+        bitmap_segment = 0;
+        stream_last_id = StreamID();
+        stream_block = 0;
+        stream_tail = StreamID();
+        stream_tail_count = 0;
     }
     void MetaObject::Encode(Buffer& buffer, uint8 type) const
     {
-        buffer.WriteByte((char) format);
+        uint8 fmt = format;
+        if (((type == KEY_ZSET && zset_rank_index) || (type == KEY_LIST && list_rank_index))
+                && fmt < kRankIndexMetaFormat)
+        {
+            fmt = kRankIndexMetaFormat;
+        }
+        if ((type == KEY_ZSET || type == KEY_LIST) && version > 0 && fmt < kVersionMetaFormat)
+        {
+            fmt = kVersionMetaFormat;
+        }
+        if (type == KEY_STREAM && stream_block > 0 && fmt < kStreamBlockMetaFormat)
+        {
+            fmt = kStreamBlockMetaFormat;
+        }
+        buffer.WriteByte((char) fmt);
         BufferHelper::WriteVarInt64(buffer, ttl);
         switch (type)
         {
@@ -338,6 +708,7 @@ OP_NAMESPACE_BEGIN
             case KEY_ZSET:
             case KEY_HASH:
             case KEY_STREAM:
+            case KEY_BITMAP:
             {
                 BufferHelper::WriteVarInt64(buffer, size);
                 break;
@@ -352,6 +723,44 @@ OP_NAMESPACE_BEGIN
             case KEY_LIST:
             {
                 buffer.WriteByte(list_sequential ? 1 : 0);
+                if (fmt >= kRankIndexMetaFormat)
+                {
+                    buffer.WriteByte(list_rank_index ? 1 : 0);
+                }
+                break;
+            }
+            case KEY_ZSET:
+            {
+                if (fmt >= kRankIndexMetaFormat)
+                {
+                    buffer.WriteByte(zset_rank_index ? 1 : 0);
+                }
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+        switch (type)
+        {
+            case KEY_LIST:
+            case KEY_ZSET:
+            {
+                if (fmt >= kVersionMetaFormat)
+                {
+                    BufferHelper::WriteVarUInt64(buffer, version);
+                    BufferHelper::WriteVarString(buffer, data_key);
+                }
+                break;
+            }
+            case KEY_BITMAP:
+            {
+                BufferHelper::WriteVarUInt64(buffer, version);
+                BufferHelper::WriteVarString(buffer, data_key);
+                BufferHelper::WriteVarInt64(buffer, bitmap_len);
+                BufferHelper::WriteVarInt64(buffer, bitmap_count);
+                BufferHelper::WriteVarInt64(buffer, bitmap_segment);
                 break;
             }
             case KEY_STREAM:
@@ -359,6 +768,14 @@ OP_NAMESPACE_BEGIN
                 Data data1;
                 stream_last_id.Encode(data1);
                 data1.Encode(buffer);
+                if (fmt >= kStreamBlockMetaFormat)
+                {
+                    BufferHelper::WriteVarInt64(buffer, stream_block);
+                    Data data2;
+                    stream_tail.Encode(data2);
+                    data2.Encode(buffer);
+                    BufferHelper::WriteVarInt64(buffer, stream_tail_count);
+                }
                 break;
             }
             default:
@@ -391,6 +808,7 @@ OP_NAMESPACE_BEGIN
             case KEY_ZSET:
             case KEY_HASH:
             case KEY_STREAM:
+            case KEY_BITMAP:
             {
                 if (!BufferHelper::ReadVarInt64(buffer, size))
                 {
@@ -412,6 +830,55 @@ OP_NAMESPACE_BEGIN
                     return false;
                 }
                 list_sequential = (bool) tmp;
+                if (format >= kRankIndexMetaFormat)
+                {
+                    if (!buffer.ReadByte(tmp))
+                    {
+                        return false;
+                    }
+                    list_rank_index = (bool) tmp;
+                }
+                break;
+            }
+            case KEY_ZSET:
+            {
+                if (format >= kRankIndexMetaFormat)
+                {
+                    if (!buffer.ReadByte(tmp))
+                    {
+                        return false;
+                    }
+                    zset_rank_index = (bool) tmp;
+                }
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+        switch (type)
+        {
+            case KEY_LIST:
+            case KEY_ZSET:
+            {
+                if (format >= kVersionMetaFormat)
+                {
+                    if (!BufferHelper::ReadVarUInt64(buffer, version) || !BufferHelper::ReadVarString(buffer, data_key))
+                    {
+                        return false;
+                    }
+                }
+                break;
+            }
+            case KEY_BITMAP:
+            {
+                if (!BufferHelper::ReadVarUInt64(buffer, version) || !BufferHelper::ReadVarString(buffer, data_key)
+                        || !BufferHelper::ReadVarInt64(buffer, bitmap_len) || !BufferHelper::ReadVarInt64(buffer, bitmap_count)
+                        || !BufferHelper::ReadVarInt64(buffer, bitmap_segment))
+                {
+                    return false;
+                }
                 break;
             }
             case KEY_STREAM:
@@ -422,6 +889,16 @@ OP_NAMESPACE_BEGIN
                     return false;
                 }
                 stream_last_id.Decode(data1);
+                if (format >= kStreamBlockMetaFormat)
+                {
+                    Data data2;
+                    if (!BufferHelper::ReadVarInt64(buffer, stream_block) || !data2.Decode(buffer, false)
+                            || !BufferHelper::ReadVarInt64(buffer, stream_tail_count))
+                    {
+                        return false;
+                    }
+                    stream_tail.Decode(data2);
+                }
                 break;
             }
             default:
@@ -518,6 +995,7 @@ OP_NAMESPACE_BEGIN
             case KEY_ZSET:
             case KEY_HASH:
             case KEY_STREAM:
+            case KEY_BITMAP:
             {
                 meta->Encode(encode_buffer, type);
                 break;
@@ -579,6 +1057,7 @@ OP_NAMESPACE_BEGIN
             case KEY_ZSET:
             case KEY_HASH:
             case KEY_STREAM:
+            case KEY_BITMAP:
             {
                 if (!meta.Decode(buffer, type))
                 {
@@ -770,6 +1249,95 @@ OP_NAMESPACE_BEGIN
         }
     }
 
+    void stream_block_append(ValueObject& block, const StreamID& block_id, const StreamID& id, ValueObject& ele)
+    {
+        StreamID prev = block_id;
+        if (block.GetType() == 0)
+        {
+            block.SetType(KEY_STREAM_BLOCK);
+            block.SetStreamBlockCount(0);
+        }
+        else
+        {
+            prev.Decode(block.GetStreamBlockLastId());
+        }
+        Buffer buffer;
+        uint64 ms_delta = id.ms - prev.ms;
+        BufferHelper::WriteVarUInt64(buffer, ms_delta);
+        BufferHelper::WriteVarUInt64(buffer, 0 == ms_delta ? id.seq - prev.seq : id.seq);
+        int64_t fieldlen = ele.GetStreamFieldLength();
+        bool with_names = ele.ElementSize() != (size_t) fieldlen + 1;
+        BufferHelper::WriteVarUInt64(buffer, ((uint64) fieldlen << 1) | (with_names ? 1 : 0));
+        std::string str;
+        for (int64_t i = 0; i < fieldlen; i++)
+        {
+            if (with_names)
+            {
+                BufferHelper::WriteVarString(buffer, ele.GetStreamFieldName(i).ToString(str));
+            }
+            BufferHelper::WriteVarString(buffer, ele.GetStreamFieldValue(i).ToString(str));
+        }
+        /* only the new entry is encoded, the packed entries grow in place */
+        Data& entries = block.GetStreamBlockEntries();
+        size_t offset = entries.StringLength();
+        char* dst = (char*) entries.ReserveStringSpace(offset + buffer.ReadableBytes());
+        memcpy(dst + offset, buffer.GetRawReadBuffer(), buffer.ReadableBytes());
+        id.Encode(block.GetStreamBlockLastId());
+        block.SetStreamBlockCount(block.GetStreamBlockCount() + 1);
+    }
+
+    bool stream_block_decode(ValueObject& block, const StreamID& block_id, StreamIDArray& ids, ValueObjectArray& eles)
+    {
+        int64 count = block.GetStreamBlockCount();
+        Data& entries = block.GetStreamBlockEntries();
+        ids.resize(count);
+        eles.resize(count);
+        if (count == 0)
+        {
+            return true;
+        }
+        Buffer buffer((char*) entries.CStr(), 0, entries.StringLength());
+        StreamID prev = block_id;
+        std::string str;
+        for (int64 i = 0; i < count; i++)
+        {
+            uint64 ms_delta, seq, header;
+            if (!BufferHelper::ReadVarUInt64(buffer, ms_delta) || !BufferHelper::ReadVarUInt64(buffer, seq)
+                    || !BufferHelper::ReadVarUInt64(buffer, header))
+            {
+                return false;
+            }
+            StreamID& id = ids[i];
+            id.ms = prev.ms + ms_delta;
+            id.seq = 0 == ms_delta ? prev.seq + seq : seq;
+            prev = id;
+            ValueObject& ele = eles[i];
+            ele.Clear();
+            ele.SetType(KEY_STREAM_ELEMENT);
+            int64_t fieldlen = (int64_t) (header >> 1);
+            ele.SetStreamFieldLength(fieldlen);
+            for (int64_t j = 0; j < fieldlen; j++)
+            {
+                if (header & 1)
+                {
+                    str.clear();
+                    if (!BufferHelper::ReadVarString(buffer, str))
+                    {
+                        return false;
+                    }
+                    ele.GetStreamFieldName(j).SetString(str, false);
+                }
+                str.clear();
+                if (!BufferHelper::ReadVarString(buffer, str))
+                {
+                    return false;
+                }
+                ele.GetStreamFieldValue(j).SetString(str, true);
+            }
+        }
+        return true;
+    }
+
     uint32_t StreamGroupTable::IncRef()
     {
         return atomic_add_uint32(&ref, 1);
@@ -60,12 +60,37 @@ OP_NAMESPACE_BEGIN
 
         KEY_STREAM = 12, KEY_STREAM_ELEMENT = 13, KEY_STREAM_PEL = 14,
 
+        KEY_ZSET_RANK = 15, KEY_LIST_RANK = 16,
+
+        KEY_BITMAP = 17, KEY_BITMAP_SEGMENT = 18,
+
+        KEY_STREAM_BLOCK = 19,
+
         /*
          * Reserver 20 types
          */
-        KEY_TTL_SORT = 29, KEY_MERGE = 30, KEY_END = 31, /* max value for 1byte */
+        KEY_STALE_VERSION = 28, KEY_TTL_SORT = 29, KEY_MERGE = 30, KEY_END = 31, /* max value for 1byte */
+    };
+
+    /*
+     * On-disk key formats, a data directory keeps the format it was created with.
+     * Keys in KEY_FORMAT_MEMCOMPARABLE order bytewise exactly like compare_keys orders legacy keys,
+     * so engines could use their native comparators.
+     */
+    enum KeyFormat
+    {
+        KEY_FORMAT_LEGACY = 0, KEY_FORMAT_MEMCOMPARABLE = 1,
     };
+    extern uint8 g_key_format;
+    bool parse_key_format(const std::string& name, uint8& format);
+    const char* key_format_name(uint8 format);
+    /*
+     * namespace header of engines storing all namespaces in one keyspace
+     */
+    void encode_key_namespace(Buffer& buffer, const Data& ns);
+    bool decode_key_namespace(Buffer& buffer, Data& ns, bool clone_str);
 
+    class ValueObject;
     struct KeyObject
     {
         private:
@@ -73,6 +98,7 @@ OP_NAMESPACE_BEGIN
             uint8 type;
             Data key;
             DataArray elements;
+            uint64 version; //version of the collection an element key belongs to, 0 for unversioned collections
 
             Data& getElement(uint32_t idx)
             {
@@ -88,18 +114,18 @@ OP_NAMESPACE_BEGIN
             }
         public:
             KeyObject(uint8 t = 0)
-                    : type(t)
+                    : type(t), version(0)
             {
                 SetType(t);
             }
             KeyObject(const Data& nns, uint8 t, const std::string& data)
-                    : ns(nns), type(0)
+                    : ns(nns), type(0), version(0)
             {
                 key.SetString(data, false);
                 SetType(t);
             }
             KeyObject(const Data& nns, uint8 t, const Data& key_data)
-                    : ns(nns), type(0), key(key_data)
+                    : ns(nns), type(0), key(key_data), version(0)
             {
                 SetType(t);
             }
@@ -109,7 +135,20 @@ OP_NAMESPACE_BEGIN
                 ns.Clear();
                 key.Clear();
                 elements.clear();
+                version = 0;
+            }
+            uint64 GetVersion() const
+            {
+                return version;
             }
+            void SetVersion(uint64 v)
+            {
+                version = v;
+            }
+            /*
+             * point an element key to the data key & version recorded in its collection's meta
+             */
+            void BindCollection(ValueObject& meta);
             const Data& GetNameSpace() const
             {
                 return ns;
@@ -151,6 +190,17 @@ OP_NAMESPACE_BEGIN
             }
             void SetStreamPELId(const StreamID& id);
             StreamID GetStreamPELId();
+            /*
+             * stream block: 0:id the block was created with, not above any entry id of the block
+             */
+            void SetStreamBlockID(const StreamID& id)
+            {
+                SetStreamID(id);
+            }
+            StreamID GetStreamBlockID() const
+            {
+                return GetStreamID();
+            }
 
             void SetHashField(const std::string& v)
             {
@@ -233,6 +283,33 @@ OP_NAMESPACE_BEGIN
             {
                 return GetElement(0).GetFloat64();
             }
+            /*
+             * rank index node: 0:level 1:position prefix of the level
+             */
+            void SetRankIndexNode(int64_t level, int64_t prefix)
+            {
+                getElement(0).SetInt64(level);
+                getElement(1).SetInt64(prefix);
+            }
+            int64_t GetRankIndexLevel() const
+            {
+                return GetElement(0).GetInt64();
+            }
+            int64_t GetRankIndexPrefix() const
+            {
+                return GetElement(1).GetInt64();
+            }
+            /*
+             * bitmap segment: 0:segment index
+             */
+            void SetBitmapSegment(int64_t idx)
+            {
+                getElement(0).SetInt64(idx);
+            }
+            int64_t GetBitmapSegment() const
+            {
+                return GetElement(0).GetInt64();
+            }
             void SetTTLKeyNamespace(const Data& ns)
             {
                 setElement(ns, 1);
@@ -257,12 +334,34 @@ OP_NAMESPACE_BEGIN
             {
                 getElement(idx).Clone(data);
             }
+            /*
+             * stale version record: 0:namespace 1:data key 2:version
+             */
+            void SetStaleVersion(const Data& ns, const Data& data_key, uint64 v)
+            {
+                getElement(0).Clone(ns);
+                getElement(1).Clone(data_key);
+                getElement(2).SetInt64((int64) v);
+            }
+            const Data& GetStaleNameSpace() const
+            {
+                return GetElement(0);
+            }
+            const Data& GetStaleDataKey() const
+            {
+                return GetElement(1);
+            }
+            uint64 GetStaleVersion() const
+            {
+                return (uint64) GetElement(2).GetInt64();
+            }
 
             bool IsValid() const;
             int Compare(const KeyObject& other) const;
             // compare (namespace, key)
             int ComparePrefix(const KeyObject& other) const;
             Slice Encode(Buffer& buffer, bool verify = true, bool with_ns = false) const;
+            Slice Encode(Buffer& buffer, bool verify, bool with_ns, uint8 format) const;
             void EncodePrefix(Buffer& buffer) const;
             bool DecodeNS(Buffer& buffer, bool clone_str);
             bool DecodeKey(Buffer& buffer, bool clone_str);
@@ -271,6 +370,7 @@ OP_NAMESPACE_BEGIN
             int DecodeElementLength(Buffer& buffer);
             bool DecodeElement(Buffer& buffer, bool clone_str, int idx);
             bool Decode(Buffer& buffer, bool clone_str, bool with_ns = false);
+            bool Decode(Buffer& buffer, bool clone_str, bool with_ns, uint8 format);
 
             void CloneStringPart();
 
@@ -295,8 +395,18 @@ OP_NAMESPACE_BEGIN
             int64_t ttl;
             int64_t size;
             bool list_sequential;  //indicate that list is sequential ot not
+            bool zset_rank_index;  //indicate that zset maintains the KEY_ZSET_RANK order statistic index
+            bool list_rank_index;  //indicate that non sequential list maintains the KEY_LIST_RANK positional index
+            uint64 version;        //zset/list element keys carry this version, 0 for collections created before versioning
+            std::string data_key;  //key name the elements are stored under after a rename, empty means the meta's own key
+            int64_t bitmap_len;    //chunked bitmap length in bytes, as the string it stands for
+            int64_t bitmap_count;  //chunked bitmap set bits
+            int64_t bitmap_segment; //chunked bitmap segment size in bytes
 
             StreamID stream_last_id;
+            int64_t stream_block;  //max entries of a stream block, 0 for streams storing one record per entry
+            StreamID stream_tail;  //id of the stream block entries are appended to
+            int64_t stream_tail_count; //entries appended to the tail block, deletes from it are not subtracted
             MetaObject();
             void Encode(Buffer& buffer, uint8 type) const;
             bool Decode(Buffer& buffer, uint8 type);
@@ -397,6 +507,40 @@ OP_NAMESPACE_BEGIN
             {
                 getElement(0).SetString(v, true);
             }
+            /*
+             * bitmap segment value: 0:segment bytes, a missing tail is zero 1:set bits of the segment
+             */
+            Data& GetBitmapSegmentBytes()
+            {
+                return getElement(0);
+            }
+            int64 GetBitmapSegmentCount()
+            {
+                return getElement(1).GetInt64();
+            }
+            void SetBitmapSegmentCount(int64 v)
+            {
+                getElement(1).SetInt64(v);
+            }
+            /*
+             * stream block value: 0:entry count 1:packed entries 2:id of the last entry
+             */
+            int64 GetStreamBlockCount()
+            {
+                return getElement(0).GetInt64();
+            }
+            void SetStreamBlockCount(int64 v)
+            {
+                getElement(0).SetInt64(v);
+            }
+            Data& GetStreamBlockEntries()
+            {
+                return getElement(1);
+            }
+            Data& GetStreamBlockLastId()
+            {
+                return getElement(2);
+            }
             void SetListElement(const std::string& v)
             {
                 getElement(0).SetString(v, true);
@@ -483,6 +627,25 @@ OP_NAMESPACE_BEGIN
             {
                 getElement(0).SetFloat64(s);
             }
+            int64_t GetRankIndexCount()
+            {
+                return getElement(0).GetInt64();
+            }
+            void SetRankIndexCount(int64_t v)
+            {
+                getElement(0).SetInt64(v);
+            }
+            /*
+             * collection type of a stale version record
+             */
+            uint8 GetStaleCollectionType()
+            {
+                return (uint8) getElement(0).GetInt64();
+            }
+            void SetStaleCollectionType(uint8 t)
+            {
+                getElement(0).SetInt64(t);
+            }
             void SetMergeArgs(const DataArray& args)
             {
                 vals = args;
@@ -672,6 +835,15 @@ OP_NAMESPACE_BEGIN
 
     typedef std::vector<KeyObject> KeyObjectArray;
     typedef std::vector<ValueObject> ValueObjectArray;
+    typedef std::vector<StreamID> StreamIDArray;
+
+    /*
+     * A stream block packs entries in id order, each one as the ms/seq delta to the previous entry (the
+     * block id for the first one) followed by its KEY_STREAM_ELEMENT value, field names are only kept for
+     * entries whose fields differ from the stream's.
+     */
+    void stream_block_append(ValueObject& block, const StreamID& block_id, const StreamID& id, ValueObject& ele);
+    bool stream_block_decode(ValueObject& block, const StreamID& block_id, StreamIDArray& ids, ValueObjectArray& eles);
 
     typedef std::vector<int> ErrCodeArray;
 
@@ -32,7 +32,9 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <sys/wait.h>
 #include <sstream>
+#include <algorithm>
 #include "db.hpp"
 #include "repl/repl.hpp"
 #include "statistics.hpp"
@@ -55,10 +57,12 @@
 #define ARDB_CMD_SKIP_MONITOR 2048         /* "M" flag */
 #define ARDB_CMD_ASKING 4096               /* "k" flag */
 #define ARDB_CMD_FAST 8192                 /* "F" flag */
+#define ARDB_CMD_MOVABLE_KEYS 16384        /* "K" flag */
 
 OP_NAMESPACE_BEGIN
     Ardb* g_db = NULL;
     Engine* g_engine = NULL;
+    static const size_t kKeyLockEntryMaxCapacity = 4096;
 
     bool Ardb::RedisCommandHandlerSetting::IsAllowedInScript() const
     {
@@ -69,18 +73,32 @@ OP_NAMESPACE_BEGIN
         return (flags & ARDB_CMD_WRITE) > 0;
     }
 
-    size_t Ardb::RedisCommandHash::operator ()(const std::string& t) const
+    /*
+     * Two seeded FNV-1a hashes of the ASCII lowercased name in one pass, h1 picks the bucket and h2 the slot.
+     */
+    static inline void command_hash(const char* s, size_t len, uint32 seed, uint32& h1, uint32& h2)
     {
-        unsigned int hash = 5381;
-        size_t len = t.size();
-        const char* buf = t.data();
-        while (len--)
-            hash = ((hash << 5) + hash) + (tolower(*buf++)); /* hash * 33 + c */
-        return hash;
+        h1 = 2166136261U ^ seed;
+        h2 = 84696351U ^ (seed * 0x9E3779B9U);
+        for (size_t i = 0; i < len; i++)
+        {
+            unsigned char c = (unsigned char) s[i];
+            if (c >= 'A' && c <= 'Z')
+            {
+                c += 'a' - 'A';
+            }
+            h1 = (h1 ^ c) * 16777619U;
+            h2 = (h2 ^ c) * 16777619U;
+        }
+        h1 ^= h1 >> 16;
     }
-    bool Ardb::RedisCommandEqual::operator()(const std::string& s1, const std::string& s2) const
+    static inline uint32 command_slot_hash(uint32 h2, uint32 disp)
     {
-        return strcasecmp(s1.c_str(), s2.c_str()) == 0 ? true : false;
+        uint32 h = h2 ^ (disp * 0x85EBCA6BU);
+        h ^= h >> 16;
+        h *= 0x7FEB352DU;
+        h ^= h >> 15;
+        return h;
     }
 
     Ardb::KeyLockGuard::KeyLockGuard(Context& cctx, const KeyObject& key, bool _lock)
@@ -88,9 +106,14 @@ OP_NAMESPACE_BEGIN
     {
         if (lock)
         {
-            ctx.keyslocked = true;
             lk.key = key.GetKey();
             lk.ns = key.GetNameSpace();
+            if (NULL != ctx.transc_keys && ctx.transc_keys->count(lk) > 0)
+            {
+                lock = false;
+                return;
+            }
+            ctx.keyslocked = true;
             g_db->LockKey(lk);
         }
 
@@ -100,6 +123,10 @@ OP_NAMESPACE_BEGIN
     {
         if (lock)
         {
+            if (ctx.repl_ordered)
+            {
+                g_repl->GetReplLog().ReserveSequence();
+            }
             g_db->UnlockKey(lk);
             ctx.keyslocked = false;
         }
@@ -114,7 +141,10 @@ OP_NAMESPACE_BEGIN
             KeyPrefix lk;
             lk.key = keys[i].GetKey();
             lk.ns = keys[i].GetNameSpace();
-            ks.insert(lk);
+            if (NULL == ctx.transc_keys || ctx.transc_keys->count(lk) == 0)
+            {
+                ks.insert(lk);
+            }
         }
         g_db->LockKeys(ks);
     }
@@ -126,12 +156,22 @@ OP_NAMESPACE_BEGIN
         lk1.ns = key1.GetNameSpace();
         lk2.key = key2.GetKey();
         lk2.ns = key2.GetNameSpace();
-        ks.insert(lk1);
-        ks.insert(lk2);
+        if (NULL == ctx.transc_keys || ctx.transc_keys->count(lk1) == 0)
+        {
+            ks.insert(lk1);
+        }
+        if (NULL == ctx.transc_keys || ctx.transc_keys->count(lk2) == 0)
+        {
+            ks.insert(lk2);
+        }
         g_db->LockKeys(ks);
     }
     Ardb::KeysLockGuard::~KeysLockGuard()
     {
+        if (ctx.repl_ordered && !ks.empty())
+        {
+            g_repl->GetReplLog().ReserveSequence();
+        }
         g_db->UnlockKeys(ks);
         ctx.keyslocked = false;
     }
@@ -140,225 +180,226 @@ OP_NAMESPACE_BEGIN
 
     Ardb::Ardb()
             : m_engine(NULL), m_starttime(0), m_loading_data(false), m_compacting_data(false), m_prepare_snapshot_num(
-                    0), m_write_caller_num(0), m_db_caller_num(0), m_redis_cursor_seed(0), m_watched_ctxs(NULL), m_ready_keys(
+                    0), m_write_caller_num(0), m_db_caller_num(0), m_settings_seed(0), m_lock_stripes(NULL), m_lock_stripes_num(0), m_meta_cache_shards(NULL), m_meta_cache_shards_num(0), m_meta_cache_epoch(0), m_redis_cursor_seed(0), m_watched_ctxs(NULL), m_ready_keys(
                     NULL), m_monitors(
             NULL), m_restoring_nss(
-            NULL), m_min_ttl(-1),g_background(NULL)
+            NULL), m_min_ttl(-1), m_expire_cycle_time_limit(0), m_last_expire_cycle_time(0), m_expired_keys(0), m_expired_keys_per_sec(
+                    0), m_expire_backlog_keys(0), g_background(NULL), m_collection_version(0), m_geo_radius_queries(0), m_geo_nearest_queries(
+                    0), m_geo_points_scanned(0), m_geo_points_kept(0)
     {
         g_db = this;
-        m_settings.set_empty_key("");
-        m_settings.set_deleted_key("\n");
+        InitKeyLockStripes(m_conf.key_lock_stripes);
 
         struct RedisCommandHandlerSetting settingTable[] =
         {
-        { "ping", REDIS_CMD_PING, &Ardb::Ping, 0, 1, "rtF", 0, 0, 0 },
-        { "multi", REDIS_CMD_MULTI, &Ardb::Multi, 0, 0, "rsF", 0, 0, 0 },
-        { "discard", REDIS_CMD_DISCARD, &Ardb::Discard, 0, 0, "rsF", 0, 0, 0 },
-        { "exec", REDIS_CMD_EXEC, &Ardb::Exec, 0, 0, "sM", 0, 0, 0 },
-        { "watch", REDIS_CMD_WATCH, &Ardb::Watch, 0, -1, "rsF", 0, 0, 0 },
-        { "unwatch", REDIS_CMD_UNWATCH, &Ardb::UnWatch, 0, 0, "rsF", 0, 0, 0 },
-        { "subscribe", REDIS_CMD_SUBSCRIBE, &Ardb::Subscribe, 1, -1, "rpslt", 0, 0, 0 },
-        { "psubscribe", REDIS_CMD_PSUBSCRIBE, &Ardb::PSubscribe, 1, -1, "rpslt", 0, 0, 0 },
-        { "unsubscribe", REDIS_CMD_UNSUBSCRIBE, &Ardb::UnSubscribe, 0, -1, "rpslt", 0, 0, 0 },
-        { "punsubscribe", REDIS_CMD_PUNSUBSCRIBE, &Ardb::PUnSubscribe, 0, -1, "rpslt", 0, 0, 0 },
-        { "publish", REDIS_CMD_PUBLISH, &Ardb::Publish, 2, 2, "pltrF", 0, 0, 0 },
-        { "pubsub", REDIS_CMD_PUBSUB, &Ardb::Pubsub, 1, -1, "pltrF", 0, 0, 0 },
-        { "info", REDIS_CMD_INFO, &Ardb::Info, 0, 1, "rlt", 0, 0, 0 },
-        { "save", REDIS_CMD_SAVE, &Ardb::Save, 0, 1, "ars", 0, 0, 0 },
-        { "bgsave", REDIS_CMD_BGSAVE, &Ardb::BGSave, 0, 1, "ar", 0, 0, 0 },
-        { "import", REDIS_CMD_IMPORT, &Ardb::Import, 1, 1, "aws", 0, 0, 0 },
-        { "lastsave", REDIS_CMD_LASTSAVE, &Ardb::LastSave, 0, 0, "r", 0, 0, 0 },
-        { "slowlog", REDIS_CMD_SLOWLOG, &Ardb::SlowLog, 1, 2, "r", 0, 0, 0 },
-        { "dbsize", REDIS_CMD_DBSIZE, &Ardb::DBSize, 0, 0, "r", 0, 0, 0 },
-        { "config", REDIS_CMD_CONFIG, &Ardb::Config, 1, 3, "ar", 0, 0, 0 },
-        { "client", REDIS_CMD_CLIENT, &Ardb::Client, 1, -1, "ar", 0, 0, 0 },
-        { "flushdb", REDIS_CMD_FLUSHDB, &Ardb::FlushDB, 0, 0, "w", 0, 0, 0 },
-        { "flushall", REDIS_CMD_FLUSHALL, &Ardb::FlushAll, 0, 0, "w", 0, 0, 0 },
-        { "compactdb", REDIS_CMD_COMPACTDB, &Ardb::CompactDB, 0, 0, "ar", 0, 0, 0 },
-        { "compactall", REDIS_CMD_COMPACTALL, &Ardb::CompactAll, 0, 0, "ar", 0, 0, 0 },
-        { "time", REDIS_CMD_TIME, &Ardb::Time, 0, 0, "ar", 0, 0, 0 },
-        { "echo", REDIS_CMD_ECHO, &Ardb::Echo, 1, 1, "r", 0, 0, 0 },
-        { "quit", REDIS_CMD_QUIT, &Ardb::Quit, 0, 0, "rs", 0, 0, 0 },
-        { "shutdown", REDIS_CMD_SHUTDOWN, &Ardb::Shutdown, 0, 1, "arlt", 0, 0, 0 },
-        { "slaveof", REDIS_CMD_SLAVEOF, &Ardb::Slaveof, 2, -1, "ast", 0, 0, 0 },
-        { "replconf", REDIS_CMD_REPLCONF, &Ardb::ReplConf, 0, -1, "arslt", 0, 0, 0 },
-        { "sync", REDIS_CMD_SYNC, &Ardb::Sync, 0, 2, "ars", 0, 0, 0 },
-        { "psync", REDIS_CMD_PSYNC, &Ardb::PSync, 2, -1, "ars", 0, 0, 0 },
-        { "select", REDIS_CMD_SELECT, &Ardb::Select, 1, 1, "r", 0, 0, 0 },
-        { "append", REDIS_CMD_APPEND, &Ardb::Append, 2, 2, "w", 0, 0, 0 },
-        { "append2", REDIS_CMD_APPEND2, &Ardb::Append, 2, 2, "w", 0, 0, 0 },
-        { "get", REDIS_CMD_GET, &Ardb::Get, 1, 1, "rF", 0, 0, 0 },
-        { "set", REDIS_CMD_SET, &Ardb::Set, 2, 7, "w", 0, 0, 0 },
-        { "set2", REDIS_CMD_SET2, &Ardb::Set, 2, 7, "w", 0, 0, 0 },
-        { "del", REDIS_CMD_DEL, &Ardb::Del, 1, -1, "w", 0, 0, 0 },
-		{ "unlink", REDIS_CMD_UNLINK, &Ardb::Unlink, 1, -1, "w", 0, 0, 0 },
-        { "exists", REDIS_CMD_EXISTS, &Ardb::Exists, 1, 1, "r", 0, 0, 0 },
-        { "expire", REDIS_CMD_EXPIRE, &Ardb::Expire, 2, 2, "w", 0, 0, 0 },
-        { "pexpire", REDIS_CMD_PEXPIRE, &Ardb::PExpire, 2, 2, "w", 0, 0, 0 },
-        { "expireat", REDIS_CMD_EXPIREAT, &Ardb::Expireat, 2, 2, "w", 0, 0, 0 },
-        { "pexpireat", REDIS_CMD_PEXPIREAT, &Ardb::PExpireat, 2, 2, "w", 0, 0, 0 },
-        { "persist", REDIS_CMD_PERSIST, &Ardb::Persist, 1, 1, "w", 1, 0, 0 },
-        { "ttl", REDIS_CMD_TTL, &Ardb::TTL, 1, 1, "r", 0, 0, 0 },
-        { "pttl", REDIS_CMD_PTTL, &Ardb::PTTL, 1, 1, "r", 0, 0, 0 },
-        { "type", REDIS_CMD_TYPE, &Ardb::Type, 1, 1, "r", 0, 0, 0 },
-        { "bitcount", REDIS_CMD_BITCOUNT, &Ardb::Bitcount, 1, 3, "r", 0, 0, 0 },
-        { "bitop", REDIS_CMD_BITOP, &Ardb::Bitop, 3, -1, "w", 1, 0, 0 },
-        { "bitopcount", REDIS_CMD_BITOPCUNT, &Ardb::BitopCount, 2, -1, "r", 0, 0, 0 },
-        { "decr", REDIS_CMD_DECR, &Ardb::Decr, 1, 1, "w", 1, 0, 0 },
-        { "decr2", REDIS_CMD_DECR2, &Ardb::Decr, 1, 1, "w", 1, 0, 0 },
-        { "decrby", REDIS_CMD_DECRBY, &Ardb::Decrby, 2, 2, "w", 1, 0, 0 },
-        { "decrby2", REDIS_CMD_DECRBY2, &Ardb::Decrby, 2, 2, "w", 1, 0, 0 },
-        { "getbit", REDIS_CMD_GETBIT, &Ardb::GetBit, 2, 2, "r", 0, 0, 0 },
-        { "getrange", REDIS_CMD_GETRANGE, &Ardb::GetRange, 3, 3, "r", 0, 0, 0 },
-        { "getset", REDIS_CMD_GETSET, &Ardb::GetSet, 2, 2, "w", 1, 0, 0 },
-        { "incr", REDIS_CMD_INCR, &Ardb::Incr, 1, 1, "w", 1, 0, 0 },
-        { "incr2", REDIS_CMD_INCR2, &Ardb::Incr, 1, 1, "w", 1, 0, 0 },
-        { "incrby", REDIS_CMD_INCRBY, &Ardb::Incrby, 2, 2, "w", 1, 0, 0 },
-        { "incrby2", REDIS_CMD_INCRBY2, &Ardb::Incrby, 2, 2, "w", 1, 0, 0 },
-        { "incrbyfloat", REDIS_CMD_INCRBYFLOAT, &Ardb::IncrbyFloat, 2, 2, "w", 0, 0, 0 },
-        { "incrbyfloat2", REDIS_CMD_INCRBYFLOAT2, &Ardb::IncrbyFloat, 2, 2, "w", 0, 0, 0 },
-        { "mget", REDIS_CMD_MGET, &Ardb::MGet, 1, -1, "r", 0, 0, 0 },
-        { "mset", REDIS_CMD_MSET, &Ardb::MSet, 2, -1, "w", 0, 0, 0 },
-        { "mset2", REDIS_CMD_MSET2, &Ardb::MSet, 2, -1, "w", 0, 0, 0 },
-        { "msetnx", REDIS_CMD_MSETNX, &Ardb::MSetNX, 2, -1, "w", 0, 0, 0 },
-        { "msetnx2", REDIS_CMD_MSETNX2, &Ardb::MSetNX, 2, -1, "w", 0, 0, 0 },
-        { "psetex", REDIS_CMD_PSETEX, &Ardb::PSetEX, 3, 3, "w", 0, 0, 0 },
-        { "setbit", REDIS_CMD_SETBIT, &Ardb::SetBit, 3, 3, "w", 0, 0, 0 },
-        { "setbit2", REDIS_CMD_SETBIT2, &Ardb::SetBit, 3, 3, "w", 0, 0, 0 },
-        { "setex", REDIS_CMD_SETEX, &Ardb::SetEX, 3, 3, "w", 0, 0, 0 },
-        { "setnx", REDIS_CMD_SETNX, &Ardb::SetNX, 2, 2, "w", 0, 0, 0 },
-        { "setnx2", REDIS_CMD_SETNX2, &Ardb::SetNX, 2, 2, "w", 0, 0, 0 },
-        { "setrange", REDIS_CMD_SETRANGE, &Ardb::SetRange, 3, 3, "w", 0, 0, 0 },
-        { "setrange2", REDIS_CMD_SETRANGE2, &Ardb::SetRange, 3, 3, "w", 0, 0, 0 },
-        { "strlen", REDIS_CMD_STRLEN, &Ardb::Strlen, 1, 1, "r", 0, 0, 0 },
-        { "hdel", REDIS_CMD_HDEL, &Ardb::HDel, 2, -1, "w", 0, 0, 0 },
-        { "hdel2", REDIS_CMD_HDEL2, &Ardb::HDel, 2, -1, "w", 0, 0, 0 },
-        { "hexists", REDIS_CMD_HEXISTS, &Ardb::HExists, 2, 2, "r", 0, 0, 0 },
-        { "hget", REDIS_CMD_HGET, &Ardb::HGet, 2, 2, "r", 0, 0, 0 },
-        { "hgetall", REDIS_CMD_HGETALL, &Ardb::HGetAll, 1, 1, "r", 0, 0, 0 },
-        { "hincrby", REDIS_CMD_HINCR, &Ardb::HIncrby, 3, 3, "w", 0, 0, 0 },
-        { "hincrby2", REDIS_CMD_HINCR2, &Ardb::HIncrby, 3, 3, "w", 0, 0, 0 },
-        { "hincrbyfloat", REDIS_CMD_HINCRBYFLOAT, &Ardb::HIncrbyFloat, 3, 3, "w", 0, 0, 0 },
-        { "hincrbyfloat2", REDIS_CMD_HINCRBYFLOAT2, &Ardb::HIncrbyFloat, 3, 3, "w", 0, 0, 0 },
-        { "hkeys", REDIS_CMD_HKEYS, &Ardb::HKeys, 1, 1, "r", 0, 0, 0 },
-        { "hlen", REDIS_CMD_HLEN, &Ardb::HLen, 1, 1, "r", 0, 0, 0 },
-        { "hvals", REDIS_CMD_HVALS, &Ardb::HVals, 1, 1, "r", 0, 0, 0 },
-        { "hmget", REDIS_CMD_HMGET, &Ardb::HMGet, 2, -1, "r", 0, 0, 0 },
-        { "hset", REDIS_CMD_HSET, &Ardb::HSet, 3, -1, "w", 0, 0, 0 },
-        { "hset2", REDIS_CMD_HSET2, &Ardb::HSet, 3, -1, "w", 0, 0, 0 },
-        { "hsetnx", REDIS_CMD_HSETNX, &Ardb::HSetNX, 3, 3, "w", 0, 0, 0 },
-        { "hsetnx2", REDIS_CMD_HSETNX2, &Ardb::HSetNX, 3, 3, "w", 0, 0, 0 },
-        { "hmset", REDIS_CMD_HMSET, &Ardb::HMSet, 3, -1, "w", 0, 0, 0 },
-        { "hmset2", REDIS_CMD_HMSET2, &Ardb::HMSet, 3, -1, "w", 0, 0, 0 },
-        { "hscan", REDIS_CMD_HSCAN, &Ardb::HScan, 2, 6, "r", 0, 0, 0 },
-        { "scard", REDIS_CMD_SCARD, &Ardb::SCard, 1, 1, "r", 0, 0, 0 },
-        { "sadd", REDIS_CMD_SADD, &Ardb::SAdd, 2, -1, "w", 0, 0, 0 },
-        { "sadd2", REDIS_CMD_SADD2, &Ardb::SAdd, 2, -1, "w", 0, 0, 0 },
-        { "sdiff", REDIS_CMD_SDIFF, &Ardb::SDiff, 2, -1, "r", 0, 0, 0 },
-        { "sdiffcount", REDIS_CMD_SDIFFCOUNT, &Ardb::SDiffCount, 2, -1, "r", 0, 0, 0 },
-        { "sdiffstore", REDIS_CMD_SDIFFSTORE, &Ardb::SDiffStore, 3, -1, "w", 0, 0, 0 },
-        { "sinter", REDIS_CMD_SINTER, &Ardb::SInter, 2, -1, "r", 0, 0, 0 },
-        { "sintercount", REDIS_CMD_SINTERCOUNT, &Ardb::SInterCount, 2, -1, "r", 0, 0, 0 },
-        { "sinterstore", REDIS_CMD_SINTERSTORE, &Ardb::SInterStore, 3, -1, "w", 0, 0, 0 },
-        { "sismember", REDIS_CMD_SISMEMBER, &Ardb::SIsMember, 2, 2, "r", 0, 0, 0 },
-        { "smembers", REDIS_CMD_SMEMBERS, &Ardb::SMembers, 1, 1, "r", 0, 0, 0 },
-        { "smove", REDIS_CMD_SMOVE, &Ardb::SMove, 3, 3, "w", 0, 0, 0 },
-        { "spop", REDIS_CMD_SPOP, &Ardb::SPop, 1, 2, "wR", 0, 0, 0 },
-        { "srandmember", REDIS_CMD_SRANMEMEBER, &Ardb::SRandMember, 1, 2, "rR", 0, 0, 0 },
-        { "srem", REDIS_CMD_SREM, &Ardb::SRem, 2, -1, "w", 1, 0, 0 },
-        { "srem2", REDIS_CMD_SREM2, &Ardb::SRem, 2, -1, "w", 1, 0, 0 },
-        { "sunion", REDIS_CMD_SUNION, &Ardb::SUnion, 2, -1, "r", 0, 0, 0 },
-        { "sunionstore", REDIS_CMD_SUNIONSTORE, &Ardb::SUnionStore, 3, -1, "w", 0, 0, 0 },
-        { "sunioncount", REDIS_CMD_SUNIONCOUNT, &Ardb::SUnionCount, 2, -1, "r", 0, 0, 0 },
-        { "sscan", REDIS_CMD_SSCAN, &Ardb::SScan, 2, 6, "r", 0, 0, 0 },
-        { "zadd", REDIS_CMD_ZADD, &Ardb::ZAdd, 3, -1, "w", 0, 0, 0 },
-        { "zcard", REDIS_CMD_ZCARD, &Ardb::ZCard, 1, 1, "r", 0, 0, 0 },
-        { "zcount", REDIS_CMD_ZCOUNT, &Ardb::ZCount, 3, 3, "r", 0, 0, 0 },
-        { "zincrby", REDIS_CMD_ZINCRBY, &Ardb::ZIncrby, 3, 3, "w", 0, 0, 0 },
-        { "zrange", REDIS_CMD_ZRANGE, &Ardb::ZRange, 3, 4, "r", 0, 0, 0 },
-        { "zrangebyscore", REDIS_CMD_ZRANGEBYSCORE, &Ardb::ZRangeByScore, 3, 7, "r", 0, 0, 0 },
-        { "zrank", REDIS_CMD_ZRANK, &Ardb::ZRank, 2, 2, "r", 0, 0, 0 },
-        { "zrem", REDIS_CMD_ZREM, &Ardb::ZRem, 2, -1, "w", 0, 0, 0 },
-        { "zremrangebyrank", REDIS_CMD_ZREMRANGEBYRANK, &Ardb::ZRemRangeByRank, 3, 3, "w", 0, 0, 0 },
-        { "zremrangebyscore", REDIS_CMD_ZREMRANGEBYSCORE, &Ardb::ZRemRangeByScore, 3, 3, "w", 0, 0, 0 },
-        { "zrevrange", REDIS_CMD_ZREVRANGE, &Ardb::ZRevRange, 3, 4, "r", 0, 0, 0 },
-        { "zrevrangebyscore", REDIS_CMD_ZREVRANGEBYSCORE, &Ardb::ZRevRangeByScore, 3, 7, "r", 0, 0, 0 },
-        { "zinterstore", REDIS_CMD_ZINTERSTORE, &Ardb::ZInterStore, 3, -1, "w", 0, 0, 0 },
-        { "zunionstore", REDIS_CMD_ZUNIONSTORE, &Ardb::ZUnionStore, 3, -1, "w", 0, 0, 0 },
-        { "zrevrank", REDIS_CMD_ZREVRANK, &Ardb::ZRevRank, 2, 2, "r", 0, 0, 0 },
-        { "zscore", REDIS_CMD_ZSCORE, &Ardb::ZScore, 2, 2, "r", 0, 0, 0 },
-        { "zscan", REDIS_CMD_ZSCAN, &Ardb::ZScan, 2, 6, "r", 0, 0, 0 },
-        { "zlexcount", REDIS_CMD_ZLEXCOUNT, &Ardb::ZLexCount, 3, 3, "r", 0, 0, 0 },
-        { "zrangebylex", REDIS_CMD_ZRANGEBYLEX, &Ardb::ZRangeByLex, 3, 6, "r", 0, 0, 0 },
-        { "zrevrangebylex", REDIS_CMD_ZREVRANGEBYLEX, &Ardb::ZRangeByLex, 3, 6, "r", 0, 0, 0 },
-        { "zremrangebylex", REDIS_CMD_ZREMRANGEBYLEX, &Ardb::ZRemRangeByLex, 3, 3, "w", 0, 0, 0 },
-        { "zpopmin", REDIS_CMD_ZPOPMIN, &Ardb::ZPopMin, 1, 2, "w", 0, 0, 0 },
-        { "zpopmax", REDIS_CMD_ZPOPMAX, &Ardb::ZPopMax, 1, 2, "w", 0, 0, 0 },
-        { "bzpopmin", REDIS_CMD_BZPOPMIN, &Ardb::BZPopMin, 2, -1, "w", 0, 0, 0 },
-        { "bzpopmax", REDIS_CMD_BZPOPMAX, &Ardb::BZPopMax, 2, -1, "w", 0, 0, 0 },
-        { "lindex", REDIS_CMD_LINDEX, &Ardb::LIndex, 2, 2, "r", 0, 0, 0 },
-        { "linsert", REDIS_CMD_LINSERT, &Ardb::LInsert, 4, 4, "w", 0, 0, 0 },
-        { "llen", REDIS_CMD_LLEN, &Ardb::LLen, 1, 1, "r", 0, 0, 0 },
-        { "lpop", REDIS_CMD_LPOP, &Ardb::LPop, 1, 1, "w", 0, 0, 0 },
-        { "lpush", REDIS_CMD_LPUSH, &Ardb::LPush, 2, -1, "w", 0, 0, 0 },
-        { "lpushx", REDIS_CMD_LPUSHX, &Ardb::LPushx, 2, 2, "w", 0, 0, 0 },
-        { "lrange", REDIS_CMD_LRANGE, &Ardb::LRange, 3, 3, "r", 0, 0, 0 },
-        { "lrem", REDIS_CMD_LREM, &Ardb::LRem, 3, 3, "w", 0, 0, 0 },
-        { "lset", REDIS_CMD_LSET, &Ardb::LSet, 3, 3, "w", 0, 0, 0 },
-        { "ltrim", REDIS_CMD_LTRIM, &Ardb::LTrim, 3, 3, "w", 0, 0, 0 },
-        { "rpop", REDIS_CMD_RPOP, &Ardb::RPop, 1, 1, "w", 0, 0, 0 },
-        { "rpush", REDIS_CMD_RPUSH, &Ardb::RPush, 2, -1, "w", 0, 0, 0 },
-        { "rpushx", REDIS_CMD_RPUSHX, &Ardb::RPushx, 2, 2, "w", 0, 0, 0 },
-        { "rpoplpush", REDIS_CMD_RPOPLPUSH, &Ardb::RPopLPush, 2, 2, "w", 0, 0, 0 },
-        { "blpop", REDIS_CMD_BLPOP, &Ardb::BLPop, 2, -1, "ws", 0, 0, 0 },
-        { "brpop", REDIS_CMD_BRPOP, &Ardb::BRPop, 2, -1, "ws", 0, 0, 0 },
-        { "brpoplpush", REDIS_CMD_BRPOPLPUSH, &Ardb::BRPopLPush, 3, 3, "ws", 0, 0, 0 },
-        { "rpoplpush", REDIS_CMD_RPOPLPUSH, &Ardb::RPopLPush, 2, 2, "w", 0, 0, 0 },
-        { "move", REDIS_CMD_MOVE, &Ardb::Move, 2, 2, "w", 0, 0, 0 },
-        { "rename", REDIS_CMD_RENAME, &Ardb::Rename, 2, 2, "w", 0, 0, 0 },
-        { "renamenx", REDIS_CMD_RENAMENX, &Ardb::RenameNX, 2, 2, "w", 0, 0, 0 },
-        { "sort", REDIS_CMD_SORT, &Ardb::Sort, 1, -1, "w", 0, 0, 0 },
-        { "keys", REDIS_CMD_KEYS, &Ardb::Keys, 1, 6, "r", 0, 0, 0 },
-        { "keyscount", REDIS_CMD_KEYSCOUNT, &Ardb::KeysCount, 1, 6, "r", 0, 0, 0 },
-        { "eval", REDIS_CMD_EVAL, &Ardb::Eval, 2, -1, "s", 0, 0, 0 },
-        { "evalsha", REDIS_CMD_EVALSHA, &Ardb::EvalSHA, 2, -1, "s", 0, 0, 0 },
-        { "script", REDIS_CMD_SCRIPT, &Ardb::Script, 1, -1, "rs", 0, 0, 0 },
-        { "randomkey", REDIS_CMD_RANDOMKEY, &Ardb::Randomkey, 0, 0, "r", 0, 0, 0 },
-        { "scan", REDIS_CMD_SCAN, &Ardb::Scan, 1, 5, "r", 0, 0, 0 },
-        { "geoadd", REDIS_CMD_GEO_ADD, &Ardb::GeoAdd, 4, -1, "w", 0, 0, 0 },
-        { "georadius", REDIS_CMD_GEO_RADIUS, &Ardb::GeoRadius, 5, -1, "w", 0, 0, 0 },
-        { "georadiusbymember", REDIS_CMD_GEO_RADIUSBYMEMBER, &Ardb::GeoRadiusByMember, 4, 10, "w", 0, 0, 0 },
-        { "geohash", REDIS_CMD_GEO_HASH, &Ardb::GeoHash, 2, -1, "r", 0, 0, 0 },
-        { "geodist", REDIS_CMD_GEO_DIST, &Ardb::GeoDist, 3, 4, "r", 0, 0, 0 },
-        { "geopos", REDIS_CMD_GEO_POS, &Ardb::GeoPos, 2, -1, "r", 0, 0, 0 },
-        { "auth", REDIS_CMD_AUTH, &Ardb::Auth, 1, 1, "rsltF", 0, 0, 0 },
-        { "pfadd", REDIS_CMD_PFADD, &Ardb::PFAdd, 2, -1, "w", 0, 0, 0 },
-        { "pfadd2", REDIS_CMD_PFADD2, &Ardb::PFAdd, 2, -1, "w", 0, 0, 0 },
-        { "pfcount", REDIS_CMD_PFCOUNT, &Ardb::PFCount, 1, -1, "r", 0, 0, 0 },
-        { "pfmerge", REDIS_CMD_PFMERGE, &Ardb::PFMerge, 2, -1, "w", 0, 0, 0 },
-        { "dump", REDIS_CMD_DUMP, &Ardb::Dump, 1, 1, "r", 0, 0, 0 },
-        { "restore", REDIS_CMD_RESTORE, &Ardb::Restore, 3, 4, "w", 0, 0, 0 },
-        { "migrate", REDIS_CMD_MIGRATE, &Ardb::Migrate, 5, -1, "w", 0, 0, 0 },
-        { "migratedb", REDIS_CMD_MIGRATEDB, &Ardb::MigrateDB, 4, 4, "w", 0, 0, 0 },
-        { "restorechunk", REDIS_CMD_RESTORECHUNK, &Ardb::RestoreChunk, 1, 1, "wl", 0, 0, 0 },
-        { "restoredb", REDIS_CMD_RESTOREDB, &Ardb::RestoreDB, 1, 1, "wl", 0, 0, 0 },
-        { "monitor", REDIS_CMD_MONITOR, &Ardb::Monitor, 0, 0, "ars", 0, 0, 0 },
-        { "debug", REDIS_CMD_DEBUG, &Ardb::Debug, 2, -1, "ars", 0, 0, 0 },
-        { "touch", REDIS_CMD_TOUCH, &Ardb::Touch, 1, -2, "rF", 0, 0, 0 },
-		{ "command", REDIS_CMD_COMMAND, &Ardb::Command, 0, -1, "r", 0, 0, 0 },
-		{ "xread", REDIS_CMD_XREAD, &Ardb::XRead, 2, -1, "r", 0, 0, 0 },
-		{ "xreadgroup", REDIS_CMD_XREAD, &Ardb::XRead, 5, -1, "rw", 0, 0, 0 },
-		{ "xadd", REDIS_CMD_XADD, &Ardb::XAdd, 4, -1, "w", 0, 0, 0 },
-		{ "xlen", REDIS_CMD_XLEN, &Ardb::XLen, 1, 1, "r", 0, 0, 0 },
-		{ "xpending", REDIS_CMD_XPENDING, &Ardb::XPending, 2, 6, "r", 0, 0, 0 },
-		{ "xrange", REDIS_CMD_XRANGE, &Ardb::XRange, 3, 5, "r", 0, 0, 0 },
-		{ "xrevrange", REDIS_CMD_XREVRANGE, &Ardb::XRevRange, 3, 5, "r", 0, 0, 0 },
-		{ "xack", REDIS_CMD_XACK, &Ardb::XACK, 3, -1, "w", 0, 0, 0 },
-		{ "xclaim", REDIS_CMD_XCLAIM, &Ardb::XClaim, 5, -1, "w", 0, 0, 0 },
-		{ "xinfo", REDIS_CMD_XINFO, &Ardb::XInfo, 1, 3, "r", 0, 0, 0 },
-		{ "xgroup", REDIS_CMD_XGROUP, &Ardb::XGroup, 1, 4, "w", 0, 0, 0 },
-		{ "xtrim", REDIS_CMD_XTRIM, &Ardb::XTrim, 4, -1, "w", 0, 0, 0 },
-		{ "xdel", REDIS_CMD_XDEL, &Ardb::XDel, 2, -1, "w", 0, 0, 0 },
+        { "ping", REDIS_CMD_PING, &Ardb::Ping, 0, 1, "rtF", 0, 0, 0, 0, 0, 0 },
+        { "multi", REDIS_CMD_MULTI, &Ardb::Multi, 0, 0, "rsF", 0, 0, 0, 0, 0, 0 },
+        { "discard", REDIS_CMD_DISCARD, &Ardb::Discard, 0, 0, "rsF", 0, 0, 0, 0, 0, 0 },
+        { "exec", REDIS_CMD_EXEC, &Ardb::Exec, 0, 0, "sM", 0, 0, 0, 0, 0, 0 },
+        { "watch", REDIS_CMD_WATCH, &Ardb::Watch, 0, -1, "rsF", 0, 0, 0, 1, -1, 1 },
+        { "unwatch", REDIS_CMD_UNWATCH, &Ardb::UnWatch, 0, 0, "rsF", 0, 0, 0, 0, 0, 0 },
+        { "subscribe", REDIS_CMD_SUBSCRIBE, &Ardb::Subscribe, 1, -1, "rpslt", 0, 0, 0, 0, 0, 0 },
+        { "psubscribe", REDIS_CMD_PSUBSCRIBE, &Ardb::PSubscribe, 1, -1, "rpslt", 0, 0, 0, 0, 0, 0 },
+        { "unsubscribe", REDIS_CMD_UNSUBSCRIBE, &Ardb::UnSubscribe, 0, -1, "rpslt", 0, 0, 0, 0, 0, 0 },
+        { "punsubscribe", REDIS_CMD_PUNSUBSCRIBE, &Ardb::PUnSubscribe, 0, -1, "rpslt", 0, 0, 0, 0, 0, 0 },
+        { "publish", REDIS_CMD_PUBLISH, &Ardb::Publish, 2, 2, "pltrF", 0, 0, 0, 0, 0, 0 },
+        { "pubsub", REDIS_CMD_PUBSUB, &Ardb::Pubsub, 1, -1, "pltrF", 0, 0, 0, 0, 0, 0 },
+        { "info", REDIS_CMD_INFO, &Ardb::Info, 0, 1, "rlt", 0, 0, 0, 0, 0, 0 },
+        { "save", REDIS_CMD_SAVE, &Ardb::Save, 0, 1, "ars", 0, 0, 0, 0, 0, 0 },
+        { "bgsave", REDIS_CMD_BGSAVE, &Ardb::BGSave, 0, 1, "ar", 0, 0, 0, 0, 0, 0 },
+        { "import", REDIS_CMD_IMPORT, &Ardb::Import, 1, 1, "aws", 0, 0, 0, 0, 0, 0 },
+        { "lastsave", REDIS_CMD_LASTSAVE, &Ardb::LastSave, 0, 0, "r", 0, 0, 0, 0, 0, 0 },
+        { "slowlog", REDIS_CMD_SLOWLOG, &Ardb::SlowLog, 1, 2, "r", 0, 0, 0, 0, 0, 0 },
+        { "latency", REDIS_CMD_LATENCY, &Ardb::Latency, 1, -1, "r", 0, 0, 0, 0, 0, 0 },
+        { "dbsize", REDIS_CMD_DBSIZE, &Ardb::DBSize, 0, 1, "r", 0, 0, 0, 0, 0, 0 },
+        { "config", REDIS_CMD_CONFIG, &Ardb::Config, 1, 3, "ar", 0, 0, 0, 0, 0, 0 },
+        { "client", REDIS_CMD_CLIENT, &Ardb::Client, 1, -1, "ar", 0, 0, 0, 0, 0, 0 },
+        { "flushdb", REDIS_CMD_FLUSHDB, &Ardb::FlushDB, 0, 0, "w", 0, 0, 0, 0, 0, 0 },
+        { "flushall", REDIS_CMD_FLUSHALL, &Ardb::FlushAll, 0, 0, "w", 0, 0, 0, 0, 0, 0 },
+        { "compactdb", REDIS_CMD_COMPACTDB, &Ardb::CompactDB, 0, 0, "ar", 0, 0, 0, 0, 0, 0 },
+        { "compactall", REDIS_CMD_COMPACTALL, &Ardb::CompactAll, 0, 0, "ar", 0, 0, 0, 0, 0, 0 },
+        { "time", REDIS_CMD_TIME, &Ardb::Time, 0, 0, "ar", 0, 0, 0, 0, 0, 0 },
+        { "echo", REDIS_CMD_ECHO, &Ardb::Echo, 1, 1, "r", 0, 0, 0, 0, 0, 0 },
+        { "quit", REDIS_CMD_QUIT, &Ardb::Quit, 0, 0, "rs", 0, 0, 0, 0, 0, 0 },
+        { "shutdown", REDIS_CMD_SHUTDOWN, &Ardb::Shutdown, 0, 1, "arlt", 0, 0, 0, 0, 0, 0 },
+        { "slaveof", REDIS_CMD_SLAVEOF, &Ardb::Slaveof, 2, -1, "ast", 0, 0, 0, 0, 0, 0 },
+        { "replconf", REDIS_CMD_REPLCONF, &Ardb::ReplConf, 0, -1, "arslt", 0, 0, 0, 0, 0, 0 },
+        { "sync", REDIS_CMD_SYNC, &Ardb::Sync, 0, 2, "ars", 0, 0, 0, 0, 0, 0 },
+        { "psync", REDIS_CMD_PSYNC, &Ardb::PSync, 2, -1, "ars", 0, 0, 0, 0, 0, 0 },
+        { "select", REDIS_CMD_SELECT, &Ardb::Select, 1, 1, "r", 0, 0, 0, 0, 0, 0 },
+        { "append", REDIS_CMD_APPEND, &Ardb::Append, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "append2", REDIS_CMD_APPEND2, &Ardb::Append, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "get", REDIS_CMD_GET, &Ardb::Get, 1, 1, "rF", 0, 0, 0, 1, 1, 1 },
+        { "set", REDIS_CMD_SET, &Ardb::Set, 2, 7, "w", 0, 0, 0, 1, 1, 1 },
+        { "set2", REDIS_CMD_SET2, &Ardb::Set, 2, 7, "w", 0, 0, 0, 1, 1, 1 },
+        { "del", REDIS_CMD_DEL, &Ardb::Del, 1, -1, "w", 0, 0, 0, 1, -1, 1 },
+		{ "unlink", REDIS_CMD_UNLINK, &Ardb::Unlink, 1, -1, "w", 0, 0, 0, 1, -1, 1 },
+        { "exists", REDIS_CMD_EXISTS, &Ardb::Exists, 1, -1, "r", 0, 0, 0, 1, -1, 1 },
+        { "expire", REDIS_CMD_EXPIRE, &Ardb::Expire, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "pexpire", REDIS_CMD_PEXPIRE, &Ardb::PExpire, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "expireat", REDIS_CMD_EXPIREAT, &Ardb::Expireat, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "pexpireat", REDIS_CMD_PEXPIREAT, &Ardb::PExpireat, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "persist", REDIS_CMD_PERSIST, &Ardb::Persist, 1, 1, "w", 1, 0, 0, 1, 1, 1 },
+        { "ttl", REDIS_CMD_TTL, &Ardb::TTL, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "pttl", REDIS_CMD_PTTL, &Ardb::PTTL, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "type", REDIS_CMD_TYPE, &Ardb::Type, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "bitcount", REDIS_CMD_BITCOUNT, &Ardb::Bitcount, 1, 3, "r", 0, 0, 0, 1, 1, 1 },
+        { "bitop", REDIS_CMD_BITOP, &Ardb::Bitop, 3, -1, "w", 1, 0, 0, 2, -1, 1 },
+        { "bitopcount", REDIS_CMD_BITOPCUNT, &Ardb::BitopCount, 2, -1, "r", 0, 0, 0, 2, -1, 1 },
+        { "decr", REDIS_CMD_DECR, &Ardb::Decr, 1, 1, "w", 1, 0, 0, 1, 1, 1 },
+        { "decr2", REDIS_CMD_DECR2, &Ardb::Decr, 1, 1, "w", 1, 0, 0, 1, 1, 1 },
+        { "decrby", REDIS_CMD_DECRBY, &Ardb::Decrby, 2, 2, "w", 1, 0, 0, 1, 1, 1 },
+        { "decrby2", REDIS_CMD_DECRBY2, &Ardb::Decrby, 2, 2, "w", 1, 0, 0, 1, 1, 1 },
+        { "getbit", REDIS_CMD_GETBIT, &Ardb::GetBit, 2, 2, "r", 0, 0, 0, 1, 1, 1 },
+        { "getrange", REDIS_CMD_GETRANGE, &Ardb::GetRange, 3, 3, "r", 0, 0, 0, 1, 1, 1 },
+        { "getset", REDIS_CMD_GETSET, &Ardb::GetSet, 2, 2, "w", 1, 0, 0, 1, 1, 1 },
+        { "incr", REDIS_CMD_INCR, &Ardb::Incr, 1, 1, "w", 1, 0, 0, 1, 1, 1 },
+        { "incr2", REDIS_CMD_INCR2, &Ardb::Incr, 1, 1, "w", 1, 0, 0, 1, 1, 1 },
+        { "incrby", REDIS_CMD_INCRBY, &Ardb::Incrby, 2, 2, "w", 1, 0, 0, 1, 1, 1 },
+        { "incrby2", REDIS_CMD_INCRBY2, &Ardb::Incrby, 2, 2, "w", 1, 0, 0, 1, 1, 1 },
+        { "incrbyfloat", REDIS_CMD_INCRBYFLOAT, &Ardb::IncrbyFloat, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "incrbyfloat2", REDIS_CMD_INCRBYFLOAT2, &Ardb::IncrbyFloat, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "mget", REDIS_CMD_MGET, &Ardb::MGet, 1, -1, "r", 0, 0, 0, 1, -1, 1 },
+        { "mset", REDIS_CMD_MSET, &Ardb::MSet, 2, -1, "w", 0, 0, 0, 1, -1, 2 },
+        { "mset2", REDIS_CMD_MSET2, &Ardb::MSet, 2, -1, "w", 0, 0, 0, 1, -1, 2 },
+        { "msetnx", REDIS_CMD_MSETNX, &Ardb::MSetNX, 2, -1, "w", 0, 0, 0, 1, -1, 2 },
+        { "msetnx2", REDIS_CMD_MSETNX2, &Ardb::MSetNX, 2, -1, "w", 0, 0, 0, 1, -1, 2 },
+        { "psetex", REDIS_CMD_PSETEX, &Ardb::PSetEX, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "setbit", REDIS_CMD_SETBIT, &Ardb::SetBit, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "setbit2", REDIS_CMD_SETBIT2, &Ardb::SetBit, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "setex", REDIS_CMD_SETEX, &Ardb::SetEX, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "setnx", REDIS_CMD_SETNX, &Ardb::SetNX, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "setnx2", REDIS_CMD_SETNX2, &Ardb::SetNX, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "setrange", REDIS_CMD_SETRANGE, &Ardb::SetRange, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "setrange2", REDIS_CMD_SETRANGE2, &Ardb::SetRange, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "strlen", REDIS_CMD_STRLEN, &Ardb::Strlen, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "hdel", REDIS_CMD_HDEL, &Ardb::HDel, 2, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "hdel2", REDIS_CMD_HDEL2, &Ardb::HDel, 2, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "hexists", REDIS_CMD_HEXISTS, &Ardb::HExists, 2, 2, "r", 0, 0, 0, 1, 1, 1 },
+        { "hget", REDIS_CMD_HGET, &Ardb::HGet, 2, 2, "r", 0, 0, 0, 1, 1, 1 },
+        { "hgetall", REDIS_CMD_HGETALL, &Ardb::HGetAll, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "hincrby", REDIS_CMD_HINCR, &Ardb::HIncrby, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "hincrby2", REDIS_CMD_HINCR2, &Ardb::HIncrby, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "hincrbyfloat", REDIS_CMD_HINCRBYFLOAT, &Ardb::HIncrbyFloat, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "hincrbyfloat2", REDIS_CMD_HINCRBYFLOAT2, &Ardb::HIncrbyFloat, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "hkeys", REDIS_CMD_HKEYS, &Ardb::HKeys, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "hlen", REDIS_CMD_HLEN, &Ardb::HLen, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "hvals", REDIS_CMD_HVALS, &Ardb::HVals, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "hmget", REDIS_CMD_HMGET, &Ardb::HMGet, 2, -1, "r", 0, 0, 0, 1, 1, 1 },
+        { "hset", REDIS_CMD_HSET, &Ardb::HSet, 3, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "hset2", REDIS_CMD_HSET2, &Ardb::HSet, 3, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "hsetnx", REDIS_CMD_HSETNX, &Ardb::HSetNX, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "hsetnx2", REDIS_CMD_HSETNX2, &Ardb::HSetNX, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "hmset", REDIS_CMD_HMSET, &Ardb::HMSet, 3, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "hmset2", REDIS_CMD_HMSET2, &Ardb::HMSet, 3, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "hscan", REDIS_CMD_HSCAN, &Ardb::HScan, 2, 6, "r", 0, 0, 0, 1, 1, 1 },
+        { "scard", REDIS_CMD_SCARD, &Ardb::SCard, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "sadd", REDIS_CMD_SADD, &Ardb::SAdd, 2, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "sadd2", REDIS_CMD_SADD2, &Ardb::SAdd, 2, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "sdiff", REDIS_CMD_SDIFF, &Ardb::SDiff, 2, -1, "r", 0, 0, 0, 1, -1, 1 },
+        { "sdiffcount", REDIS_CMD_SDIFFCOUNT, &Ardb::SDiffCount, 2, -1, "r", 0, 0, 0, 1, -1, 1 },
+        { "sdiffstore", REDIS_CMD_SDIFFSTORE, &Ardb::SDiffStore, 3, -1, "w", 0, 0, 0, 1, -1, 1 },
+        { "sinter", REDIS_CMD_SINTER, &Ardb::SInter, 2, -1, "r", 0, 0, 0, 1, -1, 1 },
+        { "sintercount", REDIS_CMD_SINTERCOUNT, &Ardb::SInterCount, 2, -1, "r", 0, 0, 0, 1, -1, 1 },
+        { "sinterstore", REDIS_CMD_SINTERSTORE, &Ardb::SInterStore, 3, -1, "w", 0, 0, 0, 1, -1, 1 },
+        { "sismember", REDIS_CMD_SISMEMBER, &Ardb::SIsMember, 2, 2, "r", 0, 0, 0, 1, 1, 1 },
+        { "smembers", REDIS_CMD_SMEMBERS, &Ardb::SMembers, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "smove", REDIS_CMD_SMOVE, &Ardb::SMove, 3, 3, "w", 0, 0, 0, 1, 2, 1 },
+        { "spop", REDIS_CMD_SPOP, &Ardb::SPop, 1, 2, "wR", 0, 0, 0, 1, 1, 1 },
+        { "srandmember", REDIS_CMD_SRANMEMEBER, &Ardb::SRandMember, 1, 2, "rR", 0, 0, 0, 1, 1, 1 },
+        { "srem", REDIS_CMD_SREM, &Ardb::SRem, 2, -1, "w", 1, 0, 0, 1, 1, 1 },
+        { "srem2", REDIS_CMD_SREM2, &Ardb::SRem, 2, -1, "w", 1, 0, 0, 1, 1, 1 },
+        { "sunion", REDIS_CMD_SUNION, &Ardb::SUnion, 2, -1, "r", 0, 0, 0, 1, -1, 1 },
+        { "sunionstore", REDIS_CMD_SUNIONSTORE, &Ardb::SUnionStore, 3, -1, "w", 0, 0, 0, 1, -1, 1 },
+        { "sunioncount", REDIS_CMD_SUNIONCOUNT, &Ardb::SUnionCount, 2, -1, "r", 0, 0, 0, 1, -1, 1 },
+        { "sscan", REDIS_CMD_SSCAN, &Ardb::SScan, 2, 6, "r", 0, 0, 0, 1, 1, 1 },
+        { "zadd", REDIS_CMD_ZADD, &Ardb::ZAdd, 3, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "zcard", REDIS_CMD_ZCARD, &Ardb::ZCard, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "zcount", REDIS_CMD_ZCOUNT, &Ardb::ZCount, 3, 3, "r", 0, 0, 0, 1, 1, 1 },
+        { "zincrby", REDIS_CMD_ZINCRBY, &Ardb::ZIncrby, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "zrange", REDIS_CMD_ZRANGE, &Ardb::ZRange, 3, 4, "r", 0, 0, 0, 1, 1, 1 },
+        { "zrangebyscore", REDIS_CMD_ZRANGEBYSCORE, &Ardb::ZRangeByScore, 3, 7, "r", 0, 0, 0, 1, 1, 1 },
+        { "zrank", REDIS_CMD_ZRANK, &Ardb::ZRank, 2, 2, "r", 0, 0, 0, 1, 1, 1 },
+        { "zrem", REDIS_CMD_ZREM, &Ardb::ZRem, 2, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "zremrangebyrank", REDIS_CMD_ZREMRANGEBYRANK, &Ardb::ZRemRangeByRank, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "zremrangebyscore", REDIS_CMD_ZREMRANGEBYSCORE, &Ardb::ZRemRangeByScore, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "zrevrange", REDIS_CMD_ZREVRANGE, &Ardb::ZRevRange, 3, 4, "r", 0, 0, 0, 1, 1, 1 },
+        { "zrevrangebyscore", REDIS_CMD_ZREVRANGEBYSCORE, &Ardb::ZRevRangeByScore, 3, 7, "r", 0, 0, 0, 1, 1, 1 },
+        { "zinterstore", REDIS_CMD_ZINTERSTORE, &Ardb::ZInterStore, 3, -1, "wK", 0, 0, 0, 1, 1, 1 },
+        { "zunionstore", REDIS_CMD_ZUNIONSTORE, &Ardb::ZUnionStore, 3, -1, "wK", 0, 0, 0, 1, 1, 1 },
+        { "zrevrank", REDIS_CMD_ZREVRANK, &Ardb::ZRevRank, 2, 2, "r", 0, 0, 0, 1, 1, 1 },
+        { "zscore", REDIS_CMD_ZSCORE, &Ardb::ZScore, 2, 2, "r", 0, 0, 0, 1, 1, 1 },
+        { "zscan", REDIS_CMD_ZSCAN, &Ardb::ZScan, 2, 6, "r", 0, 0, 0, 1, 1, 1 },
+        { "zlexcount", REDIS_CMD_ZLEXCOUNT, &Ardb::ZLexCount, 3, 3, "r", 0, 0, 0, 1, 1, 1 },
+        { "zrangebylex", REDIS_CMD_ZRANGEBYLEX, &Ardb::ZRangeByLex, 3, 6, "r", 0, 0, 0, 1, 1, 1 },
+        { "zrevrangebylex", REDIS_CMD_ZREVRANGEBYLEX, &Ardb::ZRangeByLex, 3, 6, "r", 0, 0, 0, 1, 1, 1 },
+        { "zremrangebylex", REDIS_CMD_ZREMRANGEBYLEX, &Ardb::ZRemRangeByLex, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "zpopmin", REDIS_CMD_ZPOPMIN, &Ardb::ZPopMin, 1, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "zpopmax", REDIS_CMD_ZPOPMAX, &Ardb::ZPopMax, 1, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "bzpopmin", REDIS_CMD_BZPOPMIN, &Ardb::BZPopMin, 2, -1, "w", 0, 0, 0, 1, -2, 1 },
+        { "bzpopmax", REDIS_CMD_BZPOPMAX, &Ardb::BZPopMax, 2, -1, "w", 0, 0, 0, 1, -2, 1 },
+        { "lindex", REDIS_CMD_LINDEX, &Ardb::LIndex, 2, 2, "r", 0, 0, 0, 1, 1, 1 },
+        { "linsert", REDIS_CMD_LINSERT, &Ardb::LInsert, 4, 4, "w", 0, 0, 0, 1, 1, 1 },
+        { "llen", REDIS_CMD_LLEN, &Ardb::LLen, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "lpop", REDIS_CMD_LPOP, &Ardb::LPop, 1, 1, "w", 0, 0, 0, 1, 1, 1 },
+        { "lpush", REDIS_CMD_LPUSH, &Ardb::LPush, 2, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "lpushx", REDIS_CMD_LPUSHX, &Ardb::LPushx, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "lrange", REDIS_CMD_LRANGE, &Ardb::LRange, 3, 3, "r", 0, 0, 0, 1, 1, 1 },
+        { "lrem", REDIS_CMD_LREM, &Ardb::LRem, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "lset", REDIS_CMD_LSET, &Ardb::LSet, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "ltrim", REDIS_CMD_LTRIM, &Ardb::LTrim, 3, 3, "w", 0, 0, 0, 1, 1, 1 },
+        { "rpop", REDIS_CMD_RPOP, &Ardb::RPop, 1, 1, "w", 0, 0, 0, 1, 1, 1 },
+        { "rpush", REDIS_CMD_RPUSH, &Ardb::RPush, 2, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "rpushx", REDIS_CMD_RPUSHX, &Ardb::RPushx, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "rpoplpush", REDIS_CMD_RPOPLPUSH, &Ardb::RPopLPush, 2, 2, "w", 0, 0, 0, 1, 2, 1 },
+        { "blpop", REDIS_CMD_BLPOP, &Ardb::BLPop, 2, -1, "ws", 0, 0, 0, 1, -2, 1 },
+        { "brpop", REDIS_CMD_BRPOP, &Ardb::BRPop, 2, -1, "ws", 0, 0, 0, 1, -2, 1 },
+        { "brpoplpush", REDIS_CMD_BRPOPLPUSH, &Ardb::BRPopLPush, 3, 3, "ws", 0, 0, 0, 1, 2, 1 },
+        { "move", REDIS_CMD_MOVE, &Ardb::Move, 2, 2, "w", 0, 0, 0, 1, 1, 1 },
+        { "rename", REDIS_CMD_RENAME, &Ardb::Rename, 2, 2, "w", 0, 0, 0, 1, 2, 1 },
+        { "renamenx", REDIS_CMD_RENAMENX, &Ardb::RenameNX, 2, 2, "w", 0, 0, 0, 1, 2, 1 },
+        { "sort", REDIS_CMD_SORT, &Ardb::Sort, 1, -1, "wK", 0, 0, 0, 1, 1, 1 },
+        { "keys", REDIS_CMD_KEYS, &Ardb::Keys, 1, 6, "r", 0, 0, 0, 0, 0, 0 },
+        { "keyscount", REDIS_CMD_KEYSCOUNT, &Ardb::KeysCount, 1, 6, "r", 0, 0, 0, 0, 0, 0 },
+        { "eval", REDIS_CMD_EVAL, &Ardb::Eval, 2, -1, "sK", 0, 0, 0, 0, 0, 0 },
+        { "evalsha", REDIS_CMD_EVALSHA, &Ardb::EvalSHA, 2, -1, "sK", 0, 0, 0, 0, 0, 0 },
+        { "script", REDIS_CMD_SCRIPT, &Ardb::Script, 1, -1, "rs", 0, 0, 0, 0, 0, 0 },
+        { "randomkey", REDIS_CMD_RANDOMKEY, &Ardb::Randomkey, 0, 0, "r", 0, 0, 0, 0, 0, 0 },
+        { "scan", REDIS_CMD_SCAN, &Ardb::Scan, 1, 5, "r", 0, 0, 0, 0, 0, 0 },
+        { "geoadd", REDIS_CMD_GEO_ADD, &Ardb::GeoAdd, 4, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "georadius", REDIS_CMD_GEO_RADIUS, &Ardb::GeoRadius, 5, -1, "wK", 0, 0, 0, 1, 1, 1 },
+        { "georadiusbymember", REDIS_CMD_GEO_RADIUSBYMEMBER, &Ardb::GeoRadiusByMember, 4, 10, "wK", 0, 0, 0, 1, 1, 1 },
+        { "geohash", REDIS_CMD_GEO_HASH, &Ardb::GeoHash, 2, -1, "r", 0, 0, 0, 1, 1, 1 },
+        { "geodist", REDIS_CMD_GEO_DIST, &Ardb::GeoDist, 3, 4, "r", 0, 0, 0, 1, 1, 1 },
+        { "geopos", REDIS_CMD_GEO_POS, &Ardb::GeoPos, 2, -1, "r", 0, 0, 0, 1, 1, 1 },
+        { "auth", REDIS_CMD_AUTH, &Ardb::Auth, 1, 1, "rsltF", 0, 0, 0, 0, 0, 0 },
+        { "pfadd", REDIS_CMD_PFADD, &Ardb::PFAdd, 2, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "pfadd2", REDIS_CMD_PFADD2, &Ardb::PFAdd, 2, -1, "w", 0, 0, 0, 1, 1, 1 },
+        { "pfcount", REDIS_CMD_PFCOUNT, &Ardb::PFCount, 1, -1, "r", 0, 0, 0, 1, -1, 1 },
+        { "pfmerge", REDIS_CMD_PFMERGE, &Ardb::PFMerge, 2, -1, "w", 0, 0, 0, 1, -1, 1 },
+        { "dump", REDIS_CMD_DUMP, &Ardb::Dump, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+        { "restore", REDIS_CMD_RESTORE, &Ardb::Restore, 3, 4, "w", 0, 0, 0, 1, 1, 1 },
+        { "migrate", REDIS_CMD_MIGRATE, &Ardb::Migrate, 5, -1, "wK", 0, 0, 0, 0, 0, 0 },
+        { "migratedb", REDIS_CMD_MIGRATEDB, &Ardb::MigrateDB, 4, 4, "w", 0, 0, 0, 0, 0, 0 },
+        { "restorechunk", REDIS_CMD_RESTORECHUNK, &Ardb::RestoreChunk, 1, 1, "wl", 0, 0, 0, 0, 0, 0 },
+        { "restoredb", REDIS_CMD_RESTOREDB, &Ardb::RestoreDB, 1, 1, "wl", 0, 0, 0, 0, 0, 0 },
+        { "monitor", REDIS_CMD_MONITOR, &Ardb::Monitor, 0, 0, "ars", 0, 0, 0, 0, 0, 0 },
+        { "debug", REDIS_CMD_DEBUG, &Ardb::Debug, 1, -1, "ars", 0, 0, 0, 0, 0, 0 },
+        { "touch", REDIS_CMD_TOUCH, &Ardb::Touch, 1, -2, "rF", 0, 0, 0, 1, -1, 1 },
+		{ "command", REDIS_CMD_COMMAND, &Ardb::Command, 0, -1, "r", 0, 0, 0, 0, 0, 0 },
+		{ "xread", REDIS_CMD_XREAD, &Ardb::XRead, 2, -1, "rK", 0, 0, 0, 0, 0, 0 },
+		{ "xreadgroup", REDIS_CMD_XREAD, &Ardb::XRead, 5, -1, "rwK", 0, 0, 0, 0, 0, 0 },
+		{ "xadd", REDIS_CMD_XADD, &Ardb::XAdd, 4, -1, "w", 0, 0, 0, 1, 1, 1 },
+		{ "xlen", REDIS_CMD_XLEN, &Ardb::XLen, 1, 1, "r", 0, 0, 0, 1, 1, 1 },
+		{ "xpending", REDIS_CMD_XPENDING, &Ardb::XPending, 2, 6, "r", 0, 0, 0, 1, 1, 1 },
+		{ "xrange", REDIS_CMD_XRANGE, &Ardb::XRange, 3, 5, "r", 0, 0, 0, 1, 1, 1 },
+		{ "xrevrange", REDIS_CMD_XREVRANGE, &Ardb::XRevRange, 3, 5, "r", 0, 0, 0, 1, 1, 1 },
+		{ "xack", REDIS_CMD_XACK, &Ardb::XACK, 3, -1, "w", 0, 0, 0, 1, 1, 1 },
+		{ "xclaim", REDIS_CMD_XCLAIM, &Ardb::XClaim, 5, -1, "w", 0, 0, 0, 1, 1, 1 },
+		{ "xinfo", REDIS_CMD_XINFO, &Ardb::XInfo, 1, 3, "r", 0, 0, 0, 2, 2, 1 },
+		{ "xgroup", REDIS_CMD_XGROUP, &Ardb::XGroup, 1, 4, "w", 0, 0, 0, 2, 2, 1 },
+		{ "xtrim", REDIS_CMD_XTRIM, &Ardb::XTrim, 3, -1, "w", 0, 0, 0, 1, 1, 1 },
+		{ "xdel", REDIS_CMD_XDEL, &Ardb::XDel, 2, -1, "w", 0, 0, 0, 1, 1, 1 },
         };
 
         CostRanges cmdstat_ranges;
@@ -425,21 +466,34 @@ OP_NAMESPACE_BEGIN
                     case 'F':
                         settingTable[i].flags |= ARDB_CMD_FAST;
                         break;
+                    case 'K':
+                        settingTable[i].flags |= ARDB_CMD_MOVABLE_KEYS;
+                        break;
                     default:
                         break;
                 }
                 f++;
             }
-            m_settings[settingTable[i].name] = settingTable[i];
+            NEW(settingTable[i].latency, CommandLatencyHistogram);
+            m_settings.push_back(settingTable[i]);
+            m_settings_names.push_back(settingTable[i].name);
         }
+        BuildCommandIndex();
     }
 
     Ardb::~Ardb()
     {
     	StopBackGroundThread();
+        DELETE(g_group_committer);
         DELETE(m_engine);
         DELETE(m_ready_keys);
         DELETE(m_watched_ctxs);
+        DestroyKeyLockStripes();
+        DestroyMetaCache();
+        for (size_t i = 0; i < m_settings.size(); i++)
+        {
+            DELETE(m_settings[i].latency);
+        }
         ArdbLogger::DestroyDefaultLogger();
     }
 
@@ -503,6 +557,11 @@ OP_NAMESPACE_BEGIN
             printf("Failed to parse config file:%s\n", conf_file.c_str());
             return -1;
         }
+        if ((size_t) m_conf.key_lock_stripes != m_lock_stripes_num)
+        {
+            InitKeyLockStripes(m_conf.key_lock_stripes);
+        }
+        InitMetaCache(m_conf.meta_cache_shards, m_conf.meta_cache_size);
         if (m_conf.daemonize && !m_conf.servers.empty())
         {
             daemonize();
@@ -526,6 +585,10 @@ OP_NAMESPACE_BEGIN
 
         std::string dbdir = GetConf().data_base_path + "/" + g_engine_name;
         make_dir(dbdir);
+        if (0 != LoadKeyFormat(dbdir, m_conf.key_encoding))
+        {
+            return -1;
+        }
         int err = 0;
         m_engine = create_engine();
         if (NULL == m_engine)
@@ -545,6 +608,19 @@ OP_NAMESPACE_BEGIN
         }
         m_starttime = time(NULL);
         g_engine = m_engine;
+        if (m_conf.write_group_commit)
+        {
+            if (m_engine->GetFeatureSet().support_group_commit)
+            {
+                NEW(g_group_committer,
+                        GroupCommitter(m_engine, m_conf.write_group_commit_max_delay, m_conf.write_group_commit_max_batch, m_conf.write_group_commit_sync));
+            }
+            else
+            {
+                WARN_LOG("Engine:%s does not support group commit, 'write-group-commit' is ignored.", g_engine_name);
+            }
+        }
+        InitCollectionVersion();
         CreateBackGroundThread();
         INFO_LOG("Ardb init engine:%s success.", g_engine_name);
         return 0;
@@ -560,21 +636,340 @@ OP_NAMESPACE_BEGIN
         return m_engine->Repair(dir);
     }
 
+    /*
+     * The key format is fixed when a data dir is created and recorded in its KEY_FORMAT file,
+     * dirs created before the file existed are in legacy format.
+     */
+    int Ardb::LoadKeyFormat(const std::string& dir, const std::string& encoding)
+    {
+        uint8 format = KEY_FORMAT_LEGACY;
+        uint8 expected = KEY_FORMAT_LEGACY;
+        parse_key_format(encoding, expected);
+        std::string marker = dir + "/KEY_FORMAT";
+        std::string content;
+        if (0 == file_read_full(marker, content))
+        {
+            if (!parse_key_format(trim_string(content), format))
+            {
+                ERROR_LOG("Invalid key format:%s in %s", trim_string(content).c_str(), marker.c_str());
+                return -1;
+            }
+            if (format != expected)
+            {
+                WARN_LOG("Data dir:%s keeps its %s key format, 'key-encoding %s' only applies to new data dirs.",
+                        dir.c_str(), key_format_name(format), encoding.c_str());
+            }
+        }
+        else
+        {
+            std::deque<std::string> fs;
+            list_subfiles(dir, fs, true);
+            if (fs.empty())
+            {
+                format = expected;
+            }
+            else if (expected != KEY_FORMAT_LEGACY)
+            {
+                WARN_LOG("Data dir:%s is not empty, keep using legacy key format, use ardb-convert to convert it.",
+                        dir.c_str());
+            }
+            if (0 != file_write_content(marker, key_format_name(format)))
+            {
+                ERROR_LOG("Failed to write key format file:%s", marker.c_str());
+                return -1;
+            }
+        }
+        g_key_format = format;
+        INFO_LOG("Data dir:%s uses %s key format.", dir.c_str(), key_format_name(format));
+        return 0;
+    }
+
+    int Ardb::ConvertKeyFormat(const std::string& conf_file, const std::string& src_dir, const std::string& dst_dir,
+            const std::string& encoding)
+    {
+        Properties props;
+        if (!conf_file.empty() && (!parse_conf_file(conf_file, props, " ") || !m_conf.Parse(props)))
+        {
+            ERROR_LOG("Failed to parse config file:%s", conf_file.c_str());
+            return -1;
+        }
+        uint8 dst_format;
+        if (!parse_key_format(encoding, dst_format))
+        {
+            ERROR_LOG("Invalid key encoding:%s", encoding.c_str());
+            return -1;
+        }
+        if (!is_dir_exist(src_dir))
+        {
+            ERROR_LOG("Source data dir:%s does not exist.", src_dir.c_str());
+            return -1;
+        }
+        std::deque<std::string> fs;
+        list_subfiles(dst_dir, fs, true);
+        if (!fs.empty())
+        {
+            ERROR_LOG("Destination data dir:%s is not empty.", dst_dir.c_str());
+            return -1;
+        }
+        std::string options_key = g_engine_name;
+        options_key.append(".options");
+        std::string options_value;
+        conf_get_string(props, options_key, options_value);
+        std::string dump_file = dst_dir + ".convert";
+
+        /*
+         * the key format is process wide, so the source is exported in a child process
+         * and imported into the destination after the child exits.
+         */
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            ERROR_LOG("Failed to fork export process:%s", strerror(errno));
+            return -1;
+        }
+        if (0 == pid)
+        {
+            if (0 != LoadKeyFormat(src_dir, "legacy"))
+            {
+                _exit(1);
+            }
+            m_engine = create_engine();
+            if (NULL == m_engine || 0 != m_engine->Init(src_dir, options_value))
+            {
+                ERROR_LOG("Failed to open source data dir:%s", src_dir.c_str());
+                _exit(1);
+            }
+            g_engine = m_engine;
+            FILE* fp = fopen(dump_file.c_str(), "wb");
+            if (NULL == fp)
+            {
+                ERROR_LOG("Failed to open dump file:%s", dump_file.c_str());
+                _exit(1);
+            }
+            Context ctx;
+            DataArray nss;
+            m_engine->ListNameSpaces(ctx, nss);
+            Buffer buffer;
+            uint64 count = 0;
+            for (size_t i = 0; i < nss.size(); i++)
+            {
+                KeyObject empty;
+                empty.SetNameSpace(nss[i]);
+                ctx.ns = nss[i];
+                Iterator* iter = m_engine->Find(ctx, empty);
+                while (NULL != iter && iter->Valid())
+                {
+                    KeyObject& k = iter->Key();
+                    k.SetNameSpace(nss[i]);
+                    Buffer key_buffer;
+                    BufferHelper::WriteVarSlice(buffer, k.Encode(key_buffer, false, true, dst_format));
+                    BufferHelper::WriteVarSlice(buffer, iter->RawValue());
+                    count++;
+                    if (buffer.ReadableBytes() >= 1024 * 1024)
+                    {
+                        fwrite(buffer.GetRawReadBuffer(), 1, buffer.ReadableBytes(), fp);
+                        buffer.Clear();
+                    }
+                    iter->Next();
+                }
+                DELETE(iter);
+            }
+            if (buffer.Readable())
+            {
+                fwrite(buffer.GetRawReadBuffer(), 1, buffer.ReadableBytes(), fp);
+            }
+            int err = ferror(fp);
+            fclose(fp);
+            INFO_LOG("Exported %llu records from %s.", count, src_dir.c_str());
+            _exit(0 == err ? 0 : 1);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || 0 != WEXITSTATUS(status))
+        {
+            ERROR_LOG("Failed to export data from %s.", src_dir.c_str());
+            unlink(dump_file.c_str());
+            return -1;
+        }
+
+        make_dir(dst_dir);
+        if (0 != LoadKeyFormat(dst_dir, encoding))
+        {
+            return -1;
+        }
+        m_engine = create_engine();
+        if (NULL == m_engine || 0 != m_engine->Init(dst_dir, options_value))
+        {
+            ERROR_LOG("Failed to open destination data dir:%s", dst_dir.c_str());
+            return -1;
+        }
+        g_engine = m_engine;
+        FILE* fp = fopen(dump_file.c_str(), "rb");
+        if (NULL == fp)
+        {
+            ERROR_LOG("Failed to open dump file:%s", dump_file.c_str());
+            return -1;
+        }
+        Context ctx;
+        ctx.flags.create_if_notexist = 1;
+        ctx.flags.bulk_loading = 1;
+        m_engine->BeginBulkLoad(ctx);
+        Buffer buffer;
+        uint64 count = 0;
+        int err = 0;
+        bool eof = false;
+        while (0 == err && !eof)
+        {
+            buffer.DiscardReadedBytes();
+            buffer.EnsureWritableBytes(1024 * 1024);
+            size_t n = fread(const_cast<char*>(buffer.GetRawWriteBuffer()), 1, buffer.WriteableBytes(), fp);
+            buffer.AdvanceWriteIndex(n);
+            eof = (0 == n);
+            while (buffer.Readable())
+            {
+                size_t mark = buffer.GetReadIndex();
+                Slice key, value;
+                if (!BufferHelper::ReadVarSlice(buffer, key) || !BufferHelper::ReadVarSlice(buffer, value))
+                {
+                    /*
+                     * record is not complete, read more content
+                     */
+                    buffer.SetReadIndex(mark);
+                    if (eof)
+                    {
+                        ERROR_LOG("Corrupted dump file:%s", dump_file.c_str());
+                        err = -1;
+                    }
+                    break;
+                }
+                Data ns;
+                Buffer key_buffer(const_cast<char*>(key.data()), 0, key.size());
+                if (!decode_key_namespace(key_buffer, ns, false))
+                {
+                    ERROR_LOG("Invalid key namespace in dump file:%s", dump_file.c_str());
+                    err = -1;
+                    break;
+                }
+                ctx.ns = ns;
+                err = m_engine->PutRaw(ctx, ns, Slice(key_buffer.GetRawReadBuffer(), key_buffer.ReadableBytes()), value);
+                if (0 != err)
+                {
+                    ERROR_LOG("Failed to write record into %s with error:%d", dst_dir.c_str(), err);
+                    break;
+                }
+                count++;
+            }
+        }
+        fclose(fp);
+        unlink(dump_file.c_str());
+        m_engine->EndBulkLoad(ctx);
+        if (0 == err)
+        {
+            m_engine->CompactAll(ctx);
+            INFO_LOG("Imported %llu records into %s with %s key format.", count, dst_dir.c_str(), key_format_name(g_key_format));
+        }
+        return err;
+    }
+
     void Ardb::RenameCommand()
     {
         StringStringMap::const_iterator it = GetConf().rename_commands.begin();
         while (it != GetConf().rename_commands.end())
         {
             std::string cmd = string_tolower(it->first);
-            RedisCommandHandlerSettingTable::iterator found = m_settings.find(cmd);
-            if (found != m_settings.end())
+            for (size_t i = 0; i < m_settings_names.size(); i++)
             {
-                RedisCommandHandlerSetting setting = found->second;
-                m_settings.erase(found);
-                m_settings[it->second] = setting;
+                if (m_settings_names[i] == cmd)
+                {
+                    m_settings_names[i] = string_tolower(it->second);
+                }
             }
             it++;
         }
+        BuildCommandIndex();
+    }
+
+    void Ardb::BuildCommandIndex()
+    {
+        /*
+         * a name given twice (a rename onto an existing command) dispatches to its last entry
+         */
+        std::map<std::string, int32> names;
+        for (size_t i = 0; i < m_settings_names.size(); i++)
+        {
+            if (!m_settings_names[i].empty())
+            {
+                names[m_settings_names[i]] = i;
+            }
+        }
+        uint32 num = names.size();
+        uint32 slots_num = 1;
+        while (slots_num < num * 2)
+        {
+            slots_num <<= 1;
+        }
+        uint32 buckets_num = slots_num >= 8 ? slots_num / 4 : 2;
+        std::vector<std::vector<int32> > buckets;
+        for (uint32 seed = 0;; seed++)
+        {
+            buckets.assign(buckets_num, std::vector<int32>());
+            std::map<std::string, int32>::iterator it = names.begin();
+            while (it != names.end())
+            {
+                uint32 h1, h2;
+                command_hash(it->first.data(), it->first.size(), seed, h1, h2);
+                buckets[h1 & (buckets_num - 1)].push_back(it->second);
+                it++;
+            }
+            /*
+             * place the fullest buckets first, each one with the first displacement where all its names land
+             * on free slots
+             */
+            std::vector<std::pair<size_t, uint32> > order;
+            for (uint32 b = 0; b < buckets_num; b++)
+            {
+                order.push_back(std::make_pair(buckets[b].size(), b));
+            }
+            std::sort(order.rbegin(), order.rend());
+            m_settings_disps.assign(buckets_num, 0);
+            m_settings_slots.assign(slots_num, -1);
+            bool placed = true;
+            for (uint32 k = 0; k < buckets_num && placed && order[k].first > 0; k++)
+            {
+                std::vector<int32>& bucket = buckets[order[k].second];
+                placed = false;
+                for (uint32 disp = 0; disp < 4 * slots_num && !placed; disp++)
+                {
+                    std::vector<uint32> taken;
+                    for (size_t j = 0; j < bucket.size(); j++)
+                    {
+                        const std::string& name = m_settings_names[bucket[j]];
+                        uint32 h1, h2;
+                        command_hash(name.data(), name.size(), seed, h1, h2);
+                        uint32 slot = command_slot_hash(h2, disp) & (slots_num - 1);
+                        if (m_settings_slots[slot] >= 0 || std::find(taken.begin(), taken.end(), slot) != taken.end())
+                        {
+                            break;
+                        }
+                        taken.push_back(slot);
+                    }
+                    if (taken.size() == bucket.size())
+                    {
+                        for (size_t j = 0; j < bucket.size(); j++)
+                        {
+                            m_settings_slots[taken[j]] = bucket[j];
+                        }
+                        m_settings_disps[order[k].second] = disp;
+                        placed = true;
+                    }
+                }
+            }
+            if (placed)
+            {
+                m_settings_seed = seed;
+                break;
+            }
+        }
     }
 
     void Ardb::OpenWriteLatchByWriteCaller()
@@ -629,6 +1024,10 @@ OP_NAMESPACE_BEGIN
     {
         int ret = 0;
         ret = m_engine->Put(ctx, key, val);
+        if (key.GetType() == KEY_META)
+        {
+            InvalidateMeta(key);
+        }
         if (0 == ret)
         {
             TouchWatchKey(ctx, key);
@@ -639,6 +1038,10 @@ OP_NAMESPACE_BEGIN
     int Ardb::MergeKeyValue(Context& ctx, const KeyObject& key, uint16 op, const DataArray& args)
     {
         int ret = m_engine->Merge(ctx, key, op, args);
+        if (key.GetType() == KEY_META)
+        {
+            InvalidateMeta(key);
+        }
         if (0 == ret)
         {
             TouchWatchKey(ctx, key);
@@ -649,6 +1052,10 @@ OP_NAMESPACE_BEGIN
     int Ardb::RemoveKey(Context& ctx, const KeyObject& key)
     {
         int ret = m_engine->Del(ctx, key);
+        if (key.GetType() == KEY_META)
+        {
+            InvalidateMeta(key);
+        }
         if (0 == ret)
         {
             TouchWatchKey(ctx, key);
@@ -662,6 +1069,10 @@ OP_NAMESPACE_BEGIN
         if (NULL != iter)
         {
             iter->Del();
+            if (key.GetType() == KEY_META)
+            {
+                InvalidateMeta(key);
+            }
             TouchWatchKey(ctx, key);
             ctx.dirty++;
         }
@@ -698,6 +1109,7 @@ OP_NAMESPACE_BEGIN
     int Ardb::FlushDB(Context& ctx, const Data& ns)
     {
         m_engine->DropNameSpace(ctx, ns);
+        InvalidateAllMetas();
         ctx.dirty += 1000; //makesure all
         TouchWatchedKeysOnFlush(ctx, ns);
         return 0;
@@ -710,78 +1122,407 @@ OP_NAMESPACE_BEGIN
         {
             m_engine->DropNameSpace(ctx, nss[i]);
         }
+        InvalidateAllMetas();
         ctx.dirty += 1000;
         Data empty_ns; //indicate all namespaces
         TouchWatchedKeysOnFlush(ctx, empty_ns);
         return 0;
     }
 
+    void Ardb::InitKeyLockStripes(size_t num)
+    {
+        DestroyKeyLockStripes();
+        if (num == 0)
+        {
+            num = 1;
+        }
+        m_lock_stripes = new KeyLockStripe[num];
+        m_lock_stripes_num = num;
+    }
+
+    void Ardb::DestroyKeyLockStripes()
+    {
+        if (NULL == m_lock_stripes)
+        {
+            return;
+        }
+        for (size_t i = 0; i < m_lock_stripes_num; i++)
+        {
+            KeyLockStripe& stripe = m_lock_stripes[i];
+            for (size_t j = 0; j < stripe.entries.size(); j++)
+            {
+                DELETE(stripe.entries[j].lock);
+            }
+            while (!stripe.lock_pool.empty())
+            {
+                ThreadMutexLock* lock = stripe.lock_pool.top();
+                DELETE(lock);
+                stripe.lock_pool.pop();
+            }
+        }
+        DELETE_A(m_lock_stripes);
+        m_lock_stripes_num = 0;
+    }
+
+    Ardb::KeyLockStripe& Ardb::GetKeyLockStripe(const KeyPrefix& lk, size_t& hash)
+    {
+        hash = lk.Hash();
+        return m_lock_stripes[hash % m_lock_stripes_num];
+    }
+
+    static void copy_lock_entry_data(Data& dst, std::string& buf, const Data& src)
+    {
+        if (src.IsString())
+        {
+            buf.assign(src.CStr(), src.StringLength());
+            dst.SetString(buf.data(), buf.size(), false);
+        }
+        else
+        {
+            dst = src;
+        }
+    }
+
+    /*
+     * Called under the stripe spin lock: the key is copied into buffers kept by the entry slot, which only
+     * allocate when a longer key than before is locked through that slot.
+     */
+    void Ardb::SetKeyLockEntryKey(KeyLockEntry& entry, const KeyPrefix& lk)
+    {
+        copy_lock_entry_data(entry.key.ns, entry.ns_buf, lk.ns);
+        copy_lock_entry_data(entry.key.key, entry.key_buf, lk.key);
+    }
+
     bool Ardb::LockKey(const KeyPrefix& lk, int wait_limit)
     {
-//        KeyPrefix lk;
-//        lk.ns = key.GetNameSpace();
-//        lk.key = key.GetKey();
+        size_t hash;
+        KeyLockStripe& stripe = GetKeyLockStripe(lk, hash);
         int wait_counter = 0;
         while (wait_limit <= 0 || wait_counter < wait_limit)
         {
             ThreadMutexLock* lock = NULL;
             {
-                LockGuard<SpinMutexLock> guard(m_locking_keys_lock);
-                std::pair<LockTable::iterator, bool> ret = m_locking_keys.insert(LockTable::value_type(lk, NULL));
-                if (!ret.second && NULL != ret.first->second)
+                LockGuard<SpinMutexLock> guard(stripe.lock);
+                KeyLockEntry* free_entry = NULL;
+                for (size_t i = 0; i < stripe.entries.size(); i++)
                 {
-                    /*
-                     * already locked by other thread, wait until unlocked
-                     */
-                    lock = ret.first->second;
+                    KeyLockEntry& entry = stripe.entries[i];
+                    if (NULL == entry.lock)
+                    {
+                        if (NULL == free_entry)
+                        {
+                            free_entry = &entry;
+                        }
+                    }
+                    else if (entry.hash == hash && entry.key == lk)
+                    {
+                        /*
+                         * already locked by other thread, wait until unlocked
+                         */
+                        lock = entry.lock;
+                        break;
+                    }
                 }
-                else
+                if (NULL == lock)
                 {
                     /*
-                     * no other thread lock on the key
+                     * no other thread lock on the key, entry slots are reused to avoid allocation
                      */
-                    if (!m_lock_pool.empty())
+                    if (NULL == free_entry)
                     {
-                        lock = m_lock_pool.top();
-                        m_lock_pool.pop();
+                        stripe.entries.resize(stripe.entries.size() + 1);
+                        free_entry = &(stripe.entries[stripe.entries.size() - 1]);
+                    }
+                    if (!stripe.lock_pool.empty())
+                    {
+                        free_entry->lock = stripe.lock_pool.top();
+                        stripe.lock_pool.pop();
                     }
                     else
                     {
-                        NEW(lock, ThreadMutexLock);
+                        NEW(free_entry->lock, ThreadMutexLock);
+                    }
+                    free_entry->hash = hash;
+                    SetKeyLockEntryKey(*free_entry, lk);
+                    stripe.acquired++;
+                    if (wait_counter > 0)
+                    {
+                        stripe.contended++;
                     }
-                    ret.first->second = lock;
                     return true;
                 }
+                stripe.waits++;
             }
+            LockGuard<ThreadMutexLock> guard(*lock);
+            lock->Wait(1, MILLIS);
+            wait_counter++;
+        }
+        return false;
+    }
+    void Ardb::UnlockKey(const KeyPrefix& lk)
+    {
+        /*
+         * writers may update the meta without going through SetKeyValue/RemoveKey, drop the cached one before
+         * others could lock the key
+         */
+        InvalidateMeta(lk);
+        size_t hash;
+        KeyLockStripe& stripe = GetKeyLockStripe(lk, hash);
+        LockGuard<SpinMutexLock> guard(stripe.lock);
+        for (size_t i = 0; i < stripe.entries.size(); i++)
+        {
+            KeyLockEntry& entry = stripe.entries[i];
+            if (NULL != entry.lock && entry.hash == hash && entry.key == lk)
+            {
+                ThreadMutexLock* lock = entry.lock;
+                entry.lock = NULL;
+                entry.key.Clear();
+                if (entry.key_buf.capacity() > kKeyLockEntryMaxCapacity)
+                {
+                    std::string().swap(entry.key_buf);
+                }
+                stripe.lock_pool.push(lock);
+                LockGuard<ThreadMutexLock> guard(*lock);
+                lock->Notify();
+                return;
+            }
+        }
+    }
+
+    void Ardb::GetKeyLockStats(uint64& acquired, uint64& contended, uint64& waits)
+    {
+        acquired = contended = waits = 0;
+        for (size_t i = 0; i < m_lock_stripes_num; i++)
+        {
+            KeyLockStripe& stripe = m_lock_stripes[i];
+            LockGuard<SpinMutexLock> guard(stripe.lock);
+            acquired += stripe.acquired;
+            contended += stripe.contended;
+            waits += stripe.waits;
+        }
+    }
+
+    void Ardb::InitMetaCache(size_t shards, size_t max_size)
+    {
+        DestroyMetaCache();
+        if (0 == max_size)
+        {
+            return;
+        }
+        if (0 == shards)
+        {
+            shards = 1;
+        }
+        m_meta_cache_shards = new MetaCacheShard[shards];
+        m_meta_cache_shards_num = shards;
+        size_t shard_size = max_size / shards;
+        for (size_t i = 0; i < shards; i++)
+        {
+            m_meta_cache_shards[i].cache.SetMaxCacheSize(shard_size > 0 ? shard_size : 1);
+        }
+    }
+
+    void Ardb::DestroyMetaCache()
+    {
+        DELETE_A(m_meta_cache_shards);
+        m_meta_cache_shards_num = 0;
+    }
+
+    int Ardb::GetMeta(Context& ctx, const KeyObject& key, ValueObject& meta)
+    {
+        if (NULL != ctx.prefetched_metas)
+        {
+            PrefetchedMetaTable* prefetched = (PrefetchedMetaTable*) ctx.prefetched_metas;
+            KeyPrefix prefix;
+            prefix.ns = key.GetNameSpace();
+            prefix.key = key.GetKey();
+            PrefetchedMetaTable::iterator found = prefetched->find(prefix);
+            if (found != prefetched->end())
+            {
+                /*
+                 * served once, a later read of the same key in the run may follow a write
+                 */
+                meta = found->second;
+                prefetched->erase(found);
+                return meta.GetType() > 0 ? 0 : ERR_ENTRY_NOT_EXIST;
+            }
+        }
+        /*
+         * metas read inside an EXEC batch may not be committed yet
+         */
+        if (0 == m_meta_cache_shards_num || NULL != ctx.engine_snapshot || NULL != ctx.transc_keys || IsLoadingData())
+        {
+            return m_engine->Get(ctx, key, meta);
+        }
+        KeyPrefix prefix;
+        prefix.ns = key.GetNameSpace();
+        prefix.key = key.GetKey();
+        MetaCacheShard& shard = m_meta_cache_shards[prefix.Hash() % m_meta_cache_shards_num];
+        uint64 version = 0;
+        uint64 epoch = m_meta_cache_epoch;
+        {
+            LockGuard<SpinMutexLock> guard(shard.lock);
+            MetaCacheEntry entry;
+            if (shard.cache.Get(prefix, entry) && entry.epoch == epoch)
+            {
+                shard.hits++;
+                meta = entry.meta;
+                return 0;
+            }
+            shard.misses++;
+            version = shard.version;
+        }
+        int err = m_engine->Get(ctx, key, meta);
+        /*
+         * string values may be large, only metas of collections are cached
+         */
+        if (0 != err || meta.GetType() == KEY_STRING)
+        {
+            return err;
+        }
+        MetaCacheEntry entry;
+        entry.epoch = epoch;
+        entry.meta = meta;
+        entry.meta.CloneStringPart();
+        if (prefix.ns.IsString())
+        {
+            prefix.ns.ToMutableStr();
+        }
+        if (prefix.key.IsString())
+        {
+            prefix.key.ToMutableStr();
+        }
+        LockGuard<SpinMutexLock> guard(shard.lock);
+        if (shard.version == version && m_meta_cache_epoch == epoch)
+        {
+            MetaLRUCache::CacheEntry erased;
+            shard.cache.Insert(prefix, entry, erased);
+        }
+        return 0;
+    }
+
+    /*
+     * Loads the metas of a run of pipelined point reads with one MultiGet, the following GetMeta calls
+     * on these keys are served from ctx until ClearPrefetchedMetas.
+     */
+    void Ardb::PrefetchMetas(Context& ctx, const StringArray& keys)
+    {
+        ClearPrefetchedMetas(ctx);
+        KeyObjectArray ks;
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            KeyObject k(ctx.ns, KEY_META, keys[i]);
+            ks.push_back(k);
+        }
+        ValueObjectArray vs;
+        ErrCodeArray errs;
+        if (0 != m_engine->MultiGet(ctx, ks, vs, errs))
+        {
+            return;
+        }
+        PrefetchedMetaTable* prefetched = NULL;
+        NEW(prefetched, PrefetchedMetaTable);
+        for (size_t i = 0; i < ks.size(); i++)
+        {
+            if (errs[i] != 0 && errs[i] != ERR_ENTRY_NOT_EXIST)
+            {
+                continue;
+            }
+            KeyPrefix prefix;
+            prefix.ns = ks[i].GetNameSpace();
+            prefix.key = ks[i].GetKey();
+            if (prefix.ns.IsString())
+            {
+                prefix.ns.ToMutableStr();
+            }
+            if (prefix.key.IsString())
+            {
+                prefix.key.ToMutableStr();
+            }
+            ValueObject& v = (*prefetched)[prefix];
+            if (0 == errs[i])
+            {
+                v = vs[i];
+                v.CloneStringPart();
+            }
+        }
+        ctx.prefetched_metas = prefetched;
+    }
+
+    void Ardb::ClearPrefetchedMetas(Context& ctx)
+    {
+        if (NULL != ctx.prefetched_metas)
+        {
+            PrefetchedMetaTable* prefetched = (PrefetchedMetaTable*) ctx.prefetched_metas;
+            DELETE(prefetched);
+            ctx.prefetched_metas = NULL;
+        }
+    }
+
+    /*
+     * Locks the keys of a run of pipelined writes sharing one write batch until UnlockRunKeys, so that no
+     * other client reads or writes them before the batch is committed. The key lock guards of the run skip
+     * these keys the same way as inside EXEC.
+     */
+    void Ardb::LockRunKeys(Context& ctx, const StringArray& keys, KeyPrefixSet& ks)
+    {
+        ks.clear();
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            KeyPrefix lk;
+            lk.ns = ctx.ns;
+            lk.key.SetString(keys[i], false);
+            ks.insert(lk);
+        }
+        LockKeys(ks);
+        ctx.transc_keys = &ks;
+    }
+
+    void Ardb::UnlockRunKeys(Context& ctx)
+    {
+        if (NULL != ctx.transc_keys)
+        {
+            UnlockKeys(*ctx.transc_keys);
+            ctx.transc_keys = NULL;
+        }
+    }
 
-            if (NULL != lock)
-            {
-                LockGuard<ThreadMutexLock> guard(*lock);
-                lock->Wait(1, MILLIS);
-                wait_counter++;
-            }
+    void Ardb::InvalidateMeta(const KeyPrefix& prefix)
+    {
+        if (0 == m_meta_cache_shards_num)
+        {
+            return;
         }
-        return false;
+        MetaCacheShard& shard = m_meta_cache_shards[prefix.Hash() % m_meta_cache_shards_num];
+        LockGuard<SpinMutexLock> guard(shard.lock);
+        MetaCacheEntry erased;
+        shard.cache.Erase(prefix, erased);
+        shard.version++;
     }
-    void Ardb::UnlockKey(const KeyPrefix& lk)
+
+    void Ardb::InvalidateMeta(const KeyObject& key)
+    {
+        KeyPrefix prefix;
+        prefix.ns = key.GetNameSpace();
+        prefix.key = key.GetKey();
+        InvalidateMeta(prefix);
+    }
+
+    void Ardb::InvalidateAllMetas()
+    {
+        atomic_add_uint64(&m_meta_cache_epoch, 1);
+    }
+
+    void Ardb::GetMetaCacheStats(uint64& hits, uint64& misses, uint64& keys)
     {
-//        KeyPrefix lk;
-//        lk.ns = key.GetNameSpace();
-//        lk.key = key.GetKey();
+        hits = misses = keys = 0;
+        for (size_t i = 0; i < m_meta_cache_shards_num; i++)
         {
-            LockGuard<SpinMutexLock> guard(m_locking_keys_lock);
-            LockTable::iterator ret = m_locking_keys.find(lk);
-            if (ret != m_locking_keys.end())
-            {
-                ThreadMutexLock* lock = ret->second;
-                m_locking_keys.erase(ret);
-                if(NULL != lock)
-                {
-                    m_lock_pool.push(lock);
-                    LockGuard<ThreadMutexLock> guard(*lock);
-                    lock->Notify();
-                }
-            }
+            MetaCacheShard& shard = m_meta_cache_shards[i];
+            LockGuard<SpinMutexLock> guard(shard.lock);
+            hits += shard.hits;
+            misses += shard.misses;
+            keys += shard.cache.Size();
         }
     }
 
@@ -840,15 +1581,27 @@ OP_NAMESPACE_BEGIN
         FeedReplicationBacklog(ctx, ns, del);
     }
 
-    void Ardb::FeedReplicationBacklog(Context& ctx, const Data& ns, RedisCommandFrame& cmd)
+    void Ardb::FeedReplicationBacklog(Context& ctx, const Data& ns, RedisCommandFrame& cmd, bool reserved)
     {
         if (!g_repl->IsInited())
         {
             return;
         }
+        if (NULL != ctx.repl_staged)
+        {
+            /*
+             * the write batch is not committed yet, see FeedStagedReplication
+             */
+            ctx.repl_staged->ns.push_back(ns);
+            if (ctx.repl_staged->ns.back().IsString())
+            {
+                ctx.repl_staged->ns.back().ToMutableStr();
+            }
+            ctx.repl_staged->cmds.push_back(cmd);
+            return;
+        }
         /*
-         * Since this method may be invoked by multi threads, there is a potential risk that replication commands may have wrong sequence
-         * if one thread do db operation first but feed replication log later.
+         * Since this method may be invoked by multi threads, a thread may do db operation first but feed replication log later.
          * eg:
          * Thread A: lpush mylist a (1)  Thread B: lpush mylist b (2)
          *                   |                        |
@@ -856,17 +1609,29 @@ OP_NAMESPACE_BEGIN
          *                     Replication Log Thread
          *                      lpush mylist b
          *                      lpush mylist a
-         * This risk only has data inconsistent effect when multi-threads operating on same key at the same time which is also a rare condition.
-         * If multi-threads operating on different keys at the same time,there is no any risk.
-         *
-         *
+         * Write commands reserve their replication sequence before releasing the key locks (see KeyLockGuard),
+         * the replication thread merges the per thread staged commands by that sequence, so commands operating
+         * on the same key are logged in the order they were applied. Only DoCall feeds with 'reserved' set.
          */
 //        if (!ctx.keyslocked)
 //        {
 //            ERROR_LOG("Can NOT feed replication wal log without key locked");
 //            return;
 //        }
-        g_repl->GetReplLog().WriteWAL(ns, cmd);
+        g_repl->GetReplLog().WriteWAL(ns, cmd, reserved);
+    }
+
+    /*
+     * Logs the commands of a committed write batch as one replication entry, wrapped into MULTI/EXEC for a
+     * transaction. Must be called before the keys of the batch are unlocked, like a single command would.
+     */
+    void Ardb::FeedStagedReplication(StagedReplication& staged, bool transaction)
+    {
+        if (g_repl->IsInited() && !staged.cmds.empty())
+        {
+            g_repl->GetReplLog().WriteWAL(staged.ns, staged.cmds, transaction);
+        }
+        staged.Clear();
     }
 
     void Ardb::SaveTTL(Context& ctx, const Data& ns, const std::string& key, int64 old_ttl, int64_t new_ttl)
@@ -905,22 +1670,175 @@ OP_NAMESPACE_BEGIN
         }
     }
 
-    void Ardb::ScanTTLDB()
+    /*
+     * Versions come from the clock so that they keep growing across restarts, the counter is
+     * seeded with the pending stale versions in case the clock went backwards.
+     */
+    void Ardb::NewCollectionVersion(ValueObject& meta)
+    {
+        while (true)
+        {
+            uint64 last = m_collection_version;
+            uint64 v = get_current_epoch_micros();
+            if (v <= last)
+            {
+                v = last + 1;
+            }
+            if (atomic_cmp_set_uint64(&m_collection_version, last, v))
+            {
+                meta.GetMetaObject().version = v;
+                return;
+            }
+        }
+    }
+
+    int Ardb::InitCollectionVersion()
+    {
+        Context ctx;
+        Data tll_ns(TTL_DB_NSMAESPACE, false);
+        KeyObject start(tll_ns, KEY_STALE_VERSION, "");
+        Iterator* iter = m_engine->Find(ctx, start);
+        int64 pending = 0;
+        while (NULL != iter && iter->Valid())
+        {
+            KeyObject& k = iter->Key();
+            if (k.GetType() != KEY_STALE_VERSION)
+            {
+                break;
+            }
+            if (k.GetStaleVersion() > m_collection_version)
+            {
+                m_collection_version = k.GetStaleVersion();
+            }
+            pending++;
+            iter->Next();
+        }
+        DELETE(iter);
+        if (pending > 0)
+        {
+            INFO_LOG("%lld stale collection versions to sweep.", pending);
+        }
+        return 0;
+    }
+
+    int64 Ardb::ExpireKeys(Context& ctx, ExpireCandidateArray& candidates)
     {
         /*
-         * only works with engine that has no compactfilter support
+         * keys are try-locked, a key locked by others is skipped instead of blocking the whole batch
          */
-        if (m_engine->GetFeatureSet().support_compactfilter || !GetConf().master_host.empty())
+        KeyObjectArray keys;
+        std::vector<size_t> idxs;
+        std::vector<KeyPrefix> locks;
+        for (size_t i = 0; i < candidates.size(); i++)
         {
-            return;
+            KeyPrefix lk;
+            lk.ns = candidates[i].key.GetNameSpace();
+            lk.key = candidates[i].key.GetKey();
+            if (!LockKey(lk, 1))
+            {
+                candidates[i].skipped = true;
+                continue;
+            }
+            keys.push_back(candidates[i].key);
+            idxs.push_back(i);
+            locks.push_back(lk);
+        }
+        if (keys.empty())
+        {
+            return 0;
+        }
+        /*
+         * engines may resolve the namespace of MultiGet from the context, so metas are fetched by runs of same namespace keys
+         */
+        ValueObjectArray metas(keys.size());
+        ErrCodeArray errs(keys.size(), ERR_ENTRY_NOT_EXIST);
+        size_t run_start = 0;
+        for (size_t i = 1; i <= keys.size(); i++)
+        {
+            if (i < keys.size() && keys[i].GetNameSpace() == keys[run_start].GetNameSpace())
+            {
+                continue;
+            }
+            KeyObjectArray run_keys(keys.begin() + run_start, keys.begin() + i);
+            ValueObjectArray run_metas;
+            ErrCodeArray run_errs;
+            ctx.ns = keys[run_start].GetNameSpace();
+            m_engine->MultiGet(ctx, run_keys, run_metas, run_errs);
+            for (size_t j = 0; j < run_keys.size() && j < run_metas.size() && j < run_errs.size(); j++)
+            {
+                metas[run_start + j] = run_metas[j];
+                errs[run_start + j] = run_errs[j];
+            }
+            run_start = i;
+        }
+        std::vector<bool> async_deletes(keys.size(), false);
+        int64 expired_keys = 0;
+        uint64 now = get_current_epoch_millis();
+        {
+            WriteBatchGuard batch(ctx, m_engine);
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                ExpireCandidate& c = candidates[idxs[i]];
+                ValueObject& meta = metas[i];
+                ctx.ns = keys[i].GetNameSpace();
+                if (c.ttl > 0)
+                {
+                    m_engine->Del(ctx, c.ttl_key);
+                }
+                if (0 != errs[i] || meta.GetType() == 0 || meta.GetTTL() <= 0)
+                {
+                    continue;
+                }
+                if (c.ttl > 0 ? meta.GetTTL() != c.ttl : (uint64) meta.GetTTL() > now)
+                {
+                    continue;
+                }
+                if (meta.GetType() == KEY_STRING)
+                {
+                    RemoveKey(ctx, keys[i]);
+                }
+                else if (GetConf().expire_async_delete_min_size > 0
+                        && (meta.GetObjectLen() < 0 || meta.GetObjectLen() >= GetConf().expire_async_delete_min_size))
+                {
+                    async_deletes[i] = true;
+                }
+                else
+                {
+                    DelKey(ctx, keys[i]);
+                }
+                expired_keys++;
+                FeedReplicationDelOperation(ctx, keys[i].GetNameSpace(), keys[i].GetKey().AsString());
+            }
+        }
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            if (async_deletes[i])
+            {
+                /*
+                 * the key lock is handed over to the background thread, which unlocks it after the deletion
+                 */
+                AsyncDeleteLockedKey(locks[i]);
+            }
+            else
+            {
+                UnlockKey(locks[i]);
+            }
         }
+        return expired_keys;
+    }
+
+    int64 Ardb::ScanTTLDB(uint64 deadline, bool& backlog)
+    {
+        /*
+         * only works with engine that has no compactfilter support
+         */
+        m_expire_backlog_keys = 0;
         if (0 == m_min_ttl)
         {
-            return;
+            return 0;
         }
-        uint32 max_scan_keys_one_iter = 1000;
-        uint32 scaned_keys = 0;
-        uint32 total_expired_keys = 0;
+        int64 total_expired_keys = 0;
+        int64 min_skipped_ttl = 0;
         Context scan_ctx;
         Data tll_ns(TTL_DB_NSMAESPACE, false);
         KeyObject scan_key(tll_ns, KEY_TTL_SORT, "");
@@ -930,140 +1848,170 @@ OP_NAMESPACE_BEGIN
         {
             m_min_ttl = 0; //no expire key
         }
-        uint64 start_time = get_current_epoch_millis();
-        while (iter->Valid() && scaned_keys < max_scan_keys_one_iter)
+        ExpireCandidateArray candidates;
+        uint64 now = get_current_epoch_millis();
+        while (iter->Valid())
         {
-            KeyObject& k = iter->Key(true);
-            m_min_ttl = k.GetTTL();
-            if (k.GetTTL() > (int64_t)get_current_epoch_millis())
+            if (now >= deadline)
             {
+                backlog = true;
                 break;
             }
-            scaned_keys++;
-            ValueObject meta;
-            KeyObject meta_key(k.GetElement(1), KEY_META, k.GetElement(2));
-            KeyLockGuard guard(scan_ctx, meta_key);
-            if (0 == m_engine->Get(scan_ctx, meta_key, meta))
+            candidates.clear();
+            while (iter->Valid() && candidates.size() < (size_t) GetConf().expire_batch_size)
             {
-                if (meta.GetTTL() == k.GetTTL())
+                KeyObject& k = iter->Key(true);
+                m_min_ttl = k.GetTTL();
+                if (k.GetTTL() > (int64_t) now)
                 {
-                    //delete whole key
-                    if (meta.GetType() == KEY_STRING)
-                    {
-                        m_engine->Del(scan_ctx, meta_key);
-                    }
-                    else
-                    {
-                        DelKey(scan_ctx, meta_key);
-                    }
-                    total_expired_keys++;
-                    FeedReplicationDelOperation(scan_ctx, meta_key.GetNameSpace(), meta_key.GetKey().AsString());
+                    break;
                 }
+                candidates.resize(candidates.size() + 1);
+                ExpireCandidate& c = candidates.back();
+                c.key = KeyObject(k.GetElement(1), KEY_META, k.GetElement(2));
+                c.ttl = k.GetTTL();
+                c.ttl_key = k;
+                iter->Next();
             }
-            else
+            if (candidates.empty())
             {
-
+                break;
             }
-            iter->Del();
-            iter->Next();
+            total_expired_keys += ExpireKeys(scan_ctx, candidates);
+            for (size_t i = 0; i < candidates.size(); i++)
+            {
+                if (candidates[i].skipped && (0 == min_skipped_ttl || candidates[i].ttl < min_skipped_ttl))
+                {
+                    min_skipped_ttl = candidates[i].ttl;
+                }
+            }
+            now = get_current_epoch_millis();
+        }
+        if (backlog)
+        {
+            /*
+             * count the expired entries left behind, at most 10000 entries are counted
+             */
+            int64 backlog_keys = 0;
+            while (iter->Valid() && backlog_keys < 10000 && iter->Key(false).GetTTL() <= (int64_t) now)
+            {
+                backlog_keys++;
+                iter->Next();
+            }
+            m_expire_backlog_keys = backlog_keys;
         }
         DELETE(iter);
-        uint64 end_time = get_current_epoch_millis();
-        if (total_expired_keys > 0)
+        if (min_skipped_ttl > 0 && (m_min_ttl <= 0 || min_skipped_ttl < m_min_ttl))
         {
-            INFO_LOG("Cost %llums to delete %u keys.", (end_time - start_time), total_expired_keys);
+            m_min_ttl = min_skipped_ttl;
         }
+        return total_expired_keys;
     }
     void Ardb::GC()
     {
         ClearRetiredStreamCache();
     }
 
-    int64 Ardb::ScanExpiredKeys()
+    int64 Ardb::ScanExpireKeySet(uint64 deadline, bool& backlog)
     {
-        /*
-         * do not do scan expire on slaves
-         */
-        if (!GetConf().master_host.empty())
-        {
-            return 0;
-        }
-        if (!m_engine->GetFeatureSet().support_compactfilter)
-        {
-            ScanTTLDB();
-            return 0;
-        }
-        KeyPrefix scan_key;
         Context scan_ctx;
         int64 total_expired_keys = 0;
-        uint64 start_time = get_current_epoch_millis();
+        ExpireCandidateArray candidates;
+        KeyPrefixSet skipped_keys;
         while (true)
         {
+            if (get_current_epoch_millis() >= deadline)
             {
-                LockGuard<SpinMutexLock> guard(m_expires_lock);
-                if (!m_expires.empty())
-                {
-                    scan_key = *(m_expires.begin());
-                    m_expires.erase(m_expires.begin());
-                }
-                else
-                {
-                    break;
-                }
-            }
-            if (scan_key.IsNil())
-            {
+                backlog = true;
                 break;
             }
-            KeyObject key(scan_key.ns, KEY_META, scan_key.key);
-            KeyLockGuard keylocker(scan_ctx, key);
-            ValueObject meta;
-            bool toremove = false;
-            int err = m_engine->Get(scan_ctx, key, meta);
-            if (ERR_ENTRY_NOT_EXIST == err)
-            {
-                toremove = true;
-            }
-            else if (0 == err)
+            candidates.clear();
             {
-                if (0 == m_engine->Get(scan_ctx, key, meta))
+                LockGuard<SpinMutexLock> guard(m_expires_lock);
+                while (!m_expires.empty() && candidates.size() < (size_t) GetConf().expire_batch_size)
                 {
-                    uint64 ttl = meta.GetTTL();
-                    if (ttl == 0 || ttl > get_current_epoch_millis())
+                    const KeyPrefix& k = *(m_expires.begin());
+                    if (!k.IsNil())
                     {
-                        continue;
+                        candidates.resize(candidates.size() + 1);
+                        candidates.back().key = KeyObject(k.ns, KEY_META, k.key);
                     }
-                    toremove = true;
-                    total_expired_keys++;
+                    m_expires.erase(m_expires.begin());
                 }
             }
-            else
-            {
-                continue;
-            }
-            total_expired_keys++;
-            if (toremove)
+            if (candidates.empty())
             {
-                /*
-                 * generate 'del' command for master instance
-                 */
-                FeedReplicationDelOperation(scan_ctx, key.GetNameSpace(), key.GetKey().AsString());
+                break;
             }
-            if (KEY_STRING == meta.GetType())
+            total_expired_keys += ExpireKeys(scan_ctx, candidates);
+            for (size_t i = 0; i < candidates.size(); i++)
             {
-                RemoveKey(scan_ctx, key);
+                if (candidates[i].skipped)
+                {
+                    KeyPrefix k;
+                    k.ns = candidates[i].key.GetNameSpace();
+                    k.key = candidates[i].key.GetKey();
+                    skipped_keys.insert(k);
+                }
             }
-            else if (meta.GetType() > 0)
+        }
+        LockGuard<SpinMutexLock> guard(m_expires_lock);
+        m_expires.insert(skipped_keys.begin(), skipped_keys.end());
+        m_expire_backlog_keys = m_expires.size();
+        return total_expired_keys;
+    }
+
+    int64 Ardb::ScanExpiredKeys()
+    {
+        /*
+         * do not do scan expire on slaves
+         */
+        if (!GetConf().master_host.empty())
+        {
+            return 0;
+        }
+        uint64 start_time = get_current_epoch_millis();
+        if (m_expire_cycle_time_limit < GetConf().expire_cycle_time_limit)
+        {
+            m_expire_cycle_time_limit = GetConf().expire_cycle_time_limit;
+        }
+        bool backlog = false;
+        int64 total_expired_keys = 0;
+        if (m_engine->GetFeatureSet().support_compactfilter)
+        {
+            total_expired_keys = ScanExpireKeySet(start_time + m_expire_cycle_time_limit, backlog);
+        }
+        else
+        {
+            total_expired_keys = ScanTTLDB(start_time + m_expire_cycle_time_limit, backlog);
+        }
+        uint64 end_time = get_current_epoch_millis();
+        /*
+         * double the time budget while expired keys are left behind, fall back to the configured one once drained
+         */
+        if (backlog)
+        {
+            m_expire_cycle_time_limit *= 2;
+            if (m_expire_cycle_time_limit > GetConf().expire_cycle_max_time_limit)
             {
-                DelKey(scan_ctx, key);
+                m_expire_cycle_time_limit = GetConf().expire_cycle_max_time_limit;
             }
         }
-        uint64 end_time = get_current_epoch_millis();
+        else
+        {
+            m_expire_cycle_time_limit = GetConf().expire_cycle_time_limit;
+        }
+        m_expired_keys += total_expired_keys;
+        if (m_last_expire_cycle_time > 0 && start_time > m_last_expire_cycle_time)
+        {
+            m_expired_keys_per_sec = total_expired_keys * 1000 / (start_time - m_last_expire_cycle_time);
+        }
+        m_last_expire_cycle_time = start_time;
         if (total_expired_keys > 0)
         {
             INFO_LOG("Cost %llums to delete %lld keys.", (end_time - start_time), total_expired_keys);
         }
-        return 0;
+        return total_expired_keys;
     }
     void Ardb::AddExpiredKey(const Data& ns, const Data& key)
     {
@@ -1135,7 +2083,7 @@ OP_NAMESPACE_BEGIN
         int err = 0;
         if (fetch)
         {
-            err = m_engine->Get(ctx, key, meta);
+            err = GetMeta(ctx, key, meta);
             if (err != 0 && err != ERR_ENTRY_NOT_EXIST)
             {
                 reply.SetErrCode(err);
@@ -1153,24 +2101,33 @@ OP_NAMESPACE_BEGIN
             {
                 if (GetConf().master_host.empty() || !GetConf().slave_readonly)
                 {
-                    KeyLockGuard keylocker(ctx, key, ctx.keyslocked ? false : true);
-                    int old_dirty = ctx.dirty;
-                    if (meta.GetType() == KEY_STRING)
-                    {
-                        RemoveKey(ctx, key);
-                    }
-                    else
-                    {
-                        DelKey(ctx, key);
-                    }
-                    if (GetConf().master_host.empty())
+                    /*
+                     * the 'del' is logged on its own, this short lock must not reserve the sequence of the
+                     * running command, which did not lock the key
+                     */
+                    bool repl_ordered = ctx.repl_ordered;
+                    ctx.repl_ordered = false;
                     {
-                        /*
-                         * master generate 'del' command for replication & resume dirty after delete kvs
-                         */
-                        ctx.dirty = old_dirty;
-                        FeedReplicationDelOperation(ctx, key.GetNameSpace(), key.GetKey().AsString());
+                        KeyLockGuard keylocker(ctx, key, ctx.keyslocked ? false : true);
+                        int old_dirty = ctx.dirty;
+                        if (meta.GetType() == KEY_STRING)
+                        {
+                            RemoveKey(ctx, key);
+                        }
+                        else
+                        {
+                            DelKey(ctx, key);
+                        }
+                        if (GetConf().master_host.empty())
+                        {
+                            /*
+                             * master generate 'del' command for replication & resume dirty after delete kvs
+                             */
+                            ctx.dirty = old_dirty;
+                            FeedReplicationDelOperation(ctx, key.GetNameSpace(), key.GetKey().AsString());
+                        }
                     }
+                    ctx.repl_ordered = repl_ordered;
                 }
                 meta.Clear();
                 if(NULL != expired)
@@ -1227,6 +2184,7 @@ OP_NAMESPACE_BEGIN
 
     void Ardb::FreeClient(Context& ctx)
     {
+        ClearPrefetchedMetas(ctx);
         UnwatchKeys(ctx);
         UnsubscribeAll(ctx, true, false);
         UnsubscribeAll(ctx, false, false);
@@ -1367,9 +2325,14 @@ OP_NAMESPACE_BEGIN
              */
             FeedMonitors(ctx, ctx.ns, args);
         }
+        bool outer_repl_ordered = ctx.repl_ordered;
         if (setting.IsWriteCommand())
         {
             OpenWriteLatchByWriteCaller();
+            if (!ctx.flags.no_wal)
+            {
+                ctx.repl_ordered = true;
+            }
         }
         atomic_add_uint32(&m_db_caller_num, 1);
 
@@ -1388,6 +2351,7 @@ OP_NAMESPACE_BEGIN
             uint64 stop_time = get_current_epoch_micros();
             atomic_add_uint64(&(setting.calls), 1);
             atomic_add_uint64(&(setting.microseconds), stop_time - start_time);
+            setting.latency->Add(stop_time - start_time);
             g_cmd_cost_tracks[setting.type].AddCost((stop_time - start_time));
             TryPushSlowCommand(args, stop_time - start_time);
             DEBUG_LOG("Process recved cmd cost %lluus", stop_time - start_time);
@@ -1398,7 +2362,15 @@ OP_NAMESPACE_BEGIN
          */
         if (!ctx.flags.no_wal && ctx.dirty > 0 && setting.IsWriteCommand())
         {
-            FeedReplicationBacklog(ctx, ctx.ns, args);
+            FeedReplicationBacklog(ctx, ctx.ns, args, ctx.repl_ordered && !outer_repl_ordered);
+        }
+        if (ctx.repl_ordered && !outer_repl_ordered)
+        {
+            /*
+             * hand back the sequence reserved by a write command which produced no replication log
+             */
+            g_repl->GetReplLog().ReleaseSequence();
+            ctx.repl_ordered = false;
         }
         if (setting.IsWriteCommand())
         {
@@ -1409,15 +2381,83 @@ OP_NAMESPACE_BEGIN
 
     Ardb::RedisCommandHandlerSetting* Ardb::FindRedisCommandHandlerSetting(RedisCommandFrame& args)
     {
-        std::string& cmd = args.GetMutableCommand();
-        lower_string(cmd);
-        RedisCommandHandlerSettingTable::iterator found = m_settings.find(cmd);
-        if (found == m_settings.end())
+        const std::string& cmd = args.GetCommand();
+        uint32 h1, h2;
+        command_hash(cmd.data(), cmd.size(), m_settings_seed, h1, h2);
+        uint32 disp = m_settings_disps[h1 & (m_settings_disps.size() - 1)];
+        int32 idx = m_settings_slots[command_slot_hash(h2, disp) & (m_settings_slots.size() - 1)];
+        if (idx < 0 || m_settings_names[idx].size() != cmd.size() || strncasecmp(m_settings_names[idx].data(), cmd.data(), cmd.size()) != 0)
         {
             return NULL;
         }
-        args.SetType(found->second.type);
-        return &(found->second);
+        RedisCommandHandlerSetting& setting = m_settings[idx];
+        args.SetType(setting.type);
+        return &setting;
+    }
+
+    bool Ardb::GetCommandKeys(RedisCommandFrame& cmd, std::vector<const std::string*>& keys, bool& write)
+    {
+        keys.clear();
+        RedisCommandHandlerSetting* setting = FindRedisCommandHandlerSetting(cmd);
+        if (NULL == setting)
+        {
+            return false;
+        }
+        write = setting->IsWriteCommand();
+        const ArgumentArray& args = cmd.GetArguments();
+        int argc = (int) args.size() + 1; /* the command name counts like in redis */
+        if (setting->firstkey > 0 && setting->firstkey < argc)
+        {
+            int last = setting->lastkey < 0 ? argc + setting->lastkey : setting->lastkey;
+            if (last >= argc)
+            {
+                last = argc - 1;
+            }
+            for (int i = setting->firstkey; i <= last; i += setting->keystep)
+            {
+                keys.push_back(&args[i - 1]);
+            }
+        }
+        if (!(setting->flags & ARDB_CMD_MOVABLE_KEYS))
+        {
+            return true;
+        }
+        switch (setting->type)
+        {
+            case REDIS_CMD_ZINTERSTORE:
+            case REDIS_CMD_ZUNIONSTORE:
+            {
+                int64 numkeys;
+                if (args.size() < 2 || !string_toint64(args[1], numkeys) || numkeys < 0 || (size_t) numkeys > args.size() - 2)
+                {
+                    return false;
+                }
+                for (int64 i = 0; i < numkeys; i++)
+                {
+                    keys.push_back(&args[2 + i]);
+                }
+                return true;
+            }
+            case REDIS_CMD_GEO_RADIUS:
+            case REDIS_CMD_GEO_RADIUSBYMEMBER:
+            {
+                for (size_t i = 1; i + 1 < args.size(); i++)
+                {
+                    if (!strcasecmp(args[i].c_str(), "store") || !strcasecmp(args[i].c_str(), "storedist"))
+                    {
+                        keys.push_back(&args[++i]);
+                    }
+                }
+                return true;
+            }
+            default:
+            {
+                /*
+                 * scripts, SORT patterns, MIGRATE and stream reads may touch keys not told by their arguments
+                 */
+                return false;
+            }
+        }
     }
 
     int Ardb::Call(Context& ctx, RedisCommandFrame& args)
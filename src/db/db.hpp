@@ -43,6 +43,7 @@
 #include "config.hpp"
 #include "logger.hpp"
 #include <stack>
+#include <deque>
 #include <sparsehash/dense_hash_map>
 
 #define TTL_DB_NSMAESPACE "__TTL_DB__"
@@ -57,6 +58,28 @@ OP_NAMESPACE_BEGIN
     struct StreamGroupMeta;
     struct StreamNACK;
     class BackGroundThread;
+    class AsyncDeleteWorker;
+    class StaleVersionSweeper;
+    struct KeyScanJob;
+    class KeyScanWorker;
+
+    /*
+     * Subscribed patterns grouped by their literal prefix, a channel is only matched against the patterns
+     * whose literal prefix is a prefix of the channel. Not thread safe, guarded by the pubsub lock.
+     */
+    class PubSubPatternIndex
+    {
+        private:
+            typedef TreeMap<std::string, StringTreeSet>::Type PrefixTable;
+            typedef TreeMap<size_t, size_t>::Type PrefixLengthTable;
+            PrefixTable m_prefixes; /* literal prefix -> patterns */
+            PrefixLengthTable m_prefix_lens; /* literal prefix length -> prefixes count */
+        public:
+            void Add(const std::string& pattern);
+            void Remove(const std::string& pattern);
+            void Match(const std::string& channel, StringArray& patterns);
+    };
+
     class Ardb
     {
         public:
@@ -72,18 +95,17 @@ OP_NAMESPACE_BEGIN
                     int flags;
                     volatile uint64 microseconds;
                     volatile uint64 calls;
-                    //CostTrack
+                    /*
+                     * key positions like redis, 1 is the first argument after the command name, a negative
+                     * lastkey counts from the end. 'K' flagged commands have more keys found in their arguments.
+                     */
+                    int firstkey;
+                    int lastkey;
+                    int keystep;
+                    CommandLatencyHistogram* latency;
                     bool IsAllowedInScript() const;
                     bool IsWriteCommand() const;
             };
-            struct RedisCommandHash
-            {
-                    size_t operator()(const std::string& t) const;
-            };
-            struct RedisCommandEqual
-            {
-                    bool operator()(const std::string& s1, const std::string& s2) const;
-            };
 
             struct KeyLockGuard
             {
@@ -119,13 +141,85 @@ OP_NAMESPACE_BEGIN
             SpinMutexLock m_expires_lock;
             ExpireKeySet m_expires;
 
-            typedef google::dense_hash_map<std::string, RedisCommandHandlerSetting, RedisCommandHash, RedisCommandEqual> RedisCommandHandlerSettingTable;
+            typedef std::vector<RedisCommandHandlerSetting> RedisCommandHandlerSettingTable;
             RedisCommandHandlerSettingTable m_settings;
-            typedef TreeMap<KeyPrefix, ThreadMutexLock*>::Type LockTable;
+            /*
+             * Perfect hash over the dispatched command names (m_settings_names, an empty name is a disabled
+             * command): a name hashes to a bucket whose displacement picks a slot holding its m_settings index.
+             * Built once the names are final, so lookups never probe and compare one name case insensitively.
+             */
+            StringArray m_settings_names;
+            uint32 m_settings_seed;
+            std::vector<uint32> m_settings_disps;
+            std::vector<int32> m_settings_slots;
             typedef std::stack<ThreadMutexLock*> LockPool;
-            SpinMutexLock m_locking_keys_lock;
-            LockTable m_locking_keys;
-            LockPool m_lock_pool;
+            struct KeyLockEntry
+            {
+                    size_t hash;
+                    KeyPrefix key; /* string parts point into the reused ns_buf/key_buf, see SetKeyLockEntryKey */
+                    std::string ns_buf;
+                    std::string key_buf;
+                    ThreadMutexLock* lock; /* NULL means the entry slot is free */
+                    KeyLockEntry()
+                            : hash(0), lock(NULL)
+                    {
+                    }
+            };
+            typedef std::deque<KeyLockEntry> KeyLockEntryArray; /* growing never moves an entry and its buffers */
+            /*
+             * Locking keys are hashed into stripes, every stripe has its own spin lock & reusable entry slots,
+             * so that writers on different keys rarely contend on the same spin lock.
+             */
+            struct KeyLockStripe
+            {
+                    SpinMutexLock lock;
+                    KeyLockEntryArray entries;
+                    LockPool lock_pool;
+                    uint64 acquired;
+                    uint64 contended;
+                    uint64 waits;
+                    char padding[64];
+                    KeyLockStripe()
+                            : acquired(0), contended(0), waits(0)
+                    {
+                    }
+            };
+            KeyLockStripe* m_lock_stripes;
+            size_t m_lock_stripes_num;
+
+            /*
+             * Decoded metas of collection keys, sharded LRU caches in front of the engine.
+             * Entries are invalidated by meta writes & when the key lock is released, the shard 'version' prevents
+             * a reader from caching a meta fetched before a concurrent invalidation. Bumping 'm_meta_cache_epoch'
+             * drops all entries at once.
+             */
+            struct MetaCacheEntry
+            {
+                    uint64 epoch;
+                    ValueObject meta;
+                    MetaCacheEntry()
+                            : epoch(0)
+                    {
+                    }
+            };
+            typedef LRUCache<KeyPrefix, MetaCacheEntry> MetaLRUCache;
+            typedef TreeMap<KeyPrefix, ValueObject>::Type PrefetchedMetaTable;
+            struct MetaCacheShard
+            {
+                    SpinMutexLock lock;
+                    MetaLRUCache cache;
+                    uint64 version;
+                    uint64 hits;
+                    uint64 misses;
+                    char padding[64];
+                    MetaCacheShard()
+                            : version(0), hits(0), misses(0)
+                    {
+                    }
+            };
+            MetaCacheShard* m_meta_cache_shards;
+            size_t m_meta_cache_shards_num;
+            volatile uint64 m_meta_cache_epoch;
 
             SpinMutexLock m_redis_cursor_lock;
             typedef LRUCache<uint64, std::string> RedisCursorCache;
@@ -136,6 +230,7 @@ OP_NAMESPACE_BEGIN
             SpinRWLock m_pubsub_lock;
             PubSubChannelTable m_pubsub_channels;
             PubSubChannelTable m_pubsub_patterns;
+            PubSubPatternIndex m_pubsub_pattern_index;
 
             SpinMutexLock m_watched_keys_lock;
             typedef TreeMap<KeyPrefix, ContextSet>::Type WatchedContextTable;
@@ -160,8 +255,37 @@ OP_NAMESPACE_BEGIN
 
             int64_t m_min_ttl;
 
+            /*
+             * a key expired in the expire cycle, 'ttl' is the ttl recorded in the ttl index entry 'ttl_key'
+             * which must still match the key's meta; 0 means any elapsed ttl.
+             */
+            struct ExpireCandidate
+            {
+                    KeyObject key;
+                    int64 ttl;
+                    KeyObject ttl_key;
+                    bool skipped; /* key locked by others, try it again in next cycle */
+                    ExpireCandidate()
+                            : ttl(0), skipped(false)
+                    {
+                    }
+            };
+            typedef std::vector<ExpireCandidate> ExpireCandidateArray;
+            int64 m_expire_cycle_time_limit; /* adaptive time budget of current expire cycle */
+            uint64 m_last_expire_cycle_time;
+            volatile uint64 m_expired_keys;
+            volatile int64 m_expired_keys_per_sec;
+            volatile int64 m_expire_backlog_keys;
+
             BackGroundThread* g_background;
 
+            volatile uint64 m_collection_version; /* last version assigned to a new zset/list */
+
+            volatile uint64 m_geo_radius_queries;
+            volatile uint64 m_geo_nearest_queries;
+            volatile uint64 m_geo_points_scanned;
+            volatile uint64 m_geo_points_kept;
+
             static void MigrateCoroTask(void* data);
             static void MigrateDBCoroTask(void* data);
 
@@ -176,16 +300,30 @@ OP_NAMESPACE_BEGIN
             void CloseWriteLatchBeforeSnapshotPrepare();
 
             void SaveTTL(Context& ctx, const Data& ns, const std::string& key, int64 old_ttl, int64_t new_ttl);
-            void ScanTTLDB();
-            void FeedReplicationBacklog(Context& ctx, const Data& ns, RedisCommandFrame& cmd);
+            int64 ScanTTLDB(uint64 deadline, bool& backlog);
+            int64 ScanExpireKeySet(uint64 deadline, bool& backlog);
+            int64 ExpireKeys(Context& ctx, ExpireCandidateArray& candidates);
+            void FeedReplicationBacklog(Context& ctx, const Data& ns, RedisCommandFrame& cmd, bool reserved = false);
             void FeedMonitors(Context& ctx, const Data& ns, RedisCommandFrame& cmd);
 
             int WriteReply(Context& ctx, RedisReply* r, bool async);
 
+            void InitKeyLockStripes(size_t num);
+            void DestroyKeyLockStripes();
+            KeyLockStripe& GetKeyLockStripe(const KeyPrefix& key, size_t& hash);
+            static void SetKeyLockEntryKey(KeyLockEntry& entry, const KeyPrefix& key);
             bool LockKey(const KeyPrefix& key, int wait_limit = -1);
             void UnlockKey(const KeyPrefix& key);
             void LockKeys(const KeyPrefixSet& key);
             void UnlockKeys(const KeyPrefixSet& key);
+            void GetKeyLockStats(uint64& acquired, uint64& contended, uint64& waits);
+
+            void InitMetaCache(size_t shards, size_t max_size);
+            void DestroyMetaCache();
+            int GetMeta(Context& ctx, const KeyObject& key, ValueObject& meta);
+            void InvalidateMeta(const KeyPrefix& key);
+            void InvalidateMeta(const KeyObject& key);
+            void GetMetaCacheStats(uint64& hits, uint64& misses, uint64& keys);
 
             Engine* GetEngine()
             {
@@ -204,12 +342,26 @@ OP_NAMESPACE_BEGIN
 
             int FindElementByRedisCursor(const std::string& cursor, std::string& element);
             uint64 GetNewRedisCursor(const std::string& element);
+            /*
+             * Key range partitions of ctx.ns: partition i holds the keys from bounds[i] (the first is "") up to
+             * bounds[i + 1], the last one is unbounded. At most 'max' of them, told by the engine or sampled.
+             * KeyScanPartitionsLimit is how many a scan of ctx.ns should use, 1 when it is not worth splitting.
+             */
+            void GetKeyPartitions(Context& ctx, size_t max, StringArray& bounds);
+            void SampleKeySplits(Context& ctx, size_t max, StringArray& splits);
+            void ScanKeyPartition(Context& ctx, KeyScanJob& job, size_t idx);
+            void RunKeyScanJob(Context& ctx, KeyScanJob& job);
+            size_t KeyScanPartitionsLimit(Context& ctx);
+            int64 CountKeys(Context& ctx, const std::string& pattern);
+            int ScanKeysByPartition(Context& ctx, const std::string& cursor_element, const std::string& pattern, uint32 limit);
 
             int GetValueByPattern(Context& ctx, const Slice& pattern, Data& subst, Data& value);
 
             void TryPushSlowCommand(const RedisCommandFrame& cmd, uint64 micros);
             void GetSlowlog(Context& ctx, uint32 len);
             int ObjectLen(Context& ctx, KeyType type, const std::string& key);
+            int GetBitmapRange(Context& ctx, const KeyObject& key, ValueObject& meta, int64 start, int64 end,
+                    std::string& bytes);
 
             void FillInfoResponse(Context& ctx, const std::string& section, std::string& info);
 
@@ -242,6 +394,11 @@ OP_NAMESPACE_BEGIN
                     uint8* oldbit);
             int MergePFAdd(Context& ctx, const KeyObject& key, ValueObject& value, const DataArray& ms, int* updated =
             NULL);
+            int MergeStreamAppend(Context& ctx, const KeyObject& key, ValueObject& block, const DataArray& args);
+            int BitmapSetBit(Context& ctx, const KeyObject& key, ValueObject& meta, int64 offset, uint8 bit,
+                    uint8& oldbit);
+            int BitopChunked(Context& ctx, RedisCommandFrame& cmd, uint32 op, KeyObjectArray& keys, ValueObjectArray& vals,
+                    size_t destkey_count);
 
             bool CheckMeta(Context& ctx, const std::string& key, KeyType expected);
             bool CheckMeta(Context& ctx, const std::string& key, KeyType expected, ValueObject& meta);
@@ -255,15 +412,39 @@ OP_NAMESPACE_BEGIN
             int DelKey(Context& ctx, const KeyObject& key);
             int MoveKey(Context& ctx, RedisCommandFrame& cmd);
             int AsyncDeleteKey(Context& ctx, const Data& ns, const std::string& key);
+            int AsyncDeleteLockedKey(const KeyPrefix& key);
+            int DelKeyInChunks(Context& ctx, const KeyObject& meta_key, int64 chunk_size, volatile uint64* progress);
+            void DelUnversionedRange(Context& ctx, const KeyObject& meta_key);
+            void GetAsyncDeleteStats(std::string& info);
+
+            void NewCollectionVersion(ValueObject& meta);
+            int InitCollectionVersion();
+            int StaleCollection(Context& ctx, const KeyObject& meta_key, ValueObject& meta, bool remove_meta = true);
+            int SweepStaleVersion(Context& ctx, const KeyObject& stale_key, uint8 collection_type);
+            int64 SweepStaleVersions(Context& ctx);
+            void NotifyStaleVersionSweeper();
 
             int HIterate(Context& ctx, RedisCommandFrame& cmd);
             int ZIterateByRank(Context& ctx, RedisCommandFrame& cmd);
             int ZIterateByScore(Context& ctx, RedisCommandFrame& cmd);
             int ZIterateByLex(Context& ctx, RedisCommandFrame& cmd);
             int ZPop(Context& ctx, RedisReply& r, const std::string& key, ValueObject* meta, int64_t count, bool reverse, bool emitkey, bool lock);
+            typedef std::pair<int64_t, int64_t> RankIndexNode; /* level & position prefix */
+            typedef TreeMap<RankIndexNode, int64_t>::Type RankIndexDeltaTable;
+            void RankIndexUpdate(RankIndexDeltaTable& deltas, double pos, int64_t delta);
+            int RankIndexCommit(Context& ctx, KeyType node_type, const std::string& key, ValueObject& meta,
+                    const RankIndexDeltaTable& deltas);
+            Iterator* RankIndexCountBefore(Context& ctx, KeyType node_type, const std::string& key, ValueObject& meta,
+                    double pos, int64_t& count);
+            Iterator* RankIndexSeek(Context& ctx, KeyType node_type, const std::string& key, ValueObject& meta,
+                    int64_t rank);
+            void ListRankIndexBuild(Context& ctx, const std::string& key, ValueObject& meta,
+                    RankIndexDeltaTable& deltas);
 
             int StreamDel(Context& ctx, const KeyObject& key);
-            int StreamDelItem(Context& ctx, const std::string& key, const StreamID& id);
+            int StreamAppend(Context& ctx, const std::string& key, ValueObject& meta, const StreamID& id, ValueObject& ele);
+            int StreamGetItem(Context& ctx, const std::string& key, ValueObject& meta, const StreamID& id, ValueObject& ele);
+            int64_t StreamDelItems(Context& ctx, const std::string& key, ValueObject& meta, StreamIDArray& ids);
             int StreamCreateCG(Context& ctx, const std::string& key, const std::string& group, const StreamID& id,
                     ValueObject& v);
             int64_t StreamDelConsumer(Context& ctx, const std::string& key, const std::string& group,
@@ -271,12 +452,17 @@ OP_NAMESPACE_BEGIN
             int64_t StreamDelGroup(Context& ctx, const std::string& key, const std::string& group);
             int64_t StreamTrimByLength(Context& ctx, const std::string& key, ValueObject& meta, size_t maxlen,
                     int approx);
+            int64_t StreamTrimByMinID(Context& ctx, const std::string& key, ValueObject& meta, const StreamID& minid,
+                    int approx);
+            int64_t StreamTrim(Context& ctx, const std::string& key, ValueObject& meta, int64_t maxlen,
+                    const StreamID* minid, int approx);
             int StreamCreateNACK(Context& ctx, const std::string& key, const std::string& group,
                     const std::string& consumer, const StreamID& id, StreamGroupMeta* group_meta);
             int StreamUpdateNACK(Context& ctx, const std::string& key, const std::string& group,
                     const std::string& consumer, const StreamID& id, StreamGroupMeta* group_meta, StreamNACK* nack);
             int StreamAddConsumer(Context& ctx, const std::string& consumer, StreamGroupMeta* group_meta);
-            int StreamMinMaxID(Context& ctx, const std::string& key, StreamID& min, StreamID& max, ValueObject& minv, ValueObject& maxv);
+            int StreamMinMaxID(Context& ctx, const std::string& key, ValueObject& meta, StreamID& min, StreamID& max,
+                    ValueObject& minv, ValueObject& maxv);
             StreamGroupMeta* StreamLoadGroup(Context& ctx, const KeyPrefix& key, const std::string& group);
             StreamGroupMeta* StreamLoadGroup(Context& ctx, const std::string& key, const std::string& group);
             StreamGroupTable* StreamLoadGroups(Context& ctx, const std::string& key, bool create_ifnotexist);
@@ -288,6 +474,7 @@ OP_NAMESPACE_BEGIN
             int UnwatchKeys(Context& ctx);
             int TouchWatchedKeysOnFlush(Context& ctx, const Data& ns);
             int DiscardTransaction(Context& ctx);
+            bool GetTransactionKeys(Context& ctx, KeyPrefixSet& ks);
 
             int BlockForKeys(Context& ctx, const StringArray& keys, const AnyArray& vals, KeyType ktype, uint32 mstimeout);
             static void AsyncUnblockKeysCallback(Channel* ch, void * data);
@@ -314,6 +501,7 @@ OP_NAMESPACE_BEGIN
             int DBSize(Context& ctx, RedisCommandFrame& cmd);
             int Config(Context& ctx, RedisCommandFrame& cmd);
             int SlowLog(Context& ctx, RedisCommandFrame& cmd);
+            int Latency(Context& ctx, RedisCommandFrame& cmd);
             int Client(Context& ctx, RedisCommandFrame& cmd);
             int Keys(Context& ctx, RedisCommandFrame& cmd);
             int KeysCount(Context& ctx, RedisCommandFrame& cmd);
@@ -407,6 +595,8 @@ OP_NAMESPACE_BEGIN
 
             int SAdd(Context& ctx, RedisCommandFrame& cmd);
             int SCard(Context& ctx, RedisCommandFrame& cmd);
+            struct SetMergeOutput;
+            int SetMerge(Context& ctx, RedisCommandFrame& cmd);
             int SDiff(Context& ctx, RedisCommandFrame& cmd);
             int SDiffStore(Context& ctx, RedisCommandFrame& cmd);
             int SInter(Context& ctx, RedisCommandFrame& cmd);
@@ -511,9 +701,12 @@ OP_NAMESPACE_BEGIN
             int DoCall(Context& ctx, RedisCommandHandlerSetting& setting, RedisCommandFrame& cmd);
             RedisCommandHandlerSetting* FindRedisCommandHandlerSetting(RedisCommandFrame& cmd);
             void RenameCommand();
+            void BuildCommandIndex();
 
             int CreateBackGroundThread();
             int StopBackGroundThread();
+            int CreateKeyScanPool();
+            int StopKeyScanPool();
 
             friend class LUAInterpreter;
             friend class ObjectIO;
@@ -522,16 +715,33 @@ OP_NAMESPACE_BEGIN
             friend class Master;
             friend class Slave;
             friend class BackGroundThread;
+            friend class AsyncDeleteWorker;
+            friend class StaleVersionSweeper;
+            friend class KeyScanWorker;
         public:
             Ardb();
             int Init(const std::string& conf_file);
             int Repair(const std::string& dir);
+            int LoadKeyFormat(const std::string& dir, const std::string& encoding);
+            int ConvertKeyFormat(const std::string& conf_file, const std::string& src_dir, const std::string& dst_dir,
+                    const std::string& encoding);
             int Call(Context& ctx, RedisCommandFrame& cmd);
+            /*
+             * Keys of 'cmd' told by the command table key specs, returns false for unknown commands and for
+             * commands that may touch keys not named in their arguments.
+             */
+            bool GetCommandKeys(RedisCommandFrame& cmd, std::vector<const std::string*>& keys, bool& write);
             int MergeOperation(const KeyObject& key, ValueObject& val, uint16_t op, DataArray& args);
             int MergeOperands(uint16_t left, const DataArray& left_args, uint16_t& right, DataArray& right_args);
             void AddExpiredKey(const Data& ns, const Data& key);
             void FeedReplicationDelOperation(Context& ctx, const Data& ns, const std::string& key);
             int TouchWatchKey(Context& ctx, const KeyObject& key);
+            void InvalidateAllMetas();
+            void PrefetchMetas(Context& ctx, const StringArray& keys);
+            void ClearPrefetchedMetas(Context& ctx);
+            void LockRunKeys(Context& ctx, const StringArray& keys, KeyPrefixSet& ks);
+            void UnlockRunKeys(Context& ctx);
+            void FeedStagedReplication(StagedReplication& staged, bool transaction);
             void FreeClient(Context& ctx);
             void AddClient(Context& ctx);
             void ScanClients();
@@ -32,6 +32,10 @@
 #include "util/file_helper.hpp"
 #include "thread/event_condition.hpp"
 #include "db.hpp"
+#include "util/atomic.hpp"
+#include "util/concurrent_queue.hpp"
+#include <sched.h>
+#include <algorithm>
 
 #define DEFAULT_LOCAL_ENCODE_BUFFER_SIZE 8192
 
@@ -65,21 +69,72 @@ OP_NAMESPACE_BEGIN
         return encode_buffer_cache;
     }
 
+    struct DBWriterBarrier
+    {
+            uint32 parties;
+            volatile uint32 arrived;
+            volatile uint32 left;
+            volatile bool done;
+            DBWriterBarrier(uint32 n) :
+                    parties(n), arrived(0), left(0), done(false)
+            {
+            }
+    };
+
+    /*
+     * A synced command with the namespace it was selected in. A task without command is a fence, its worker
+     * waits there while another worker applies the command spanning both of them.
+     */
+    struct DBWriterTask
+    {
+            RedisCommandFrame* cmd;
+            Data ns;
+            DBWriterBarrier* barrier;
+            DBWriterTask() :
+                    cmd(NULL), barrier(NULL)
+            {
+            }
+    };
+
+    static void writer_pause(uint32& spins)
+    {
+        if (++spins < 1000)
+        {
+            sched_yield();
+        }
+        else
+        {
+            Thread::Sleep(100, MICROS);
+        }
+    }
+
+    static void release_writer_task(DBWriterTask* task)
+    {
+        if (NULL != task->barrier && atomic_add_uint32(&task->barrier->left, 1) == task->barrier->parties)
+        {
+            DELETE(task->barrier);
+        }
+        DELETE(task->cmd);
+        DELETE(task);
+    }
+
     class DBWriterWorker: public Thread
     {
         public:
             Context worker_ctx;
             CallFlags flags;
             DBWriter* writer;
-            bool running;
-            volatile bool writing;
+            volatile bool running;
+            SPSCQueue<DBWriterTask*> queue;
+            volatile uint32 pending;
+            volatile bool sleeping;
+            ThreadMutexLock wait_lock;
             DBWriterWorker(DBWriter* w) :
-                    writer(w), running(true),writing(false)
+                    writer(w), running(true), pending(0), sleeping(false)
             {
             }
             void Call(RedisCommandFrame& cmd)
             {
-                writing = true;
                 worker_ctx.ClearFlags();
                 worker_ctx.flags = flags;
                 g_db->Call(worker_ctx, cmd);
@@ -89,17 +144,61 @@ OP_NAMESPACE_BEGIN
                     WARN_LOG("Slave sync error:%s", r.Error().c_str());
                 }
                 r.Clear();
-                writing = false;
+            }
+            void Apply(DBWriterTask* task)
+            {
+                DBWriterBarrier* barrier = task->barrier;
+                uint32 spins = 0;
+                if (NULL != barrier && NULL == task->cmd)
+                {
+                    atomic_add_uint32(&barrier->arrived, 1);
+                    while (!barrier->done && running)
+                    {
+                        writer_pause(spins);
+                    }
+                }
+                else
+                {
+                    if (NULL != barrier)
+                    {
+                        /*
+                         * every other worker holding one of the keys must have applied what came before
+                         */
+                        while (barrier->arrived < barrier->parties - 1 && running)
+                        {
+                            writer_pause(spins);
+                        }
+                    }
+                    worker_ctx.ns = task->ns;
+                    Call(*task->cmd);
+                    if (NULL != barrier)
+                    {
+                        __memory_barrier();
+                        barrier->done = true;
+                    }
+                }
+                release_writer_task(task);
+                atomic_sub_uint32(&pending, 1);
             }
             void Run()
             {
                 while (running)
                 {
-                    RedisCommandFrame* cmd = writer->Dequeue(1);
-                    if(NULL != cmd)
+                    DBWriterTask* task = NULL;
+                    if (!queue.Pop(task))
+                    {
+                        LockGuard<ThreadMutexLock> guard(wait_lock);
+                        sleeping = true;
+                        __memory_barrier();
+                        if (!queue.Pop(task))
+                        {
+                            wait_lock.Wait(1);
+                        }
+                        sleeping = false;
+                    }
+                    if (NULL != task)
                     {
-                        Call(*cmd);
-                        DELETE(cmd);
+                        Apply(task);
                     }
                 }
             }
@@ -107,9 +206,18 @@ OP_NAMESPACE_BEGIN
             {
                 running = false;
             }
+            ~DBWriterWorker()
+            {
+                DBWriterTask* task = NULL;
+                while (queue.Pop(task))
+                {
+                    release_writer_task(task);
+                }
+            }
     };
 
-    DBWriter::DBWriter()
+    DBWriter::DBWriter() :
+            m_in_transaction(false)
     {
 
     }
@@ -132,6 +240,7 @@ OP_NAMESPACE_BEGIN
         /*
          * multi thread only work faster for commands
          */
+        g_db->InvalidateAllMetas();
         return g_engine->PutRaw(ctx, ns, key, value);
     }
     int DBWriter::Put(Context& ctx, const KeyObject& k, const ValueObject& value)
@@ -139,70 +248,43 @@ OP_NAMESPACE_BEGIN
         /*
          * multi thread only work faster for commands
          */
+        if (k.GetType() == KEY_META)
+        {
+            g_db->InvalidateAllMetas();
+        }
         return g_engine->Put(ctx, k, value);
     }
 
-    void DBWriter::Enqueue(RedisCommandFrame& cmd)
+    void DBWriter::Enqueue(DBWriterWorker* worker, DBWriterTask* task)
     {
-
-        if (!strncasecmp(cmd.GetCommand().c_str(), "select", 6))
+        while (worker->pending >= (uint32) g_db->GetConf().max_slave_worker_queue)
         {
-            /*
-             * wait all commands in queue executed, because 'select' affect all commands later
-             */
-            LockGuard<ThreadMutexLock> guard(m_queue_lock);
-            while(!m_queue.empty())
-            {
-                m_queue_lock.Wait(1);
-            }
-            for(size_t i = 0 ; i < m_workers.size(); i++)
-            {
-                while(m_workers[i]->writing)
-                {
-                    m_queue_lock.Wait(1);
-                }
-                m_workers[i]->Call(cmd);
-            }
-            return;
+            Thread::Sleep(1);
         }
-        LockGuard<ThreadMutexLock> guard(m_queue_lock);
-        while(m_queue.size() >= (size_t)(g_db->GetConf().max_slave_worker_queue))
+        atomic_add_uint32(&worker->pending, 1);
+        worker->queue.Push(task);
+        __memory_barrier();
+        if (worker->sleeping)
         {
-            m_queue_lock.Wait(1);
+            LockGuard<ThreadMutexLock> guard(worker->wait_lock);
+            worker->wait_lock.Notify();
         }
-        RedisCommandFrame* new_cmd;
-        NEW(new_cmd, RedisCommandFrame);
-        *new_cmd = cmd;
-        m_queue.push_back(new_cmd);
-        m_queue_lock.Notify();
     }
-    RedisCommandFrame* DBWriter::Dequeue(int timeout)
+    int64 DBWriter::QueueSize()
     {
-        LockGuard<ThreadMutexLock> guard(m_queue_lock);
-        if(m_queue.empty())
-        {
-            m_queue_lock.Wait(timeout);
-        }
-        RedisCommandFrame* cmd = NULL;
-        if(!m_queue.empty())
+        int64 size = 0;
+        for (size_t i = 0; i < m_workers.size(); i++)
         {
-            cmd =  m_queue.front();
-            m_queue.pop_front();
+            size += m_workers[i]->pending;
         }
-        return cmd;
-    }
-    int64 DBWriter::QueueSize()
-    {
-        LockGuard<ThreadMutexLock> guard(m_queue_lock);
-        return m_queue.size();
+        return size;
     }
     void DBWriter::SetNamespace(Context& ctx, const std::string& ns)
     {
+        /*
+         * queued commands carry their own namespace, only the later ones are affected
+         */
         ctx.ns.SetString(ns, false);
-        for (size_t i = 0; i < m_workers.size(); i++)
-        {
-            m_workers[i]->worker_ctx.ns.SetString(ns, false);
-        }
     }
 
     void DBWriter::SetMasterClient(Context& ctx)
@@ -215,6 +297,7 @@ OP_NAMESPACE_BEGIN
 
     void DBWriter::Clear()
     {
+        m_in_transaction = false;
         for (size_t i = 0; i < m_workers.size(); i++)
         {
             m_workers[i]->worker_ctx.client = NULL;
@@ -227,6 +310,16 @@ OP_NAMESPACE_BEGIN
             m_workers[i]->flags = flags;
         }
     }
+    static size_t writer_key_hash(const std::string& key)
+    {
+        size_t hash = 5381;
+        for (size_t i = 0; i < key.size(); i++)
+        {
+            hash = ((hash << 5) + hash) + (unsigned char) key[i];
+        }
+        return hash;
+    }
+
     int DBWriter::Put(Context& ctx,RedisCommandFrame& cmd)
     {
         if(m_workers.empty())
@@ -234,7 +327,81 @@ OP_NAMESPACE_BEGIN
             g_db->Call(ctx, cmd);
             return 0;
         }
-        Enqueue(cmd);
+        bool write = true;
+        bool known = g_db->GetCommandKeys(cmd, m_keys, write);
+        m_targets.clear();
+        if (m_in_transaction || cmd.GetType() == REDIS_CMD_MULTI)
+        {
+            /*
+             * a transaction is queued on the first worker as a whole, its EXEC waits for every worker like a
+             * command of unknown keys so that it is applied atomically and in order
+             */
+            m_in_transaction = cmd.GetType() != REDIS_CMD_EXEC && cmd.GetType() != REDIS_CMD_DISCARD;
+            m_targets.push_back(0);
+            if (cmd.GetType() == REDIS_CMD_EXEC)
+            {
+                for (size_t i = 1; i < m_workers.size(); i++)
+                {
+                    m_targets.push_back(i);
+                }
+            }
+        }
+        else if (known && cmd.GetType() == REDIS_CMD_SELECT)
+        {
+            /*
+             * no barrier, it only changes the namespace queued with the later commands
+             */
+            g_db->Call(ctx, cmd);
+            ctx.GetReply().Clear();
+            return 0;
+        }
+        else if (known && !m_keys.empty())
+        {
+            /*
+             * keys are hashed without namespace, so MOVE between namespaces stays on one worker
+             */
+            for (size_t i = 0; i < m_keys.size(); i++)
+            {
+                size_t idx = writer_key_hash(*m_keys[i]) % m_workers.size();
+                if (std::find(m_targets.begin(), m_targets.end(), idx) == m_targets.end())
+                {
+                    m_targets.push_back(idx);
+                }
+            }
+            std::sort(m_targets.begin(), m_targets.end());
+        }
+        else if (!known || write)
+        {
+            for (size_t i = 0; i < m_workers.size(); i++)
+            {
+                m_targets.push_back(i);
+            }
+        }
+        else
+        {
+            m_targets.push_back(0);
+        }
+
+        DBWriterTask* task = NULL;
+        NEW(task, DBWriterTask);
+        NEW(task->cmd, RedisCommandFrame);
+        *(task->cmd) = cmd;
+        task->ns = ctx.ns;
+        if (m_targets.size() > 1)
+        {
+            /*
+             * the lowest worker applies the command once the others are parked at their fence
+             */
+            NEW(task->barrier, DBWriterBarrier(m_targets.size()));
+            for (size_t i = 1; i < m_targets.size(); i++)
+            {
+                DBWriterTask* fence = NULL;
+                NEW(fence, DBWriterTask);
+                fence->barrier = task->barrier;
+                Enqueue(m_workers[m_targets[i]], fence);
+            }
+        }
+        Enqueue(m_workers[m_targets[0]], task);
         return 0;
     }
 
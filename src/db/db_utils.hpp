@@ -65,17 +65,22 @@ OP_NAMESPACE_BEGIN
     /*
      *  A multi thread db writer, which could do db write operations by several threads to increase
      *  write performance.
-     *  It's used in loading snapshot.
+     *  It's used in loading snapshot and applying commands synced from master. Synced commands are
+     *  partitioned by key: a key always goes to the same worker through that worker's own SPSC queue, so
+     *  commands on a key are applied in order, and each command carries the namespace it was selected in.
+     *  Only a command whose keys live on several workers, or a write command with unknown keys, waits for
+     *  the workers involved to reach it.
      */
     class DBWriterWorker;
+    struct DBWriterTask;
     class DBWriter
     {
         private:
             std::vector<DBWriterWorker*> m_workers;
-            ThreadMutexLock m_queue_lock;
-            std::deque<RedisCommandFrame*> m_queue;
-            void Enqueue(RedisCommandFrame& cmd);
-            RedisCommandFrame* Dequeue(int timeout);
+            std::vector<const std::string*> m_keys;
+            std::vector<size_t> m_targets;
+            bool m_in_transaction;
+            void Enqueue(DBWriterWorker* worker, DBWriterTask* task);
             friend class DBWriterWorker;
         public:
             DBWriter();
@@ -29,10 +29,12 @@
 #include "engine.hpp"
 #include <assert.h>
 #include "util/atomic.hpp"
+#include <algorithm>
 
 OP_NAMESPACE_BEGIN
 
     volatile uint64_t g_db_iterator_counter = 0;
+    GroupCommitter* g_group_committer = NULL;
     Iterator::Iterator()
     {
     	atomic_add_uint64(&g_db_iterator_counter, 1);
@@ -41,6 +43,132 @@ OP_NAMESPACE_BEGIN
     {
     	atomic_sub_uint64(&g_db_iterator_counter, 1);
     }
+    GroupCommitter::GroupCommitter(Engine* engine, int64 max_delay, int64 max_batch, bool sync) :
+            m_engine(engine), m_max_delay(max_delay), m_max_batch(max_batch > 0 ? max_batch : 1), m_sync(sync), m_groups(
+                    0), m_batches(0)
+    {
+    }
+
+    int GroupCommitter::Commit(Context& ctx, void* batch)
+    {
+        Writer w(batch);
+        m_lock.Lock();
+        m_queue.push_back(&w);
+        m_lock.NotifyAll();
+        while (!w.done && m_queue.front() != &w)
+        {
+            m_lock.Wait();
+        }
+        if (w.done)
+        {
+            m_lock.Unlock();
+            return w.err;
+        }
+        /*
+         * leader: give concurrent committers a chance to join this group
+         */
+        if (m_max_delay > 0 && m_queue.size() < m_max_batch)
+        {
+            uint64 deadline = get_current_epoch_micros() + m_max_delay;
+            while (m_queue.size() < m_max_batch)
+            {
+                uint64 now = get_current_epoch_micros();
+                if (now >= deadline)
+                {
+                    break;
+                }
+                m_lock.Wait(deadline - now, MICROS);
+            }
+        }
+        size_t count = m_queue.size() < m_max_batch ? m_queue.size() : m_max_batch;
+        m_group.clear();
+        for (size_t i = 0; i < count; i++)
+        {
+            m_group.push_back(m_queue[i]->batch);
+        }
+        /*
+         * writers behind the group keep waiting since the leader stays at the queue head
+         */
+        m_lock.Unlock();
+        int err = m_engine->WriteGroup(ctx, &m_group[0], count, m_sync);
+        m_lock.Lock();
+        for (size_t i = 0; i < count; i++)
+        {
+            Writer* writer = m_queue.front();
+            writer->err = err;
+            writer->done = true;
+            m_queue.pop_front();
+        }
+        m_groups++;
+        m_batches += count;
+        m_lock.NotifyAll();
+        m_lock.Unlock();
+        return err;
+    }
+
+    void GroupCommitter::Stats(uint64& groups, uint64& batches)
+    {
+        m_lock.Lock();
+        groups = m_groups;
+        batches = m_batches;
+        m_lock.Unlock();
+    }
+
+    struct EncodedKeyLess
+    {
+            const std::vector<Slice>& encoded;
+            bool has_ns;
+            EncodedKeyLess(const std::vector<Slice>& e, bool ns) :
+                    encoded(e), has_ns(ns)
+            {
+            }
+            bool operator()(size_t i, size_t j) const
+            {
+                return compare_keyslices(encoded[i], encoded[j], has_ns) < 0;
+            }
+    };
+
+    void encode_sorted_keys(const KeyObjectArray& keys, bool with_ns, Buffer& buffer, std::vector<Slice>& encoded,
+            std::vector<size_t>& order)
+    {
+        std::vector<size_t> lens(keys.size());
+        buffer.Clear();
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            size_t mark = buffer.GetWriteIndex();
+            keys[i].Encode(buffer, false, with_ns);
+            lens[i] = buffer.GetWriteIndex() - mark;
+        }
+        /*
+         * slices are built after all keys were encoded since the buffer may grow while encoding
+         */
+        encoded.resize(keys.size());
+        order.resize(keys.size());
+        const char* p = buffer.GetRawBuffer();
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            encoded[i] = Slice(p, lens[i]);
+            p += lens[i];
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), EncodedKeyLess(encoded, with_ns));
+    }
+
+    void init_iterate_upper_bound(const KeyObject& key, KeyObject& upperbound)
+    {
+        upperbound.SetNameSpace(key.GetNameSpace());
+        if (key.GetType() == KEY_META)
+        {
+            upperbound.SetType(KEY_END);
+        }
+        else
+        {
+            upperbound.SetType(key.GetType());
+            upperbound.SetVersion(key.GetVersion() + 1);
+        }
+        upperbound.SetKey(key.GetKey());
+    }
+
     int compare_keyslices(const Slice& k1, const Slice& k2, bool has_ns)
     {
         return compare_keys(k1.data(), k1.size(), k2.data(), k2.size(), has_ns);
@@ -53,6 +181,18 @@ OP_NAMESPACE_BEGIN
         {
             return ret;
         }
+        if (KEY_FORMAT_MEMCOMPARABLE == g_key_format)
+        {
+            /*
+             * memcomparable keys already order bytewise, no need to decode
+             */
+            ret = memcmp(k1, k2, k1_len < k2_len ? k1_len : k2_len);
+            if (0 != ret)
+            {
+                return ret;
+            }
+            return k1_len < k2_len ? -1 : (k1_len > k2_len ? 1 : 0);
+        }
 
         Buffer kbuf1(const_cast<char*>(k1), 0, k1_len);
         Buffer kbuf2(const_cast<char*>(k2), 0, k2_len);
@@ -125,6 +265,13 @@ OP_NAMESPACE_BEGIN
             {
                 FATAL_LOG("Invalid element length");
             }
+            /*
+             * element keys of versioned collections order after unversioned ones, then by version
+             */
+            if (key1.GetVersion() != key2.GetVersion())
+            {
+                return key1.GetVersion() < key2.GetVersion() ? -1 : 1;
+            }
             ret = elen1 - elen2;
             if (ret != 0)
             {
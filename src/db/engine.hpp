@@ -33,6 +33,9 @@
 #include "codec.hpp"
 #include "context.hpp"
 #include "util/config_helper.hpp"
+#include "thread/thread_mutex_lock.hpp"
+#include <deque>
+#include <vector>
 
 OP_NAMESPACE_BEGIN
 
@@ -71,9 +74,10 @@ OP_NAMESPACE_BEGIN
             unsigned support_merge :1;
             unsigned support_backup :1;
             unsigned support_delete_range :1;
+            unsigned support_group_commit :1;
             FeatureSet() :
                     support_namespace(0), support_compactfilter(0), support_merge(0), support_backup(0), support_delete_range(
-                            0)
+                            0), support_group_commit(0)
             {
             }
     };
@@ -109,6 +113,14 @@ OP_NAMESPACE_BEGIN
             virtual int BeginWriteBatch(Context& ctx) = 0;
             virtual int CommitWriteBatch(Context& ctx) = 0;
             virtual int DiscardWriteBatch(Context& ctx) = 0;
+            /*
+             * Like BeginWriteBatch, but the reads of the calling thread see the batched writes until the batch is
+             * committed or discarded. Engines which can not read their own batch return ERR_NOTSUPPORTED.
+             */
+            virtual int BeginIndexedWriteBatch(Context& ctx)
+            {
+                return ERR_NOTSUPPORTED;
+            }
 
             virtual int ListNameSpaces(Context& ctx, DataArray& nss) = 0;
             virtual int DropNameSpace(Context& ctx, const Data& ns) = 0;
@@ -129,6 +141,24 @@ OP_NAMESPACE_BEGIN
                 return ERR_NOTSUPPORTED;
             }
 
+            /*
+             * Build an engine native file at 'file' from raw key/values of one namespace which are put in engine order,
+             * 'EndSortedLoad' ingests it into the db if 'commit' is true. NULL loader means the engine can not do this,
+             * callers should fall back to PutRaw.
+             */
+            virtual void* BeginSortedLoad(Context& ctx, const Data& ns, const std::string& file)
+            {
+                return NULL;
+            }
+            virtual int SortedLoadPut(void* loader, const Slice& key, const Slice& value)
+            {
+                return ERR_NOTSUPPORTED;
+            }
+            virtual int EndSortedLoad(Context& ctx, void* loader, bool commit)
+            {
+                return ERR_NOTSUPPORTED;
+            }
+
             virtual int Backup(Context& ctx, const std::string& dir)
             {
                 return ERR_NOTSUPPORTED;
@@ -139,6 +169,14 @@ OP_NAMESPACE_BEGIN
             }
 
             virtual int64_t EstimateKeysNum(Context& ctx, const Data& ns) = 0;
+            /*
+             * At most 'max' ascending user keys cutting the keys of 'ns' into ranges of similar size, told by the
+             * engine's storage layout without scanning. Engines without one leave sampling to the caller.
+             */
+            virtual int GetKeySplits(Context& ctx, const Data& ns, size_t max, StringArray& splits)
+            {
+                return ERR_NOTSUPPORTED;
+            }
             virtual void Stats(Context& ctx, std::string& str) = 0;
 
             virtual const std::string GetErrorReason(int err) = 0;
@@ -161,6 +199,15 @@ OP_NAMESPACE_BEGIN
 
             virtual int MaxOpenFiles() = 0;
 
+            /*
+             * Write the thread local write batches of several committers with one engine write,
+             * only invoked on engines with 'support_group_commit'.
+             */
+            virtual int WriteGroup(Context& ctx, void** batches, size_t count, bool sync)
+            {
+                return ERR_NOTSUPPORTED;
+            }
+
             virtual ~Engine()
             {
             }
@@ -201,10 +248,59 @@ OP_NAMESPACE_BEGIN
             }
     };
 
+    /*
+     * Group commit stage in front of Engine::WriteGroup.
+     * The committer at the queue head becomes the leader, it waits at most 'max_delay' micros for
+     * other committers, writes up to 'max_batch' batches at once and wakes the followers afterwards,
+     * so a write command never replies before its batch reached the engine.
+     */
+    class GroupCommitter
+    {
+        private:
+            struct Writer
+            {
+                    void* batch;
+                    int err;
+                    bool done;
+                    Writer(void* b) :
+                            batch(b), err(0), done(false)
+                    {
+                    }
+            };
+            typedef std::deque<Writer*> WriterQueue;
+            Engine* m_engine;
+            int64 m_max_delay;
+            size_t m_max_batch;
+            bool m_sync;
+            ThreadMutexLock m_lock;
+            WriterQueue m_queue;
+            std::vector<void*> m_group;
+            uint64 m_groups;
+            uint64 m_batches;
+        public:
+            GroupCommitter(Engine* engine, int64 max_delay, int64 max_batch, bool sync);
+            int Commit(Context& ctx, void* batch);
+            void Stats(uint64& groups, uint64& batches);
+    };
+
     int compare_keys(const char* k1, size_t k1_len, const char* k2, size_t k2_len, bool has_ns);
     int compare_keyslices(const Slice& k1, const Slice& k2, bool has_ns);
 
+    /*
+     * Encodes 'keys' into 'buffer' for a batched lookup, 'order' is filled with the key indexes sorted
+     * in engine key order so that the lookups walk the engine forward.
+     */
+    void encode_sorted_keys(const KeyObjectArray& keys, bool with_ns, Buffer& buffer, std::vector<Slice>& encoded,
+            std::vector<size_t>& order);
+
+    /*
+     * Upper bound of an iteration starting at 'key': all records of the key for a meta key, otherwise
+     * the element records with the same type & collection version.
+     */
+    void init_iterate_upper_bound(const KeyObject& key, KeyObject& upperbound);
+
     extern Engine* g_engine;
+    extern GroupCommitter* g_group_committer;
     extern volatile uint64_t g_db_iterator_counter;
 OP_NAMESPACE_END
 
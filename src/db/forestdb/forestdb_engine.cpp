@@ -596,16 +596,7 @@ namespace ardb
                 if (!ctx.flags.iterate_no_upperbound)
                 {
                     KeyObject upperbound_key;
-                    upperbound_key.SetNameSpace(key.GetNameSpace());
-                    if (key.GetType() == KEY_META)
-                    {
-                        upperbound_key.SetType(KEY_END);
-                    }
-                    else
-                    {
-                        upperbound_key.SetType(key.GetType() + 1);
-                    }
-                    upperbound_key.SetKey(key.GetKey());
+                    init_iterate_upper_bound(key, upperbound_key);
                     upperbound_key.Encode(encode_buffer, false);
                     end_keylen = encode_buffer.ReadableBytes() - start_keylen;
                     end_key = (const void *) (encode_buffer.GetRawBuffer() + start_keylen);
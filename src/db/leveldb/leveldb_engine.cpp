@@ -30,6 +30,7 @@
 #include "leveldb_engine.hpp"
 #include "util/file_helper.hpp"
 #include "leveldb/env.h"
+#include "leveldb/comparator.h"
 #include "db/db_utils.hpp"
 #include "db/db.hpp"
 #include "thread/lock_guard.hpp"
@@ -260,7 +261,10 @@ namespace ardb
 
         static LevelDBComparator comparator;
         m_options.create_if_missing = true;
-        m_options.comparator = &comparator;
+        /*
+         * memcomparable keys order bytewise, the default comparator avoids decoding keys on every compare
+         */
+        m_options.comparator = KEY_FORMAT_MEMCOMPARABLE == g_key_format ? leveldb::BytewiseComparator() : &comparator;
         if (m_cfg.block_cache_size > 0)
         {
             leveldb::Cache* cache = leveldb::NewLRUCache(m_cfg.block_cache_size);
@@ -364,7 +368,7 @@ namespace ardb
     {
         static LevelDBComparator comparator;
         static LevelDBLogger logger;
-        m_options.comparator = &comparator;
+        m_options.comparator = KEY_FORMAT_MEMCOMPARABLE == g_key_format ? leveldb::BytewiseComparator() : &comparator;
         m_options.info_log = &logger;
         leveldb::Status status = leveldb::RepairDB(dir, m_options);
         return status.ok() ? 0 : -1;
@@ -391,7 +395,7 @@ namespace ardb
         LevelDBLocalContext& local_ctx = g_local_ctx.GetValue();
         leveldb::WriteOptions opt;
         Buffer& encode_buffer = local_ctx.GetEncodeBufferCache();
-        ns.Encode(encode_buffer);
+        encode_key_namespace(encode_buffer, ns);
         encode_buffer.Write(key.data(), key.size());
         leveldb::Slice key_slice(encode_buffer.GetRawReadBuffer(), encode_buffer.ReadableBytes());
         leveldb::Slice value_slice(value.data(), value.size());
@@ -439,12 +443,40 @@ namespace ardb
     int LevelDBEngine::MultiGet(Context& ctx, const KeyObjectArray& keys, ValueObjectArray& values, ErrCodeArray& errs)
     {
         values.resize(keys.size());
-        errs.resize(keys.size());
-        for (size_t i = 0; i < keys.size(); i++)
+        errs.assign(keys.size(), ERR_ENTRY_NOT_EXIST);
+        LevelDBLocalContext& local_ctx = g_local_ctx.GetValue();
+        std::vector<Slice> encoded;
+        std::vector<size_t> order;
+        encode_sorted_keys(keys, true, local_ctx.GetEncodeBufferCache(), encoded, order);
+        /*
+         * all keys are read from one snapshot in comparator order
+         */
+        leveldb::ReadOptions opt;
+        opt.snapshot = local_ctx.snapshot.Get();
+        std::string& valstr = local_ctx.GetStringCache();
+        const Data* ns = NULL;
+        bool ns_exist = false;
+        for (size_t i = 0; i < order.size(); i++)
         {
-            int err = Get(ctx, keys[i], values[i]);
-            errs[i] = err;
+            size_t idx = order[i];
+            if (NULL == ns || !(*ns == keys[idx].GetNameSpace()))
+            {
+                ns = &(keys[idx].GetNameSpace());
+                ns_exist = GetNamespace(*ns, false);
+            }
+            if (!ns_exist)
+            {
+                continue;
+            }
+            leveldb::Status s = m_db->Get(opt, to_leveldb_slice(encoded[idx]), &valstr);
+            errs[idx] = leveldb_err(s);
+            if (0 == errs[idx])
+            {
+                Buffer valBuffer(const_cast<char*>(valstr.data()), 0, valstr.size());
+                values[idx].Decode(valBuffer, true);
+            }
         }
+        local_ctx.snapshot.Release();
         return 0;
     }
     int LevelDBEngine::Get(Context& ctx, const KeyObject& key, ValueObject& value)
@@ -574,16 +606,7 @@ namespace ardb
                 if (!ctx.flags.iterate_no_upperbound)
                 {
                     KeyObject& upperbound_key = iter->IterateUpperBoundKey();
-                    upperbound_key.SetNameSpace(key.GetNameSpace());
-                    if (key.GetType() == KEY_META)
-                    {
-                        upperbound_key.SetType(KEY_END);
-                    }
-                    else
-                    {
-                        upperbound_key.SetType(key.GetType() + 1);
-                    }
-                    upperbound_key.SetKey(key.GetKey());
+                    init_iterate_upper_bound(key, upperbound_key);
                     upperbound_key.CloneStringPart();
                 }
             }
@@ -610,13 +633,32 @@ namespace ardb
     int LevelDBEngine::CommitWriteBatch(Context& ctx)
     {
         LevelDBLocalContext& rocks_ctx = g_local_ctx.GetValue();
+        int err = 0;
         if (rocks_ctx.batch.ReleaseRef(false) == 0)
         {
-            leveldb::WriteOptions opt;
-            m_db->Write(opt, &rocks_ctx.batch.GetBatch());
+            if (NULL != g_group_committer && !ctx.flags.bulk_loading)
+            {
+                err = g_group_committer->Commit(ctx, &rocks_ctx.batch.GetBatch());
+            }
+            else
+            {
+                leveldb::WriteOptions opt;
+                m_db->Write(opt, &rocks_ctx.batch.GetBatch());
+            }
             rocks_ctx.batch.Clear();
         }
-        return 0;
+        return err;
+    }
+    int LevelDBEngine::WriteGroup(Context& ctx, void** batches, size_t count, bool sync)
+    {
+        leveldb::WriteBatch* group = (leveldb::WriteBatch*) batches[0];
+        for (size_t i = 1; i < count; i++)
+        {
+            group->Append(*((leveldb::WriteBatch*) batches[i]));
+        }
+        leveldb::WriteOptions opt;
+        opt.sync = sync;
+        return leveldb_err(m_db->Write(opt, group));
     }
     int LevelDBEngine::DiscardWriteBatch(Context& ctx)
     {
@@ -848,7 +890,7 @@ namespace ardb
          * trim namespace header
          */
         Buffer buf((char*) s.data(), 0, s.size());
-        ns.Decode(buf, false);
+        decode_key_namespace(buf, ns, false);
         return Slice(buf.GetRawReadBuffer(), buf.ReadableBytes());
     }
     Slice LevelDBIterator::RawKey()
@@ -135,6 +135,7 @@ namespace ardb
             bool Exists(Context& ctx, const KeyObject& key,ValueObject& val);
             int BeginWriteBatch(Context& ctx);
             int CommitWriteBatch(Context& ctx);
+            int WriteGroup(Context& ctx, void** batches, size_t count, bool sync);
             int DiscardWriteBatch(Context& ctx);
             int Compact(Context& ctx, const KeyObject& start, const KeyObject& end);
             int ListNameSpaces(Context& ctx, DataArray& nss);
@@ -149,6 +150,7 @@ namespace ardb
                 features.support_compactfilter = 0;
                 features.support_namespace = 0;
                 features.support_merge = 0;
+                features.support_group_commit = 1;
                 return features;
             }
             int MaxOpenFiles();
@@ -350,7 +350,13 @@ namespace ardb
             recreate_local_txn = true;
         }
         CHECK_RET(mdb_open(txn, ns.AsString().c_str(), create_if_noexist ? MDB_CREATE : 0, &dbi), false);
-        mdb_set_compare(txn, dbi, LMDBCompareFunc);
+        if (KEY_FORMAT_LEGACY == g_key_format)
+        {
+            /*
+             * memcomparable keys just use lmdb's default lexical order
+             */
+            mdb_set_compare(txn, dbi, LMDBCompareFunc);
+        }
 
         std::string ns_key = "ns:" + ns.AsString();
         std::string ns_val = ns.AsString();
@@ -608,23 +614,10 @@ namespace ardb
             return 0;
         }
         LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
-        Buffer& key_encode_buffers = local_ctx.GetEncodeBuferCache();
-        std::vector<size_t> positions;
-        std::vector<MDB_val> ks;
-        ks.resize(keys.size());
-        errs.resize(keys.size());
-        for (size_t i = 0; i < keys.size(); i++)
-        {
-            size_t mark = key_encode_buffers.GetWriteIndex();
-            keys[i].Encode(key_encode_buffers);
-            positions.push_back(key_encode_buffers.GetWriteIndex() - mark);
-        }
-        for (size_t i = 0; i < keys.size(); i++)
-        {
-            ks[i].mv_data = (void*) key_encode_buffers.GetRawReadBuffer();
-            ks[i].mv_size = positions[i];
-            key_encode_buffers.AdvanceReadIndex(positions[i]);
-        }
+        std::vector<Slice> encoded;
+        std::vector<size_t> order;
+        encode_sorted_keys(keys, false, local_ctx.GetEncodeBuferCache(), encoded, order);
+        errs.assign(keys.size(), 0);
 
         MDB_txn *txn = local_ctx.txn;
         int rc = 0;
@@ -634,18 +627,25 @@ namespace ardb
         }
         if (0 == rc)
         {
-            for (size_t i = 0; i < keys.size(); i++)
+            /*
+             * all keys are read within one read txn, in comparator order so that neighbour keys
+             * are served from the same btree pages
+             */
+            for (size_t i = 0; i < order.size(); i++)
             {
-                MDB_val v;
-                rc = mdb_get(txn, dbi, &ks[i], &v);
-                if (0 == rc)
+                size_t idx = order[i];
+                MDB_val k, v;
+                k.mv_data = (void*) encoded[idx].data();
+                k.mv_size = encoded[idx].size();
+                int get_rc = mdb_get(txn, dbi, &k, &v);
+                if (0 == get_rc)
                 {
                     Buffer valBuffer((char*) (v.mv_data), 0, v.mv_size);
-                    values[i].Decode(valBuffer, true);
+                    values[idx].Decode(valBuffer, true);
                 }
                 else
                 {
-                    errs[i] = ENGINE_ERR(rc);
+                    errs[idx] = ENGINE_ERR(get_rc);
                 }
             }
             if (NULL == local_ctx.txn)
@@ -831,16 +831,7 @@ namespace ardb
                 if (!ctx.flags.iterate_no_upperbound)
                 {
                     KeyObject& upperbound_key = iter->IterateUpperBoundKey();
-                    upperbound_key.SetNameSpace(key.GetNameSpace());
-                    if (key.GetType() == KEY_META)
-                    {
-                        upperbound_key.SetType(KEY_END);
-                    }
-                    else
-                    {
-                        upperbound_key.SetType(key.GetType() + 1);
-                    }
-                    upperbound_key.SetKey(key.GetKey());
+                    init_iterate_upper_bound(key, upperbound_key);
                     upperbound_key.CloneStringPart();
                 }
             }
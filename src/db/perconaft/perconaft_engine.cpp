@@ -563,16 +563,7 @@ namespace ardb
                 if (!ctx.flags.iterate_no_upperbound)
                 {
                     KeyObject& upperbound_key = iter->IterateUpperBoundKey();
-                    upperbound_key.SetNameSpace(key.GetNameSpace());
-                    if (key.GetType() == KEY_META)
-                    {
-                        upperbound_key.SetType(KEY_END);
-                    }
-                    else
-                    {
-                        upperbound_key.SetType(key.GetType() + 1);
-                    }
-                    upperbound_key.SetKey(key.GetKey());
+                    init_iterate_upper_bound(key, upperbound_key);
                     upperbound_key.CloneStringPart();
                 }
             }
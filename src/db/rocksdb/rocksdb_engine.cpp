@@ -30,9 +30,12 @@
 #include "rocksdb/utilities/convenience.h"
 #include "rocksdb/compaction_filter.h"
 #include "rocksdb/slice_transform.h"
+#include "rocksdb/comparator.h"
 #include "rocksdb/utilities/memory_util.h"
 #include "rocksdb/table.h"
 #include "rocksdb/write_buffer_manager.h"
+#include "rocksdb/sst_file_writer.h"
+#include "db/write_batch_internal.h"
 #include "thread/lock_guard.hpp"
 #include "thread/spin_mutex_lock.hpp"
 #include "db/db.hpp"
@@ -51,32 +54,69 @@ OP_NAMESPACE_BEGIN
 
     static rocksdb::DB* g_rocksdb = NULL;
 
+    /*
+     * The indexed batch is only used by the outermost batch begun with BeginIndexedWriteBatch, it costs an index
+     * insert per write, but reads may look up the batched writes.
+     */
     class RocksWriteBatch
     {
         private:
             rocksdb::WriteBatch batch;
+            rocksdb::WriteBatchWithIndex* indexed_batch;
+            bool indexed;
             uint32_t ref;
+            rocksdb::WriteBatchBase& Current()
+            {
+                if (indexed)
+                {
+                    return *indexed_batch;
+                }
+                return batch;
+            }
         public:
             RocksWriteBatch()
-                    : ref(0)
+                    : indexed_batch(NULL), indexed(false), ref(0)
             {
             }
             rocksdb::WriteBatch& GetBatch()
             {
+                if (indexed)
+                {
+                    return *(indexed_batch->GetWriteBatch());
+                }
                 return batch;
             }
-            rocksdb::WriteBatch* Ref()
+            rocksdb::WriteBatchBase* Ref()
             {
                 if (ref > 0)
                 {
-                    return &batch;
+                    return &Current();
                 }
                 return NULL;
             }
-            uint32 AddRef()
+            rocksdb::WriteBatchWithIndex* Indexed()
             {
+                if (ref > 0 && indexed)
+                {
+                    return indexed_batch;
+                }
+                return NULL;
+            }
+            uint32 AddRef(bool index = false)
+            {
+                if (0 == ref && index)
+                {
+                    if (NULL == indexed_batch)
+                    {
+                        /*
+                         * overwrite_key is required by NewIteratorWithBase
+                         */
+                        NEW(indexed_batch, rocksdb::WriteBatchWithIndex(rocksdb::BytewiseComparator(), 0, true));
+                    }
+                    indexed = true;
+                }
                 ref++;
-                batch.SetSavePoint();
+                Current().SetSavePoint();
                 return ref;
             }
             uint32 ReleaseRef(bool rollback)
@@ -84,15 +124,24 @@ OP_NAMESPACE_BEGIN
                 ref--;
                 if (rollback)
                 {
-                    batch.RollbackToSavePoint();
+                    Current().RollbackToSavePoint();
                 }
                 return ref;
             }
             void Clear()
             {
                 batch.Clear();
+                if (NULL != indexed_batch)
+                {
+                    indexed_batch->Clear();
+                }
+                indexed = false;
                 ref = 0;
             }
+            ~RocksWriteBatch()
+            {
+                DELETE(indexed_batch);
+            }
     };
 
     struct RocksIterData
@@ -743,7 +792,10 @@ OP_NAMESPACE_BEGIN
         //g_iter_cache.Init();
 
         static RocksDBComparator comparator;
-        m_options.comparator = &comparator;
+        /*
+         * memcomparable keys order bytewise, the builtin comparator avoids decoding keys on every compare
+         */
+        m_options.comparator = KEY_FORMAT_MEMCOMPARABLE == g_key_format ? rocksdb::BytewiseComparator() : &comparator;
         m_options.merge_operator.reset(new MergeOperator);
         m_options.prefix_extractor.reset(new RocksDBPrefixExtractor);
         m_options.compaction_filter_factory.reset(new RocksDBCompactionFilterFactory(this));
@@ -794,7 +846,7 @@ OP_NAMESPACE_BEGIN
     int RocksDBEngine::Repair(const std::string& dir)
     {
         static RocksDBComparator comparator;
-        m_options.comparator = &comparator;
+        m_options.comparator = KEY_FORMAT_MEMCOMPARABLE == g_key_format ? rocksdb::BytewiseComparator() : &comparator;
         m_options.merge_operator.reset(new MergeOperator);
         m_options.prefix_extractor.reset(new RocksDBPrefixExtractor);
         m_options.compaction_filter_factory.reset(new RocksDBCompactionFilterFactory(this));
@@ -837,7 +889,7 @@ OP_NAMESPACE_BEGIN
         rocksdb::Slice key_slice = to_rocksdb_slice(key);
         rocksdb::Slice value_slice = to_rocksdb_slice(value);
         rocksdb::Status s;
-        rocksdb::WriteBatch* batch = rocks_ctx.transc.Ref();
+        rocksdb::WriteBatchBase* batch = rocks_ctx.transc.Ref();
         if (NULL != batch)
         {
             batch->Put(cf, key_slice, value_slice);
@@ -871,7 +923,7 @@ OP_NAMESPACE_BEGIN
         size_t value_len = encode_buffer.ReadableBytes() - key_len;
         rocksdb::Slice key_slice(encode_buffer.GetRawBuffer(), key_len);
         rocksdb::Slice value_slice(encode_buffer.GetRawBuffer() + key_len, value_len);
-        rocksdb::WriteBatch* batch = rocks_ctx.transc.Ref();
+        rocksdb::WriteBatchBase* batch = rocks_ctx.transc.Ref();
         if (NULL != batch)
         {
             batch->Put(cf, key_slice, value_slice);
@@ -894,37 +946,42 @@ OP_NAMESPACE_BEGIN
         }
         errs.resize(keys.size());
         RocksDBLocalContext& rocks_ctx = g_rocks_context.GetValue();
-        std::vector<rocksdb::ColumnFamilyHandle*> cfs;
-        std::vector<rocksdb::Slice> ks;
-        std::vector<size_t> positions;
-        Buffer& key_encode_buffers = rocks_ctx.GetEncodeBuferCache();
-        ks.resize(keys.size());
-        std::vector<std::string>& vs = rocks_ctx.GetMultiStringCache();
-        for (size_t i = 0; i < keys.size(); i++)
+        if (NULL != rocks_ctx.transc.Indexed())
         {
-            size_t mark = key_encode_buffers.GetWriteIndex();
-            keys[i].Encode(key_encode_buffers);
-            positions.push_back((size_t) (key_encode_buffers.GetWriteIndex() - mark));
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                errs[i] = Get(ctx, keys[i], values[i]);
+            }
+            return 0;
         }
-        for (size_t i = 0; i < keys.size(); i++)
+        std::vector<Slice> encoded;
+        std::vector<size_t> order;
+        encode_sorted_keys(keys, false, rocks_ctx.GetEncodeBuferCache(), encoded, order);
+        /*
+         * keys are passed in comparator order, so the lookups under the shared snapshot walk
+         * memtables and sst blocks forward
+         */
+        std::vector<rocksdb::ColumnFamilyHandle*> cfs(keys.size(), cf);
+        std::vector<rocksdb::Slice> ks(keys.size());
+        for (size_t i = 0; i < order.size(); i++)
         {
-            cfs.push_back(cf);
-            ks[i] = rocksdb::Slice(key_encode_buffers.GetRawReadBuffer(), positions[i]);
-            key_encode_buffers.AdvanceReadIndex(positions[i]);
+            ks[i] = to_rocksdb_slice(encoded[order[i]]);
         }
-
+        std::vector<std::string>& vs = rocks_ctx.GetMultiStringCache();
         rocksdb::ReadOptions opt;
+        opt.snapshot = (const rocksdb::Snapshot*) ctx.engine_snapshot;
         opt.fill_cache = g_db->GetConf().rocksdb_read_fill_cache;
         std::vector<rocksdb::Status> ss = m_db->MultiGet(opt, cfs, ks, &vs);
 
         for (size_t i = 0; i < ss.size(); i++)
         {
+            size_t idx = order[i];
             if (ss[i].ok())
             {
                 Buffer valBuffer(const_cast<char*>(vs[i].data()), 0, vs[i].size());
-                values[i].Decode(valBuffer, true);
+                values[idx].Decode(valBuffer, true);
             }
-            errs[i] = rocksdb_err(ss[i]);
+            errs[idx] = rocksdb_err(ss[i]);
         }
         return 0;
     }
@@ -938,11 +995,21 @@ OP_NAMESPACE_BEGIN
         }
         RocksDBLocalContext& rocks_ctx = g_rocks_context.GetValue();
         rocksdb::ReadOptions opt;
+        opt.snapshot = (const rocksdb::Snapshot*) ctx.engine_snapshot;
         opt.fill_cache = g_db->GetConf().rocksdb_read_fill_cache;
         std::string& valstr = rocks_ctx.GetStringCache();
         Buffer& key_encode_buffer = rocks_ctx.GetEncodeBuferCache();
         rocksdb::Slice key_slice = to_rocksdb_slice(key.Encode(key_encode_buffer));
-        rocksdb::Status s = m_db->Get(opt, cf, key_slice, &valstr);
+        rocksdb::WriteBatchWithIndex* indexed = rocks_ctx.transc.Indexed();
+        rocksdb::Status s;
+        if (NULL != indexed)
+        {
+            s = indexed->GetFromBatchAndDB(m_db, opt, cf, key_slice, &valstr);
+        }
+        else
+        {
+            s = m_db->Get(opt, cf, key_slice, &valstr);
+        }
         int err = rocksdb_err(s);
         if (0 != err)
         {
@@ -972,8 +1039,33 @@ OP_NAMESPACE_BEGIN
         rocksdb::Slice start_slice(key_encode_buffer.GetRawBuffer(), start_len);
         rocksdb::Slice end_slice(key_encode_buffer.GetRawBuffer() + start_len, end_len);
         rocksdb::Status s;
-        rocksdb::WriteBatch* batch = rocks_ctx.transc.Ref();
-        if (NULL != batch)
+        rocksdb::WriteBatchWithIndex* indexed = rocks_ctx.transc.Indexed();
+        rocksdb::WriteBatchBase* batch = rocks_ctx.transc.Ref();
+        if (NULL != indexed)
+        {
+            /*
+             * indexed batches can not hold range deletions, the keys in range are deleted one by one. A key
+             * written earlier in the batch points into the batch buffer, which a Delete may reallocate, so the
+             * keys are copied out before the batch is updated.
+             */
+            rocksdb::ReadOptions ropt;
+            ropt.snapshot = (const rocksdb::Snapshot*) ctx.engine_snapshot;
+            ropt.total_order_seek = true;
+            const rocksdb::Comparator* cmp = cf->GetComparator();
+            StringArray keys;
+            rocksdb::Iterator* iter = indexed->NewIteratorWithBase(cf, m_db->NewIterator(ropt, cf));
+            for (iter->Seek(start_slice); iter->Valid() && cmp->Compare(iter->key(), end_slice) < 0; iter->Next())
+            {
+                keys.push_back(iter->key().ToString());
+            }
+            s = iter->status();
+            delete iter;
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                indexed->Delete(cf, keys[i]);
+            }
+        }
+        else if (NULL != batch)
         {
             batch->DeleteRange(cf, start_slice, end_slice);
         }
@@ -983,12 +1075,12 @@ OP_NAMESPACE_BEGIN
         }
         return rocksdb_err(s);
     }
-    int RocksDBEngine::DelKeySlice(rocksdb::WriteBatch* batch, rocksdb::ColumnFamilyHandle* cf,
+    int RocksDBEngine::DelKeySlice(rocksdb::WriteBatchBase* batch, rocksdb::ColumnFamilyHandle* cf,
             const rocksdb::Slice& key_slice)
     {
         rocksdb::WriteOptions opt;
         rocksdb::Status s;
-        //rocksdb::WriteBatch* batch = rocks_ctx.transc.Ref();
+        //rocksdb::WriteBatchBase* batch = rocks_ctx.transc.Ref();
         if (NULL != batch)
         {
             batch->Delete(cf, key_slice);
@@ -1044,7 +1136,7 @@ OP_NAMESPACE_BEGIN
         rocksdb::Slice key_slice(encode_buffer.GetRawBuffer(), key_len);
         rocksdb::Slice merge_slice(encode_buffer.GetRawBuffer() + key_len, merge_len);
         rocksdb::Status s;
-        rocksdb::WriteBatch* batch = rocks_ctx.transc.Ref();
+        rocksdb::WriteBatchBase* batch = rocks_ctx.transc.Ref();
         if (NULL != batch)
         {
             batch->Merge(cf, key_slice, merge_slice);
@@ -1065,7 +1157,12 @@ OP_NAMESPACE_BEGIN
             return false;
         }
         RocksDBLocalContext& rocks_ctx = g_rocks_context.GetValue();
+        if (NULL != rocks_ctx.transc.Indexed())
+        {
+            return 0 == Get(ctx, key, val);
+        }
         rocksdb::ReadOptions opt;
+        opt.snapshot = (const rocksdb::Snapshot*) ctx.engine_snapshot;
         opt.fill_cache = g_db->GetConf().rocksdb_read_fill_cache;
         Buffer& key_encode_buffer = rocks_ctx.GetEncodeBuferCache();
         std::string& tmp = rocks_ctx.GetStringCache();
@@ -1111,16 +1208,7 @@ OP_NAMESPACE_BEGIN
                 if (!ctx.flags.iterate_no_upperbound)
                 {
                     KeyObject& upperbound_key = iter->IterateUpperBoundKey();
-                    upperbound_key.SetNameSpace(key.GetNameSpace());
-                    if (key.GetType() == KEY_META)
-                    {
-                        upperbound_key.SetType(KEY_END);
-                    }
-                    else
-                    {
-                        upperbound_key.SetType(key.GetType() + 1);
-                    }
-                    upperbound_key.SetKey(key.GetKey());
+                    init_iterate_upper_bound(key, upperbound_key);
                     upperbound_key.CloneStringPart();
                 }
             }
@@ -1138,7 +1226,12 @@ OP_NAMESPACE_BEGIN
         if (NULL == rocksiter)
         {
             NEW(rocksiter, RocksIterData);
+            rocksdb::WriteBatchWithIndex* indexed = g_rocks_context.GetValue().transc.Indexed();
             rocksiter->iter = m_db->NewIterator(opt, cf);
+            if (NULL != indexed)
+            {
+                rocksiter->iter = indexed->NewIteratorWithBase(cf, rocksiter->iter);
+            }
             rocksiter->dbseq = m_db->GetLatestSequenceNumber();
             rocksiter->create_time = time(NULL);
             rocksiter->iter_prefix_same_as_start = opt.prefix_same_as_start;
@@ -1165,20 +1258,49 @@ OP_NAMESPACE_BEGIN
         rocks_ctx.transc.AddRef();
         return 0;
     }
+    int RocksDBEngine::BeginIndexedWriteBatch(Context& ctx)
+    {
+        RocksDBLocalContext& rocks_ctx = g_rocks_context.GetValue();
+        rocks_ctx.transc.AddRef(true);
+        return 0;
+    }
     int RocksDBEngine::CommitWriteBatch(Context& ctx)
     {
         RocksDBLocalContext& rocks_ctx = g_rocks_context.GetValue();
+        int err = 0;
         if (rocks_ctx.transc.ReleaseRef(false) == 0)
         {
-            rocksdb::WriteOptions opt;
-            if (disablewal || ctx.flags.bulk_loading)
+            if (NULL != g_group_committer && !ctx.flags.bulk_loading)
+            {
+                err = g_group_committer->Commit(ctx, &rocks_ctx.transc.GetBatch());
+            }
+            else
             {
-                opt.disableWAL = true;
+                rocksdb::WriteOptions opt;
+                if (disablewal || ctx.flags.bulk_loading)
+                {
+                    opt.disableWAL = true;
+                }
+                m_db->Write(opt, &rocks_ctx.transc.GetBatch());
             }
-            m_db->Write(opt, &rocks_ctx.transc.GetBatch());
             rocks_ctx.transc.Clear();
         }
-        return 0;
+        return err;
+    }
+    int RocksDBEngine::WriteGroup(Context& ctx, void** batches, size_t count, bool sync)
+    {
+        /*
+         * the first batch belongs to the group leader, the others are appended to it
+         */
+        rocksdb::WriteBatch* group = (rocksdb::WriteBatch*) batches[0];
+        for (size_t i = 1; i < count; i++)
+        {
+            rocksdb::WriteBatchInternal::Append(group, (rocksdb::WriteBatch*) batches[i]);
+        }
+        rocksdb::WriteOptions opt;
+        opt.sync = sync && !disablewal;
+        opt.disableWAL = disablewal;
+        return rocksdb_err(m_db->Write(opt, group));
     }
     int RocksDBEngine::DiscardWriteBatch(Context& ctx)
     {
@@ -1257,6 +1379,73 @@ OP_NAMESPACE_BEGIN
         return ret;
     }
 
+    struct RocksDBSortedLoader
+    {
+            std::shared_ptr<rocksdb::ColumnFamilyHandle> cf;
+            rocksdb::SstFileWriter writer;
+            std::string file;
+            uint64 count;
+            RocksDBSortedLoader(const rocksdb::Options& options, const std::shared_ptr<rocksdb::ColumnFamilyHandle>& h)
+                    : cf(h), writer(rocksdb::EnvOptions(), options, h.get()), count(0)
+            {
+            }
+    };
+
+    void* RocksDBEngine::BeginSortedLoad(Context& ctx, const Data& ns, const std::string& file)
+    {
+        ColumnFamilyHandlePtr cfp = GetColumnFamilyHandle(ctx, ns, true);
+        if (NULL == cfp.get())
+        {
+            return NULL;
+        }
+        RocksDBSortedLoader* loader = NULL;
+        NEW(loader, RocksDBSortedLoader(m_options, cfp));
+        rocksdb::Status s = loader->writer.Open(file);
+        if (!s.ok())
+        {
+            WARN_LOG("Failed to open sst file:%s for reason:%s", file.c_str(), s.ToString().c_str());
+            DELETE(loader);
+            return NULL;
+        }
+        loader->file = file;
+        return loader;
+    }
+
+    int RocksDBEngine::SortedLoadPut(void* loader, const Slice& key, const Slice& value)
+    {
+        RocksDBSortedLoader* sst = (RocksDBSortedLoader*) loader;
+        rocksdb::Status s = sst->writer.Put(to_rocksdb_slice(key), to_rocksdb_slice(value));
+        if (s.ok())
+        {
+            sst->count++;
+        }
+        return rocksdb_err(s);
+    }
+
+    int RocksDBEngine::EndSortedLoad(Context& ctx, void* loader, bool commit)
+    {
+        RocksDBSortedLoader* sst = (RocksDBSortedLoader*) loader;
+        rocksdb::Status s;
+        if (commit && sst->count > 0)
+        {
+            s = sst->writer.Finish();
+            if (s.ok())
+            {
+                rocksdb::IngestExternalFileOptions opt;
+                opt.move_files = true;
+                std::vector<std::string> files(1, sst->file);
+                s = m_db->IngestExternalFile(sst->cf.get(), files, opt);
+            }
+            if (!s.ok())
+            {
+                ERROR_LOG("Failed to ingest sst file:%s for reason:%s", sst->file.c_str(), s.ToString().c_str());
+            }
+        }
+        file_del(sst->file);
+        DELETE(sst);
+        return rocksdb_err(s);
+    }
+
     const std::string RocksDBEngine::GetErrorReason(int err)
     {
         err = err - STORAGE_ENGINE_ERR_OFFSET;
@@ -1295,6 +1484,45 @@ OP_NAMESPACE_BEGIN
         return (int64) value;
     }
 
+    int RocksDBEngine::GetKeySplits(Context& ctx, const Data& ns, size_t max, StringArray& splits)
+    {
+        splits.clear();
+        std::string cf_name;
+        ns.ToString(cf_name);
+        std::vector<rocksdb::LiveFileMetaData> files;
+        m_db->GetLiveFilesMetaData(&files);
+        /*
+         * sst files of a level cover disjoint ranges of similar size, their first keys are the split points
+         */
+        StringTreeSet keys;
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (files[i].column_family_name != cf_name)
+            {
+                continue;
+            }
+            const std::string& smallest = files[i].smallestkey;
+            Buffer buffer(const_cast<char*>(smallest.data()), 0, smallest.size());
+            KeyObject k;
+            if (k.DecodeKey(buffer, false))
+            {
+                keys.insert(k.GetKey().AsString());
+            }
+        }
+        StringTreeSet::iterator it = keys.begin();
+        for (size_t i = 0; it != keys.end(); i++, it++)
+        {
+            /*
+             * keep 'max' evenly spaced ones
+             */
+            if (keys.size() <= max || (i * max) / keys.size() != ((i + 1) * max) / keys.size())
+            {
+                splits.push_back(*it);
+            }
+        }
+        return 0;
+    }
+
     int RocksDBEngine::MaxOpenFiles()
     {
         return (int) (m_options.max_open_files);
@@ -1308,6 +1536,7 @@ OP_NAMESPACE_BEGIN
         features.support_merge = 1;
         features.support_backup = 1;
         features.support_delete_range = 1;
+        features.support_group_commit = 1;
         return features;
     }
 
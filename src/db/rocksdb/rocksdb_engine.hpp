@@ -36,6 +36,7 @@
 #include "thread/thread_local.hpp"
 #include "rocksdb/db.h"
 #include "rocksdb/write_batch.h"
+#include "rocksdb/utilities/write_batch_with_index.h"
 #include "rocksdb/comparator.h"
 #include "rocksdb/cache.h"
 #include "rocksdb/filter_policy.h"
@@ -117,7 +118,7 @@ OP_NAMESPACE_BEGIN
             void Close();
             friend class RocksDBIterator;
             friend class RocksDBCompactionFilter;
-            int DelKeySlice(rocksdb::WriteBatch* batch, rocksdb::ColumnFamilyHandle* cf, const rocksdb::Slice& key);
+            int DelKeySlice(rocksdb::WriteBatchBase* batch, rocksdb::ColumnFamilyHandle* cf, const rocksdb::Slice& key);
         public:
             RocksDBEngine();
             ~RocksDBEngine();
@@ -135,15 +136,21 @@ OP_NAMESPACE_BEGIN
             int BeginWriteBatch(Context& ctx);
             int CommitWriteBatch(Context& ctx);
             int DiscardWriteBatch(Context& ctx);
+            int BeginIndexedWriteBatch(Context& ctx);
+            int WriteGroup(Context& ctx, void** batches, size_t count, bool sync);
             int Compact(Context& ctx, const KeyObject& start, const KeyObject& end);
             int ListNameSpaces(Context& ctx, DataArray& nss);
             int DropNameSpace(Context& ctx, const Data& ns);
             void Stats(Context& ctx, std::string& str);
             int64_t EstimateKeysNum(Context& ctx, const Data& ns);
+            int GetKeySplits(Context& ctx, const Data& ns, size_t max, StringArray& splits);
             Iterator* Find(Context& ctx, const KeyObject& key);
             int Flush(Context& ctx, const Data& ns);
             int BeginBulkLoad(Context& ctx);
             int EndBulkLoad(Context& ctx);
+            void* BeginSortedLoad(Context& ctx, const Data& ns, const std::string& file);
+            int SortedLoadPut(void* loader, const Slice& key, const Slice& value);
+            int EndSortedLoad(Context& ctx, void* loader, bool commit);
             const std::string GetErrorReason(int err);
             int Backup(Context& ctx, const std::string& dir);
             int Restore(Context& ctx, const std::string& dir);
@@ -43,10 +43,10 @@ OP_NAMESPACE_BEGIN
     static TreeMap<std::string, InstantQPS>::Type g_hostInstanceQpsTable;
     static SpinMutexLock g_hostInstanceQpsTableLock;
 
-    static uint64_t incHostInstanceQps(const std::string& host, time_t now)
+    static uint64_t incHostInstanceQps(const std::string& host, time_t now, uint64_t n)
     {
     	LockGuard<SpinMutexLock> guard(g_hostInstanceQpsTableLock);
-    	return g_hostInstanceQpsTable[host].Inc(now);
+    	return g_hostInstanceQpsTable[host].Inc(now, n);
     }
 
     class ServerLifecycleHandler: public ChannelServiceLifeCycle, public Runnable
@@ -88,7 +88,13 @@ OP_NAMESPACE_BEGIN
             }
     };
 
-    class RedisRequestHandler: public ChannelUpstreamHandler<RedisCommandFrame>
+    enum CommandState
+    {
+        CMD_CONTINUE = 0, CMD_STOP = 1, //client blocked or closed, leave the rest of the batch in the buffer
+        CMD_ABORT = 2, //handler deleted or server stopping
+    };
+
+    class RedisRequestHandler: public ChannelUpstreamHandler<RedisCommandBatch>
     {
         private:
             //QPSTrack* qpsTrack;
@@ -99,6 +105,11 @@ OP_NAMESPACE_BEGIN
             RedisReplyPool* pool;
             std::string client_host;
             InstantQPS conn_qps;
+            StringArray m_run_keys;
+            StringTreeSet m_run_key_set;
+            KeyPrefixSet m_run_lock_keys;
+            StagedReplication m_run_repl;
+            RedisReplyArray m_deferred_replies;
 
             void suspendConnection(uint64 now)
             {
@@ -112,33 +123,214 @@ OP_NAMESPACE_BEGIN
             	 }
             }
 
-            void MessageReceived(ChannelHandlerContext& ctx, MessageEvent<RedisCommandFrame>& e)
+            static bool isPointRead(RedisCommandFrame& cmd)
+            {
+                return cmd.GetArguments().size() == 1 && !strcasecmp(cmd.GetCommand().c_str(), "get");
+            }
+            static bool isBlindWrite(RedisCommandFrame& cmd)
+            {
+                return cmd.GetArguments().size() == 2 && !strcasecmp(cmd.GetCommand().c_str(), "set");
+            }
+            bool canRunBatched()
+            {
+                return m_ctx.authenticated && !m_ctx.InTransaction() && !m_ctx.IsSubscribed();
+            }
+            size_t countPointReads(RedisCommandBatch& batch, size_t idx)
+            {
+                size_t n = 0;
+                while (idx + n < batch.count && isPointRead(batch.frames[idx + n]))
+                {
+                    n++;
+                }
+                return n;
+            }
+            /*
+             * The commands of a write run do not see each other's writes before the shared batch is
+             * committed, so a run ends at the first key written twice.
+             */
+            size_t countBlindWrites(RedisCommandBatch& batch, size_t idx)
+            {
+                if (!g_db->GetConf().master_host.empty())
+                {
+                    return 0;
+                }
+                m_run_key_set.clear();
+                size_t n = 0;
+                while (idx + n < batch.count && isBlindWrite(batch.frames[idx + n]))
+                {
+                    if (!m_run_key_set.insert(batch.frames[idx + n].GetArguments()[0]).second)
+                    {
+                        break;
+                    }
+                    n++;
+                }
+                return n;
+            }
+
+            /*
+             * Runs one command, its reply is written at once or collected into 'deferred'.
+             */
+            int processCommand(RedisCommandFrame& cmd, RedisReplyArray* deferred)
+            {
+                if (NULL == deferred)
+                {
+                    pool->Clear();
+                }
+                m_ctx.SetReply(&(pool->Allocate()));
+                RedisReply& reply = m_ctx.GetReply();
+                int ret = g_db->Call(m_ctx, cmd);
+                if (m_delete_after_processing)
+                {
+                    return CMD_ABORT;
+                }
+                if (reply.type != 0 && !m_ctx.flags.reply_off)
+                {
+                    if (NULL != deferred)
+                    {
+                        deferred->push_back(&reply);
+                    }
+                    else
+                    {
+                        m_client_ctx.client->Write(reply);
+                    }
+                    if (m_ctx.flags.reply_skip)
+                    {
+                        m_ctx.flags.reply_skip = 0;
+                        m_ctx.flags.reply_off = 1;
+                    }
+                }
+                if (ret < -1)
+                {
+                    ChannelService* root = &(m_client_ctx.client->GetService());
+                    while (root->GetParent() != NULL)
+                    {
+                        root = root->GetParent();
+                    }
+                    root->Stop();
+                    return CMD_ABORT;
+                }
+                m_ctx.ClearState();
+                if (-1 == ret)
+                {
+                    m_client_ctx.client->Close();
+                    return CMD_STOP;
+                }
+                return m_client_ctx.client->IsReadBlocked() ? CMD_STOP : CMD_CONTINUE;
+            }
+
+            /*
+             * A run of GETs loads all its keys with one MultiGet first.
+             */
+            int processPointReads(RedisCommandBatch& batch, size_t& idx, size_t count)
+            {
+                m_run_keys.clear();
+                for (size_t i = 0; i < count; i++)
+                {
+                    m_run_keys.push_back(batch.frames[idx + i].GetArguments()[0]);
+                }
+                g_db->PrefetchMetas(m_ctx, m_run_keys);
+                int state = CMD_CONTINUE;
+                for (size_t i = 0; i < count && CMD_CONTINUE == state; i++)
+                {
+                    state = processCommand(batch.frames[idx++], NULL);
+                }
+                g_db->ClearPrefetchedMetas(m_ctx);
+                return state;
+            }
+
+            /*
+             * A run of SETs shares one engine write batch, the replies are held back until it is committed.
+             * All keys of the run stay locked until the commit, otherwise another client could read a key
+             * between its SET and the commit and overwrite the SET with a value computed from the old one.
+             * The replication log gets the SETs only once the batch is committed.
+             */
+            int processBlindWrites(RedisCommandBatch& batch, size_t& idx, size_t count)
+            {
+                int state = CMD_CONTINUE;
+                pool->Clear();
+                m_deferred_replies.clear();
+                m_ctx.transc_err = 0;
+                m_run_keys.clear();
+                for (size_t i = 0; i < count; i++)
+                {
+                    m_run_keys.push_back(batch.frames[idx + i].GetArguments()[0]);
+                }
+                g_db->LockRunKeys(m_ctx, m_run_keys, m_run_lock_keys);
+                m_ctx.repl_staged = &m_run_repl;
+                {
+                    WriteBatchGuard guard(m_ctx, g_engine);
+                    for (size_t i = 0; i < count && CMD_CONTINUE == state; i++)
+                    {
+                        state = processCommand(batch.frames[idx++], &m_deferred_replies);
+                    }
+                }
+                m_ctx.repl_staged = NULL;
+                if (0 == m_ctx.transc_err)
+                {
+                    g_db->FeedStagedReplication(m_run_repl, false);
+                }
+                m_run_repl.Clear();
+                g_db->UnlockRunKeys(m_ctx);
+                if (CMD_ABORT == state)
+                {
+                    return state;
+                }
+                for (size_t i = 0; i < m_deferred_replies.size(); i++)
+                {
+                    RedisReply* reply = m_deferred_replies[i];
+                    if (0 != m_ctx.transc_err && reply->type == REDIS_REPLY_STATUS)
+                    {
+                        reply->SetErrCode(m_ctx.transc_err);
+                    }
+                    m_client_ctx.client->Write(*reply);
+                }
+                m_deferred_replies.clear();
+                m_ctx.transc_err = 0;
+                return state;
+            }
+
+            void MessageReceived(ChannelHandlerContext& ctx, MessageEvent<RedisCommandBatch>& e)
             {
             	uint64 now = get_current_epoch_micros();
                 m_client_ctx.last_interaction_ustime = now;
                 m_client_ctx.client = ctx.GetChannel();
-                RedisCommandFrame* cmd = e.GetMessage();
+                RedisCommandBatch* batch = e.GetMessage();
                 m_client_ctx.processing = true;
                 if (NULL == pool)
                 {
                     pool = &(g_reply_pool.GetValue());
                 }
-                pool->Clear();
-                m_ctx.SetReply(&(pool->Allocate()));
-                RedisReply& reply = m_ctx.GetReply();
-                int ret = g_db->Call(m_ctx, *cmd);
+                size_t idx = 0;
+                int state = CMD_CONTINUE;
+                while (idx < batch->count && CMD_CONTINUE == state)
+                {
+                    size_t run = 0;
+                    if (canRunBatched() && (run = countPointReads(*batch, idx)) > 1)
+                    {
+                        state = processPointReads(*batch, idx, run);
+                    }
+                    else if (canRunBatched() && (run = countBlindWrites(*batch, idx)) > 1)
+                    {
+                        state = processBlindWrites(*batch, idx, run);
+                    }
+                    else
+                    {
+                        state = processCommand(batch->frames[idx++], NULL);
+                    }
+                }
+                batch->processed = idx;
                 bool is_overload = false;
-                g_serverQpsTracks[server_index].IncMsgCount(1);
-                g_total_qps.IncMsgCount(1);
+                g_serverQpsTracks[server_index].IncMsgCount(idx);
+                g_total_qps.IncMsgCount(idx);
                 now = get_current_epoch_micros();
                 time_t now_sec = now/1000000;
              	if(g_db->GetConf().qps_limit_per_connection > 0)
                 {
-             		is_overload = conn_qps.Inc(now_sec) >= (uint64_t)(g_db->GetConf().qps_limit_per_connection);
+             		is_overload = conn_qps.Inc(now_sec, idx) >= (uint64_t)(g_db->GetConf().qps_limit_per_connection);
                 }
              	if(g_db->GetConf().qps_limit_per_host > 0 && !client_host.empty())
              	{
-             		uint64_t instance_qps = incHostInstanceQps(client_host, now_sec);
+             		uint64_t instance_qps = incHostInstanceQps(client_host, now_sec, idx);
              		if(!is_overload)
              		{
              		    is_overload = instance_qps >= (uint64_t)(g_db->GetConf().qps_limit_per_host);
@@ -146,7 +338,7 @@ OP_NAMESPACE_BEGIN
              	}
              	if(g_db->GetConf().servers[server_index].qps_limit > 0)
              	{
-             		uint64_t instance_qps =  g_serverInstanceQps[server_index].Inc(now_sec);
+             		uint64_t instance_qps =  g_serverInstanceQps[server_index].Inc(now_sec, idx);
              		if(!is_overload)
              		{
              			is_overload = instance_qps >= (uint64_t)(g_db->GetConf().servers[server_index].qps_limit);
@@ -157,32 +349,12 @@ OP_NAMESPACE_BEGIN
                     delete this;
                     return;
                 }
-                if (reply.type != 0 && !m_ctx.flags.reply_off)
-                {
-                    m_client_ctx.client->Write(reply);
-                    if (m_ctx.flags.reply_skip)
-                    {
-                        m_ctx.flags.reply_skip = 0;
-                        m_ctx.flags.reply_off = 1;
-                    }
-                }
-                if (ret < -1)
+                if (CMD_ABORT == state)
                 {
-                    ChannelService* root = &(m_client_ctx.client->GetService());
-                    while (root->GetParent() != NULL)
-                    {
-                        root = root->GetParent();
-                    }
-                    root->Stop();
                     return;
                 }
-                else if (-1 == ret)
-                {
-                    m_client_ctx.client->Close();
-                }
                 m_client_ctx.processing = false;
                 m_client_ctx.last_interaction_ustime = now;
-                m_ctx.ClearState();
 
                 if(is_overload)
                 {
@@ -265,7 +437,7 @@ OP_NAMESPACE_BEGIN
     {
     	uint64 idx = (uint64)data;
         //QPSTrack* init_data = (QPSTrack*) data;
-        pipeline->AddLast("decoder", new RedisCommandDecoder);
+        pipeline->AddLast("decoder", new RedisCommandBatchDecoder);
         pipeline->AddLast("encoder", new RedisReplyEncoder);
         pipeline->AddLast("handler", new RedisRequestHandler(idx));
     }
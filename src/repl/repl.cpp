@@ -34,6 +34,9 @@
 #define RUN_PERIOD(name, ms) static uint64_t name##_exec_ms = 0;  \
     if(ms > 0 && (now - name##_exec_ms >= ms) && (name##_exec_ms = now))
 OP_NAMESPACE_BEGIN
+    static const uint32 kReplStageSize = 1024;
+    static const size_t kReplStageEntryMaxCapacity = 64 * 1024;
+    static const size_t kReplFlushBatchSize = 1024 * 1024;
     static ReplicationService _repl_singleton;
     ReplicationService* g_repl = &_repl_singleton;
     struct ReplMeta
@@ -51,7 +54,7 @@ OP_NAMESPACE_BEGIN
     };
 
     ReplicationBacklog::ReplicationBacklog() :
-            m_wal(NULL),m_wal_queue_size(0)
+            m_wal(NULL), m_wal_queue_size(0), m_sequence(0), m_flush_scheduled(0), m_next_sequence(1), m_local_stage(false)
     {
     }
     void ReplicationBacklog::Routine()
@@ -143,9 +146,12 @@ OP_NAMESPACE_BEGIN
         swal_append(m_wal, cmd.GetRawReadBuffer(), cmd.ReadableBytes());
         return cmd.ReadableBytes();
     }
-    int ReplicationBacklog::WriteWAL(const Data& ns, const Buffer& cmd)
+    /*
+     * Append the command into the pending flush buffer, with a 'select' in front when
+     * the namespace differs from the last one written into the log.
+     */
+    int ReplicationBacklog::BufferWAL(const Data& ns, const Buffer& cmd)
     {
-        //WriteLockGuard<SpinRWLock> guard(m_repl_lock, true);
         ReplMeta* meta = (ReplMeta*) swal_user_meta(m_wal);
         int len = 0;
         if (meta->select_ns_size != ns.StringLength() || strncmp(ns.CStr(), meta->select_ns, ns.StringLength()))
@@ -154,9 +160,9 @@ OP_NAMESPACE_BEGIN
             {
                 RedisCommandFrame select_cmd("select");
                 select_cmd.AddArg(ns.AsString());
-                Buffer select;
-                RedisCommandEncoder::Encode(select, select_cmd);
-                len += WriteWAL(select, false);
+                size_t mark = m_flush_buffer.ReadableBytes();
+                RedisCommandEncoder::Encode(m_flush_buffer, select_cmd);
+                len += (m_flush_buffer.ReadableBytes() - mark);
                 memcpy(meta->select_ns, ns.CStr(), ns.StringLength());
                 meta->select_ns[ns.StringLength()] = 0;
                 meta->select_ns_size = ns.StringLength();
@@ -166,51 +172,208 @@ OP_NAMESPACE_BEGIN
                 //slave can NOT generate 'select' itself & never reach here
             }
         }
-        len += WriteWAL(cmd, false);
+        m_flush_buffer.Write(cmd.GetRawReadBuffer(), cmd.ReadableBytes());
+        len += cmd.ReadableBytes();
         return len;
     }
 
-    struct ReplCommand
+    ReplStage::ReplStage(uint32 size) :
+            entries(NULL), capacity(size), head(0), tail(0), reserved(0)
     {
-            Data ns;
-            Buffer cmdbuf;
-    };
+        entries = new Entry[capacity];
+    }
+    ReplStage::~ReplStage()
+    {
+        delete[] entries;
+    }
 
-    static std::deque<ReplCommand*> g_repl_cmd_buffer;
-    static SpinMutexLock g_repl_cmd_buffer_lock;
+    ReplStage& ReplicationBacklog::LocalStage()
+    {
+        ReplStage*& stage = m_local_stage.GetValue();
+        if (NULL == stage)
+        {
+            NEW(stage, ReplStage(kReplStageSize));
+            LockGuard<SpinMutexLock> guard(m_stages_lock);
+            m_stages.push_back(stage);
+        }
+        return *stage;
+    }
 
-    static inline ReplCommand* get_repl_cmd()
+    static void encode_repl_command(Buffer& buf, RedisCommandFrame& cmd)
     {
-        LockGuard<SpinMutexLock> guard(g_repl_cmd_buffer_lock);
-        if (!g_repl_cmd_buffer.empty())
+        const Buffer& raw_protocol = cmd.GetRawProtocolData();
+        if (raw_protocol.Readable() && !cmd.IsInLine())
         {
-            ReplCommand* repl_cmd = g_repl_cmd_buffer.front();
-            g_repl_cmd_buffer.pop_front();
-            repl_cmd->cmdbuf.Clear();
-            return repl_cmd;
+            /*
+             * make sure the raw protocol part is OK
+             */
+            if (raw_protocol.GetRawReadBuffer()[0] == '*')
+            {
+                buf.Write(raw_protocol.GetRawReadBuffer(), raw_protocol.ReadableBytes());
+                return;
+            }
+            WARN_LOG("Invalid raw protocol part:%s", raw_protocol.AsString().c_str());
         }
-        ReplCommand* repl_cmd = new ReplCommand;
-        return repl_cmd;
+        RedisCommandEncoder::Encode(buf, cmd);
     }
-    static inline void recycle_repl_cmd(ReplCommand* cmd)
+
+    /*
+     * Called by the owner thread of the local stage only, the replication thread never blocks on
+     * a full ring since it drains entries in sequence order and the smallest pending sequence
+     * is always staged or about to be staged into a ring with free space.
+     */
+    ReplStage::Entry& ReplicationBacklog::AcquireEntry(ReplStage& stage, uint64 seq)
     {
-        LockGuard<SpinMutexLock> guard(g_repl_cmd_buffer_lock);
-        if (g_repl_cmd_buffer.size() >= 10)
+        while (stage.tail - stage.head >= stage.capacity)
         {
-            DELETE(cmd);
-            return;
+            ScheduleFlush();
+            usleep(10);
+        }
+        ReplStage::Entry& entry = stage.entries[stage.tail % stage.capacity];
+        entry.seq = seq;
+        entry.cmd.Clear();
+        return entry;
+    }
+
+    void ReplicationBacklog::PublishEntry(ReplStage& stage)
+    {
+        __memory_barrier();
+        stage.tail++;
+        ScheduleFlush();
+    }
+
+    void ReplicationBacklog::Stage(uint64 seq, const Data* ns, RedisCommandFrame* cmd)
+    {
+        ReplStage& stage = LocalStage();
+        ReplStage::Entry& entry = AcquireEntry(stage, seq);
+        if (NULL != cmd)
+        {
+            entry.ns = *ns;
+            encode_repl_command(entry.cmd, *cmd);
+            atomic_add_uint32(&m_wal_queue_size, 1);
         }
-        g_repl_cmd_buffer.push_back(cmd);
+        PublishEntry(stage);
     }
 
-    void ReplicationBacklog::WriteWALCallback(Channel*, void* data)
+    /*
+     * All commands of one write batch go into a single entry so no other command is logged in between.
+     * Namespace switches are written inline and the entry ends in the namespace it started with, which
+     * is the one BufferWAL selects for it.
+     */
+    void ReplicationBacklog::Stage(uint64 seq, const DataArray& ns, RedisCommandFrameArray& cmds, bool transaction)
     {
-        ReplCommand* cmd = (ReplCommand*) data;
-        g_repl->GetReplLog().WriteWAL(cmd->ns, cmd->cmdbuf);
-        //DELETE(cmd);
-        recycle_repl_cmd(cmd);
-        atomic_sub_uint32(&(g_repl->GetReplLog().m_wal_queue_size), 1);
-        g_repl->GetMaster().SyncWAL();
+        ReplStage& stage = LocalStage();
+        ReplStage::Entry& entry = AcquireEntry(stage, seq);
+        entry.ns = ns[0];
+        if (transaction)
+        {
+            RedisCommandFrame multi("multi");
+            RedisCommandEncoder::Encode(entry.cmd, multi);
+        }
+        const Data* current = &ns[0];
+        for (size_t i = 0; i < cmds.size(); i++)
+        {
+            if (ns[i].Compare(*current) != 0)
+            {
+                RedisCommandFrame select_cmd("select");
+                select_cmd.AddArg(ns[i].AsString());
+                RedisCommandEncoder::Encode(entry.cmd, select_cmd);
+                current = &ns[i];
+            }
+            encode_repl_command(entry.cmd, cmds[i]);
+        }
+        if (transaction)
+        {
+            RedisCommandFrame exec("exec");
+            RedisCommandEncoder::Encode(entry.cmd, exec);
+        }
+        if (current->Compare(ns[0]) != 0)
+        {
+            RedisCommandFrame select_cmd("select");
+            select_cmd.AddArg(ns[0].AsString());
+            RedisCommandEncoder::Encode(entry.cmd, select_cmd);
+        }
+        atomic_add_uint32(&m_wal_queue_size, 1);
+        PublishEntry(stage);
+    }
+
+    void ReplicationBacklog::ScheduleFlush()
+    {
+        if (atomic_cmp_set_uint32(&m_flush_scheduled, 0, 1))
+        {
+            g_repl->GetIOService().AsyncIO(0, FlushStagedCallback, this);
+        }
+    }
+
+    void ReplicationBacklog::FlushStagedCallback(Channel*, void* data)
+    {
+        ReplicationBacklog* backlog = (ReplicationBacklog*) data;
+        atomic_cmp_set_uint32(&backlog->m_flush_scheduled, 1, 0);
+        backlog->FlushStaged();
+    }
+
+    /*
+     * Merge all staging rings in sequence order, a gap means the owner of the missing sequence
+     * has not staged it yet, it would schedule another flush once it does.
+     */
+    void ReplicationBacklog::FlushStaged()
+    {
+        {
+            LockGuard<SpinMutexLock> guard(m_stages_lock);
+            m_flush_stages = m_stages;
+        }
+        uint32 written = 0;
+        bool progress = true;
+        while (progress)
+        {
+            progress = false;
+            for (size_t i = 0; i < m_flush_stages.size(); i++)
+            {
+                ReplStage* stage = m_flush_stages[i];
+                while (stage->head != stage->tail)
+                {
+                    __memory_barrier();
+                    ReplStage::Entry& entry = stage->entries[stage->head % stage->capacity];
+                    if (entry.seq != m_next_sequence)
+                    {
+                        break;
+                    }
+                    if (entry.cmd.Readable())
+                    {
+                        BufferWAL(entry.ns, entry.cmd);
+                        written++;
+                        if (entry.cmd.Capacity() > kReplStageEntryMaxCapacity)
+                        {
+                            entry.cmd.Clear();
+                            entry.cmd.Compact(kReplStageEntryMaxCapacity);
+                        }
+                    }
+                    m_next_sequence++;
+                    __memory_barrier();
+                    stage->head++;
+                    progress = true;
+                }
+            }
+            if (m_flush_buffer.ReadableBytes() >= kReplFlushBatchSize)
+            {
+                WriteWAL(m_flush_buffer, false);
+                m_flush_buffer.Clear();
+            }
+        }
+        if (m_flush_buffer.Readable())
+        {
+            WriteWAL(m_flush_buffer, false);
+            m_flush_buffer.Clear();
+        }
+        if (m_flush_buffer.Capacity() > kReplFlushBatchSize * 2)
+        {
+            m_flush_buffer.Compact(kReplFlushBatchSize);
+        }
+        if (written > 0)
+        {
+            atomic_sub_uint32(&m_wal_queue_size, written);
+            g_repl->GetMaster().SyncWAL();
+        }
     }
 
     void ReplicationBacklog::Replay(size_t offset, int64_t limit_len, swal_replay_logfunc func, void* data)
@@ -223,37 +386,80 @@ OP_NAMESPACE_BEGIN
         swal_replay(m_wal, offset, limit_len, func, data);
     }
 
-    int ReplicationBacklog::WriteWAL(const Data& ns, RedisCommandFrame& cmd)
+    /*
+     * Only the running write command itself logs with the 'reserved' sequence, other commands fed meanwhile
+     * (expired keys, served blocked clients) take a new one.
+     */
+    int ReplicationBacklog::WriteWAL(const Data& ns, RedisCommandFrame& cmd, bool reserved)
     {
         if (!g_repl->IsInited())
         {
             return -1;
         }
-        ReplCommand* repl_cmd = get_repl_cmd();
-        repl_cmd->ns = ns;
-        const Buffer& raw_protocol = cmd.GetRawProtocolData();
-        if (raw_protocol.Readable() && !cmd.IsInLine())
+        ReplStage& stage = LocalStage();
+        uint64 seq = 0;
+        if (reserved)
         {
-            /*
-             * make sure the raw protocol part is OK
-             */
-            if(raw_protocol.GetRawReadBuffer()[0] == '*')
-            {
-                repl_cmd->cmdbuf.Write(raw_protocol.GetRawReadBuffer(), raw_protocol.ReadableBytes());
-            }else
-            {
-                WARN_LOG("Invalid raw protocol part:%s", raw_protocol.AsString().c_str());
-            }
+            seq = stage.reserved;
+            stage.reserved = 0;
         }
-        if(!repl_cmd->cmdbuf.Readable())
+        if (0 == seq)
         {
-            RedisCommandEncoder::Encode(repl_cmd->cmdbuf, cmd);
+            seq = atomic_add_uint64(&m_sequence, 1);
         }
-        atomic_add_uint32(&m_wal_queue_size, 1);
-        g_repl->GetIOService().AsyncIO(0, WriteWALCallback, repl_cmd);
+        Stage(seq, &ns, &cmd);
         return 0;
     }
 
+    int ReplicationBacklog::WriteWAL(const DataArray& ns, RedisCommandFrameArray& cmds, bool transaction)
+    {
+        if (!g_repl->IsInited() || cmds.empty())
+        {
+            return -1;
+        }
+        ReplStage& stage = LocalStage();
+        uint64 seq = stage.reserved;
+        stage.reserved = 0;
+        if (0 == seq)
+        {
+            seq = atomic_add_uint64(&m_sequence, 1);
+        }
+        Stage(seq, ns, cmds, transaction);
+        return 0;
+    }
+
+    /*
+     * Take the replication sequence of the running write command before its key locks are released,
+     * so that conflicting commands are logged in the same order as they are applied.
+     * A write command must hold all its keys under one key lock guard: a second release would need a
+     * sequence after the writes committed on its later keys, which one reservation can not give.
+     */
+    void ReplicationBacklog::ReserveSequence()
+    {
+        if (!g_repl->IsInited())
+        {
+            return;
+        }
+        ReplStage& stage = LocalStage();
+        ASSERT(0 == stage.reserved);
+        stage.reserved = atomic_add_uint64(&m_sequence, 1);
+    }
+
+    void ReplicationBacklog::ReleaseSequence()
+    {
+        if (!g_repl->IsInited())
+        {
+            return;
+        }
+        ReplStage& stage = LocalStage();
+        if (0 != stage.reserved)
+        {
+            uint64 seq = stage.reserved;
+            stage.reserved = 0;
+            Stage(seq, NULL, NULL);
+        }
+    }
+
     static size_t cksm_callback(const void* log, size_t loglen, void* data)
     {
         uint64_t* cksm = (uint64_t*) data;
@@ -37,6 +37,8 @@
 #include "thread/lock_guard.hpp"
 #include "util/concurrent_queue.hpp"
 #include "thread/spin_rwlock.hpp"
+#include "thread/spin_mutex_lock.hpp"
+#include "thread/thread_local.hpp"
 #include "swal.h"
 #include "context.hpp"
 #include "db/db_utils.hpp"
@@ -49,15 +51,58 @@ OP_NAMESPACE_BEGIN
     class Master;
     class Slave;
     class ReplicationService;
+
+    /*
+     * Single producer/single consumer ring of write commands staged by one worker thread,
+     * every entry is tagged with the global replication sequence it was committed with.
+     * Entries without command are placeholders of sequences which produced nothing.
+     */
+    struct ReplStage
+    {
+            struct Entry
+            {
+                    uint64 seq;
+                    Data ns;
+                    Buffer cmd;
+                    Entry() :
+                            seq(0)
+                    {
+                    }
+            };
+            Entry* entries;
+            uint32 capacity;
+            volatile uint32 head; //moved by replication thread only
+            volatile uint32 tail; //moved by owner thread only
+            uint64 reserved;      //sequence taken before releasing key locks, accessed by owner thread only
+            ReplStage(uint32 size);
+            ~ReplStage();
+    };
+    typedef std::vector<ReplStage*> ReplStageArray;
+
     class ReplicationBacklog
     {
         private:
             swal_t* m_wal;
             volatile uint32 m_wal_queue_size;
+            volatile uint64_t m_sequence;
+            volatile uint32_t m_flush_scheduled;
+            uint64 m_next_sequence;
+            SpinMutexLock m_stages_lock;
+            ReplStageArray m_stages;
+            ReplStageArray m_flush_stages;
+            ThreadLocal<ReplStage*> m_local_stage;
+            Buffer m_flush_buffer;
             //SpinRWLock m_repl_lock;
             void ReCreateWAL();
-            static void WriteWALCallback(Channel*, void* data);
-            int WriteWAL(const Data& ns, const Buffer& cmd);
+            ReplStage& LocalStage();
+            void Stage(uint64 seq, const Data* ns, RedisCommandFrame* cmd);
+            void Stage(uint64 seq, const DataArray& ns, RedisCommandFrameArray& cmds, bool transaction);
+            ReplStage::Entry& AcquireEntry(ReplStage& stage, uint64 seq);
+            void PublishEntry(ReplStage& stage);
+            void ScheduleFlush();
+            static void FlushStagedCallback(Channel*, void* data);
+            void FlushStaged();
+            int BufferWAL(const Data& ns, const Buffer& cmd);
             int WriteWAL(const Buffer& cmd, bool lock);
             int DirectWriteWAL(RedisCommandFrame& cmd);
             void FlushSyncWAL();
@@ -71,7 +116,10 @@ OP_NAMESPACE_BEGIN
             std::string GetReplKey();
             bool IsReplKeySelfGen();
             void SetReplKey(const std::string& str);
-            int WriteWAL(const Data& ns, RedisCommandFrame& cmd);
+            int WriteWAL(const Data& ns, RedisCommandFrame& cmd, bool reserved = false);
+            int WriteWAL(const DataArray& ns, RedisCommandFrameArray& cmds, bool transaction);
+            void ReserveSequence();
+            void ReleaseSequence();
             void Replay(size_t offset, int64_t limit_len, swal_replay_logfunc func, void* data);
             bool IsValidOffsetCksm(int64_t offset, uint64_t cksm);
             uint64_t WALStartOffset(bool lock = true);
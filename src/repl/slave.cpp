@@ -300,12 +300,8 @@ OP_NAMESPACE_BEGIN
         {
             m_ctx.ResetCallFlags();
             /*
-             * todo:
-             * call db may block current sync thread, maybe use more threads to exec command better.
-             * If use more threads to handle sync commands, there are several new problems:
-             * 1. Keep the commands exec order for same key
-             *    eg: lpush list a  & lpush list b must be executed in same thread  to keep exec order
-             * 2. ?
+             * commands are applied by key partitioned workers, the same key always goes to the same worker
+             * so the exec order of every key is kept.
              */
             //g_db->Call(m_ctx.ctx, cmd);
             m_db_writer.Put(m_ctx.ctx, cmd);
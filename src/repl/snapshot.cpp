@@ -60,7 +60,10 @@ extern "C"
 
 #define REDIS_RDB_VERSION 9
 
-#define ARDB_RDB_VERSION 1
+/*
+ * version 2 saves key ranges as independently compressed parts listed in a manifest
+ */
+#define ARDB_RDB_VERSION 2
 
 /* Defines related to the dump file format. To store 32 bits lengths for short
  * keys requires a lot of space, so we check the most significant 2 bits of
@@ -130,6 +133,7 @@ extern "C"
 #define ARDB_RDB_TYPE_CHUNK 1
 #define ARDB_RDB_TYPE_SNAPPY_CHUNK 2
 #define ARDB_RDB_OPCODE_SELECTDB   3
+#define ARDB_RDB_OPCODE_PARTS      4
 #define ARDB_OPCODE_AUX        250
 #define ARDB_RDB_TYPE_EOF 255
 
@@ -155,6 +159,11 @@ namespace ardb
     static time_t g_lastsave_start = 0;
     static const uint32 kloading_process_events_interval_bytes = 10 * 1024 * 1024;
     static const uint32 kmax_read_buffer_size = 10 * 1024 * 1024;
+    static const uint32 kpart_buffer_size = 1024 * 1024;
+    static const uint32 kparts_per_thread = 4;
+    static const int64 kmin_split_keys = 100000;
+    static const size_t kmax_split_prefix_len = 8;
+    static const size_t kmax_split_prefixes = 4096;
 
     static const char* type2str(int type)
     {
@@ -659,6 +668,7 @@ namespace ardb
         switch (type)
         {
             case KEY_STRING:
+            case KEY_BITMAP:
             {
                 return WriteType(REDIS_RDB_TYPE_STRING);
             }
@@ -1327,8 +1337,36 @@ namespace ardb
                 ERROR_LOG("Failed to read value in kv pair.");
                 return -1;
             }
+            uint8 key_format = m_key_format < 0 ? g_key_format : (uint8) m_key_format;
+            Buffer converted;
+            if (key_format != g_key_format)
+            {
+                /*
+                 * raw keys saved by a server with another key format need to be re-encoded
+                 */
+                Buffer keybuf((char*) key.data(), 0, key.size());
+                KeyObject kk;
+                if (!kk.Decode(keybuf, false, false, key_format))
+                {
+                    ERROR_LOG("Failed to decode key object in %s format.", key_format_name(key_format));
+                    return -1;
+                }
+                key = kk.Encode(converted, false, false, g_key_format);
+            }
             //g_db->GetEngine()->PutRaw(ctx, ctx.ns, key, value);
-            GetDBWriter().Put(ctx, ctx.ns, key, value);
+            if (NULL != m_sorted_loader)
+            {
+                int err = g_engine->SortedLoadPut(m_sorted_loader, key, value);
+                if (0 != err)
+                {
+                    ERROR_LOG("Failed to put kv pair into sorted loader with err:%d", err);
+                    return -1;
+                }
+            }
+            else
+            {
+                GetDBWriter().Put(ctx, ctx.ns, key, value);
+            }
             if (ttl > 0 && !g_db->GetEngine()->GetFeatureSet().support_compactfilter)
             {
                 Buffer keybuf((char*) key.data(), 0, key.size());
@@ -1549,226 +1587,334 @@ namespace ardb
         return nwritten;
     }
 
-    int64_t ObjectIO::RedisWriteStream(void* iter)
+    /*
+     * Elements of a versioned zset/list may be stored under a former name of the key, so they are
+     * not next to the meta in the iteration order, dump them with a dedicated iterator instead.
+     * Return the number of elements written, or -1 on error.
+     */
+    int64_t ObjectIO::RedisWriteVersionedCollection(Context& ctx, const KeyObject& key, ValueObject& meta)
     {
-        int64_t nwritten = 0;
-        Iterator* siter = (Iterator*) iter;
-        KeyObject& key = siter->Key(true);
-        ValueObject& meta = siter->Value(true);
-        size_t lp_bytes = 0; /* Total bytes in the tail listpack. */
-        unsigned char *lp = NULL; /* Tail listpack pointer. */
-        siter->Next();
-        int64_t raxlen = 0;
-        int64_t streamlen = 0;
-        int64_t raxlen_pos = GetWritePos();
-        nwritten += WriteLen(raxlen, 8);
-        StreamID master_id;
-        bool write_rax_end = false;
-        while (siter->Valid())
+        KeyObject start(key.GetNameSpace(), meta.GetType() == KEY_LIST ? KEY_LIST_ELEMENT : KEY_ZSET_SORT,
+                key.GetKey());
+        start.BindCollection(meta);
+        Iterator* iter = g_db->GetEngine()->Find(ctx, start);
+        int64_t count = 0;
+        while (iter->Valid() && count < meta.GetObjectLen())
         {
-            KeyObject& ik = siter->Key(false);
-            if (ik.GetKey() != key.GetKey())
+            KeyObject& k = iter->Key();
+            if (k.GetType() != start.GetType() || k.GetNameSpace() != start.GetNameSpace()
+                    || k.GetKey() != start.GetKey() || k.GetVersion() != start.GetVersion())
             {
                 break;
             }
-            ValueObject& iv = siter->Value(false);
-            int64_t numfields = iv.GetStreamFieldLength();
-            int flags = STREAM_ITEM_FLAG_NONE;
-            StringArray fns;
-            int n;
-            if (ik.GetType() == KEY_STREAM_ELEMENT)
+            int n = 0;
+            if (k.GetType() == KEY_LIST_ELEMENT)
             {
-                streamlen++;
-                if (lp_bytes > STREAM_BYTES_PER_LISTPACK)
-                {
-                    Data d;
-                    master_id.Encode(d);
-                    if ((n = WriteRawString(d.CStr(), d.StringLength())) == -1) return -1;
-                    nwritten += n;
-                    if ((n = WriteRawString((const char*) lp, lp_bytes)) == -1) return -1;
-                    nwritten += n;
-                    lpFree(lp);
-                    lp = NULL;
-                }
-                StreamID sid = ik.GetStreamID();
-                if (lp == NULL)
-                {
-                    raxlen++;
-                    master_id = sid;
-                    //streamEncodeID(rax_key, &id);
-                    /* Create the listpack having the master entry ID and fields. */
-                    lp = lpNew();
-                    lp = lpAppendInteger(lp, 1); /* One item, the one we are adding. */
-                    lp = lpAppendInteger(lp, 0); /* Zero deleted so far. */
-                    lp = lpAppendInteger(lp, numfields);
-                    GetStreamFieldNames(meta, iv, fns);
-                    for (int i = 0; i < numfields; i++)
-                    {
-                        const std::string& field = fns[i];
-                        lp = lpAppend(lp, (unsigned char*) field.data(), field.size());
-                    }
-                    lp = lpAppendInteger(lp, 0); /* Master entry zero terminator. */
-                    //raxInsert(s->rax, (unsigned char*) &rax_key, sizeof(rax_key), lp, NULL);
-                    /* The first entry we insert, has obviously the same fields of the
-                     * master entry. */
-                    flags |= STREAM_ITEM_FLAG_SAMEFIELDS;
-                }
-                else
-                {
-                    //serverAssert(ri.key_len == sizeof(rax_key));
-                    //memcpy(rax_key, ri.key, sizeof(rax_key));
-                    /* Read the master ID from the radix tree key. */
-                    //streamDecodeID(rax_key, &master_id);
-                    unsigned char *lp_ele = lpFirst(lp);
-
-                    /* Update count and skip the deleted fields. */
-                    int64_t count = lpGetInteger(lp_ele);
-                    lp = lpReplaceInteger(lp, &lp_ele, count + 1);
-                    lp_ele = lpNext(lp, lp_ele); /* seek deleted. */
-                    lp_ele = lpNext(lp, lp_ele); /* seek master entry num fields. */
-
-                    /* Check if the entry we are adding, have the same fields
-                     * as the master entry. */
-                    int master_fields_count = lpGetInteger(lp_ele);
-                    lp_ele = lpNext(lp, lp_ele);
-                    if (numfields == master_fields_count)
-                    {
-                        int i;
-                        GetStreamFieldNames(meta, iv, fns);
-                        for (i = 0; i < master_fields_count; i++)
-                        {
-                            const std::string& field = fns[i];
-                            int64_t e_len;
-                            unsigned char buf[LP_INTBUF_SIZE];
-                            unsigned char *e = lpGet(lp_ele, &e_len, buf);
-                            /* Stop if there is a mismatch. */
-                            if (field.size() != (size_t) e_len || memcmp(e, field.c_str(), e_len) != 0) break;
-                            lp_ele = lpNext(lp, lp_ele);
-                        }
-                        /* All fields are the same! We can compress the field names
-                         * setting a single bit in the flags. */
-                        if (i == master_fields_count) flags |= STREAM_ITEM_FLAG_SAMEFIELDS;
-                    }
-                }
-                /* Populate the listpack with the new entry. We use the following
-                 * encoding:
-                 *
-                 * +-----+--------+----------+-------+-------+-/-+-------+-------+--------+
-                 * |flags|entry-id|num-fields|field-1|value-1|...|field-N|value-N|lp-count|
-                 * +-----+--------+----------+-------+-------+-/-+-------+-------+--------+
-                 *
-                 * However if the SAMEFIELD flag is set, we have just to populate
-                 * the entry with the values, so it becomes:
-                 *
-                 * +-----+--------+-------+-/-+-------+--------+
-                 * |flags|entry-id|value-1|...|value-N|lp-count|
-                 * +-----+--------+-------+-/-+-------+--------+
-                 *
-                 * The entry-id field is actually two separated fields: the ms
-                 * and seq difference compared to the master entry.
-                 *
-                 * The lp-count field is a number that states the number of listpack pieces
-                 * that compose the entry, so that it's possible to travel the entry
-                 * in reverse order: we can just start from the end of the listpack, read
-                 * the entry, and jump back N times to seek the "flags" field to read
-                 * the stream full entry. */
-                lp = lpAppendInteger(lp, flags);
-                lp = lpAppendInteger(lp, sid.ms - master_id.ms);
-                lp = lpAppendInteger(lp, sid.seq - master_id.seq);
-                if (!(flags & STREAM_ITEM_FLAG_SAMEFIELDS))
+                n = WriteStringObject(iter->Value().GetListElement());
+            }
+            else
+            {
+                n = WriteStringObject(k.GetZSetMember());
+                if (n >= 0)
                 {
-                    lp = lpAppendInteger(lp, numfields);
-                    GetStreamFieldNames(meta, iv, fns);
+                    n = WriteDouble(k.GetZSetScore());
                 }
-                for (int i = 0; i < numfields; i++)
+            }
+            if (n < 0)
+            {
+                DELETE(iter);
+                return -1;
+            }
+            count++;
+            iter->Next();
+        }
+        DELETE(iter);
+        return count;
+    }
+
+    /*
+     * Appends one entry to the tail listpack of a stream being written, a full tail listpack is written out
+     * first.
+     */
+    int64_t ObjectIO::RedisWriteStreamEntry(RedisStreamListpack& tail, ValueObject& meta, const StreamID& sid,
+            ValueObject& iv)
+    {
+        int64_t nwritten = 0;
+        int64_t numfields = iv.GetStreamFieldLength();
+        int flags = STREAM_ITEM_FLAG_NONE;
+        StringArray fns;
+        int n;
+        tail.streamlen++;
+        if (tail.lp_bytes > STREAM_BYTES_PER_LISTPACK)
+        {
+            if ((n = RedisFlushStreamListpack(tail)) == -1) return -1;
+            nwritten += n;
+        }
+        if (tail.lp == NULL)
+        {
+            tail.raxlen++;
+            tail.master_id = sid;
+            //streamEncodeID(rax_key, &id);
+            /* Create the listpack having the master entry ID and fields. */
+            tail.lp = lpNew();
+            tail.lp = lpAppendInteger(tail.lp, 1); /* One item, the one we are adding. */
+            tail.lp = lpAppendInteger(tail.lp, 0); /* Zero deleted so far. */
+            tail.lp = lpAppendInteger(tail.lp, numfields);
+            GetStreamFieldNames(meta, iv, fns);
+            for (int i = 0; i < numfields; i++)
+            {
+                const std::string& field = fns[i];
+                tail.lp = lpAppend(tail.lp, (unsigned char*) field.data(), field.size());
+            }
+            tail.lp = lpAppendInteger(tail.lp, 0); /* Master entry zero terminator. */
+            //raxInsert(s->rax, (unsigned char*) &rax_key, sizeof(rax_key), lp, NULL);
+            /* The first entry we insert, has obviously the same fields of the
+             * master entry. */
+            flags |= STREAM_ITEM_FLAG_SAMEFIELDS;
+        }
+        else
+        {
+            //serverAssert(ri.key_len == sizeof(rax_key));
+            //memcpy(rax_key, ri.key, sizeof(rax_key));
+            /* Read the master ID from the radix tree key. */
+            //streamDecodeID(rax_key, &master_id);
+            unsigned char *lp_ele = lpFirst(tail.lp);
+
+            /* Update count and skip the deleted fields. */
+            int64_t count = lpGetInteger(lp_ele);
+            tail.lp = lpReplaceInteger(tail.lp, &lp_ele, count + 1);
+            lp_ele = lpNext(tail.lp, lp_ele); /* seek deleted. */
+            lp_ele = lpNext(tail.lp, lp_ele); /* seek master entry num fields. */
+
+            /* Check if the entry we are adding, have the same fields
+             * as the master entry. */
+            int master_fields_count = lpGetInteger(lp_ele);
+            lp_ele = lpNext(tail.lp, lp_ele);
+            if (numfields == master_fields_count)
+            {
+                int i;
+                GetStreamFieldNames(meta, iv, fns);
+                for (i = 0; i < master_fields_count; i++)
                 {
-                    std::string value;
-                    iv.GetStreamFieldValue(i).ToString(value);
-                    if (!(flags & STREAM_ITEM_FLAG_SAMEFIELDS))
-                    {
-                        const std::string& field = fns[i];
-                        lp = lpAppend(lp, (unsigned char*) field.data(), field.size());
-                    }
-                    lp = lpAppend(lp, (unsigned char*) value.data(), value.size());
+                    const std::string& field = fns[i];
+                    int64_t e_len;
+                    unsigned char buf[LP_INTBUF_SIZE];
+                    unsigned char *e = lpGet(lp_ele, &e_len, buf);
+                    /* Stop if there is a mismatch. */
+                    if (field.size() != (size_t) e_len || memcmp(e, field.c_str(), e_len) != 0) break;
+                    lp_ele = lpNext(tail.lp, lp_ele);
                 }
-                /* Compute and store the lp-count field. */
-                int lp_count = numfields;
-                lp_count += 3; /* Add the 3 fixed fields flags + ms-diff + seq-diff. */
-                if (!(flags & STREAM_ITEM_FLAG_SAMEFIELDS))
+                /* All fields are the same! We can compress the field names
+                 * setting a single bit in the flags. */
+                if (i == master_fields_count) flags |= STREAM_ITEM_FLAG_SAMEFIELDS;
+            }
+        }
+        /* Populate the listpack with the new entry. We use the following
+         * encoding:
+         *
+         * +-----+--------+----------+-------+-------+-/-+-------+-------+--------+
+         * |flags|entry-id|num-fields|field-1|value-1|...|field-N|value-N|lp-count|
+         * +-----+--------+----------+-------+-------+-/-+-------+-------+--------+
+         *
+         * However if the SAMEFIELD flag is set, we have just to populate
+         * the entry with the values, so it becomes:
+         *
+         * +-----+--------+-------+-/-+-------+--------+
+         * |flags|entry-id|value-1|...|value-N|lp-count|
+         * +-----+--------+-------+-/-+-------+--------+
+         *
+         * The entry-id field is actually two separated fields: the ms
+         * and seq difference compared to the master entry.
+         *
+         * The lp-count field is a number that states the number of listpack pieces
+         * that compose the entry, so that it's possible to travel the entry
+         * in reverse order: we can just start from the end of the listpack, read
+         * the entry, and jump back N times to seek the "flags" field to read
+         * the stream full entry. */
+        tail.lp = lpAppendInteger(tail.lp, flags);
+        tail.lp = lpAppendInteger(tail.lp, sid.ms - tail.master_id.ms);
+        tail.lp = lpAppendInteger(tail.lp, sid.seq - tail.master_id.seq);
+        if (!(flags & STREAM_ITEM_FLAG_SAMEFIELDS))
+        {
+            tail.lp = lpAppendInteger(tail.lp, numfields);
+            GetStreamFieldNames(meta, iv, fns);
+        }
+        for (int i = 0; i < numfields; i++)
+        {
+            std::string value;
+            iv.GetStreamFieldValue(i).ToString(value);
+            if (!(flags & STREAM_ITEM_FLAG_SAMEFIELDS))
+            {
+                const std::string& field = fns[i];
+                tail.lp = lpAppend(tail.lp, (unsigned char*) field.data(), field.size());
+            }
+            tail.lp = lpAppend(tail.lp, (unsigned char*) value.data(), value.size());
+        }
+        /* Compute and store the lp-count field. */
+        int lp_count = numfields;
+        lp_count += 3; /* Add the 3 fixed fields flags + ms-diff + seq-diff. */
+        if (!(flags & STREAM_ITEM_FLAG_SAMEFIELDS))
+        {
+            /* If the item is not compressed, it also has the fields other than
+             * the values, and an additional num-fileds field. */
+            lp_count += numfields + 1;
+        }
+        tail.lp = lpAppendInteger(tail.lp, lp_count);
+        tail.lp_bytes = lpBytes(tail.lp);
+        return nwritten;
+    }
+
+    int64_t ObjectIO::RedisFlushStreamListpack(RedisStreamListpack& tail)
+    {
+        if (NULL == tail.lp)
+        {
+            return 0;
+        }
+        int64_t nwritten = 0;
+        int n;
+        Data d;
+        tail.master_id.Encode(d);
+        if ((n = WriteRawString(d.CStr(), d.StringLength())) == -1) return -1;
+        nwritten += n;
+        if ((n = WriteRawString((const char*) tail.lp, tail.lp_bytes)) == -1) return -1;
+        nwritten += n;
+        lpFree(tail.lp);
+        tail.lp = NULL;
+        tail.lp_bytes = 0;
+        return nwritten;
+    }
+
+    /*
+     * Writes the entries of a stream packed in KEY_STREAM_BLOCK records, which are stored after the
+     * consumer group records of the stream.
+     */
+    int64_t ObjectIO::RedisWriteStreamBlocks(Context& ctx, RedisStreamListpack& tail, const KeyObject& key,
+            ValueObject& meta)
+    {
+        int64_t nwritten = 0;
+        KeyObject start(key.GetNameSpace(), KEY_STREAM_BLOCK, key.GetKey());
+        Iterator* iter = g_db->GetEngine()->Find(ctx, start);
+        while (iter->Valid())
+        {
+            KeyObject& k = iter->Key(false);
+            if (k.GetType() != KEY_STREAM_BLOCK || k.GetNameSpace() != start.GetNameSpace()
+                    || k.GetKey() != start.GetKey())
+            {
+                break;
+            }
+            StreamIDArray ids;
+            ValueObjectArray eles;
+            if (!stream_block_decode(iter->Value(false), k.GetStreamBlockID(), ids, eles))
+            {
+                DELETE(iter);
+                return -1;
+            }
+            for (size_t i = 0; i < ids.size(); i++)
+            {
+                int64_t n = RedisWriteStreamEntry(tail, meta, ids[i], eles[i]);
+                if (n == -1)
                 {
-                    /* If the item is not compressed, it also has the fields other than
-                     * the values, and an additional num-fileds field. */
-                    lp_count += numfields + 1;
+                    DELETE(iter);
+                    return -1;
                 }
-                lp = lpAppendInteger(lp, lp_count);
+                nwritten += n;
+            }
+            iter->Next();
+        }
+        DELETE(iter);
+        return nwritten;
+    }
+
+    int64_t ObjectIO::RedisWriteStream(Context& ctx, void* iter)
+    {
+        int64_t nwritten = 0;
+        Iterator* siter = (Iterator*) iter;
+        KeyObject key = siter->Key(true);
+        ValueObject meta = siter->Value(true);
+        RedisStreamListpack tail;
+        siter->Next();
+        int64_t raxlen_pos = GetWritePos();
+        nwritten += WriteLen(tail.raxlen, 8);
+        bool write_rax_end = false;
+        int n;
+        if (meta.GetMetaObject().stream_block > 0)
+        {
+            if ((n = RedisWriteStreamBlocks(ctx, tail, key, meta)) == -1) return -1;
+            nwritten += n;
+        }
+        while (true)
+        {
+            bool same_key = siter->Valid() && siter->Key(false).GetKey() == key.GetKey()
+                    && siter->Key(false).GetNameSpace() == key.GetNameSpace();
+            if (same_key && siter->Key(false).GetType() == KEY_STREAM_ELEMENT)
+            {
+                KeyObject& ik = siter->Key(false);
+                if ((n = RedisWriteStreamEntry(tail, meta, ik.GetStreamID(), siter->Value(false))) == -1) return -1;
+                nwritten += n;
+                siter->Next();
+                continue;
+            }
+            if (same_key && (write_rax_end || siter->Key(false).GetType() != KEY_STREAM_PEL))
+            {
+                /* stream blocks were written before */
+                siter->Next();
+                continue;
+            }
+            if (write_rax_end)
+            {
+                break;
+            }
+            if ((n = RedisFlushStreamListpack(tail)) == -1) return -1;
+            nwritten += n;
+            write_rax_end = true;
+            //rewrite raxlen
+            int64_t current_wpos = GetWritePos();
+            WriteSeek(raxlen_pos);
+            WriteLen(tail.raxlen, 8);
+            WriteSeek(current_wpos);
+
+            /* Save the number of elements inside the stream. We cannot obtain
+             * this easily later, since our macro nodes should be checked for
+             * number of items: not a great CPU / space tradeoff. */
+            if ((n = WriteLen(tail.streamlen)) == -1) return -1;
+            nwritten += n;
+            /* Save the last entry ID. */
+            if ((n = WriteLen(meta.GetStreamLastId().ms)) == -1) return -1;
+            nwritten += n;
+            if ((n = WriteLen(meta.GetStreamLastId().seq)) == -1) return -1;
+            nwritten += n;
+            StreamGroupTable* gtable = same_key ? g_db->StreamLoadGroups(siter) : NULL;
+            if (NULL == gtable)
+            {
+                if ((n = WriteLen(0)) == -1) return -1;
             }
             else
             {
-                if(NULL != lp)
+                if ((n = WriteLen(gtable->size())) == -1) return -1;
+                StreamGroupTable::iterator git = gtable->begin();
+                while (git != gtable->end())
                 {
-                    Data d;
-                    master_id.Encode(d);
-                    if ((n = WriteRawString(d.CStr(), d.StringLength())) == -1) return -1;
+                    StreamGroupMeta& gmeta = *(git->second);
+                    if ((n = WriteRawString(gmeta.name)) == -1) return -1;
                     nwritten += n;
-                    if ((n = WriteRawString((const char*) lp, lp_bytes)) == -1) return -1;
+
+                    /* Last ID. */
+                    if ((n = WriteLen(gmeta.lastid.ms)) == -1) return -1;
                     nwritten += n;
-                    lpFree(lp);
-                    lp = NULL;
-                }
-                if (!write_rax_end)
-                {
-                    write_rax_end = true;
-                    //rewrite raxlen
-                    int64_t current_wpos = GetWritePos();
-                    WriteSeek(raxlen_pos);
-                    WriteLen(raxlen, 8);
-                    WriteSeek(current_wpos);
-
-                    /* Save the number of elements inside the stream. We cannot obtain
-                     * this easily later, since our macro nodes should be checked for
-                     * number of items: not a great CPU / space tradeoff. */
-                    if ((n = WriteLen(streamlen)) == -1) return -1;
+                    if ((n = WriteLen(gmeta.lastid.seq)) == -1) return -1;
                     nwritten += n;
-                    /* Save the last entry ID. */
-                    if ((n = WriteLen(meta.GetStreamLastId().ms)) == -1) return -1;
+
+                    /* Save the global PEL. */
+                    if ((n = RedisWriteStreamPEL(gmeta.consumer_pels, true)) == -1) return -1;
                     nwritten += n;
-                    if ((n = WriteLen(meta.GetStreamLastId().seq)) == -1) return -1;
+
+                    /* Save the consumers of this group. */
+                    if ((n = RedisWriteStreamConsumers(gmeta.consumers)) == -1) return -1;
                     nwritten += n;
+                    git++;
                 }
-                StreamGroupTable* gtable = g_db->StreamLoadGroups(siter);
-                if (NULL == gtable)
-                {
-                    if ((n = WriteLen(0)) == -1) return -1;
-                }
-                else
-                {
-                    if ((n = WriteLen(gtable->size())) == -1) return -1;
-                    StreamGroupTable::iterator git = gtable->begin();
-                    while (git != gtable->end())
-                    {
-                        StreamGroupMeta& gmeta = *(git->second);
-                        if ((n = WriteRawString(gmeta.name)) == -1) return -1;
-                        nwritten += n;
-
-                        /* Last ID. */
-                        if ((n = WriteLen(gmeta.lastid.ms)) == -1) return -1;
-                        nwritten += n;
-                        if ((n = WriteLen(gmeta.lastid.seq)) == -1) return -1;
-                        nwritten += n;
-
-                        /* Save the global PEL. */
-                        if ((n = RedisWriteStreamPEL(gmeta.consumer_pels, true)) == -1) return -1;
-                        nwritten += n;
-
-                        /* Save the consumers of this group. */
-                        if ((n = RedisWriteStreamConsumers(gmeta.consumers)) == -1) return -1;
-                        nwritten += n;
-                        git++;
-                    }
-                    DELETE(gtable);
-                }
+                DELETE(gtable);
             }
-            siter->Next();
         }
         return nwritten;
     }
@@ -1778,8 +1924,11 @@ namespace ardb
         KeyObject meta_key(ctx.ns, KEY_META, key);
         ValueObject meta_value;
         meta_value.SetType(KEY_STREAM);
+        meta_value.GetMetaObject().stream_block = g_db->GetConf().stream_block_entries;
         uint64_t listpacks;
         int64_t ele_count = 0;
+        KeyObject block_key(ctx.ns, KEY_STREAM_BLOCK, key);
+        ValueObject block;
         meta_value.GetStreamMetaFieldNames();
         int isencode;
         if ((listpacks = ReadLen(&isencode)) == REDIS_RDB_LENERR)
@@ -1900,11 +2049,34 @@ namespace ardb
                 lp_ele = lpNext(lp, lp_ele); //skip lpcount
                 if (!(flags & STREAM_ITEM_FLAG_DELETED))
                 {
-                    GetDBWriter().Put(ctx, sk, sv);
+                    if (meta_value.GetMetaObject().stream_block > 0)
+                    {
+                        if (block.GetType() != 0
+                                && block.GetStreamBlockCount() >= meta_value.GetMetaObject().stream_block)
+                        {
+                            GetDBWriter().Put(ctx, block_key, block);
+                            block.Clear();
+                        }
+                        if (block.GetType() == 0)
+                        {
+                            block_key.SetStreamBlockID(id);
+                            meta_value.GetMetaObject().stream_tail = id;
+                        }
+                        stream_block_append(block, meta_value.GetMetaObject().stream_tail, id, sv);
+                        meta_value.GetMetaObject().stream_tail_count = block.GetStreamBlockCount();
+                    }
+                    else
+                    {
+                        GetDBWriter().Put(ctx, sk, sv);
+                    }
                     ele_count++;
                 }
             }
         }
+        if (block.GetType() != 0)
+        {
+            GetDBWriter().Put(ctx, block_key, block);
+        }
         int64_t stream_len;
         if ((stream_len = ReadLen(NULL)) == REDIS_RDB_LENERR)
         {
@@ -2160,6 +2332,14 @@ namespace ardb
                             iter_continue = false;
                             break;
                         }
+                        case KEY_BITMAP:
+                        {
+                            std::string str;
+                            g_db->GetBitmapRange(ctx, k, v, 0, v.GetMetaObject().bitmap_len - 1, str);
+                            WriteRawString(str.data(), str.size());
+                            iter_continue = false;
+                            break;
+                        }
                         case KEY_LIST:
                         case KEY_ZSET:
                         case KEY_SET:
@@ -2169,11 +2349,16 @@ namespace ardb
                             objectlen = ctx.GetReply().GetInteger();
                             WriteLen(objectlen);
                             //DUMP_CHECK_WRITE(WriteStringObject(v.GetStringValue()));
+                            if (v.GetMetaObject().version > 0)
+                            {
+                                objectlen -= RedisWriteVersionedCollection(ctx, k, v);
+                                iter_continue = false;
+                            }
                             break;
                         }
                         case KEY_STREAM:
                         {
-                            RedisWriteStream(iter);
+                            RedisWriteStream(ctx, iter);
                             continue;
                             //break;
                         }
@@ -2186,7 +2371,7 @@ namespace ardb
                 }
                 case KEY_LIST_ELEMENT:
                 {
-                    if (current_keytype != KEY_LIST || objectlen <= 0)
+                    if (current_keytype != KEY_LIST || objectlen <= 0 || k.GetVersion() > 0)
                     {
                         iter_continue = false;
                         break;
@@ -2208,7 +2393,7 @@ namespace ardb
                 }
                 case KEY_ZSET_SORT:
                 {
-                    if (current_keytype != KEY_ZSET || objectlen <= 0)
+                    if (current_keytype != KEY_ZSET || objectlen <= 0 || k.GetVersion() > 0)
                     {
                         break;
                     }
@@ -2275,13 +2460,15 @@ namespace ardb
             NULL), m_processed_bytes(0), m_file_size(0), m_state(SNAPSHOT_INVALID), m_routinetime(0), m_read_buf(
             NULL), m_expected_data_size(0), m_writed_data_size(0), m_cached_repl_offset(0), m_cached_repl_cksm(0), m_save_time(
                     0), m_type((SnapshotType) 0), m_engine_snapshot(
-            NULL)
+            NULL), m_write_cksm(true), m_next_part(0), m_parts_done(0), m_parts_bytes(0), m_parts_keys(0), m_parts_abort(
+            false), m_parts_err(0), m_parts_total(0), m_parts_start(0), m_parts_cost(0)
     {
 
     }
     Snapshot::~Snapshot()
     {
         Close();
+        ClearParts();
         DELETE_A(m_read_buf);
     }
 
@@ -2527,7 +2714,10 @@ namespace ardb
 
             m_writed_data_size += bytes_to_write;
             //check sum here
-            m_cksm = crc64(m_cksm, (unsigned char *) data, bytes_to_write);
+            if (m_write_cksm)
+            {
+                m_cksm = crc64(m_cksm, (unsigned char *) data, bytes_to_write);
+            }
             data += bytes_to_write;
             buflen -= bytes_to_write;
         }
@@ -3102,6 +3292,13 @@ namespace ardb
                                 DUMP_CHECK_WRITE(WriteStringObject(v.GetStringValue()));
                                 break;
                             }
+                            case KEY_BITMAP:
+                            {
+                                std::string str;
+                                g_db->GetBitmapRange(dumpctx, k, v, 0, v.GetMetaObject().bitmap_len - 1, str);
+                                DUMP_CHECK_WRITE(WriteRawString(str.data(), str.size()));
+                                break;
+                            }
                             case KEY_LIST:
                             case KEY_ZSET:
                             case KEY_SET:
@@ -3113,6 +3310,12 @@ namespace ardb
                                 object_totallen = objectlen;
                                 DUMP_CHECK_WRITE(WriteLen(objectlen));
                                 //DUMP_CHECK_WRITE(WriteStringObject(v.GetStringValue()));
+                                if (current_keytype != KEY_STREAM && v.GetMetaObject().version > 0)
+                                {
+                                    int64_t written = RedisWriteVersionedCollection(dumpctx, k, v);
+                                    DUMP_CHECK_WRITE(written);
+                                    objectlen -= written;
+                                }
                                 break;
                             }
                             default:
@@ -3124,7 +3327,8 @@ namespace ardb
                     }
                     case KEY_LIST_ELEMENT:
                     {
-                        if (current_key != k.GetKey() || current_keytype != KEY_LIST || objectlen <= 0)
+                        if (current_key != k.GetKey() || current_keytype != KEY_LIST || objectlen <= 0
+                                || k.GetVersion() > 0)
                         {
                             break;
                         }
@@ -3144,7 +3348,8 @@ namespace ardb
                     }
                     case KEY_ZSET_SORT:
                     {
-                        if (current_key != k.GetKey() || current_keytype != KEY_ZSET || objectlen <= 0)
+                        if (current_key != k.GetKey() || current_keytype != KEY_ZSET || objectlen <= 0
+                                || k.GetVersion() > 0)
                         {
                             break;
                         }
@@ -3210,6 +3415,222 @@ namespace ardb
         return 0;
     }
 
+    /*
+     * One key range of a namespace, saved into an independently compressed part of an ardb snapshot file
+     * by a snapshot thread, and loaded from it by another one.
+     */
+    class SnapshotPart: public ObjectIO
+    {
+        private:
+            FILE* m_fp;
+            uint64 m_left;
+            bool Read(void* buf, size_t buflen, bool cksm)
+            {
+                if (buflen > m_left || fread(buf, buflen, 1, m_fp) != 1)
+                {
+                    return false;
+                }
+                m_left -= buflen;
+                if (cksm)
+                {
+                    this->cksm = crc64(this->cksm, (const unsigned char *) buf, buflen);
+                }
+                atomic_add_uint64(&snapshot->m_parts_bytes, buflen);
+                return true;
+            }
+            int Write(const void* buf, size_t buflen)
+            {
+                if (fwrite(buf, buflen, 1, m_fp) != 1)
+                {
+                    ERROR_LOG("Failed to write %u bytes to snapshot part file:%s", buflen, path.c_str());
+                    return -1;
+                }
+                bytes += buflen;
+                cksm = crc64(cksm, (const unsigned char *) buf, buflen);
+                atomic_add_uint64(&snapshot->m_parts_bytes, buflen);
+                return 0;
+            }
+            int64_t WriteSeek(int64_t pos)
+            {
+                fseeko(m_fp, pos, SEEK_SET);
+                return ftello(m_fp);
+            }
+            int64_t GetWritePos()
+            {
+                return ftello(m_fp);
+            }
+            void CloseFile()
+            {
+                if (NULL != m_fp)
+                {
+                    fclose(m_fp);
+                    m_fp = NULL;
+                }
+            }
+        public:
+            Snapshot* snapshot;
+            Data ns;
+            std::string start;
+            std::string end; /* empty means the end of namespace */
+            bool stale_only;
+            std::string path;
+            uint64 offset;
+            uint64 bytes;
+            uint64 keys;
+            uint64 cksm;
+            SnapshotPart(Snapshot* s, const Data& n) :
+                    m_fp(NULL), m_left(0), snapshot(s), ns(n), stale_only(false), offset(0), bytes(0), keys(0), cksm(0)
+            {
+            }
+            int Save()
+            {
+                if ((m_fp = fopen(path.c_str(), "w")) == NULL)
+                {
+                    ERROR_LOG("Failed to open snapshot part file:%s to write", path.c_str());
+                    return -1;
+                }
+                Context dumpctx;
+                dumpctx.flags.iterate_multi_keys = 1;
+                dumpctx.ns = ns;
+                Iterator* iter = NULL;
+                if (stale_only)
+                {
+                    KeyObject stale_start(ns, KEY_STALE_VERSION, "");
+                    dumpctx.engine_snapshot = snapshot->m_engine_snapshot;
+                    iter = g_engine->Find(dumpctx, stale_start);
+                }
+                else if (start.empty())
+                {
+                    iter = (Iterator*) snapshot->GetIteratorByNamespace(dumpctx, ns);
+                }
+                else
+                {
+                    KeyObject start_key(ns, KEY_META, start);
+                    dumpctx.engine_snapshot = snapshot->m_engine_snapshot;
+                    iter = g_engine->Find(dumpctx, start_key);
+                }
+                Data end_key;
+                end_key.SetString(end, false);
+                Buffer buffer;
+                uint64 flushed_keys = 0;
+                int ret = 0;
+                while (iter->Valid())
+                {
+                    if (snapshot->m_parts_abort)
+                    {
+                        ret = -1;
+                        break;
+                    }
+                    KeyObject& k = iter->Key();
+                    if (stale_only && k.GetType() != KEY_STALE_VERSION)
+                    {
+                        break;
+                    }
+                    if (!end.empty() && k.GetKey().Compare(end_key, true) >= 0)
+                    {
+                        break;
+                    }
+                    int64 ttl = 0;
+                    if (k.GetType() == KEY_META)
+                    {
+                        ttl = iter->Value().GetTTL();
+                        keys++;
+                    }
+                    ArdbSaveRawKeyValue(iter->RawKey(), iter->RawValue(), buffer, ttl);
+                    if (buffer.ReadableBytes() >= kpart_buffer_size)
+                    {
+                        if ((ret = ArdbFlushWriteBuffer(buffer)) < 0)
+                        {
+                            break;
+                        }
+                        atomic_add_uint64(&snapshot->m_parts_keys, keys - flushed_keys);
+                        flushed_keys = keys;
+                    }
+                    iter->Next();
+                }
+                DELETE(iter);
+                if (0 == ret)
+                {
+                    ret = ArdbFlushWriteBuffer(buffer);
+                    atomic_add_uint64(&snapshot->m_parts_keys, keys - flushed_keys);
+                }
+                CloseFile();
+                return ret;
+            }
+            int Load()
+            {
+                if ((m_fp = fopen(snapshot->m_file_path.c_str(), "r")) == NULL)
+                {
+                    ERROR_LOG("Failed to open snapshot file:%s to read", snapshot->m_file_path.c_str());
+                    return -1;
+                }
+                setvbuf(m_fp, NULL, _IOFBF, kpart_buffer_size);
+                fseeko(m_fp, offset, SEEK_SET);
+                m_left = bytes;
+                m_key_format = snapshot->m_key_format;
+                m_dbwriter = snapshot->m_dbwriter;
+                uint64 expected_cksm = cksm;
+                cksm = 0;
+
+                Context loadctx;
+                loadctx.flags.no_fill_reply = 1;
+                loadctx.flags.no_wal = 1;
+                loadctx.flags.create_if_notexist = 1;
+                loadctx.flags.bulk_loading = 1;
+                loadctx.ns = ns;
+                /*
+                 * raw keys are saved in engine order, they could be ingested as engine files directly
+                 * unless they need to be re-encoded into another key format.
+                 */
+                uint8 key_format = m_key_format < 0 ? g_key_format : (uint8) m_key_format;
+                if (key_format == g_key_format)
+                {
+                    m_sorted_loader = g_engine->BeginSortedLoad(loadctx, ns, path);
+                }
+                int ret = 0;
+                while (m_left > 0)
+                {
+                    if (snapshot->m_parts_abort)
+                    {
+                        ret = -1;
+                        break;
+                    }
+                    int type = ReadType();
+                    if (type != ARDB_RDB_TYPE_CHUNK && type != ARDB_RDB_TYPE_SNAPPY_CHUNK)
+                    {
+                        ERROR_LOG("Invalid type:%d in snapshot part.", type);
+                        ret = -1;
+                        break;
+                    }
+                    if (0 != (ret = ArdbLoadChunk(loadctx, type)))
+                    {
+                        ERROR_LOG("Failed to load chunk type:%d.", type);
+                        break;
+                    }
+                }
+                if (0 == ret && cksm != expected_cksm)
+                {
+                    ERROR_LOG("Wrong snapshot part checksum.(%llu-%llu)", expected_cksm, cksm);
+                    ret = -1;
+                }
+                if (NULL != m_sorted_loader)
+                {
+                    int err = g_engine->EndSortedLoad(loadctx, m_sorted_loader, 0 == ret);
+                    m_sorted_loader = NULL;
+                    if (0 == ret)
+                    {
+                        ret = err;
+                    }
+                }
+                CloseFile();
+                return ret;
+            }
+            ~SnapshotPart()
+            {
+                CloseFile();
+            }
+    };
+
     int Snapshot::ArdbSave()
     {
         RETURN_NEGATIVE_EXPR(ArdbWriteMagicHeader());
@@ -3234,53 +3655,362 @@ namespace ardb
         RETURN_NEGATIVE_EXPR(WriteType(ARDB_OPCODE_AUX));
         RETURN_NEGATIVE_EXPR(WriteRawString("create_time"));
         RETURN_NEGATIVE_EXPR(WriteRawString(stringfromll(time(NULL))));
+        RETURN_NEGATIVE_EXPR(WriteType(ARDB_OPCODE_AUX));
+        RETURN_NEGATIVE_EXPR(WriteRawString("key_format"));
+        RETURN_NEGATIVE_EXPR(WriteRawString(key_format_name(g_key_format)));
 
         DataArray nss;
         g_db->GetEngine()->ListNameSpaces(dumpctx, nss);
+        size_t split_parts = g_db->GetConf().snapshot_threads * kparts_per_thread;
         for (size_t i = 0; i < nss.size(); i++)
         {
             /*
-             * do not iterate ttl db
+             * ttl entries are rebuilt from the metas while loading, only the pending stale collection
+             * versions of the ttl db are dumped, so that their elements could still be reclaimed.
              */
             if (nss[i].AsString() == TTL_DB_NSMAESPACE)
             {
+                AddPart(nss[i], "", "", true);
                 continue;
             }
-            dumpctx.ns = nss[i];
-            RETURN_NEGATIVE_EXPR(WriteType(ARDB_RDB_OPCODE_SELECTDB));
-            RETURN_NEGATIVE_EXPR(WriteStringObject(nss[i]));
+            StringArray bounds;
+            if (split_parts > 1 && g_engine->EstimateKeysNum(dumpctx, nss[i]) >= kmin_split_keys)
+            {
+                SplitNamespace(dumpctx, nss[i], split_parts, bounds);
+            }
+            std::string start;
+            for (size_t j = 0; j < bounds.size(); j++)
+            {
+                AddPart(nss[i], start, bounds[j], false);
+                start = bounds[j];
+            }
+            AddPart(nss[i], start, "", false);
+        }
+        int ret = RunParts(true);
+        if (0 == ret)
+        {
+            /*
+             * manifest of the parts, part contents follow it in the same order, every part carries its own checksum
+             * and is excluded from the checksum of the whole file.
+             */
+            ret = WriteType(ARDB_RDB_OPCODE_PARTS);
+            if (0 == ret)
+            {
+                ret = WriteLen(m_parts.size());
+            }
+            for (size_t i = 0; i < m_parts.size() && 0 == ret; i++)
+            {
+                SnapshotPart* part = m_parts[i];
+                uint64 part_cksm = part->cksm;
+                memrev64ifbe(&part_cksm);
+                if (WriteStringObject(part->ns) < 0 || WriteLen(part->bytes) < 0 || WriteLen(part->keys) < 0
+                        || Write(&part_cksm, sizeof(part_cksm)) < 0)
+                {
+                    ret = -1;
+                }
+            }
+            for (size_t i = 0; i < m_parts.size() && 0 == ret; i++)
+            {
+                ret = WritePartContent(m_parts[i]);
+            }
+        }
+        ClearParts();
+        if (0 != ret)
+        {
+            Close();
+            return ret;
+        }
+        WriteType(REDIS_RDB_OPCODE_EOF);
+        uint64 cksm = m_cksm;
+        memrev64ifbe(&cksm);
+        Write(&cksm, sizeof(cksm));
+        return 0;
+    }
 
-            //KeyObject empty;
-            //empty.SetNameSpace(nss[i]);
-            //Iterator* iter = g_db->GetEngine()->Find(dumpctx, empty);
-            Iterator* iter = (Iterator*) GetIteratorByNamespace(dumpctx, nss[i]);
-            while (iter->Valid())
+    /*
+     * Skip scan the distinct key prefixes of the namespace with growing prefix length until there are
+     * enough of them, the namespace is then cut at evenly spaced prefixes.
+     */
+    void Snapshot::SplitNamespace(Context& ctx, const Data& ns, size_t parts, StringArray& bounds)
+    {
+        StringArray prefixes;
+        for (size_t prefix_len = 1; prefix_len <= kmax_split_prefix_len && prefixes.size() < parts; prefix_len++)
+        {
+            StringArray found;
+            Iterator* iter = (Iterator*) GetIteratorByNamespace(ctx, ns);
+            while (iter->Valid() && found.size() < kmax_split_prefixes)
             {
-                int64 ttl = 0;
-                if (iter->Key().GetType() == KEY_META)
+                std::string prefix, next;
+                iter->Key().GetKey().ToString(prefix);
+                if (prefix.size() >= prefix_len)
                 {
-                    ttl = iter->Value().GetTTL();
+                    prefix.resize(prefix_len);
+                    next = prefix;
+                    while (!next.empty() && (uint8) next[next.size() - 1] == 0xFF)
+                    {
+                        next.resize(next.size() - 1);
+                    }
+                    if (!next.empty())
+                    {
+                        next[next.size() - 1]++;
+                    }
                 }
-                int ret = ArdbSaveRawKeyValue(iter->RawKey(), iter->RawValue(), m_write_buffer, ttl);
-                if (0 != ret)
+                else
                 {
-                    DELETE(iter);
-                    Close();
-                    return ret;
+                    next = prefix;
+                    next.push_back(0);
                 }
-                if (m_write_buffer.ReadableBytes() >= 1024 * 1024)
+                found.push_back(prefix);
+                if (next.empty())
                 {
-                    ArdbFlushWriteBuffer(m_write_buffer);
+                    break;
                 }
-                iter->Next();
+                KeyObject next_key(ns, KEY_META, next);
+                iter->Jump(next_key);
             }
-            ArdbFlushWriteBuffer(m_write_buffer);
             DELETE(iter);
+            bool truncated = found.size() >= kmax_split_prefixes;
+            if (!truncated || prefixes.empty())
+            {
+                prefixes.swap(found);
+            }
+            if (truncated)
+            {
+                break;
+            }
         }
-        WriteType(REDIS_RDB_OPCODE_EOF);
-        uint64 cksm = m_cksm;
-        memrev64ifbe(&cksm);
-        Write(&cksm, sizeof(cksm));
+        size_t step = prefixes.size() / parts;
+        if (0 == step)
+        {
+            step = 1;
+        }
+        for (size_t i = step; i < prefixes.size() && bounds.size() + 1 < parts; i += step)
+        {
+            bounds.push_back(prefixes[i]);
+        }
+    }
+
+    void Snapshot::AddPart(const Data& ns, const std::string& start, const std::string& end, bool stale_only)
+    {
+        SnapshotPart* part = NULL;
+        NEW(part, SnapshotPart(this, ns));
+        part->start = start;
+        part->end = end;
+        part->stale_only = stale_only;
+        part->path = m_file_path + ".part" + stringfromll(m_parts.size());
+        m_parts.push_back(part);
+    }
+
+    void Snapshot::RunPartTasks(bool save)
+    {
+        while (!m_parts_abort)
+        {
+            uint32 idx = atomic_add_uint32(&m_next_part, 1) - 1;
+            if (idx >= m_parts.size())
+            {
+                break;
+            }
+            SnapshotPart* part = m_parts[idx];
+            int err = save ? part->Save() : part->Load();
+            if (0 != err)
+            {
+                ERROR_LOG("Failed to %s part:%u of namespace:%s with err:%d", save ? "save" : "load", idx,
+                        part->ns.AsString().c_str(), err);
+                m_parts_err = err;
+                m_parts_abort = true;
+            }
+            else if (!save)
+            {
+                atomic_add_uint64(&m_parts_keys, part->keys);
+            }
+            atomic_add_uint32(&m_parts_done, 1);
+        }
+    }
+
+    void Snapshot::LogPartsProgress(bool save)
+    {
+        uint64 cost = get_current_epoch_millis() - m_parts_start;
+        double mb = m_parts_bytes / (1024.0 * 1024.0);
+        INFO_LOG("%s %u/%u snapshot parts with %llu keys & %.2fMB in %.2fs(%.2fMB/s).", save ? "Saved" : "Loaded",
+                m_parts_done, m_parts_total, m_parts_keys, mb, cost / 1000.0, cost > 0 ? mb * 1000 / cost : 0.0);
+    }
+
+    int Snapshot::RunParts(bool save)
+    {
+        struct PartWorker: public Thread
+        {
+                Snapshot* snapshot;
+                bool save;
+                volatile bool complete;
+                PartWorker(Snapshot* s, bool v)
+                        : snapshot(s), save(v), complete(false)
+                {
+                }
+                void Run()
+                {
+                    snapshot->RunPartTasks(save);
+                    complete = true;
+                }
+        };
+        m_next_part = 0;
+        m_parts_done = 0;
+        m_parts_bytes = 0;
+        m_parts_keys = 0;
+        m_parts_abort = false;
+        m_parts_err = 0;
+        m_parts_total = m_parts.size();
+        m_parts_cost = 0;
+        m_parts_start = get_current_epoch_millis();
+        uint64 processed_base = m_processed_bytes;
+        size_t thread_num = g_db->GetConf().snapshot_threads;
+        if (thread_num > m_parts.size())
+        {
+            thread_num = m_parts.size();
+        }
+        std::vector<PartWorker*> workers;
+        for (size_t i = 0; i < thread_num; i++)
+        {
+            PartWorker* worker = NULL;
+            NEW(worker, PartWorker(this, save));
+            worker->Start();
+            workers.push_back(worker);
+        }
+        uint64 last_log_time = m_parts_start;
+        size_t running = workers.size();
+        while (running > 0)
+        {
+            Thread::Sleep(10);
+            running = 0;
+            for (size_t i = 0; i < workers.size(); i++)
+            {
+                if (!workers[i]->complete)
+                {
+                    running++;
+                }
+            }
+            if (!save)
+            {
+                m_processed_bytes = processed_base + m_parts_bytes;
+            }
+            if (NULL != m_routine_cb && !m_parts_abort)
+            {
+                int cbret = m_routine_cb(save ? DUMPING : LODING, this, m_routine_cbdata);
+                if (0 != cbret)
+                {
+                    ERROR_LOG("Routine return error:%d or snapshot file:%s", cbret, m_file_path.c_str());
+                    m_parts_err = cbret;
+                    m_parts_abort = true;
+                }
+                m_routinetime = get_current_epoch_millis();
+            }
+            if (get_current_epoch_millis() - last_log_time >= 10000)
+            {
+                LogPartsProgress(save);
+                last_log_time = get_current_epoch_millis();
+            }
+        }
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            workers[i]->Join();
+            DELETE(workers[i]);
+        }
+        m_parts_cost = get_current_epoch_millis() - m_parts_start;
+        LogPartsProgress(save);
+        return m_parts_err;
+    }
+
+    int Snapshot::WritePartContent(SnapshotPart* part)
+    {
+        FILE* fp = fopen(part->path.c_str(), "r");
+        if (NULL == fp)
+        {
+            ERROR_LOG("Failed to open snapshot part file:%s to read", part->path.c_str());
+            return -1;
+        }
+        char* buf = NULL;
+        NEW(buf, char[kpart_buffer_size]);
+        uint64 left = part->bytes;
+        int ret = 0;
+        m_write_cksm = false;
+        while (left > 0)
+        {
+            size_t len = left > kpart_buffer_size ? kpart_buffer_size : left;
+            if (fread(buf, len, 1, fp) != 1)
+            {
+                ERROR_LOG("Failed to read snapshot part file:%s", part->path.c_str());
+                ret = -1;
+                break;
+            }
+            if ((ret = Write(buf, len)) != 0)
+            {
+                break;
+            }
+            left -= len;
+        }
+        m_write_cksm = true;
+        DELETE_A(buf);
+        fclose(fp);
+        file_del(part->path);
+        return ret;
+    }
+
+    void Snapshot::ClearParts()
+    {
+        for (size_t i = 0; i < m_parts.size(); i++)
+        {
+            if (is_file_exist(m_parts[i]->path))
+            {
+                file_del(m_parts[i]->path);
+            }
+            DELETE(m_parts[i]);
+        }
+        m_parts.clear();
+    }
+
+    int Snapshot::ArdbLoadParts()
+    {
+        uint64 count = ReadLen(NULL);
+        if (count == REDIS_RDB_LENERR || count == (uint64) -1)
+        {
+            return -1;
+        }
+        for (uint64 i = 0; i < count; i++)
+        {
+            std::string ns;
+            uint64 part_cksm = 0;
+            if (!ReadString(ns))
+            {
+                ClearParts();
+                return -1;
+            }
+            AddPart(Data(ns, false), "", "", false);
+            SnapshotPart* part = m_parts.back();
+            part->path = m_file_path + ".part" + stringfromll(i) + ".sst";
+            part->bytes = ReadLen(NULL);
+            part->keys = ReadLen(NULL);
+            if (!Read(&part_cksm, sizeof(part_cksm), true))
+            {
+                ClearParts();
+                return -1;
+            }
+            memrev64ifbe(&part_cksm);
+            part->cksm = part_cksm;
+        }
+        uint64 offset = ftello(m_read_fp);
+        for (size_t i = 0; i < m_parts.size(); i++)
+        {
+            m_parts[i]->offset = offset;
+            offset += m_parts[i]->bytes;
+        }
+        int ret = RunParts(false);
+        ClearParts();
+        g_db->InvalidateAllMetas();
+        if (0 != ret)
+        {
+            return ret;
+        }
+        m_processed_bytes = offset;
+        fseeko(m_read_fp, offset, SEEK_SET);
         return 0;
     }
 
@@ -3310,6 +4040,10 @@ namespace ardb
             WARN_LOG("Can't handle ARDB format version %d", rdbver);
             return -1;
         }
+        /*
+         * snapshots without 'key_format' aux info were saved in legacy key format
+         */
+        m_key_format = KEY_FORMAT_LEGACY;
         g_engine->BeginBulkLoad(loadctx);
         while (true)
         {
@@ -3339,6 +4073,11 @@ namespace ardb
                     goto eoferr;
                 }
                 INFO_LOG("Snapshot aux info: %s=%s", aux_key.c_str(), aux_val.c_str());
+                uint8 key_format;
+                if (aux_key == "key_format" && parse_key_format(aux_val, key_format))
+                {
+                    m_key_format = key_format;
+                }
             }
             else if (type == ARDB_RDB_TYPE_CHUNK || type == ARDB_RDB_TYPE_SNAPPY_CHUNK)
             {
@@ -3348,6 +4087,14 @@ namespace ardb
                     goto eoferr;
                 }
             }
+            else if (type == ARDB_RDB_OPCODE_PARTS)
+            {
+                if (0 != ArdbLoadParts())
+                {
+                    ERROR_LOG("Failed to load snapshot parts.");
+                    goto eoferr;
+                }
+            }
             else
             {
                 ERROR_LOG("Invalid type:%d.", type);
@@ -3521,9 +4268,19 @@ namespace ardb
         {
             time_t ts = m_snapshots[i]->SaveTime();
             sprintf(buffer, "snapshot%u:type=%s,"
-                    "create_time=%s,name=%s\r\n", (uint32_t)i, type2str(m_snapshots[i]->GetType()),
+                    "create_time=%s,name=%s", (uint32_t)i, type2str(m_snapshots[i]->GetType()),
                     trim_str(ctime_r(&ts, tmp), " \t\r\n"), get_basename(m_snapshots[i]->GetPath()).c_str());
             str.append(buffer);
+            Snapshot* s = m_snapshots[i];
+            if (s->m_parts_total > 0)
+            {
+                uint64 cost = s->m_parts_cost > 0 ? s->m_parts_cost : get_current_epoch_millis() - s->m_parts_start;
+                double mb = s->m_parts_bytes / (1024.0 * 1024.0);
+                sprintf(buffer, ",parts=%u/%u,keys=%" PRIu64 ",bytes=%" PRIu64 ",throughput=%.2fMB/s", s->m_parts_done,
+                        s->m_parts_total, (uint64) s->m_parts_keys, (uint64) s->m_parts_bytes, cost > 0 ? mb * 1000 / cost : 0.0);
+                str.append(buffer);
+            }
+            str.append("\r\n");
         }
     }
     void SnapshotManager::Routine()
@@ -31,6 +31,7 @@
 #define SNAPSHOT_HPP_
 #include <string>
 #include <deque>
+#include <vector>
 #include "common.hpp"
 #include "buffer/buffer_helper.hpp"
 #include "context.hpp"
@@ -52,12 +53,30 @@ namespace ardb
     class Snapshot;
     typedef int SnapshotRoutine(SnapshotState state, Snapshot* snapshot, void* cb);
 
+    /*
+     * tail listpack of a stream written in the redis rdb format
+     */
+    struct RedisStreamListpack
+    {
+            unsigned char* lp;
+            size_t lp_bytes;
+            StreamID master_id;
+            int64_t raxlen;
+            int64_t streamlen;
+            RedisStreamListpack()
+                    : lp(NULL), lp_bytes(0), raxlen(0), streamlen(0)
+            {
+            }
+    };
+
     class ObjectIO
     {
         protected:
 
             typedef TreeMap<StreamID, unsigned char *>::Type ListPackTree;
             DBWriter* m_dbwriter;
+            int m_key_format; /* key format of loaded raw keys, -1 means the local format */
+            void* m_sorted_loader; /* engine sorted loader taking loaded raw keys instead of the db writer */
             virtual bool Read(void* buf, size_t buflen, bool cksm = true) = 0;
             virtual int Write(const void* buf, size_t buflen) = 0;
             virtual int64_t WriteSeek(int64_t pos) = 0;
@@ -93,9 +112,15 @@ namespace ardb
             void RedisLoadSetIntSet(Context& ctx, unsigned char* data, const std::string& key, ValueObject& meta_value);
             bool RedisLoadStream(Context& ctx, const std::string& key);
             void RedisWriteMagicHeader();
-            int64_t RedisWriteStream(void* iter);
+            int64_t RedisWriteStream(Context& ctx, void* iter);
+            int64_t RedisWriteStreamEntry(RedisStreamListpack& tail, ValueObject& meta, const StreamID& sid,
+                    ValueObject& iv);
+            int64_t RedisFlushStreamListpack(RedisStreamListpack& tail);
+            int64_t RedisWriteStreamBlocks(Context& ctx, RedisStreamListpack& tail, const KeyObject& key,
+                    ValueObject& meta);
             int64_t RedisWriteStreamPEL(PELTable& pel, bool nacks);
             int64_t RedisWriteStreamConsumers(ConsumerTable& consumers);
+            int64_t RedisWriteVersionedCollection(Context& ctx, const KeyObject& key, ValueObject& meta);
 
             int ArdbWriteMagicHeader();
             int ArdbLoadChunk(Context& ctx, int type);
@@ -104,7 +129,7 @@ namespace ardb
             DBWriter& GetDBWriter();
         public:
             ObjectIO() :
-                    m_dbwriter(NULL)
+                    m_dbwriter(NULL), m_key_format(-1), m_sorted_loader(NULL)
             {
             }
             void SetDBWriter(DBWriter* writer)
@@ -146,6 +171,8 @@ namespace ardb
     };
 
     class SnapshotManager;
+    class SnapshotPart;
+    typedef std::vector<SnapshotPart*> SnapshotPartArray;
     class Snapshot: public ObjectIO
     {
         protected:
@@ -171,6 +198,21 @@ namespace ardb
             SnapshotType m_type;
 
             const void* m_engine_snapshot;
+            bool m_write_cksm;
+
+            /*
+             * key ranges of an ardb snapshot saved/loaded by 'snapshot-threads' threads in parallel
+             */
+            SnapshotPartArray m_parts;
+            volatile uint32_t m_next_part;
+            volatile uint32_t m_parts_done;
+            volatile uint64_t m_parts_bytes;
+            volatile uint64_t m_parts_keys;
+            volatile bool m_parts_abort;
+            int m_parts_err;
+            uint32 m_parts_total;
+            uint64 m_parts_start;
+            uint64 m_parts_cost;
             bool Read(void* buf, size_t buflen, bool cksm);
 
             int RedisLoad();
@@ -178,6 +220,14 @@ namespace ardb
 
             int ArdbSave();
             int ArdbLoad();
+            int ArdbLoadParts();
+            void SplitNamespace(Context& ctx, const Data& ns, size_t parts, StringArray& bounds);
+            void AddPart(const Data& ns, const std::string& start, const std::string& end, bool stale_only);
+            int RunParts(bool save);
+            void RunPartTasks(bool save);
+            void LogPartsProgress(bool save);
+            int WritePartContent(SnapshotPart* part);
+            void ClearParts();
 
             int BackupSave();
             int BackupLoad();
@@ -192,6 +242,7 @@ namespace ardb
             int64_t GetWritePos();
 
             friend class SnapshotManager;
+            friend class SnapshotPart;
         public:
             Snapshot();
             SnapshotType GetType()
@@ -27,6 +27,7 @@
  *THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "statistics.hpp"
+#include "thread/thread_local.hpp"
 OP_NAMESPACE_BEGIN
     static Statistics* g_singleton = NULL;
 
@@ -129,6 +130,117 @@ OP_NAMESPACE_BEGIN
         recs.resize(ranges.size() + 1);
     }
 
+    struct LatencyShardIndex
+    {
+            uint32_t idx;
+            LatencyShardIndex()
+            {
+                static volatile uint32_t seed = 0;
+                idx = atomic_add_uint32(&seed, 1) % LATENCY_HISTOGRAM_SHARDS;
+            }
+    };
+    static ThreadLocal<LatencyShardIndex> g_latency_shard;
+
+    CommandLatencyHistogram::CommandLatencyHistogram()
+    {
+        memset(shards, 0, sizeof(shards));
+    }
+    CommandLatencyHistogram::~CommandLatencyHistogram()
+    {
+        for (size_t i = 0; i < LATENCY_HISTOGRAM_SHARDS; i++)
+        {
+            delete[] shards[i];
+        }
+    }
+    size_t CommandLatencyHistogram::BucketIndex(uint64 micros)
+    {
+        if (micros < 16)
+        {
+            return micros;
+        }
+        int msb = 63 - __builtin_clzll(micros);
+        size_t idx = 16 + (msb - 4) * 4 + ((micros >> (msb - 2)) & 3);
+        return idx < LATENCY_HISTOGRAM_BUCKETS ? idx : LATENCY_HISTOGRAM_BUCKETS - 1;
+    }
+    uint64 CommandLatencyHistogram::BucketUpperBound(size_t idx)
+    {
+        if (idx < 16)
+        {
+            return idx;
+        }
+        int msb = 4 + (idx - 16) / 4;
+        uint64 lower = (uint64) (4 + (idx - 16) % 4) << (msb - 2);
+        return lower + ((uint64) 1 << (msb - 2)) - 1;
+    }
+    void CommandLatencyHistogram::Add(uint64 micros)
+    {
+        uint32_t idx = g_latency_shard.GetValue().idx;
+        Shard* shard = shards[idx];
+        if (NULL == shard)
+        {
+            LockGuard<SpinMutexLock> guard(shards_lock);
+            if (NULL == shards[idx])
+            {
+                shard = (Shard*) new Shard[1];
+                memset((void*) shard, 0, sizeof(Shard));
+                shards[idx] = shard;
+            }
+            shard = shards[idx];
+        }
+        atomic_add_uint64(&((*shard)[BucketIndex(micros)]), 1);
+    }
+    uint64 CommandLatencyHistogram::Merge(uint64* counts) const
+    {
+        uint64 total = 0;
+        memset(counts, 0, sizeof(uint64) * LATENCY_HISTOGRAM_BUCKETS);
+        for (size_t i = 0; i < LATENCY_HISTOGRAM_SHARDS; i++)
+        {
+            const Shard* shard = shards[i];
+            if (NULL == shard)
+            {
+                continue;
+            }
+            for (size_t j = 0; j < LATENCY_HISTOGRAM_BUCKETS; j++)
+            {
+                counts[j] += (*shard)[j];
+                total += (*shard)[j];
+            }
+        }
+        return total;
+    }
+    uint64 CommandLatencyHistogram::Percentile(const uint64* counts, uint64 total, double p)
+    {
+        if (0 == total)
+        {
+            return 0;
+        }
+        uint64 rank = (uint64) (p * total);
+        if (rank < p * total || 0 == rank)
+        {
+            rank++;
+        }
+        uint64 sum = 0;
+        for (size_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+        {
+            sum += counts[i];
+            if (sum >= rank)
+            {
+                return BucketUpperBound(i);
+            }
+        }
+        return BucketUpperBound(LATENCY_HISTOGRAM_BUCKETS - 1);
+    }
+    void CommandLatencyHistogram::Clear()
+    {
+        for (size_t i = 0; i < LATENCY_HISTOGRAM_SHARDS; i++)
+        {
+            if (NULL != shards[i])
+            {
+                memset((void*) shards[i], 0, sizeof(Shard));
+            }
+        }
+    }
+
     Statistics::Statistics()
     {
     }
@@ -208,6 +208,34 @@ OP_NAMESPACE_BEGIN
             }
     };
 
+    /*
+     * Fixed bucket latency histogram in microseconds: exact below 16us, then 4 buckets per power of two up to
+     * ~2^32us, so a percentile is off by at most 25%. Counters are sharded per thread so the hot path is one
+     * uncontended atomic add, readers merge the shards.
+     */
+#define LATENCY_HISTOGRAM_BUCKETS 128
+#define LATENCY_HISTOGRAM_SHARDS  16
+    struct CommandLatencyHistogram
+    {
+            typedef volatile uint64_t Shard[LATENCY_HISTOGRAM_BUCKETS];
+            Shard* shards[LATENCY_HISTOGRAM_SHARDS]; /* allocated on the first Add from a shard */
+            SpinMutexLock shards_lock;
+            CommandLatencyHistogram();
+            ~CommandLatencyHistogram();
+            void Add(uint64 micros);
+            /*
+             * Fills 'counts' with LATENCY_HISTOGRAM_BUCKETS merged counters and returns their sum.
+             */
+            uint64 Merge(uint64* counts) const;
+            void Clear();
+            static size_t BucketIndex(uint64 micros);
+            static uint64 BucketUpperBound(size_t idx);
+            /*
+             * Upper bound of the bucket holding the 'p' (0-1] quantile of merged 'counts', 0 if empty.
+             */
+            static uint64 Percentile(const uint64* counts, uint64 total, double p);
+    };
+
     struct InstantQPS
     {
     	volatile uint64_t count;
@@ -215,14 +243,14 @@ OP_NAMESPACE_BEGIN
     	InstantQPS():count(0),ts(0)
     	{
     	}
-    	uint64_t Inc(time_t now)
+    	uint64_t Inc(time_t now, uint64_t n = 1)
     	{
     		if(ts != now)
     		{
     			ts = now;
     			count = 0;
     		}
-    		return atomic_add_uint64(&count, 1);
+    		return atomic_add_uint64(&count, n);
     	}
     };
 
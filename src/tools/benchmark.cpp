@@ -0,0 +1,931 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include "network.hpp"
+#include "db/db.hpp"
+#include "thread/thread.hpp"
+#include "util/string_helper.hpp"
+#include "util/time_helper.hpp"
+#include "channel/codec/redis_reply_codec.hpp"
+#include "channel/codec/redis_command_codec.hpp"
+
+using namespace ardb;
+using namespace ardb::codec;
+
+enum BenchOpType
+{
+    BENCH_SET = 0,
+    BENCH_GET,
+    BENCH_MSET,
+    BENCH_MGET,
+    BENCH_DEL,
+    BENCH_SCAN,
+    BENCH_HSET,
+    BENCH_HGET,
+    BENCH_HGETALL,
+    BENCH_LPUSH,
+    BENCH_LPOP,
+    BENCH_LRANGE,
+    BENCH_ZADD,
+    BENCH_ZRANGE,
+    BENCH_XADD,
+    BENCH_XRANGE,
+    BENCH_GEOADD,
+    BENCH_GEORADIUS,
+    BENCH_OP_MAX
+};
+
+struct BenchOpDesc
+{
+        const char* name;
+        bool engine_mode; /* could also be run directly against the engine */
+};
+
+static const BenchOpDesc kBenchOps[BENCH_OP_MAX] = { { "set", true }, { "get", true }, { "mset", true }, { "mget", true }, {
+        "del", true }, { "scan", true }, { "hset", false }, { "hget", false }, { "hgetall", false }, { "lpush", false }, {
+        "lpop", false }, { "lrange", false }, { "zadd", false }, { "zrange", false }, { "xadd", false }, { "xrange", false }, {
+        "geoadd", false }, { "georadius", false } };
+
+static const size_t kMultiKeys = 10;
+static const size_t kScanCount = 20;
+
+struct BenchOptions
+{
+        std::string host;
+        uint16 port;
+        uint32 clients;
+        uint32 threads;
+        uint64 requests;
+        uint32 pipeline;
+        uint64 keyspace;
+        uint64 collections;
+        uint32 datasize;
+        std::string engine_conf;
+        std::vector<int> mix; /* op types repeated by weight */
+        BenchOptions() :
+                host("127.0.0.1"), port(16379), clients(50), threads(1), requests(100000), pipeline(1), keyspace(100000), collections(
+                        100), datasize(16)
+        {
+        }
+};
+static BenchOptions g_opts;
+
+/*
+ * Latency histogram in microseconds, values below 64 are counted exactly, larger values are kept
+ * in 32 sub buckets per power of two, so every bucket is within ~3% of the recorded latency.
+ */
+class LatencyHistogram
+{
+    private:
+        static const int kLinearBuckets = 64;
+        static const int kSubBucketBits = 5;
+        static const int kBuckets = kLinearBuckets + (64 - 6) * (1 << kSubBucketBits);
+        uint64 m_counts[kBuckets];
+        uint64 m_count;
+        uint64 m_sum;
+        uint64 m_min;
+        uint64 m_max;
+        static int BucketIndex(uint64 v)
+        {
+            if (v < (uint64) kLinearBuckets)
+            {
+                return (int) v;
+            }
+            int msb = 63 - __builtin_clzll(v);
+            int shift = msb - kSubBucketBits;
+            return kLinearBuckets + (msb - 6) * (1 << kSubBucketBits) + (int) ((v >> shift) & ((1 << kSubBucketBits) - 1));
+        }
+        static uint64 BucketValue(int idx)
+        {
+            if (idx < kLinearBuckets)
+            {
+                return idx;
+            }
+            int group = (idx - kLinearBuckets) >> kSubBucketBits;
+            int sub = (idx - kLinearBuckets) & ((1 << kSubBucketBits) - 1);
+            int shift = group + 6 - kSubBucketBits;
+            return ((uint64) ((1 << kSubBucketBits) + sub)) << shift;
+        }
+    public:
+        LatencyHistogram() :
+                m_count(0), m_sum(0), m_min(0), m_max(0)
+        {
+            memset(m_counts, 0, sizeof(m_counts));
+        }
+        void Record(uint64 micros)
+        {
+            m_counts[BucketIndex(micros)]++;
+            if (0 == m_count || micros < m_min)
+            {
+                m_min = micros;
+            }
+            if (micros > m_max)
+            {
+                m_max = micros;
+            }
+            m_count++;
+            m_sum += micros;
+        }
+        void Merge(const LatencyHistogram& other)
+        {
+            if (0 == other.m_count)
+            {
+                return;
+            }
+            for (int i = 0; i < kBuckets; i++)
+            {
+                m_counts[i] += other.m_counts[i];
+            }
+            if (0 == m_count || other.m_min < m_min)
+            {
+                m_min = other.m_min;
+            }
+            if (other.m_max > m_max)
+            {
+                m_max = other.m_max;
+            }
+            m_count += other.m_count;
+            m_sum += other.m_sum;
+        }
+        uint64 Count() const
+        {
+            return m_count;
+        }
+        double Mean() const
+        {
+            return m_count > 0 ? (double) m_sum / m_count : 0;
+        }
+        uint64 Percentile(double p) const
+        {
+            if (0 == m_count)
+            {
+                return 0;
+            }
+            uint64 rank = (uint64) (p / 100.0 * m_count);
+            if (rank >= m_count)
+            {
+                return m_max;
+            }
+            uint64 seen = 0;
+            for (int i = 0; i < kBuckets; i++)
+            {
+                seen += m_counts[i];
+                if (seen > rank)
+                {
+                    uint64 v = BucketValue(i);
+                    return v > m_max ? m_max : v;
+                }
+            }
+            return m_max;
+        }
+        void PrintSummary(const char* name, double seconds, uint64 errors) const
+        {
+            printf("%-10s %10" PRIu64 " %12.1f %9.1f %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8" PRIu64 "\n",
+                    name, m_count, seconds > 0 ? m_count / seconds : 0, Mean(), Percentile(50), Percentile(90), Percentile(99),
+                    Percentile(99.9), m_max, errors);
+        }
+        /*
+         * cumulative distribution at power of two boundaries
+         */
+        void PrintDistribution() const
+        {
+            if (0 == m_count)
+            {
+                return;
+            }
+            uint64 seen = 0;
+            uint64 bound = 1;
+            for (int i = 0; i < kBuckets && seen < m_count; i++)
+            {
+                if (BucketValue(i) >= bound)
+                {
+                    printf("  <%10" PRIu64 "us %8.3f%%\n", bound, seen * 100.0 / m_count);
+                    while (bound <= BucketValue(i))
+                    {
+                        bound <<= 1;
+                    }
+                }
+                seen += m_counts[i];
+            }
+            printf("  <%10" PRIu64 "us %8.3f%%\n", bound, 100.0);
+        }
+};
+
+struct BenchStats
+{
+        LatencyHistogram hists[BENCH_OP_MAX];
+        uint64 errors[BENCH_OP_MAX];
+        uint64 conn_errors;
+        BenchStats() :
+                conn_errors(0)
+        {
+            memset(errors, 0, sizeof(errors));
+        }
+        void Record(int op, uint64 micros, bool err)
+        {
+            hists[op].Record(micros);
+            if (err)
+            {
+                errors[op]++;
+            }
+        }
+        void Merge(const BenchStats& other)
+        {
+            for (int i = 0; i < BENCH_OP_MAX; i++)
+            {
+                hists[i].Merge(other.hists[i]);
+                errors[i] += other.errors[i];
+            }
+            conn_errors += other.conn_errors;
+        }
+};
+
+/*
+ * xorshift64*, every worker owns one generator so that command generation never contends
+ */
+class BenchRandom
+{
+    private:
+        uint64 m_state;
+    public:
+        BenchRandom(uint64 seed) :
+                m_state(seed ? seed : 88172645463325252ULL)
+        {
+        }
+        uint64 Next()
+        {
+            m_state ^= m_state >> 12;
+            m_state ^= m_state << 25;
+            m_state ^= m_state >> 27;
+            return m_state * 2685821657736338717ULL;
+        }
+        uint64 Next(uint64 bound)
+        {
+            return bound > 0 ? Next() % bound : 0;
+        }
+};
+
+class BenchWorker: public Thread
+{
+    protected:
+        BenchRandom m_rand;
+        std::string m_value;
+        int64 m_remaining;
+        std::string Name(const char* prefix, uint64 bound)
+        {
+            std::string name = prefix;
+            name.append(stringfromll(m_rand.Next(bound)));
+            return name;
+        }
+        std::string KeyName()
+        {
+            return Name("bench:key:", g_opts.keyspace);
+        }
+        int PickOp()
+        {
+            return g_opts.mix[m_rand.Next(g_opts.mix.size())];
+        }
+    public:
+        BenchStats stats;
+        BenchWorker(uint32 idx, int64 requests) :
+                m_rand(get_current_epoch_micros() * (idx + 1)), m_value(g_opts.datasize, 'x'), m_remaining(requests)
+        {
+        }
+};
+
+/*
+ * Drives one server connection, keeps up to 'pipeline' commands in flight and records the
+ * latency of every reply from the time its command was written.
+ */
+class ServerBenchWorker;
+class BenchConnection: public ChannelUpstreamHandler<RedisReply>
+{
+    private:
+        struct Inflight
+        {
+                int op;
+                uint64 start;
+        };
+        ServerBenchWorker* m_worker;
+        bool m_connected;
+        std::deque<Inflight> m_inflight;
+        Buffer m_out;
+        void Send(Channel* ch);
+        void ChannelConnected(ChannelHandlerContext& ctx, ChannelStateEvent& e);
+        void MessageReceived(ChannelHandlerContext& ctx, MessageEvent<RedisReply>& e);
+        void ChannelClosed(ChannelHandlerContext& ctx, ChannelStateEvent& e);
+    public:
+        RedisReplyDecoder decoder;
+        BenchConnection(ServerBenchWorker* w) :
+                m_worker(w), m_connected(false)
+        {
+        }
+};
+
+class ServerBenchWorker: public BenchWorker
+{
+    private:
+        ChannelService m_serv;
+        uint32 m_conns;
+        uint32 m_active_conns;
+        std::vector<BenchConnection*> m_handlers;
+        void Run()
+        {
+            SocketHostAddress addr(g_opts.host, g_opts.port);
+            for (uint32 i = 0; i < m_conns; i++)
+            {
+                BenchConnection* conn = new BenchConnection(this);
+                m_handlers.push_back(conn);
+                ClientSocketChannel* ch = m_serv.NewClientSocketChannel();
+                ch->GetPipeline().AddLast("decoder", &conn->decoder);
+                ch->GetPipeline().AddLast("handler", conn);
+                m_active_conns++;
+                ch->Connect(&addr);
+            }
+            if (m_active_conns > 0)
+            {
+                m_serv.Start();
+            }
+        }
+        void BuildCommand(int op, RedisCommandFrame& cmd)
+        {
+            switch (op)
+            {
+                case BENCH_SET:
+                {
+                    cmd.SetCommand("set");
+                    cmd.AddArg(KeyName());
+                    cmd.AddArg(m_value);
+                    break;
+                }
+                case BENCH_GET:
+                {
+                    cmd.SetCommand("get");
+                    cmd.AddArg(KeyName());
+                    break;
+                }
+                case BENCH_MSET:
+                {
+                    cmd.SetCommand("mset");
+                    for (size_t i = 0; i < kMultiKeys; i++)
+                    {
+                        cmd.AddArg(KeyName());
+                        cmd.AddArg(m_value);
+                    }
+                    break;
+                }
+                case BENCH_MGET:
+                {
+                    cmd.SetCommand("mget");
+                    for (size_t i = 0; i < kMultiKeys; i++)
+                    {
+                        cmd.AddArg(KeyName());
+                    }
+                    break;
+                }
+                case BENCH_DEL:
+                {
+                    cmd.SetCommand("del");
+                    cmd.AddArg(KeyName());
+                    break;
+                }
+                case BENCH_SCAN:
+                {
+                    cmd.SetCommand("scan");
+                    cmd.AddArg("0");
+                    cmd.AddArg("count");
+                    cmd.AddArg(stringfromll(kScanCount));
+                    break;
+                }
+                case BENCH_HSET:
+                {
+                    cmd.SetCommand("hset");
+                    cmd.AddArg(Name("bench:hash:", g_opts.collections));
+                    cmd.AddArg(Name("field:", g_opts.keyspace));
+                    cmd.AddArg(m_value);
+                    break;
+                }
+                case BENCH_HGET:
+                {
+                    cmd.SetCommand("hget");
+                    cmd.AddArg(Name("bench:hash:", g_opts.collections));
+                    cmd.AddArg(Name("field:", g_opts.keyspace));
+                    break;
+                }
+                case BENCH_HGETALL:
+                {
+                    cmd.SetCommand("hgetall");
+                    cmd.AddArg(Name("bench:hash:", g_opts.collections));
+                    break;
+                }
+                case BENCH_LPUSH:
+                {
+                    cmd.SetCommand("lpush");
+                    cmd.AddArg(Name("bench:list:", g_opts.collections));
+                    cmd.AddArg(m_value);
+                    break;
+                }
+                case BENCH_LPOP:
+                {
+                    cmd.SetCommand("lpop");
+                    cmd.AddArg(Name("bench:list:", g_opts.collections));
+                    break;
+                }
+                case BENCH_LRANGE:
+                {
+                    cmd.SetCommand("lrange");
+                    cmd.AddArg(Name("bench:list:", g_opts.collections));
+                    cmd.AddArg("0");
+                    cmd.AddArg("99");
+                    break;
+                }
+                case BENCH_ZADD:
+                {
+                    cmd.SetCommand("zadd");
+                    cmd.AddArg(Name("bench:zset:", g_opts.collections));
+                    cmd.AddArg(stringfromll(m_rand.Next(1000000)));
+                    cmd.AddArg(Name("member:", g_opts.keyspace));
+                    break;
+                }
+                case BENCH_ZRANGE:
+                {
+                    cmd.SetCommand("zrange");
+                    cmd.AddArg(Name("bench:zset:", g_opts.collections));
+                    cmd.AddArg("0");
+                    cmd.AddArg("99");
+                    break;
+                }
+                case BENCH_XADD:
+                {
+                    cmd.SetCommand("xadd");
+                    cmd.AddArg(Name("bench:stream:", g_opts.collections));
+                    cmd.AddArg("*");
+                    cmd.AddArg("field");
+                    cmd.AddArg(m_value);
+                    break;
+                }
+                case BENCH_XRANGE:
+                {
+                    cmd.SetCommand("xrange");
+                    cmd.AddArg(Name("bench:stream:", g_opts.collections));
+                    cmd.AddArg("-");
+                    cmd.AddArg("+");
+                    cmd.AddArg("count");
+                    cmd.AddArg(stringfromll(kScanCount));
+                    break;
+                }
+                case BENCH_GEOADD:
+                {
+                    /*
+                     * members are spread over a 10x10 degrees area, so radius queries hit a bounded number of members
+                     */
+                    char lon[32], lat[32];
+                    snprintf(lon, sizeof(lon), "%.6f", 100.0 + m_rand.Next(10000000) / 1000000.0);
+                    snprintf(lat, sizeof(lat), "%.6f", 20.0 + m_rand.Next(10000000) / 1000000.0);
+                    cmd.SetCommand("geoadd");
+                    cmd.AddArg(Name("bench:geo:", g_opts.collections));
+                    cmd.AddArg(lon);
+                    cmd.AddArg(lat);
+                    cmd.AddArg(Name("member:", g_opts.keyspace));
+                    break;
+                }
+                case BENCH_GEORADIUS:
+                {
+                    char lon[32], lat[32];
+                    snprintf(lon, sizeof(lon), "%.6f", 100.0 + m_rand.Next(10000000) / 1000000.0);
+                    snprintf(lat, sizeof(lat), "%.6f", 20.0 + m_rand.Next(10000000) / 1000000.0);
+                    cmd.SetCommand("georadius");
+                    cmd.AddArg(Name("bench:geo:", g_opts.collections));
+                    cmd.AddArg(lon);
+                    cmd.AddArg(lat);
+                    cmd.AddArg("50");
+                    cmd.AddArg("km");
+                    cmd.AddArg("COUNT");
+                    cmd.AddArg("10");
+                    break;
+                }
+                default:
+                {
+                    break;
+                }
+            }
+        }
+    public:
+        ServerBenchWorker(uint32 idx, uint32 conns, int64 requests) :
+                BenchWorker(idx, requests), m_conns(conns), m_active_conns(0)
+        {
+        }
+        bool NextCommand(RedisCommandFrame& cmd, int& op)
+        {
+            if (m_remaining <= 0)
+            {
+                return false;
+            }
+            m_remaining--;
+            op = PickOp();
+            cmd.Clear();
+            BuildCommand(op, cmd);
+            return true;
+        }
+        void ConnectionClosed(bool failed)
+        {
+            if (failed)
+            {
+                stats.conn_errors++;
+            }
+            m_active_conns--;
+            if (0 == m_active_conns)
+            {
+                m_serv.Stop();
+            }
+        }
+        ~ServerBenchWorker()
+        {
+            for (size_t i = 0; i < m_handlers.size(); i++)
+            {
+                delete m_handlers[i];
+            }
+        }
+};
+
+void BenchConnection::Send(Channel* ch)
+{
+    RedisCommandFrame cmd;
+    int op;
+    while (m_inflight.size() < g_opts.pipeline && m_worker->NextCommand(cmd, op))
+    {
+        RedisCommandEncoder::Encode(m_out, cmd);
+        Inflight f;
+        f.op = op;
+        f.start = 0;
+        m_inflight.push_back(f);
+    }
+    if (m_inflight.empty())
+    {
+        ch->Close();
+        return;
+    }
+    if (m_out.Readable())
+    {
+        uint64 now = get_current_epoch_micros();
+        for (size_t i = m_inflight.size(); i > 0 && 0 == m_inflight[i - 1].start; i--)
+        {
+            m_inflight[i - 1].start = now;
+        }
+        ch->Write(m_out);
+        m_out.Clear();
+    }
+}
+
+void BenchConnection::ChannelConnected(ChannelHandlerContext& ctx, ChannelStateEvent& e)
+{
+    m_connected = true;
+    Send(ctx.GetChannel());
+}
+
+void BenchConnection::MessageReceived(ChannelHandlerContext& ctx, MessageEvent<RedisReply>& e)
+{
+    if (m_inflight.empty())
+    {
+        return;
+    }
+    Inflight f = m_inflight.front();
+    m_inflight.pop_front();
+    m_worker->stats.Record(f.op, get_current_epoch_micros() - f.start, e.GetMessage()->IsErr());
+    Send(ctx.GetChannel());
+}
+
+void BenchConnection::ChannelClosed(ChannelHandlerContext& ctx, ChannelStateEvent& e)
+{
+    m_worker->ConnectionClosed(!m_connected || !m_inflight.empty());
+    m_inflight.clear();
+}
+
+/*
+ * Runs the operations against the compiled in Engine without the server and protocol in between,
+ * build ardb-benchmark with each storage_engine to compare the engines on the same machine.
+ */
+class EngineBenchWorker: public BenchWorker
+{
+    private:
+        Context m_ctx;
+        KeyObject Key()
+        {
+            return KeyObject(m_ctx.ns, KEY_META, KeyName());
+        }
+        int DoOp(int op)
+        {
+            Engine* engine = g_engine;
+            switch (op)
+            {
+                case BENCH_SET:
+                case BENCH_MSET:
+                {
+                    ValueObject v;
+                    v.SetType(KEY_STRING);
+                    v.GetStringValue().SetString(m_value, false);
+                    if (BENCH_SET == op)
+                    {
+                        return engine->Put(m_ctx, Key(), v);
+                    }
+                    WriteBatchGuard batch(m_ctx, engine);
+                    for (size_t i = 0; i < kMultiKeys; i++)
+                    {
+                        engine->Put(m_ctx, Key(), v);
+                    }
+                    return 0;
+                }
+                case BENCH_GET:
+                {
+                    ValueObject v;
+                    int err = engine->Get(m_ctx, Key(), v);
+                    return ERR_ENTRY_NOT_EXIST == err ? 0 : err;
+                }
+                case BENCH_MGET:
+                {
+                    KeyObjectArray keys;
+                    for (size_t i = 0; i < kMultiKeys; i++)
+                    {
+                        keys.push_back(Key());
+                    }
+                    ValueObjectArray vals;
+                    ErrCodeArray errs;
+                    int err = engine->MultiGet(m_ctx, keys, vals, errs);
+                    return ERR_ENTRY_NOT_EXIST == err ? 0 : err;
+                }
+                case BENCH_DEL:
+                {
+                    int err = engine->Del(m_ctx, Key());
+                    return ERR_ENTRY_NOT_EXIST == err ? 0 : err;
+                }
+                case BENCH_SCAN:
+                {
+                    Iterator* iter = engine->Find(m_ctx, Key());
+                    for (size_t i = 0; i < kScanCount && NULL != iter && iter->Valid(); i++)
+                    {
+                        iter->Next();
+                    }
+                    DELETE(iter);
+                    return 0;
+                }
+                default:
+                {
+                    return 0;
+                }
+            }
+        }
+        void Run()
+        {
+            while (m_remaining > 0)
+            {
+                m_remaining--;
+                int op = PickOp();
+                uint64 start = get_current_epoch_micros();
+                int err = DoOp(op);
+                stats.Record(op, get_current_epoch_micros() - start, 0 != err);
+            }
+        }
+    public:
+        EngineBenchWorker(uint32 idx, int64 requests) :
+                BenchWorker(idx, requests)
+        {
+            m_ctx.ns.SetString("bench", false);
+            m_ctx.flags.create_if_notexist = 1;
+        }
+};
+
+static void usage()
+{
+    fprintf(stderr, "Usage: ./ardb-benchmark [options]\n");
+    fprintf(stderr, "  -h <host>        Server hostname (default 127.0.0.1)\n");
+    fprintf(stderr, "  -p <port>        Server port (default 16379)\n");
+    fprintf(stderr, "  -c <clients>     Number of connections (default 50)\n");
+    fprintf(stderr, "  -t <threads>     Number of client threads (default 1)\n");
+    fprintf(stderr, "  -n <requests>    Total number of requests (default 100000)\n");
+    fprintf(stderr, "  -P <pipeline>    Commands in flight per connection (default 1)\n");
+    fprintf(stderr, "  -r <keyspace>    Number of distinct keys/fields/members (default 100000)\n");
+    fprintf(stderr, "  -C <collections> Number of distinct hashes/lists/zsets/streams/geo keys (default 100)\n");
+    fprintf(stderr, "  -d <size>        Value size in bytes (default 16)\n");
+    fprintf(stderr, "  -m <mix>         Weighted operation mix, e.g. 'get:8,set:2' (default set:1,get:1)\n");
+    fprintf(stderr, "  -e <conf>        Engine mode: run against the engine opened with the given ardb conf\n");
+    fprintf(stderr, "  --help           Output this help and exit\n");
+    fprintf(stderr, "Operations: ");
+    for (int i = 0; i < BENCH_OP_MAX; i++)
+    {
+        fprintf(stderr, "%s%s%s", i > 0 ? "," : "", kBenchOps[i].name, kBenchOps[i].engine_mode ? "" : "(server only)");
+    }
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+static bool parse_mix(const std::string& spec)
+{
+    g_opts.mix.clear();
+    std::vector<std::string> items = split_string(spec, ",");
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        std::vector<std::string> kv = split_string(items[i], ":");
+        int64 weight = 1;
+        if (kv.empty() || kv.size() > 2 || (kv.size() == 2 && (!string_toint64(kv[1], weight) || weight < 0)))
+        {
+            fprintf(stderr, "Invalid mix item:%s\n", items[i].c_str());
+            return false;
+        }
+        int op = -1;
+        for (int j = 0; j < BENCH_OP_MAX; j++)
+        {
+            if (!strcasecmp(kBenchOps[j].name, kv[0].c_str()))
+            {
+                op = j;
+                break;
+            }
+        }
+        if (op < 0)
+        {
+            fprintf(stderr, "Unknown operation:%s\n", kv[0].c_str());
+            return false;
+        }
+        if (!g_opts.engine_conf.empty() && !kBenchOps[op].engine_mode)
+        {
+            fprintf(stderr, "Operation:%s is not supported in engine mode\n", kv[0].c_str());
+            return false;
+        }
+        g_opts.mix.insert(g_opts.mix.end(), (size_t) weight, op);
+    }
+    return !g_opts.mix.empty();
+}
+
+int main(int argc, char** argv)
+{
+    std::string mix = "set:1,get:1";
+    for (int i = 1; i < argc; i++)
+    {
+        bool lastarg = i == argc - 1;
+        const char* arg = argv[i];
+        if (!strcmp(arg, "--help"))
+        {
+            usage();
+        }
+        if (lastarg || arg[0] != '-' || strlen(arg) != 2)
+        {
+            fprintf(stderr, "Invalid option:%s\n", arg);
+            usage();
+        }
+        const char* v = argv[++i];
+        switch (arg[1])
+        {
+            case 'h':
+                g_opts.host = v;
+                break;
+            case 'p':
+                g_opts.port = (uint16) atoi(v);
+                break;
+            case 'c':
+                g_opts.clients = (uint32) atoi(v);
+                break;
+            case 't':
+                g_opts.threads = (uint32) atoi(v);
+                break;
+            case 'n':
+                g_opts.requests = strtoull(v, NULL, 10);
+                break;
+            case 'P':
+                g_opts.pipeline = (uint32) atoi(v);
+                break;
+            case 'r':
+                g_opts.keyspace = strtoull(v, NULL, 10);
+                break;
+            case 'C':
+                g_opts.collections = strtoull(v, NULL, 10);
+                break;
+            case 'd':
+                g_opts.datasize = (uint32) atoi(v);
+                break;
+            case 'm':
+                mix = v;
+                break;
+            case 'e':
+                g_opts.engine_conf = v;
+                break;
+            default:
+                fprintf(stderr, "Invalid option:%s\n", arg);
+                usage();
+        }
+    }
+    if (g_opts.threads == 0 || g_opts.clients == 0 || g_opts.pipeline == 0 || g_opts.keyspace == 0 || g_opts.collections == 0)
+    {
+        usage();
+    }
+    if (g_opts.clients < g_opts.threads)
+    {
+        g_opts.clients = g_opts.threads;
+    }
+    if (!parse_mix(mix))
+    {
+        usage();
+    }
+
+    Ardb* db = NULL;
+    if (!g_opts.engine_conf.empty())
+    {
+        db = new Ardb;
+        if (0 != db->Init(g_opts.engine_conf))
+        {
+            fprintf(stderr, "Failed to init engine:%s with conf:%s\n", g_engine_name, g_opts.engine_conf.c_str());
+            return -1;
+        }
+    }
+
+    std::vector<BenchWorker*> workers;
+    for (uint32 i = 0; i < g_opts.threads; i++)
+    {
+        int64 requests = g_opts.requests / g_opts.threads + (i < g_opts.requests % g_opts.threads ? 1 : 0);
+        if (NULL != db)
+        {
+            workers.push_back(new EngineBenchWorker(i, requests));
+        }
+        else
+        {
+            uint32 conns = g_opts.clients / g_opts.threads + (i < g_opts.clients % g_opts.threads ? 1 : 0);
+            workers.push_back(new ServerBenchWorker(i, conns, requests));
+        }
+    }
+    uint64 start = get_current_epoch_micros();
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i]->Start();
+    }
+    BenchStats total;
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i]->Join();
+        total.Merge(workers[i]->stats);
+        delete workers[i];
+    }
+    double seconds = (get_current_epoch_micros() - start) / 1000000.0;
+
+    if (NULL != db)
+    {
+        printf("====== engine:%s threads:%u requests:%" PRIu64 " value:%uB ======\n", g_engine_name, g_opts.threads,
+                g_opts.requests, g_opts.datasize);
+    }
+    else
+    {
+        printf("====== server:%s:%u clients:%u threads:%u pipeline:%u requests:%" PRIu64 " value:%uB ======\n",
+                g_opts.host.c_str(), g_opts.port, g_opts.clients, g_opts.threads, g_opts.pipeline, g_opts.requests,
+                g_opts.datasize);
+    }
+    printf("%-10s %10s %12s %9s %8s %8s %8s %8s %8s %8s\n", "op", "requests", "ops/sec", "avg(us)", "p50", "p90", "p99",
+            "p99.9", "max", "errors");
+    LatencyHistogram all;
+    uint64 all_errors = 0;
+    for (int i = 0; i < BENCH_OP_MAX; i++)
+    {
+        if (total.hists[i].Count() > 0)
+        {
+            total.hists[i].PrintSummary(kBenchOps[i].name, seconds, total.errors[i]);
+            all.Merge(total.hists[i]);
+            all_errors += total.errors[i];
+        }
+    }
+    all.PrintSummary("all", seconds, all_errors);
+    printf("\nLatency distribution(all):\n");
+    all.PrintDistribution();
+    if (total.conn_errors > 0)
+    {
+        printf("\n%" PRIu64 " connections failed or closed with requests in flight\n", total.conn_errors);
+    }
+    printf("\n%.2f seconds elapsed\n", seconds);
+    delete db;
+    return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "util/bit_helper.hpp"
+#include "util/string_helper.hpp"
+#include "util/time_helper.hpp"
+
+using namespace ardb;
+
+/*
+ * Compares the BITCOUNT/BITPOS/BITOP kernels on in memory bitmaps, every kernel's result is checked against
+ * the portable one.
+ */
+struct BitBenchOptions
+{
+        size_t size;
+        uint32 rounds;
+        uint32 sources;
+        BitBenchOptions()
+                : size(4 * 1024 * 1024), rounds(50), sources(4)
+        {
+        }
+};
+static BitBenchOptions g_opts;
+
+enum BitBenchOp
+{
+    BIT_BENCH_POPCOUNT = 0, BIT_BENCH_POS1, BIT_BENCH_POS0, BIT_BENCH_AND, BIT_BENCH_OR, BIT_BENCH_XOR, BIT_BENCH_NOT, BIT_BENCH_MAX
+};
+static const char* kBitBenchOpNames[BIT_BENCH_MAX] =
+{ "bitcount", "bitpos1", "bitpos0", "bitop-and", "bitop-or", "bitop-xor", "bitop-not" };
+
+struct BitBenchData
+{
+        std::vector<std::string> srcs;
+        std::vector<const unsigned char*> ptrs;
+        std::vector<size_t> lens;
+        std::string zeros;
+        std::string ones;
+        std::string dst;
+};
+
+/*
+ * Runs 'op' once, BITOP results are left in data.dst.
+ */
+static int64 run_op(int op, BitBenchData& data)
+{
+    switch (op)
+    {
+        case BIT_BENCH_POPCOUNT:
+            return bits_popcount(data.srcs[0].data(), data.srcs[0].size());
+        case BIT_BENCH_POS1:
+            return bits_pos(data.zeros.data(), data.zeros.size(), 1);
+        case BIT_BENCH_POS0:
+            return bits_pos(data.ones.data(), data.ones.size(), 0);
+        default:
+        {
+            int bitop = BITOP_AND + (op - BIT_BENCH_AND);
+            size_t numsrc = bitop == BITOP_NOT ? 1 : data.ptrs.size();
+            bits_op(bitop, (unsigned char*) &data.dst[0], data.dst.size(), &data.ptrs[0], &data.lens[0], numsrc);
+            return 0;
+        }
+    }
+}
+
+static size_t op_bytes(int op, BitBenchData& data)
+{
+    if (op >= BIT_BENCH_AND && op != BIT_BENCH_NOT)
+    {
+        return data.dst.size() * data.ptrs.size();
+    }
+    return data.dst.size();
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: ./ardb-bitops-benchmark [options]\n");
+    fprintf(stderr, "  -s <size>        Bitmap size in bytes (default 4194304)\n");
+    fprintf(stderr, "  -n <rounds>      Rounds per kernel and operation (default 50)\n");
+    fprintf(stderr, "  -k <sources>     Source bitmaps for BITOP AND/OR/XOR (default 4)\n");
+    fprintf(stderr, "  --help           Output this help and exit\n");
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        bool lastarg = i == argc - 1;
+        const char* arg = argv[i];
+        if (!strcmp(arg, "--help"))
+        {
+            usage();
+        }
+        if (lastarg || arg[0] != '-' || strlen(arg) != 2)
+        {
+            fprintf(stderr, "Invalid option:%s\n", arg);
+            usage();
+        }
+        const char* v = argv[++i];
+        switch (arg[1])
+        {
+            case 's':
+                g_opts.size = strtoull(v, NULL, 10);
+                break;
+            case 'n':
+                g_opts.rounds = (uint32) atoi(v);
+                break;
+            case 'k':
+                g_opts.sources = (uint32) atoi(v);
+                break;
+            default:
+                fprintf(stderr, "Invalid option:%s\n", arg);
+                usage();
+        }
+    }
+    if (g_opts.size == 0 || g_opts.rounds == 0 || g_opts.sources == 0)
+    {
+        usage();
+    }
+
+    BitBenchData data;
+    srandom(12345);
+    data.srcs.resize(g_opts.sources);
+    for (size_t i = 0; i < data.srcs.size(); i++)
+    {
+        /* sources of slightly different lengths so the zero padding paths are exercised too */
+        size_t len = g_opts.size - (i * 64 < g_opts.size ? i * 64 : 0);
+        data.srcs[i].resize(len);
+        for (size_t j = 0; j < len; j++)
+        {
+            data.srcs[i][j] = (char) random();
+        }
+        data.ptrs.push_back((const unsigned char*) data.srcs[i].data());
+        data.lens.push_back(len);
+    }
+    /* the searched bit sits in the last byte so BITPOS scans the whole bitmap */
+    data.zeros.assign(g_opts.size, 0);
+    data.zeros[g_opts.size - 1] = 1;
+    data.ones.assign(g_opts.size, (char) 0xFF);
+    data.ones[g_opts.size - 1] = (char) 0xFE;
+    data.dst.resize(g_opts.size);
+
+    BitKernel best = bits_kernel();
+    std::string expected[BIT_BENCH_MAX];
+    bits_select_kernel(BIT_KERNEL_PORTABLE);
+    for (int op = 0; op < BIT_BENCH_MAX; op++)
+    {
+        expected[op] = op >= BIT_BENCH_AND ? (run_op(op, data), data.dst) : stringfromll(run_op(op, data));
+    }
+
+    printf("bitmap size:%zu bytes, rounds:%u, bitop sources:%u, default kernel:%s\n", g_opts.size, g_opts.rounds, g_opts.sources,
+            bits_kernel_name(best));
+    printf("%-10s", "kernel");
+    for (int op = 0; op < BIT_BENCH_MAX; op++)
+    {
+        printf(" %12s", kBitBenchOpNames[op]);
+    }
+    printf("   (MB/s)\n");
+    int err = 0;
+    for (int k = BIT_KERNEL_PORTABLE; k < BIT_KERNEL_MAX; k++)
+    {
+        if (!bits_select_kernel((BitKernel) k))
+        {
+            printf("%-10s not supported by this cpu\n", bits_kernel_name((BitKernel) k));
+            continue;
+        }
+        printf("%-10s", bits_kernel_name((BitKernel) k));
+        for (int op = 0; op < BIT_BENCH_MAX; op++)
+        {
+            int64 result = run_op(op, data);
+            uint64 start = get_current_epoch_micros();
+            for (uint32 r = 0; r < g_opts.rounds; r++)
+            {
+                result = run_op(op, data);
+            }
+            uint64 cost = get_current_epoch_micros() - start;
+            if ((op >= BIT_BENCH_AND ? data.dst : stringfromll(result)) != expected[op])
+            {
+                printf(" %12s", "MISMATCH");
+                err = 1;
+                continue;
+            }
+            double mbytes = (double) op_bytes(op, data) * g_opts.rounds / (1024.0 * 1024.0);
+            printf(" %12.1f", cost > 0 ? mbytes * 1000000.0 / cost : 0.0);
+        }
+        printf("\n");
+    }
+    bits_select_kernel(best);
+    return err;
+}
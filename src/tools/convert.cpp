@@ -0,0 +1,74 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "db/db.hpp"
+
+void version()
+{
+    printf("Ardb convert v=%s bits=%d engine=%s \n", ARDB_VERSION, sizeof(long) == 4 ? 32 : 64, g_engine_name);
+    exit(0);
+}
+
+void usage()
+{
+    fprintf(stderr, "Usage: ./ardb-convert [-c conf_file] [src_dir] [dst_dir] [legacy|memcomparable]\n");
+    fprintf(stderr, "       ./ardb-convert -v or --version\n");
+    fprintf(stderr, "       ./ardb-convert -h or --help\n");
+    fprintf(stderr, "Examples:\n");
+    fprintf(stderr, "       ./ardb-convert -c ./ardb.conf ./data/rocksdb ./data/rocksdb.new memcomparable\n");
+    fprintf(stderr, "The server must be stopped, move dst_dir to the server's data dir after converting.\n");
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    std::string conf_file;
+    std::vector<std::string> args;
+    for (int j = 1; j < argc; j++)
+    {
+        if (strcmp(argv[j], "-v") == 0 || strcmp(argv[j], "--version") == 0)
+            version();
+        if (strcmp(argv[j], "--help") == 0 || strcmp(argv[j], "-h") == 0)
+            usage();
+        if (strcmp(argv[j], "-c") == 0 && j + 1 < argc)
+        {
+            conf_file = argv[++j];
+            continue;
+        }
+        args.push_back(argv[j]);
+    }
+    if (args.size() != 3)
+    {
+        usage();
+    }
+
+    Ardb db;
+    return db.ConvertKeyFormat(conf_file, args[0], args[1], args[2]) == 0 ? 0 : 1;
+}
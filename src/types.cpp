@@ -65,16 +65,28 @@ OP_NAMESPACE_BEGIN
 
     void* Data::ReserveStringSpace(size_t size)
     {
-        ToMutableStr();
+        /* a borrowed string about to grow is copied once below, not first into a private copy */
+        if (encoding != E_CSTR || StringLength() >= size)
+        {
+            ToMutableStr();
+        }
         if (StringLength() < size)
         {
-            void* s = malloc(size);
-            memset((char*) s + StringLength(), 0, size - StringLength());
-            if (IsString())
+            size_t old_len = StringLength();
+            void* s = NULL;
+            if (encoding == E_SDS)
             {
-                memcpy(s, CStr(), StringLength());
-                Clear();
+                s = realloc((void*) data, size);
             }
+            else
+            {
+                s = malloc(size);
+                if (IsString())
+                {
+                    memcpy(s, CStr(), old_len);
+                }
+            }
+            memset((char*) s + old_len, 0, size - old_len);
             data = (int64_t) s;
             encoding = E_SDS;
             this->len = size;
@@ -474,7 +486,13 @@ OP_NAMESPACE_BEGIN
         {
             return (size_t) t.GetInt64();
         }
-        return 0;
+        if (!t.IsString())
+        {
+            return 0;
+        }
+        uint32_t hash = 0;
+        MurmurHash3_x86_32(t.CStr(), t.StringLength(), 0, &hash);
+        return hash;
     }
 
     bool DataEqual::operator()(const Data& s1, const Data& s2) const
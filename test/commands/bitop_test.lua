@@ -10,4 +10,47 @@ ardb.assert2(s == 0, s)
 s = ardb.call("getbit", "mykey", "7")
 ardb.assert2(s == 1, s)
 s = ardb.call("setbit", "mykey", "7", "0")
-ardb.assert2(s == 1, s)
\ No newline at end of file
+ardb.assert2(s == 1, s)
+
+ardb.call("del", "bitmap1", "bitmap2", "bitmap3")
+ardb.call("setbit", "bitmap1", "1", "1")
+ardb.call("setbit", "bitmap1", "40", "1")
+ardb.call("setbit", "bitmap1", "100", "1")
+s = ardb.call("bitcount", "bitmap1")
+ardb.assert2(s == 3, s)
+s = ardb.call("bitcount", "bitmap1", "1", "-1")
+ardb.assert2(s == 2, s)
+s = ardb.call("strlen", "bitmap1")
+ardb.assert2(s == 13, s)
+s = ardb.call("bitpos", "bitmap1", "1", "2")
+ardb.assert2(s == 40, s)
+s = ardb.call("bitpos", "bitmap1", "0", "6", "11")
+ardb.assert2(s == 48, s)
+s = ardb.call("getrange", "bitmap1", "0", "0")
+ardb.assert2(s == "@", s)
+ardb.call("setbit", "bitmap2", "40", "1")
+s = ardb.call("bitop", "and", "bitmap3", "bitmap1", "bitmap2")
+ardb.assert2(s == 13, s)
+s = ardb.call("bitcount", "bitmap3")
+ardb.assert2(s == 1, s)
+ardb.call("setbit", "bitmap1", "40", "0")
+s = ardb.call("bitcount", "bitmap1")
+ardb.assert2(s == 2, s)
+ardb.call("del", "bitmap1", "bitmap2", "bitmap3")
+
+--[[ the destination of BITOP is also a source, its old segments are read before they are staled --]]
+ardb.call("del", "bitacc", "bitx")
+ardb.call("setbit", "bitacc", "3", "1")
+ardb.call("setbit", "bitacc", "70", "1")
+ardb.call("setbit", "bitx", "5", "1")
+ardb.call("setbit", "bitx", "100", "1")
+s = ardb.call("bitop", "or", "bitacc", "bitacc", "bitx")
+ardb.assert2(s == 13, s)
+ardb.call("debug", "sweep")
+s = ardb.call("bitcount", "bitacc")
+ardb.assert2(s == 4, s)
+s = ardb.call("getbit", "bitacc", "70")
+ardb.assert2(s == 1, s)
+s = ardb.call("getbit", "bitacc", "100")
+ardb.assert2(s == 1, s)
+ardb.call("del", "bitacc", "bitx")
\ No newline at end of file
@@ -18,4 +18,8 @@ ardb.assert2(s[2] == "Catania", s)
 ardb.call("geoadd", "mygeo", "13.583333", "37.316667", "Agrigento")
 s = ardb.call("GEORADIUSBYMEMBER", "mygeo", "Agrigento", "100", "km")
 ardb.assert2(s[1] == "Agrigento", s)
-ardb.assert2(s[2] == "Palermo", s)
\ No newline at end of file
+ardb.assert2(s[2] == "Palermo", s)
+s = ardb.call("GEORADIUS", "mygeo", "15", "37", "200", "km", "COUNT", "2")
+ardb.assert2(#s == 2, s)
+ardb.assert2(s[1] == "Catania", s)
+ardb.assert2(s[2] == "Agrigento", s)
\ No newline at end of file
@@ -1,3 +1,62 @@
 --[[   --]]
 local s = ardb.call("echo", "hello,world")
-ardb.assert2(s == "hello,world", s)
\ No newline at end of file
+ardb.assert2(s == "hello,world", s)
+
+ardb.call("del", "kp:1", "kp:2", "kp:3", "kpx")
+ardb.call("mset", "kp:1", "a", "kp:2", "b", "kp:3", "c", "kpx", "d")
+s = ardb.call("keyscount", "kp:*")
+ardb.assert2(s == 3, s)
+s = ardb.call("keys", "kp:*")
+ardb.assert2(#s == 3 and s[1] == "kp:1" and s[3] == "kp:3", s)
+s = ardb.call("keys", "kpx")
+ardb.assert2(#s == 1, s)
+s = ardb.call("dbsize", "exact")
+ardb.assert2(s >= 4, s)
+
+--[[ collection metas are cached, a read after a write must not see the cached meta of before the write --]]
+local function meta_cache_hits()
+    local info = ardb.call("info", "stats")
+    return tonumber(string.match(info, "meta_cache_hits:(%d+)"))
+end
+ardb.call("del", "metakey", "metakey2", "metazset")
+ardb.call("hset", "metakey", "f1", "v1")
+s = ardb.call("hlen", "metakey")
+ardb.assert2(s == 1, s)
+local hits = meta_cache_hits()
+s = ardb.call("hlen", "metakey")
+ardb.assert2(s == 1, s)
+s = meta_cache_hits()
+ardb.assert2(s > hits, s)
+ardb.call("hset", "metakey", "f2", "v2")
+s = ardb.call("hlen", "metakey")
+ardb.assert2(s == 2, s)
+ardb.call("hsetnx", "metakey", "f3", "v3")
+s = ardb.call("hlen", "metakey")
+ardb.assert2(s == 3, s)
+ardb.call("hdel", "metakey", "f1")
+s = ardb.call("hlen", "metakey")
+ardb.assert2(s == 2, s)
+ardb.call("pexpire", "metakey", "100000")
+s = ardb.call("pttl", "metakey")
+ardb.assert2(s > 0, s)
+ardb.call("persist", "metakey")
+s = ardb.call("pttl", "metakey")
+ardb.assert2(s == -1, s)
+ardb.call("rename", "metakey", "metakey2")
+s = ardb.call("hlen", "metakey")
+ardb.assert2(s == 0, s)
+s = ardb.call("hlen", "metakey2")
+ardb.assert2(s == 2, s)
+ardb.call("del", "metakey2")
+ardb.call("hset", "metakey2", "f", "v")
+s = ardb.call("hlen", "metakey2")
+ardb.assert2(s == 1, s)
+ardb.call("zadd", "metazset", "1", "a", "2", "b")
+s = ardb.call("zcard", "metazset")
+ardb.assert2(s == 2, s)
+ardb.call("zpopmin", "metazset")
+s = ardb.call("zcard", "metazset")
+ardb.assert2(s == 1, s)
+s = ardb.call("type", "metazset")
+ardb.assert2(s["ok"] == "zset", s)
+ardb.call("del", "metakey", "metakey2", "metazset")
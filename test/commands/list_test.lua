@@ -124,3 +124,64 @@ vs = ardb.call("lrange", "destlist", "0", "-1")
 ardb.assert2(table.getn(vs) == 1, vs)
 ardb.assert2(vs[1] == "three", vs)
 
+
+--[[ non sequential list positional index  --]]
+ardb.call("del", "poslist")
+ardb.call("rpush", "poslist", "a", "b", "c", "d", "e", "f", "g", "h")
+ardb.call("linsert", "poslist", "before", "e", "x")
+--[[ "a b c d x e f g h"  --]]
+s = ardb.call("lindex", "poslist", "4")
+ardb.assert2(s == "x", s)
+s = ardb.call("lindex", "poslist", "-3")
+ardb.assert2(s == "f", s)
+vs = ardb.call("lrange", "poslist", "3", "5")
+ardb.assert2(table.getn(vs) == 3, vs)
+ardb.assert2(vs[1] == "d", vs)
+ardb.assert2(vs[2] == "x", vs)
+ardb.assert2(vs[3] == "e", vs)
+ardb.call("lpush", "poslist", "y")
+ardb.call("rpop", "poslist")
+ardb.call("lrem", "poslist", "1", "c")
+--[[ "y a b d x e f g"  --]]
+s = ardb.call("lset", "poslist", "5", "z")
+ardb.assert2(s["ok"] == "OK", s)
+vs = ardb.call("lrange", "poslist", "4", "-1")
+ardb.assert2(table.getn(vs) == 4, vs)
+ardb.assert2(vs[1] == "x", vs)
+ardb.assert2(vs[2] == "z", vs)
+ardb.call("ltrim", "poslist", "1", "-2")
+--[[ "a b d x z f"  --]]
+s = ardb.call("lindex", "poslist", "3")
+ardb.assert2(s == "x", s)
+s = ardb.call("lindex", "poslist", "5")
+ardb.assert2(s == "f", s)
+ardb.call("del", "poslist")
+
+--[[ versioned list DEL/RENAME  --]]
+ardb.call("del", "biglist", "biglist2")
+for i = 1, 500 do
+   ardb.call("rpush", "biglist", "v" .. i)
+end
+s = ardb.call("del", "biglist")
+ardb.assert2(s == 1, s)
+s = ardb.call("llen", "biglist")
+ardb.assert2(s == 0, s)
+ardb.call("rpush", "biglist", "a", "b")
+vs = ardb.call("lrange", "biglist", "0", "-1")
+ardb.assert2(table.getn(vs) == 2, vs)
+ardb.assert2(vs[1] == "a", vs)
+ardb.assert2(vs[2] == "b", vs)
+for i = 1, 500 do
+   ardb.call("rpush", "biglist", "v" .. i)
+end
+s = ardb.call("rename", "biglist", "biglist2")
+ardb.assert2(s["ok"] == "OK", s)
+s = ardb.call("llen", "biglist2")
+ardb.assert2(s == 502, s)
+s = ardb.call("lindex", "biglist2", "251")
+ardb.assert2(s == "v250", s)
+ardb.call("lpush", "biglist", "x")
+vs = ardb.call("lrange", "biglist", "0", "-1")
+ardb.assert2(table.getn(vs) == 1, vs)
+ardb.assert2(vs[1] == "x", vs)
+ardb.call("del", "biglist", "biglist2")
@@ -101,3 +101,23 @@ ardb.assert2(table.getn(vs) == 1, vs)
 ardb.assert2(vs[1] == "c", vs)
 
 
+
+ardb.call("del", "myset1", "myset2", "storeset")
+ardb.call("sadd", "myset1", "a", "b", "c", "d", "e", "f", "g")
+ardb.call("sadd", "myset2", "b", "f", "g", "h")
+s = ardb.call("sinterstore", "myset1", "myset1", "myset2")
+ardb.assert2(s == 3, s)
+vs = ardb.call("smembers", "myset1")
+ardb.assert2(table.getn(vs) == 3, vs)
+ardb.assert2(vs[1] == "b", vs)
+ardb.assert2(vs[3] == "g", vs)
+s = ardb.call("sdiffstore", "myset2", "myset2", "myset1")
+ardb.assert2(s == 1, s)
+vs = ardb.call("smembers", "myset2")
+ardb.assert2(vs[1] == "h", vs)
+s = ardb.call("sunionstore", "storeset", "myset1", "myset2")
+ardb.assert2(s == 4, s)
+s = ardb.call("sinterstore", "storeset", "myset1", "myset2")
+ardb.assert2(s == 0, s)
+s = ardb.call("exists", "storeset")
+ardb.assert2(s == 0, s)
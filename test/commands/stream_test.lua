@@ -0,0 +1,112 @@
+--[[ streams are packed into blocks of 'stream-block-entries 4' entries in ardb-test.conf --]]
+ardb.call("del", "mystream", "mystream2")
+for i = 1, 10 do
+    local id = ardb.call("xadd", "mystream", i .. "-1", "f", "v" .. i)
+    ardb.assert2(id == i .. "-1", id)
+end
+local s = ardb.call("xlen", "mystream")
+ardb.assert2(s == 10, s)
+s = ardb.call("xrange", "mystream", "-", "+")
+ardb.assert2(#s == 10, s)
+ardb.assert2(s[5][1] == "5-1", s)
+ardb.assert2(s[5][2][1] == "f", s)
+ardb.assert2(s[5][2][2] == "v5", s)
+s = ardb.call("xrange", "mystream", "3-1", "9-1")
+ardb.assert2(#s == 7, s)
+ardb.assert2(s[1][1] == "3-1", s)
+ardb.assert2(s[7][1] == "9-1", s)
+s = ardb.call("xrange", "mystream", "4-1", "+", "COUNT", "3")
+ardb.assert2(#s == 3, s)
+ardb.assert2(s[3][1] == "6-1", s)
+s = ardb.call("xrevrange", "mystream", "+", "-", "COUNT", "6")
+ardb.assert2(#s == 6, s)
+ardb.assert2(s[1][1] == "10-1", s)
+ardb.assert2(s[6][1] == "5-1", s)
+
+--[[ XDEL updates XLEN, in the middle of a block and in the tail block --]]
+s = ardb.call("xdel", "mystream", "2-1", "6-1", "10-1", "100-1")
+ardb.assert2(s == 3, s)
+s = ardb.call("xlen", "mystream")
+ardb.assert2(s == 7, s)
+s = ardb.call("xrange", "mystream", "-", "+")
+ardb.assert2(#s == 7, s)
+ardb.assert2(s[2][1] == "3-1", s)
+ardb.assert2(s[5][1] == "7-1", s)
+ardb.assert2(s[7][1] == "9-1", s)
+
+--[[ exact MAXLEN drops whole blocks and rewrites the partial head block --]]
+s = ardb.call("xtrim", "mystream", "MAXLEN", "4")
+ardb.assert2(s == 3, s)
+s = ardb.call("xlen", "mystream")
+ardb.assert2(s == 4, s)
+s = ardb.call("xrange", "mystream", "-", "+")
+ardb.assert2(#s == 4, s)
+ardb.assert2(s[1][1] == "5-1", s)
+ardb.assert2(s[4][1] == "9-1", s)
+
+--[[ MINID keeps the entries at or after the id --]]
+s = ardb.call("xtrim", "mystream", "MINID", "8-1")
+ardb.assert2(s == 2, s)
+s = ardb.call("xlen", "mystream")
+ardb.assert2(s == 2, s)
+s = ardb.call("xrange", "mystream", "-", "+")
+ardb.assert2(s[1][1] == "8-1", s)
+
+--[[ XADD trims with both strategies, the new entry is never trimmed --]]
+s = ardb.call("xadd", "mystream", "MAXLEN", "2", "11-1", "f", "v11")
+ardb.assert2(s == "11-1", s)
+s = ardb.call("xlen", "mystream")
+ardb.assert2(s == 2, s)
+s = ardb.call("xrange", "mystream", "-", "+")
+ardb.assert2(s[1][1] == "9-1", s)
+ardb.assert2(s[2][1] == "11-1", s)
+s = ardb.call("xadd", "mystream", "MINID", "11-1", "12-1", "f", "v12")
+ardb.assert2(s == "12-1", s)
+s = ardb.call("xrange", "mystream", "-", "+")
+ardb.assert2(#s == 2, s)
+ardb.assert2(s[1][1] == "11-1", s)
+
+--[[ approximate trimming only drops whole blocks, so it may keep up to a block more --]]
+for i = 13, 20 do
+    ardb.call("xadd", "mystream", i .. "-1", "f", "v" .. i)
+end
+s = ardb.call("xtrim", "mystream", "MAXLEN", "~", "3")
+local len = ardb.call("xlen", "mystream")
+ardb.assert2(len >= 3 and len <= 6, len)
+ardb.assert2(s == 10 - len, s)
+s = ardb.call("xrange", "mystream", "-", "+")
+ardb.assert2(#s == len, s)
+ardb.assert2(s[len][1] == "20-1", s)
+
+--[[ XADD keeps appending after XDEL emptied the tail block, with every field of the entry --]]
+ardb.call("xdel", "mystream", "17-1", "18-1", "19-1", "20-1")
+for i = 21, 22 do
+    s = ardb.call("xadd", "mystream", i .. "-1", "a", "1", "b", "v" .. i)
+    ardb.assert2(s == i .. "-1", s)
+end
+len = ardb.call("xlen", "mystream")
+s = ardb.call("xrange", "mystream", "-", "+")
+ardb.assert2(#s == len, s)
+ardb.assert2(s[len - 1][1] == "21-1", s)
+ardb.assert2(s[len][1] == "22-1", s)
+ardb.assert2(#s[len][2] == 4, s)
+ardb.assert2(s[len][2][3] == "b", s)
+ardb.assert2(s[len][2][4] == "v22", s)
+
+--[[ DUMP/RESTORE round trip through the RDB stream encoding --]]
+local payload = ardb.call("dump", "mystream")
+s = ardb.call("restore", "mystream2", "0", payload)
+ardb.assert2(s["ok"] == "OK", s)
+s = ardb.call("xlen", "mystream2")
+ardb.assert2(s == len, s)
+local src = ardb.call("xrange", "mystream", "-", "+")
+s = ardb.call("xrange", "mystream2", "-", "+")
+ardb.assert2(#s == #src, s)
+for i = 1, #src do
+    ardb.assert2(s[i][1] == src[i][1], s[i])
+    ardb.assert2(s[i][2][2] == src[i][2][2], s[i])
+end
+s = ardb.call("xadd", "mystream2", "*", "f", "new")
+s = ardb.call("xlen", "mystream2")
+ardb.assert2(s == len + 1, s)
+ardb.call("del", "mystream", "mystream2")
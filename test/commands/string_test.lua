@@ -112,6 +112,13 @@ ardb.assert2(vs[2] == "v3", vs)
 vs = ardb.call("mget", "not_exist_key", "k3")
 ardb.assert2(vs[1] == false, vs)
 ardb.assert2(vs[2] == "v3", vs)
+vs = ardb.call("mget", "k3", "not_exist_key", "k2", "k3")
+ardb.assert2(vs[1] == "v3", vs)
+ardb.assert2(vs[2] == false, vs)
+ardb.assert2(vs[3] == "v2", vs)
+ardb.assert2(vs[4] == "v3", vs)
+c = ardb.call("exists", "k3", "not_exist_key", "k2", "k3")
+ardb.assert2( c == 3, c)
 c = ardb.call("del", "k2", "k3")
 ardb.assert2( c == 2, c)
 s = ardb.call("msetnx", "k2", "v2", "k3", "v3")
@@ -185,4 +192,18 @@ s = ardb.call("incrbyfloat2", "fkey", "1.1")
 v = ardb.call("get", "fkey")
 ardb.assert2(tonumber(v) == 1.1, v)
 
+--[[ bulk strings of at least 4KB are written to clients from the reply with writev --]]
+local big = string.rep("x", 10000) .. "end"
+ardb.call("set", "bigkey", big)
+ardb.call("set", "smallkey", "small")
+v = ardb.call("get", "bigkey")
+ardb.assert2(v == big, #v)
+v = ardb.call("strlen", "bigkey")
+ardb.assert2(v == 10003, v)
+v = ardb.call("getrange", "bigkey", "9998", "-1")
+ardb.assert2(v == "xxend", v)
+v = ardb.call("mget", "smallkey", "bigkey", "smallkey")
+ardb.assert2(#v == 3 and v[1] == "small" and v[2] == big and v[3] == "small", #v)
+ardb.call("del", "bigkey", "smallkey")
+
 
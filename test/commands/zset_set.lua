@@ -221,3 +221,71 @@ ardb.assert2(vs[1] == "3", vs)
 ardb.assert2(vs[2] == "three", vs)
 
 
+
+--[[  rank index --]]
+ardb.call("del", "test-zset-rank")
+ardb.call("zadd", "test-zset-rank", "-100.5", "m1", "-1", "m2", "0", "m3", "0", "m4", "1e-300", "m5", "2", "m6", "2", "m7", "1e200", "m8", "+inf", "m9", "-inf", "m0")
+s = ardb.call("zrank", "test-zset-rank", "m0")
+ardb.assert2(s == 0, s)
+s = ardb.call("zrank", "test-zset-rank", "m4")
+ardb.assert2(s == 4, s)
+s = ardb.call("zrank", "test-zset-rank", "m7")
+ardb.assert2(s == 7, s)
+s = ardb.call("zrevrank", "test-zset-rank", "m8")
+ardb.assert2(s == 1, s)
+vs = ardb.call("zrange", "test-zset-rank", "5", "6")
+ardb.assert2(vs[1] == "m5", vs)
+ardb.assert2(vs[2] == "m6", vs)
+vs = ardb.call("zrevrange", "test-zset-rank", "2", "3")
+ardb.assert2(vs[1] == "m7", vs)
+ardb.assert2(vs[2] == "m6", vs)
+ardb.call("zadd", "test-zset-rank", "3", "m1")
+s = ardb.call("zrank", "test-zset-rank", "m1")
+ardb.assert2(s == 7, s)
+ardb.call("zrem", "test-zset-rank", "m3")
+ardb.call("zpopmin", "test-zset-rank")
+s = ardb.call("zrank", "test-zset-rank", "m1")
+ardb.assert2(s == 5, s)
+s = ardb.call("zremrangebyrank", "test-zset-rank", "1", "2")
+ardb.assert2(s == 2, s)
+vs = ardb.call("zrange", "test-zset-rank", "1", "-1")
+ardb.assert2(vs[1] == "m6", vs)
+ardb.assert2(vs[2] == "m7", vs)
+s = ardb.call("zrank", "test-zset-rank", "m9")
+ardb.assert2(s == 5, s)
+ardb.call("del", "test-zset-rank")
+
+--[[  versioned zset DEL/RENAME --]]
+ardb.call("del", "test-zset-big", "test-zset-big2")
+for i = 1, 500 do
+   ardb.call("zadd", "test-zset-big", tostring(i), "m" .. i)
+end
+s = ardb.call("del", "test-zset-big")
+ardb.assert2(s == 1, s)
+s = ardb.call("zcard", "test-zset-big")
+ardb.assert2(s == 0, s)
+ardb.call("zadd", "test-zset-big", "1", "a", "2", "b")
+s = ardb.call("zcard", "test-zset-big")
+ardb.assert2(s == 2, s)
+vs = ardb.call("zrange", "test-zset-big", "0", "-1")
+ardb.assert2(table.getn(vs) == 2, vs)
+ardb.assert2(vs[1] == "a", vs)
+ardb.assert2(vs[2] == "b", vs)
+s = ardb.call("zscore", "test-zset-big", "m250")
+ardb.assert2(s == false, s)
+for i = 1, 500 do
+   ardb.call("zadd", "test-zset-big", tostring(i), "m" .. i)
+end
+s = ardb.call("rename", "test-zset-big", "test-zset-big2")
+ardb.assert2(s["ok"] == "OK", s)
+s = ardb.call("zcard", "test-zset-big2")
+ardb.assert2(s == 502, s)
+s = ardb.call("zscore", "test-zset-big2", "m250")
+ardb.assert2(s == "250", s)
+s = ardb.call("zrank", "test-zset-big2", "m250")
+ardb.assert2(s == 251, s)
+ardb.call("zadd", "test-zset-big", "1", "x")
+vs = ardb.call("zrange", "test-zset-big", "0", "-1")
+ardb.assert2(table.getn(vs) == 1, vs)
+ardb.assert2(vs[1] == "x", vs)
+ardb.call("del", "test-zset-big", "test-zset-big2")
@@ -33,10 +33,801 @@
 #include "util/time_helper.hpp"
 #include "command/lua_scripting.hpp"
 #include "db/db.hpp"
+#include "db/db_utils.hpp"
+#include "repl/repl.hpp"
 #include "config.hpp"
+#include "thread/thread.hpp"
+#include "channel/fifo/fifo_channel.hpp"
+#include "channel/codec/redis_reply_codec.hpp"
+#include "redis/endianconv.h"
 
 using namespace ardb;
 
+#define TEST_ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d assert failed: %s\n", __FILE__, __LINE__, #cond); \
+        return -1; \
+    } \
+} while (0)
+
+static RedisReply& test_call(Context& ctx, const std::string& cmdline)
+{
+    std::vector<std::string> args = split_string(cmdline, " ");
+    RedisCommandFrame cmd(args[0]);
+    for (size_t i = 1; i < args.size(); i++)
+    {
+        cmd.AddArg(args[i]);
+    }
+    ctx.GetReply().Clear();
+    g_db->Call(ctx, cmd);
+    return ctx.GetReply();
+}
+
+struct CallThread: public Thread
+{
+        std::string cmdline;
+        RedisReply reply;
+        volatile bool done;
+        CallThread(const std::string& line) :
+                cmdline(line), done(false)
+        {
+        }
+        void Run()
+        {
+            Context ctx;
+            reply.Clone(test_call(ctx, cmdline));
+            done = true;
+        }
+};
+
+/*
+ * A run of pipelined SETs keeps its keys locked until the shared write batch is committed, a concurrent
+ * INCR must see the SET value instead of being overwritten by the commit.
+ */
+static int test_pipelined_set_run()
+{
+    Context ctx;
+    test_call(ctx, "del runkey1 runkey2");
+    StringArray keys;
+    keys.push_back("runkey1");
+    keys.push_back("runkey2");
+    KeyPrefixSet locked;
+    CallThread incr("incr runkey1");
+    bool waited = false;
+    g_db->LockRunKeys(ctx, keys, locked);
+    {
+        WriteBatchGuard guard(ctx, g_engine);
+        test_call(ctx, "set runkey1 10");
+        test_call(ctx, "set runkey2 20");
+        incr.Start();
+        Thread::Sleep(50);
+        waited = !incr.done;
+    }
+    g_db->UnlockRunKeys(ctx);
+    incr.Join();
+    TEST_ASSERT(waited);
+    TEST_ASSERT(incr.reply.GetInteger() == 11);
+    TEST_ASSERT(test_call(ctx, "get runkey1").GetString() == "11");
+    TEST_ASSERT(test_call(ctx, "get runkey2").GetString() == "20");
+    test_call(ctx, "del runkey1 runkey2");
+    return 0;
+}
+
+/*
+ * Commands inside EXEC run in one write batch and read the writes of the commands before them.
+ */
+static int test_exec_read_own_writes()
+{
+    Context ctx;
+    test_call(ctx, "del transkey");
+    test_call(ctx, "multi");
+    TEST_ASSERT(test_call(ctx, "set transkey 1").type == REDIS_REPLY_STATUS);
+    test_call(ctx, "get transkey");
+    test_call(ctx, "incr transkey");
+    RedisReply& r = test_call(ctx, "exec");
+    TEST_ASSERT(r.IsArray() && r.MemberSize() == 3);
+    TEST_ASSERT(r.MemberAt(0).type == REDIS_REPLY_STATUS);
+    TEST_ASSERT(r.MemberAt(1).GetString() == "1");
+    TEST_ASSERT(r.MemberAt(2).GetInteger() == 2);
+    TEST_ASSERT(test_call(ctx, "get transkey").GetString() == "2");
+    test_call(ctx, "del transkey");
+    return 0;
+}
+
+static int count_version_elements(Context& ctx, KeyType type, const std::string& key, uint64 version)
+{
+    KeyObject start(ctx.ns, type, key);
+    start.SetVersion(version);
+    Iterator* iter = g_engine->Find(ctx, start);
+    int count = 0;
+    while (NULL != iter && iter->Valid())
+    {
+        KeyObject& k = iter->Key();
+        if (k.GetType() != type || k.GetVersion() != version || k.GetKey() != start.GetKey())
+        {
+            break;
+        }
+        count++;
+        iter->Next();
+    }
+    DELETE(iter);
+    return count;
+}
+
+/*
+ * DEL of a versioned zset only removes its meta, the sweeper reclaims the elements of the old version.
+ */
+static int test_stale_version_sweep()
+{
+    Context ctx;
+    test_call(ctx, "del sweepzset");
+    for (int i = 0; i < 100; i++)
+    {
+        test_call(ctx, "zadd sweepzset " + stringfromll(i) + " m" + stringfromll(i));
+    }
+    KeyObject meta_key(ctx.ns, KEY_META, "sweepzset");
+    ValueObject meta;
+    TEST_ASSERT(0 == g_engine->Get(ctx, meta_key, meta));
+    uint64 version = meta.GetMetaObject().version;
+    TEST_ASSERT(version > 0);
+    TEST_ASSERT(count_version_elements(ctx, KEY_ZSET_SORT, "sweepzset", version) == 100);
+    TEST_ASSERT(test_call(ctx, "del sweepzset").GetInteger() == 1);
+    test_call(ctx, "zadd sweepzset 1 a");
+    TEST_ASSERT(test_call(ctx, "zcard sweepzset").GetInteger() == 1);
+    test_call(ctx, "debug sweep");
+    TEST_ASSERT(count_version_elements(ctx, KEY_ZSET_SORT, "sweepzset", version) == 0);
+    TEST_ASSERT(count_version_elements(ctx, KEY_ZSET_SCORE, "sweepzset", version) == 0);
+    TEST_ASSERT(test_call(ctx, "zscore sweepzset a").GetString() == "1");
+    test_call(ctx, "del sweepzset");
+    return 0;
+}
+
+static std::string match_patterns(PubSubPatternIndex& index, const std::string& channel)
+{
+    StringArray patterns;
+    index.Match(channel, patterns);
+    std::string s;
+    for (size_t i = 0; i < patterns.size(); i++)
+    {
+        s.append(i > 0 ? " " : "").append(patterns[i]);
+    }
+    return s;
+}
+
+static int test_pubsub_pattern_index()
+{
+    PubSubPatternIndex index;
+    index.Add("*");
+    index.Add("h?llo");
+    index.Add("h[ae]llo");
+    index.Add("h\\*llo");
+    index.Add("news.*");
+    TEST_ASSERT(match_patterns(index, "hello") == "* h?llo h[ae]llo");
+    TEST_ASSERT(match_patterns(index, "h*llo") == "* h?llo h\\*llo");
+    TEST_ASSERT(match_patterns(index, "heello") == "*");
+    TEST_ASSERT(match_patterns(index, "news.sport") == "* news.*");
+    TEST_ASSERT(match_patterns(index, "new") == "*");
+    TEST_ASSERT(match_patterns(index, "") == "*");
+    index.Remove("*");
+    TEST_ASSERT(match_patterns(index, "hallo") == "h?llo h[ae]llo");
+    index.Remove("h?llo");
+    index.Remove("h[ae]llo");
+    TEST_ASSERT(match_patterns(index, "hallo") == "");
+    TEST_ASSERT(match_patterns(index, "h*llo") == "h\\*llo");
+    index.Remove("not-subscribed");
+    TEST_ASSERT(match_patterns(index, "news.") == "news.*");
+    return 0;
+}
+
+/*
+ * Reserves a replication sequence, then stages 'set <key> 1' or an empty placeholder once told to.
+ */
+struct SequenceThread: public Thread
+{
+        RedisCommandFrame cmd;
+        bool placeholder;
+        volatile int step;
+        SequenceThread(const std::string& key, bool empty) :
+                cmd("set"), placeholder(empty), step(0)
+        {
+            cmd.AddArg(key);
+            cmd.AddArg("1");
+        }
+        void Run()
+        {
+            Context ctx;
+            g_repl->GetReplLog().ReserveSequence();
+            step = 1;
+            while (step == 1)
+            {
+                Thread::Sleep(1);
+            }
+            if (placeholder)
+            {
+                g_repl->GetReplLog().ReleaseSequence();
+            }
+            else
+            {
+                g_repl->GetReplLog().WriteWAL(ctx.ns, cmd, true);
+            }
+            step = 3;
+        }
+};
+
+static size_t append_wal(const void* log, size_t loglen, void* data)
+{
+    ((std::string*) data)->append((const char*) log, loglen);
+    return loglen;
+}
+
+static std::string wal_since(uint64 offset, const std::string& wait_for)
+{
+    std::string wal;
+    for (int i = 0; i < 100; i++)
+    {
+        wal.clear();
+        uint64 end = g_repl->GetReplLog().WALEndOffset();
+        g_repl->GetReplLog().Replay(offset, end - offset, append_wal, &wal);
+        if (wait_for.empty() || wal.find(wait_for) != std::string::npos)
+        {
+            break;
+        }
+        Thread::Sleep(10);
+    }
+    return wal;
+}
+
+/*
+ * Commands are logged in sequence order: a later sequence waits in its staging ring until every
+ * reserved sequence before it is staged, with its command or with an empty placeholder.
+ */
+static int test_repl_sequence_order()
+{
+    g_repl->Init();
+    TEST_ASSERT(g_repl->IsInited());
+    uint64 start = g_repl->GetReplLog().WALEndOffset();
+    SequenceThread first("seqkey1", false);
+    SequenceThread gap("seqkey3", true);
+    first.Start();
+    while (first.step != 1)
+    {
+        Thread::Sleep(1);
+    }
+    gap.Start();
+    while (gap.step != 1)
+    {
+        Thread::Sleep(1);
+    }
+    Context ctx;
+    RedisCommandFrame last("set");
+    last.AddArg("seqkey2");
+    last.AddArg("1");
+    g_repl->GetReplLog().WriteWAL(ctx.ns, last);
+    Thread::Sleep(50);
+    TEST_ASSERT(wal_since(start, "").find("seqkey2") == std::string::npos);
+
+    first.step = 2;
+    first.Join();
+    std::string wal = wal_since(start, "seqkey1");
+    TEST_ASSERT(wal.find("seqkey1") != std::string::npos);
+    TEST_ASSERT(wal.find("seqkey2") == std::string::npos);
+
+    gap.step = 2;
+    gap.Join();
+    wal = wal_since(start, "seqkey2");
+    TEST_ASSERT(wal.find("seqkey2") != std::string::npos);
+    TEST_ASSERT(wal.find("seqkey1") < wal.find("seqkey2"));
+    TEST_ASSERT(wal.find("seqkey3") == std::string::npos);
+    return 0;
+}
+
+static void writer_put(DBWriter& writer, Context& ctx, const std::string& cmdline)
+{
+    std::vector<std::string> args = split_string(cmdline, " ");
+    RedisCommandFrame cmd(args[0]);
+    for (size_t i = 1; i < args.size(); i++)
+    {
+        cmd.AddArg(args[i]);
+    }
+    writer.Put(ctx, cmd);
+}
+
+/*
+ * Synced commands are applied by key partitioned workers, a command spanning several workers must wait for
+ * the single key writes queued before it. A SELECT is no barrier, every queued command carries its namespace.
+ */
+static int test_dbwriter_barrier()
+{
+    DBWriter writer;
+    CallFlags flags;
+    flags.no_wal = 1;
+    writer.Init(4);
+    writer.SetDefaulFlags(flags);
+    Context ctx;
+    for (int i = 0; i < 64; i++)
+    {
+        writer_put(writer, ctx, "set wkey" + stringfromll(i) + " " + stringfromll(i));
+        writer_put(writer, ctx, "incr wkey" + stringfromll(i));
+    }
+    for (int i = 0; i < 32; i++)
+    {
+        writer_put(writer, ctx, "rename wkey" + stringfromll(i) + " wkey" + stringfromll(i + 32));
+    }
+    writer_put(writer, ctx, "mset wkey0 a wkey63 b");
+    writer_put(writer, ctx, "append wkey63 c");
+    writer_put(writer, ctx, "select 1");
+    writer_put(writer, ctx, "set wkey40 ns1");
+    writer_put(writer, ctx, "select 0");
+    writer_put(writer, ctx, "incr wkey40");
+    while (writer.QueueSize() > 0)
+    {
+        Thread::Sleep(1);
+    }
+    writer.Stop();
+
+    Context check;
+    TEST_ASSERT(test_call(check, "get wkey0").GetString() == "a");
+    TEST_ASSERT(test_call(check, "get wkey63").GetString() == "bc");
+    TEST_ASSERT(test_call(check, "get wkey40").GetString() == "10");
+    TEST_ASSERT(test_call(check, "exists wkey1").GetInteger() == 0);
+    TEST_ASSERT(test_call(check, "get wkey33").GetString() == "2");
+    TEST_ASSERT(test_call(check, "get wkey62").GetString() == "31");
+    test_call(check, "select 1");
+    TEST_ASSERT(test_call(check, "get wkey40").GetString() == "ns1");
+    test_call(check, "del wkey40");
+    test_call(check, "select 0");
+    for (int i = 0; i < 64; i++)
+    {
+        test_call(check, "del wkey" + stringfromll(i));
+    }
+    return 0;
+}
+
+/*
+ * Expired keys are removed in batches within the cycle time budget, big collections are handed over to the
+ * background delete threads with their key lock held.
+ */
+static int test_expire_cycle()
+{
+    ArdbConfig& conf = g_db->GetMutableConf();
+    int64 batch_size = conf.expire_batch_size;
+    int64 async_min_size = conf.expire_async_delete_min_size;
+    conf.expire_batch_size = 16;
+    conf.expire_async_delete_min_size = 20;
+    Context ctx;
+    StringArray keys;
+    for (int i = 0; i < 300; i++)
+    {
+        keys.push_back("expkey" + stringfromll(i));
+        test_call(ctx, "set " + keys.back() + " v");
+        test_call(ctx, "pexpire " + keys.back() + " 1");
+    }
+    for (int i = 0; i < 50; i++)
+    {
+        test_call(ctx, "hset exphash f" + stringfromll(i) + " v");
+    }
+    test_call(ctx, "pexpire exphash 1");
+    keys.push_back("exphash");
+    Thread::Sleep(10);
+    if (g_engine->GetFeatureSet().support_compactfilter)
+    {
+        /*
+         * the compaction filter feeds the expire set on these engines
+         */
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            g_db->AddExpiredKey(ctx.ns, Data(keys[i], false));
+        }
+    }
+    int64 expired = 0;
+    for (int i = 0; i < 100 && expired < (int64) keys.size(); i++)
+    {
+        expired += g_db->ScanExpiredKeys();
+    }
+    conf.expire_batch_size = batch_size;
+    conf.expire_async_delete_min_size = async_min_size;
+    TEST_ASSERT(expired == (int64) keys.size());
+    for (size_t i = 0; i < keys.size() - 1; i++)
+    {
+        KeyObject meta_key(ctx.ns, KEY_META, keys[i]);
+        ValueObject meta;
+        TEST_ASSERT(!g_engine->Exists(ctx, meta_key, meta));
+    }
+    /*
+     * the write waits for the background delete to release the key
+     */
+    test_call(ctx, "hset exphash f0 new");
+    TEST_ASSERT(test_call(ctx, "hlen exphash").GetInteger() == 1);
+    TEST_ASSERT(test_call(ctx, "hget exphash f0").GetString() == "new");
+    TEST_ASSERT(test_call(ctx, "pttl exphash").GetInteger() == -1);
+    test_call(ctx, "del exphash");
+    return 0;
+}
+
+static int count_key_records(Context& ctx, const std::string& key)
+{
+    KeyObject start(ctx.ns, KEY_META, key);
+    Iterator* iter = g_engine->Find(ctx, start);
+    int count = 0;
+    while (NULL != iter && iter->Valid())
+    {
+        KeyObject& k = iter->Key();
+        if (k.GetNameSpace() != ctx.ns || k.GetKey() != start.GetKey())
+        {
+            break;
+        }
+        count++;
+        iter->Next();
+    }
+    DELETE(iter);
+    return count;
+}
+
+/*
+ * UNLINK hands the key to the background delete threads, which remove it in chunks of
+ * 'async-delete-batch-size' records and keep the key locked until the last chunk is committed.
+ */
+static int test_unlink_chunked_delete()
+{
+    ArdbConfig& conf = g_db->GetMutableConf();
+    int64 batch_size = conf.async_delete_batch_size;
+    int64 range_min_size = conf.range_delete_min_size;
+    conf.async_delete_batch_size = 7;
+    conf.range_delete_min_size = 1000000;
+    Context ctx;
+    test_call(ctx, "del unlinkhash");
+    for (int i = 0; i < 100; i++)
+    {
+        test_call(ctx, "hset unlinkhash f" + stringfromll(i) + " v");
+    }
+    TEST_ASSERT(count_key_records(ctx, "unlinkhash") == 101);
+    TEST_ASSERT(test_call(ctx, "unlink unlinkhash").GetInteger() == 1);
+    /*
+     * the write waits for the background delete to release the key
+     */
+    test_call(ctx, "hset unlinkhash fresh v");
+    conf.async_delete_batch_size = batch_size;
+    conf.range_delete_min_size = range_min_size;
+    TEST_ASSERT(test_call(ctx, "hlen unlinkhash").GetInteger() == 1);
+    TEST_ASSERT(test_call(ctx, "hexists unlinkhash f0").GetInteger() == 0);
+    TEST_ASSERT(count_key_records(ctx, "unlinkhash") == 2);
+    test_call(ctx, "del unlinkhash");
+    return 0;
+}
+
+struct PushThread: public Thread
+{
+        int id;
+        int count;
+        PushThread(int i, int n) :
+                id(i), count(n)
+        {
+        }
+        void Run()
+        {
+            Context ctx;
+            for (int i = 0; i < count; i++)
+            {
+                test_call(ctx, "rpush gclist t" + stringfromll(id) + "-" + stringfromll(i));
+            }
+        }
+};
+
+/*
+ * Concurrent write batches are coalesced by the group committer, no batch is lost and the writes of one
+ * client keep their order.
+ */
+static int test_group_commit()
+{
+    if (NULL == g_group_committer)
+    {
+        printf("Engine does not support group commit, skipped.\n");
+        return 0;
+    }
+    Context ctx;
+    test_call(ctx, "del gclist");
+    uint64 groups = 0, batches = 0;
+    g_group_committer->Stats(groups, batches);
+    std::vector<PushThread*> threads;
+    for (int i = 0; i < 8; i++)
+    {
+        PushThread* t = NULL;
+        NEW(t, PushThread(i, 200));
+        t->Start();
+        threads.push_back(t);
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i]->Join();
+        DELETE(threads[i]);
+    }
+    uint64 end_groups = 0, end_batches = 0;
+    g_group_committer->Stats(end_groups, end_batches);
+    TEST_ASSERT(end_batches - batches >= 1600);
+    TEST_ASSERT(end_groups - groups <= end_batches - batches);
+    TEST_ASSERT(test_call(ctx, "llen gclist").GetInteger() == 1600);
+    RedisReply& r = test_call(ctx, "lrange gclist 0 -1");
+    TEST_ASSERT(r.MemberSize() == 1600);
+    std::vector<int> next(8, 0);
+    for (size_t i = 0; i < r.MemberSize(); i++)
+    {
+        const std::string& v = r.MemberAt(i).GetString();
+        int id = v[1] - '0';
+        TEST_ASSERT(v == "t" + stringfromll(id) + "-" + stringfromll(next[id]));
+        next[id]++;
+    }
+    test_call(ctx, "del gclist");
+    return 0;
+}
+
+/*
+ * Bulk strings of at least 4KB are not copied into the staging buffer but written from the reply with
+ * writev, the part a full pipe does not take is copied into the output buffer.
+ */
+static int test_reply_writev()
+{
+    RedisReply reply;
+    reply.AddMember().SetString(std::string(256 * 1024, 'a'));
+    reply.AddMember().SetInteger(10);
+    reply.AddMember().SetString("small");
+    reply.AddMember().SetString(std::string(5000, 'b'));
+    Buffer encoded;
+    codec::RedisReplyEncoder::Encode(encoded, reply);
+    std::string expected(encoded.GetRawReadBuffer(), encoded.ReadableBytes());
+
+    Buffer staged;
+    codec::RedisBulkSegmentArray segments;
+    codec::RedisReplyEncoder::Encode(staged, reply, &segments);
+    TEST_ASSERT(segments.size() == 2);
+    TEST_ASSERT(staged.ReadableBytes() + 256 * 1024 + 5000 == expected.size());
+    std::string scattered;
+    size_t pos = 0;
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        scattered.append(staged.GetRawReadBuffer() + pos, segments[i].offset - pos);
+        scattered.append(*segments[i].str);
+        pos = segments[i].offset;
+    }
+    scattered.append(staged.GetRawReadBuffer() + pos, staged.ReadableBytes() - pos);
+    TEST_ASSERT(scattered == expected);
+
+    int fds[2];
+    TEST_ASSERT(0 == pipe(fds));
+    make_fd_nonblocking(fds[0]);
+    make_fd_nonblocking(fds[1]);
+    codec::RedisReplyEncoder encoder;
+    ChannelService service;
+    PipeChannel* ch = service.NewPipeChannel(-1, fds[1]);
+    ch->GetPipeline().AddLast("encoder", &encoder);
+    TEST_ASSERT(ch->Write(reply));
+    std::string written;
+    char buf[4096];
+    ssize_t n = 0;
+    while ((n = ::read(fds[0], buf, sizeof(buf))) > 0)
+    {
+        written.append(buf, n);
+    }
+    Buffer& rest = ch->GetOutputBuffer();
+    TEST_ASSERT(written.size() < expected.size() && rest.ReadableBytes() > 0);
+    written.append(rest.GetRawReadBuffer(), rest.ReadableBytes());
+    TEST_ASSERT(written == expected);
+    rest.Clear();
+    ch->Close();
+    ::close(fds[0]);
+    return 0;
+}
+
+/*
+ * Saves the keys of 'ns' the way ardb snapshots were written before format version 2: raw key values in
+ * chunks after a SELECTDB opcode, no aux info and no parts manifest.
+ */
+class SnapshotV1Writer: public Snapshot
+{
+    public:
+        int SaveNameSpace(const std::string& file, const Data& ns)
+        {
+            if (0 != OpenWriteFile(file))
+            {
+                return -1;
+            }
+            /*
+             * 3 is ARDB_RDB_OPCODE_SELECTDB
+             */
+            if (Write("ARDB0001", 8) < 0 || WriteType(3) < 0 || WriteStringObject(ns) < 0)
+            {
+                Close();
+                return -1;
+            }
+            Context dumpctx;
+            dumpctx.flags.iterate_multi_keys = 1;
+            Iterator* iter = (Iterator*) GetIteratorByNamespace(dumpctx, ns);
+            while (iter->Valid())
+            {
+                int64 ttl = 0;
+                if (iter->Key().GetType() == KEY_META)
+                {
+                    ttl = iter->Value().GetTTL();
+                }
+                ArdbSaveRawKeyValue(iter->RawKey(), iter->RawValue(), m_write_buffer, ttl);
+                iter->Next();
+            }
+            DELETE(iter);
+            ArdbFlushWriteBuffer(m_write_buffer);
+            WriteType(255); /* REDIS_RDB_OPCODE_EOF */
+            uint64 cksm = m_cksm;
+            memrev64ifbe(&cksm);
+            Write(&cksm, sizeof(cksm));
+            Close();
+            return 0;
+        }
+};
+
+static void del_snapshot_keys(Context& ctx)
+{
+    test_call(ctx, "del snapkey snaphash snapzset snaplist");
+    test_call(ctx, "select 1");
+    test_call(ctx, "del snapkey");
+    test_call(ctx, "select 0");
+}
+
+static int check_snapshot_keys(Context& ctx, bool with_ns1)
+{
+    TEST_ASSERT(test_call(ctx, "get snapkey").GetString() == "v1");
+    TEST_ASSERT(test_call(ctx, "hget snaphash f").GetString() == "v");
+    TEST_ASSERT(test_call(ctx, "pttl snaphash").GetInteger() > 0);
+    TEST_ASSERT(test_call(ctx, "zscore snapzset b").GetString() == "2");
+    TEST_ASSERT(test_call(ctx, "zcard snapzset").GetInteger() == 2);
+    TEST_ASSERT(test_call(ctx, "lindex snaplist 1").GetString() == "b");
+    TEST_ASSERT(test_call(ctx, "llen snaplist").GetInteger() == 3);
+    test_call(ctx, "select 1");
+    RedisReply& r = test_call(ctx, "get snapkey");
+    bool ns1_ok = with_ns1 ? r.GetString() == "ns1" : r.type == REDIS_REPLY_NIL;
+    test_call(ctx, "select 0");
+    TEST_ASSERT(ns1_ok);
+    return 0;
+}
+
+/*
+ * A format version 2 snapshot is loaded back with all namespaces, snapshots of format version 1 are still
+ * loaded.
+ */
+static int test_snapshot_formats()
+{
+    Context ctx;
+    del_snapshot_keys(ctx);
+    test_call(ctx, "set snapkey v1");
+    test_call(ctx, "hset snaphash f v");
+    test_call(ctx, "pexpire snaphash 1000000");
+    test_call(ctx, "zadd snapzset 1 a 2 b");
+    test_call(ctx, "rpush snaplist a b c");
+    test_call(ctx, "select 1");
+    test_call(ctx, "set snapkey ns1");
+    test_call(ctx, "select 0");
+
+    Snapshot v2;
+    TEST_ASSERT(0 == v2.Save(ARDB_DUMP, "snapshot_test.ardb", NULL, NULL));
+    char magic[9] = { 0 };
+    FILE* fp = fopen(v2.GetPath().c_str(), "r");
+    TEST_ASSERT(NULL != fp);
+    size_t n = fread(magic, 8, 1, fp);
+    fclose(fp);
+    TEST_ASSERT(1 == n && std::string(magic) == "ARDB0002");
+    SnapshotV1Writer v1;
+    TEST_ASSERT(0 == v1.SaveNameSpace("snapshot_test_v1.ardb", ctx.ns));
+
+    del_snapshot_keys(ctx);
+    Snapshot v2_loader;
+    TEST_ASSERT(0 == v2_loader.Load(v2.GetPath(), NULL, NULL));
+    TEST_ASSERT(0 == check_snapshot_keys(ctx, true));
+
+    del_snapshot_keys(ctx);
+    Snapshot v1_loader;
+    TEST_ASSERT(0 == v1_loader.Load(v1.GetPath(), NULL, NULL));
+    TEST_ASSERT(0 == check_snapshot_keys(ctx, false));
+
+    v2.Remove();
+    v1.Remove();
+    del_snapshot_keys(ctx);
+    return 0;
+}
+
+struct SetBitThread: public Thread
+{
+        int id;
+        SetBitThread(int i) :
+                id(i)
+        {
+        }
+        void Run()
+        {
+            Context ctx;
+            for (int i = 0; i < 100; i++)
+            {
+                test_call(ctx, "setbit cbitmap " + stringfromll(i * 4 + id) + " 1");
+            }
+        }
+};
+
+/*
+ * Concurrent SETBITs on one chunked bitmap update its counters under the key lock, none is lost.
+ */
+static int test_concurrent_setbit()
+{
+    Context ctx;
+    test_call(ctx, "del cbitmap");
+    std::vector<SetBitThread*> threads;
+    for (int i = 0; i < 4; i++)
+    {
+        SetBitThread* t = NULL;
+        NEW(t, SetBitThread(i));
+        t->Start();
+        threads.push_back(t);
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i]->Join();
+        DELETE(threads[i]);
+    }
+    TEST_ASSERT(test_call(ctx, "bitcount cbitmap").GetInteger() == 400);
+    TEST_ASSERT(test_call(ctx, "strlen cbitmap").GetInteger() == 50);
+    test_call(ctx, "del cbitmap");
+    return 0;
+}
+
+/*
+ * A DEL inside EXEC range deletes the records of the key from the indexed batch, including the ones written
+ * earlier in the same EXEC.
+ */
+static int test_exec_del_own_writes()
+{
+    ArdbConfig& conf = g_db->GetMutableConf();
+    int64 range_min_size = conf.range_delete_min_size;
+    conf.range_delete_min_size = 0;
+    Context ctx;
+    test_call(ctx, "del txhash");
+    test_call(ctx, "hset txhash f0 v0");
+    test_call(ctx, "multi");
+    for (int i = 1; i <= 20; i++)
+    {
+        test_call(ctx, "hset txhash f" + stringfromll(i) + " v");
+    }
+    test_call(ctx, "del txhash");
+    test_call(ctx, "hset txhash fresh v");
+    RedisReply& r = test_call(ctx, "exec");
+    conf.range_delete_min_size = range_min_size;
+    TEST_ASSERT(r.IsArray() && r.MemberSize() == 22);
+    TEST_ASSERT(r.MemberAt(20).GetInteger() == 1);
+    TEST_ASSERT(test_call(ctx, "hlen txhash").GetInteger() == 1);
+    TEST_ASSERT(test_call(ctx, "hexists txhash f0").GetInteger() == 0);
+    TEST_ASSERT(test_call(ctx, "hexists txhash f20").GetInteger() == 0);
+    TEST_ASSERT(count_key_records(ctx, "txhash") == 2);
+    test_call(ctx, "del txhash");
+    return 0;
+}
+
+typedef int TestFunc();
+struct TestCase
+{
+        const char* name;
+        TestFunc* func;
+};
+
+static TestCase g_test_cases[] = {
+    { "pipelined set run", test_pipelined_set_run },
+    { "exec read own writes", test_exec_read_own_writes },
+    { "stale version sweep", test_stale_version_sweep },
+    { "pubsub pattern index", test_pubsub_pattern_index },
+    { "repl sequence order", test_repl_sequence_order },
+    { "dbwriter barrier", test_dbwriter_barrier },
+    { "expire cycle", test_expire_cycle },
+    { "unlink chunked delete", test_unlink_chunked_delete },
+    { "group commit", test_group_commit },
+    { "reply writev", test_reply_writev },
+    { "snapshot formats", test_snapshot_formats },
+    { "concurrent setbit", test_concurrent_setbit },
+    { "exec del own writes", test_exec_del_own_writes },
+};
+
 
 int main()
 {
@@ -46,6 +837,18 @@ int main()
         printf("Failed to init db.\n");
         return -1;
     }
+    for (size_t i = 0; i < arraysize(g_test_cases); i++)
+    {
+        printf("=======================%s Test Begin============================\n", g_test_cases[i].name);
+        uint64 start = get_current_epoch_millis();
+        int err = g_test_cases[i].func();
+        uint64 end = get_current_epoch_millis();
+        printf("=======================%s Test End(%" PRIu64 "ms)============================\n\n", g_test_cases[i].name, (end - start));
+        if (0 != err)
+        {
+            return -1;
+        }
+    }
     LUAInterpreter interpreter;
     std::deque<std::string> fs;
     std::string command_test_path = "../commands/";